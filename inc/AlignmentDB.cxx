@@ -0,0 +1,325 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: AlignmentDB.cxx                                                     //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class stores the map parameters of many runs in one binary file      //
+//  (TestBeamOutput/MapParameters/alignment.db). Each entry holds the map     //
+//  parameters and errors of the four orientations, the chosen orientation,   //
+//  the run and time interval it is valid for, and where it came from. The    //
+//  entries are fixed-size records kept sorted by run and start time, so      //
+//  the whole file is read with one call and a lookup is a binary search.     //
+//                                                                            //
+//  When a run has several calibration points, e.g. because the alignment     //
+//  drifted during a campaign, getAlignment() interpolates linearly between   //
+//  the centres of the two intervals around the requested time. Before the    //
+//  first and after the last centre the nearest point is used.                //
+//                                                                            //
+//  Several programs may add entries for different runs at the same time. A   //
+//  writer holds lock() from load() until after save(), so that no entries    //
+//  of another writer are lost.                                               //
+//                                                                            //
+//  Version 2 of the file adds the statistical uncertainties and the          //
+//  residual slopes and rotation to each entry. Files of version 1 are still  //
+//  read, with these set to zero, and are written as version 2.               //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "AlignmentDB.h"
+
+// Identifies the database file format:
+static const char alignmentMagic[8] = {'T','B','A','L','I','G','N','\0'};
+static const int alignmentVersion = 2;
+
+// The size of a version 1 entry, which is the start of a version 2 entry:
+static const int alignmentEntrySizeV1 = (int)offsetof(AlignmentEntry,
+						      mapStatErr);
+
+/**
+   Initialize an empty database. Call load() to read the file.
+   @param newFileName - the name of the database file.
+*/
+AlignmentDB::AlignmentDB(TString newFileName) {
+  fileName = newFileName;
+  lockDescriptor = -1;
+  entries.clear();
+}
+
+/**
+   Release the lock, if it is held.
+*/
+AlignmentDB::~AlignmentDB() {
+  unlock();
+}
+
+/**
+   Wait for exclusive access to the database, using an flock() on the file
+   "<database>.lock" next to it. Hold it across load(), addEntry() and save()
+   when updating the database, then call unlock().
+   @returns - true iff the lock was acquired.
+*/
+bool AlignmentDB::lock() {
+  if (lockDescriptor >= 0) return true;
+  TString lockName = Form("%s.lock", fileName.Data());
+  lockDescriptor = open(lockName.Data(), O_RDWR | O_CREAT, 0644);
+  if (lockDescriptor < 0) {
+    std::cout << "AlignmentDB: Could not open " << lockName << std::endl;
+    return false;
+  }
+  if (flock(lockDescriptor, LOCK_EX) != 0) {
+    std::cout << "AlignmentDB: Could not lock " << lockName << std::endl;
+    close(lockDescriptor);
+    lockDescriptor = -1;
+    return false;
+  }
+  return true;
+}
+
+/**
+   Release the lock taken by lock().
+*/
+void AlignmentDB::unlock() {
+  if (lockDescriptor < 0) return;
+  flock(lockDescriptor, LOCK_UN);
+  close(lockDescriptor);
+  lockDescriptor = -1;
+}
+
+/**
+   Add an entry, replacing any entry for the same run and time interval.
+   @param entry - the alignment to add.
+*/
+void AlignmentDB::addEntry(AlignmentEntry entry) {
+  if (entry.created == 0) entry.created = (Long64_t)time(NULL);
+  std::vector<AlignmentEntry>::iterator position
+    = std::lower_bound(entries.begin(), entries.end(), entry, isBefore);
+  if (position != entries.end() &&
+      strncmp(position->runName, entry.runName, sizeof(entry.runName)) == 0 &&
+      position->startTime == entry.startTime &&
+      position->stopTime == entry.stopTime) {
+    *position = entry;
+  }
+  else entries.insert(position, entry);
+}
+
+/**
+   Read the database file. A missing file gives an empty database.
+   @returns - true iff the file was read.
+*/
+bool AlignmentDB::load() {
+  entries.clear();
+  std::ifstream inputFile(fileName.Data(), std::ios::binary);
+  if (!inputFile.is_open()) return false;
+
+  char magic[8]; int version; int entrySize; Long64_t nEntries;
+  inputFile.read(magic, sizeof(magic));
+  inputFile.read((char*)&version, sizeof(version));
+  inputFile.read((char*)&entrySize, sizeof(entrySize));
+  inputFile.read((char*)&nEntries, sizeof(nEntries));
+  bool isCurrent = (version == alignmentVersion &&
+		    entrySize == (int)sizeof(AlignmentEntry));
+  bool isVersion1 = (version == 1 && entrySize == alignmentEntrySizeV1);
+  if (!inputFile || memcmp(magic, alignmentMagic, sizeof(magic)) != 0 ||
+      (!isCurrent && !isVersion1) || nEntries < 0) {
+    std::cout << "AlignmentDB: Cannot read " << fileName << std::endl;
+    return false;
+  }
+  entries.resize(nEntries);
+  if (nEntries > 0 && isCurrent) {
+    inputFile.read((char*)&entries[0], nEntries * sizeof(AlignmentEntry));
+  }
+  else if (nEntries > 0) {
+    // Version 1 entries lack the fields at the end:
+    memset(&entries[0], 0, nEntries * sizeof(AlignmentEntry));
+    for (Long64_t i_e = 0; i_e < nEntries; i_e++) {
+      inputFile.read((char*)&entries[i_e], entrySize);
+    }
+  }
+  if (!inputFile) {
+    entries.clear();
+    return false;
+  }
+  return true;
+}
+
+/**
+   Write the database file. The file is replaced in one step, so a reader
+   never sees a partial database.
+   @returns - true iff the file was written.
+*/
+bool AlignmentDB::save() {
+  TString tempName = Form("%s.%d.tmp", fileName.Data(), (int)getpid());
+  std::ofstream outputFile(tempName.Data(), std::ios::binary);
+  if (!outputFile.is_open()) {
+    std::cout << "AlignmentDB: Could not write " << fileName << std::endl;
+    return false;
+  }
+  int entrySize = (int)sizeof(AlignmentEntry);
+  Long64_t nEntries = (Long64_t)entries.size();
+  outputFile.write(alignmentMagic, sizeof(alignmentMagic));
+  outputFile.write((char*)&alignmentVersion, sizeof(alignmentVersion));
+  outputFile.write((char*)&entrySize, sizeof(entrySize));
+  outputFile.write((char*)&nEntries, sizeof(nEntries));
+  if (nEntries > 0) {
+    outputFile.write((char*)&entries[0], nEntries * sizeof(AlignmentEntry));
+  }
+  bool good = outputFile.good();
+  outputFile.close();
+  if (good && rename(tempName.Data(), fileName.Data()) == 0) return true;
+  remove(tempName.Data());
+  std::cout << "AlignmentDB: Could not write " << fileName << std::endl;
+  return false;
+}
+
+/**
+   Get the alignment of a run at a given time.
+   @param runName - the name of the run.
+   @param time - the time (unix time), or a negative value for the entry of
+   the run that was added last.
+   @param result - set to the alignment.
+   @returns - false if the run has no entries.
+*/
+bool AlignmentDB::getAlignment(TString runName, double time,
+			       AlignmentEntry &result) {
+  int first = 0; int last = 0;
+  findRun(runName, first, last);
+  if (first == last) return false;
+
+  if (time < 0) {
+    int latest = first;
+    for (int i_e = first+1; i_e < last; i_e++) {
+      if (entries[i_e].created >= entries[latest].created) latest = i_e;
+    }
+    result = entries[latest];
+    return true;
+  }
+
+  // Find the calibration points on either side of the time:
+  int after = first;
+  while (after < last &&
+	 0.5 * (entries[after].startTime + entries[after].stopTime) <= time) {
+    after++;
+  }
+  if (after == first || after == last) {
+    result = entries[after == first ? first : last-1];
+    return true;
+  }
+  const AlignmentEntry &previous = entries[after-1];
+  const AlignmentEntry &next = entries[after];
+  double centrePrevious = 0.5 * (previous.startTime + previous.stopTime);
+  double centreNext = 0.5 * (next.startTime + next.stopTime);
+  double fraction = (time - centrePrevious) / (centreNext - centrePrevious);
+
+  // Points with different orientations cannot be interpolated:
+  if (previous.orientation != next.orientation) {
+    result = fraction < 0.5 ? previous : next;
+    return true;
+  }
+  result = previous;
+  for (int i_h = 0; i_h < 4; i_h++) {
+    for (int i_p = 0; i_p < 4; i_p++) {
+      result.mapVar[i_h][i_p] = ((1.0 - fraction) * previous.mapVar[i_h][i_p] +
+				 fraction * next.mapVar[i_h][i_p]);
+      result.mapErr[i_h][i_p] = ((1.0 - fraction) * previous.mapErr[i_h][i_p] +
+				 fraction * next.mapErr[i_h][i_p]);
+      result.mapStatErr[i_h][i_p]
+	= ((1.0 - fraction) * previous.mapStatErr[i_h][i_p] +
+	   fraction * next.mapStatErr[i_h][i_p]);
+    }
+    for (int i_s = 0; i_s < 2; i_s++) {
+      result.slopeCorr[i_h][i_s]
+	= ((1.0 - fraction) * previous.slopeCorr[i_h][i_s] +
+	   fraction * next.slopeCorr[i_h][i_s]);
+    }
+    result.rotation[i_h] = ((1.0 - fraction) * previous.rotation[i_h] +
+			    fraction * next.rotation[i_h]);
+  }
+  result.startTime = centrePrevious;
+  result.stopTime = centreNext;
+  setText(result.provenance, sizeof(result.provenance),
+	  Form("interpolated at %.0f", time));
+  return true;
+}
+
+/**
+   Get the entry that was added last, whatever its run.
+   @param result - set to the alignment.
+   @returns - false if the database is empty.
+*/
+bool AlignmentDB::getLatest(AlignmentEntry &result) {
+  if (entries.empty()) return false;
+  int latest = 0;
+  for (int i_e = 1; i_e < (int)entries.size(); i_e++) {
+    if (entries[i_e].created >= entries[latest].created) latest = i_e;
+  }
+  result = entries[latest];
+  return true;
+}
+
+/**
+   Get the number of entries.
+*/
+int AlignmentDB::getNEntries() {
+  return (int)entries.size();
+}
+
+/**
+   Print the runs, intervals and origins of the entries.
+*/
+void AlignmentDB::printEntries() {
+  std::cout << "AlignmentDB: " << entries.size() << " entries in " << fileName
+	    << std::endl;
+  for (int i_e = 0; i_e < (int)entries.size(); i_e++) {
+    std::cout << "\t" << entries[i_e].runName << " ["
+	      << (Long64_t)entries[i_e].startTime << ", "
+	      << (Long64_t)entries[i_e].stopTime << ") orientation "
+	      << entries[i_e].orientation << " from "
+	      << entries[i_e].provenance << std::endl;
+  }
+}
+
+/**
+   Copy a string into a fixed-size field of an entry, truncating if needed.
+   @param field - the field.
+   @param size - the size of the field.
+   @param value - the string.
+*/
+void AlignmentDB::setText(char *field, int size, TString value) {
+  memset(field, 0, size);
+  strncpy(field, value.Data(), size-1);
+}
+
+/**
+   The order of the entries: by run name, then by start time.
+   @param first - the first entry.
+   @param second - the second entry.
+   @returns - true iff the first entry comes before the second.
+*/
+bool AlignmentDB::isBefore(const AlignmentEntry &first,
+			   const AlignmentEntry &second) {
+  int compare = strncmp(first.runName, second.runName, sizeof(first.runName));
+  if (compare != 0) return compare < 0;
+  return first.startTime < second.startTime;
+}
+
+/**
+   Find the entries of a run.
+   @param runName - the name of the run.
+   @param first - set to the index of the first entry of the run.
+   @param last - set to one past the index of the last entry of the run.
+*/
+void AlignmentDB::findRun(TString runName, int &first, int &last) {
+  AlignmentEntry key;
+  memset(&key, 0, sizeof(key));
+  setText(key.runName, sizeof(key.runName), runName);
+  key.startTime = -1e300;
+  first = (int)(std::lower_bound(entries.begin(), entries.end(), key,
+				 isBefore) - entries.begin());
+  last = first;
+  while (last < (int)entries.size() &&
+	 strncmp(entries[last].runName, key.runName,
+		 sizeof(key.runName)) == 0) {
+    last++;
+  }
+}
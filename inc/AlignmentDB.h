@@ -0,0 +1,81 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: AlignmentDB.h                                                       //
+//  Class: AlignmentDB.cxx                                                    //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef AlignmentDB_h
+#define AlignmentDB_h
+
+#include <stddef.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <algorithm>
+
+#include <fcntl.h>
+#include <sys/file.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "TString.h"
+
+// One alignment of the two chips, valid for a run during an interval of time.
+// Plain data, so that the database is read and written as a single block:
+struct AlignmentEntry {
+  char runName[32];
+  double startTime;// start of the validity interval (unix time)
+  double stopTime;// end of the validity interval
+  int orientation;// the orientation believed to be correct
+  double mapVar[4][4];// [orientation][parameter], as in MapParameters
+  double mapErr[4][4];
+  char provenance[96];// the program and inputs that made the alignment
+  Long64_t created;// when the entry was added (unix time)
+  // Added in version 2 (zero for entries from version 1 files):
+  double mapStatErr[4][4];// statistical uncertainty of the map peak
+  double slopeCorr[4][2];// residual relative slope of the rows and columns
+  double rotation[4];// residual rotation (rad)
+};
+
+class AlignmentDB {
+
+ public:
+
+  AlignmentDB(TString newFileName);
+  virtual ~AlignmentDB();
+
+  // Mutators:
+  void addEntry(AlignmentEntry entry);
+  bool load();
+  bool lock();
+  bool save();
+  void unlock();
+
+  // Accessors:
+  bool getAlignment(TString runName, double time, AlignmentEntry &result);
+  bool getLatest(AlignmentEntry &result);
+  int getNEntries();
+  void printEntries();
+  static void setText(char *field, int size, TString value);
+
+ private:
+
+  static bool isBefore(const AlignmentEntry &first,
+		       const AlignmentEntry &second);
+  void findRun(TString runName, int &first, int &last);
+
+  TString fileName;
+  int lockDescriptor;// -1 unless lock() is held
+
+  // Sorted by run name, then by start time:
+  std::vector<AlignmentEntry> entries;
+
+};
+
+#endif
@@ -0,0 +1,312 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: AnalysisPipeline.cxx                                                //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class runs a set of analysis stages that are connected through       //
+//  named products. Each stage declares the products it reads and the ones    //
+//  it writes. Asking for a product runs the stage that makes it, after       //
+//  first making that stage's inputs, and the product is then kept. A stage   //
+//  shared by several later stages therefore runs only once per job.          //
+//                                                                            //
+//  Typical use:                                                              //
+//    1. put() the input trees (not owned by the pipeline).                   //
+//    2. addStage() for each stage (see AnalysisStages.h).                    //
+//    3. get<Type>("ProductName") for the results.                            //
+//    4. To repeat part of the analysis with new settings, change the stage   //
+//       settings and invalidate() the first product affected. Everything     //
+//       downstream of it is recomputed on the next get().                    //
+//                                                                            //
+//  Optionally the outputs of cacheable stages are kept in a ResultCache      //
+//  between jobs. Call setCache() and give each input product a key with      //
+//  setInputKey() (e.g. ResultCache::fileKey() of the input file). The key    //
+//  of a stage combines its name, its parameters and the keys of its inputs,  //
+//  so it changes whenever anything upstream changes. A stage whose outputs   //
+//  are found in the cache is not run, and neither are the stages upstream    //
+//  of it unless another stage needs their products.                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "AnalysisPipeline.h"
+
+/**
+   Initialize an empty pipeline.
+*/
+AnalysisPipeline::AnalysisPipeline() {
+  stages.clear();
+  producers.clear();
+  products.clear();
+  running.clear();
+  cache = NULL;
+  inputKeys.clear();
+  productKeys.clear();
+}
+
+/**
+   Delete the stored products and the stages.
+*/
+AnalysisPipeline::~AnalysisPipeline() {
+  for (std::map<std::string,ProductBase*>::iterator it = products.begin();
+       it != products.end(); it++) {
+    delete it->second;
+  }
+  for (int i_s = 0; i_s < (int)stages.size(); i_s++) delete stages[i_s];
+}
+
+/**
+   Register a stage. The pipeline takes ownership of it.
+   @param stage - the stage to add.
+*/
+void AnalysisPipeline::addStage(AnalysisStage *stage) {
+  std::vector<TString> outputs = stage->getOutputs();
+  for (int i_o = 0; i_o < (int)outputs.size(); i_o++) {
+    if (producers.count((std::string)outputs[i_o]) > 0) {
+      std::cout << "AnalysisPipeline: Product " << outputs[i_o]
+		<< " already has a producer." << std::endl;
+      exit(0);
+    }
+    producers[(std::string)outputs[i_o]] = (int)stages.size();
+  }
+  stages.push_back(stage);
+  running.push_back(false);
+}
+
+/**
+   Remove a product and every product that depends on it, so that they are
+   recomputed when next requested.
+   @param productName - the name of the product.
+*/
+void AnalysisPipeline::invalidate(TString productName) {
+  // The stage settings may have changed, so the keys are computed again:
+  productKeys.clear();
+  removeProduct(productName);
+  for (int i_s = 0; i_s < (int)stages.size(); i_s++) {
+    std::vector<TString> inputs = stages[i_s]->getInputs();
+    for (int i_i = 0; i_i < (int)inputs.size(); i_i++) {
+      if (inputs[i_i].EqualTo(productName)) {
+	std::vector<TString> outputs = stages[i_s]->getOutputs();
+	for (int i_o = 0; i_o < (int)outputs.size(); i_o++) {
+	  invalidate(outputs[i_o]);
+	}
+	break;
+      }
+    }
+  }
+}
+
+/**
+   Make a product without retrieving it.
+   @param productName - the name of the product.
+*/
+void AnalysisPipeline::run(TString productName) {
+  getProduct(productName);
+}
+
+/**
+   Keep the outputs of cacheable stages between jobs.
+   @param newCache - the cache (not owned by the pipeline), or NULL for none.
+*/
+void AnalysisPipeline::setCache(ResultCache *newCache) {
+  cache = newCache;
+}
+
+/**
+   Set the key of an input product that is put() by the caller. Stages that
+   depend on an input without a key are not cached.
+   @param productName - the name of the product.
+   @param key - the key identifying the product contents.
+*/
+void AnalysisPipeline::setInputKey(TString productName, TString key) {
+  inputKeys[(std::string)productName] = key;
+  productKeys.clear();
+}
+
+/**
+   Check whether a product has already been made.
+   @param productName - the name of the product.
+*/
+bool AnalysisPipeline::hasProduct(TString productName) {
+  return (products.count((std::string)productName) > 0);
+}
+
+/**
+   Get the cache key of a product, which is that of the stage making it.
+   @param productName - the name of the product.
+   @returns - the key, or "" if some input has no key.
+*/
+TString AnalysisPipeline::getKey(TString productName) {
+  std::map<std::string,TString>::iterator found
+    = inputKeys.find((std::string)productName);
+  if (found != inputKeys.end()) return found->second;
+  found = productKeys.find((std::string)productName);
+  if (found != productKeys.end()) return found->second;
+  if (producers.count((std::string)productName) == 0) return "";
+
+  int stageIndex = producers[(std::string)productName];
+  AnalysisStage *stage = stages[stageIndex];
+  if (running[stageIndex]) {
+    std::cout << "AnalysisPipeline: Cycle found at stage " << stage->getName()
+	      << std::endl;
+    exit(0);
+  }
+  running[stageIndex] = true;
+  CacheKey key;
+  key.addString(stage->getName());
+  stage->hashParameters(key);
+  bool complete = true;
+  std::vector<TString> inputs = stage->getInputs();
+  for (int i_i = 0; i_i < (int)inputs.size(); i_i++) {
+    TString inputKey = getKey(inputs[i_i]);
+    if (inputKey.IsNull()) complete = false;
+    key.addString(inputs[i_i]);
+    key.addString(inputKey);
+  }
+  running[stageIndex] = false;
+
+  TString result = complete ? key.getKey() : TString("");
+  std::vector<TString> outputs = stage->getOutputs();
+  for (int i_o = 0; i_o < (int)outputs.size(); i_o++) {
+    productKeys[(std::string)outputs[i_o]] = result;
+  }
+  return result;
+}
+
+/**
+   Print the registered stages with their inputs and outputs.
+*/
+void AnalysisPipeline::printStages() {
+  std::cout << "AnalysisPipeline: " << stages.size() << " stages" << std::endl;
+  for (int i_s = 0; i_s < (int)stages.size(); i_s++) {
+    std::cout << "\t" << stages[i_s]->getName() << ":";
+    std::vector<TString> inputs = stages[i_s]->getInputs();
+    for (int i_i = 0; i_i < (int)inputs.size(); i_i++) {
+      std::cout << " " << inputs[i_i];
+    }
+    std::cout << " ->";
+    std::vector<TString> outputs = stages[i_s]->getOutputs();
+    for (int i_o = 0; i_o < (int)outputs.size(); i_o++) {
+      std::cout << " " << outputs[i_o];
+    }
+    std::cout << std::endl;
+  }
+}
+
+/**
+   Get a product, first running the stage that makes it (and the stages that
+   make its inputs) if it does not exist yet.
+   @param productName - the name of the product.
+   @returns - the stored product.
+*/
+ProductBase *AnalysisPipeline::getProduct(TString productName) {
+  std::map<std::string,ProductBase*>::iterator found
+    = products.find((std::string)productName);
+  if (found != products.end()) return found->second;
+
+  if (producers.count((std::string)productName) == 0) {
+    std::cout << "AnalysisPipeline: No stage produces " << productName
+	      << std::endl;
+    exit(0);
+  }
+  int stageIndex = producers[(std::string)productName];
+  AnalysisStage *stage = stages[stageIndex];
+  if (running[stageIndex]) {
+    std::cout << "AnalysisPipeline: Cycle found at stage " << stage->getName()
+	      << std::endl;
+    exit(0);
+  }
+
+  // Try the cache before making any of the inputs:
+  TString key = "";
+  if (cache && stage->isCacheable()) key = getKey(productName);
+  if (!key.IsNull() && loadStage(stageIndex, key)) {
+    found = products.find((std::string)productName);
+    if (found != products.end()) return found->second;
+  }
+
+  // Make the inputs first, then run the stage:
+  running[stageIndex] = true;
+  std::vector<TString> inputs = stage->getInputs();
+  for (int i_i = 0; i_i < (int)inputs.size(); i_i++) getProduct(inputs[i_i]);
+
+  TStopwatch timer;
+  timer.Start();
+  stage->run(this);
+  timer.Stop();
+  running[stageIndex] = false;
+  std::cout << "AnalysisPipeline: Ran " << stage->getName() << " in "
+	    << timer.RealTime() << " s." << std::endl;
+  if (!key.IsNull()) saveStage(stageIndex, key);
+
+  found = products.find((std::string)productName);
+  if (found == products.end()) {
+    std::cout << "AnalysisPipeline: Stage " << stage->getName()
+	      << " did not produce " << productName << std::endl;
+    exit(0);
+  }
+  return found->second;
+}
+
+/**
+   Load the outputs of a stage from the cache.
+   @param stageIndex - the index of the stage.
+   @param key - the stage key.
+   @returns - true iff all of the outputs were loaded.
+*/
+bool AnalysisPipeline::loadStage(int stageIndex, TString key) {
+  AnalysisStage *stage = stages[stageIndex];
+  std::ifstream input;
+  if (!cache->openInput(stage->getName(), key, input)) return false;
+
+  TStopwatch timer;
+  timer.Start();
+  bool loaded = stage->loadProducts(this, input);
+  input.close();
+  timer.Stop();
+
+  // Discard a partial load so that the stage is run instead:
+  std::vector<TString> outputs = stage->getOutputs();
+  for (int i_o = 0; i_o < (int)outputs.size(); i_o++) {
+    if (!hasProduct(outputs[i_o])) loaded = false;
+  }
+  if (!loaded) {
+    std::cout << "AnalysisPipeline: Cache entry for " << stage->getName()
+	      << " is unreadable, running the stage." << std::endl;
+    for (int i_o = 0; i_o < (int)outputs.size(); i_o++) {
+      removeProduct(outputs[i_o]);
+    }
+    return false;
+  }
+  std::cout << "AnalysisPipeline: Loaded " << stage->getName()
+	    << " from cache in " << timer.RealTime() << " s." << std::endl;
+  return true;
+}
+
+/**
+   Store the outputs of a stage in the cache.
+   @param stageIndex - the index of the stage.
+   @param key - the stage key.
+*/
+void AnalysisPipeline::saveStage(int stageIndex, TString key) {
+  AnalysisStage *stage = stages[stageIndex];
+  std::ofstream output;
+  if (!cache->openOutput(stage->getName(), key, output)) return;
+  bool saved = stage->saveProducts(this, output);
+  if (!cache->closeOutput(stage->getName(), key, output, saved)) {
+    std::cout << "AnalysisPipeline: Could not cache " << stage->getName()
+	      << std::endl;
+  }
+}
+
+/**
+   Delete a stored product, if it exists.
+   @param productName - the name of the product.
+*/
+void AnalysisPipeline::removeProduct(TString productName) {
+  std::map<std::string,ProductBase*>::iterator found
+    = products.find((std::string)productName);
+  if (found != products.end()) {
+    delete found->second;
+    products.erase(found);
+  }
+}
@@ -0,0 +1,147 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: AnalysisPipeline.h                                                  //
+//  Class: AnalysisPipeline.cxx                                               //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef AnalysisPipeline_h
+#define AnalysisPipeline_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TString.h"
+#include "TStopwatch.h"
+
+#include "ResultCache.h"
+
+class AnalysisPipeline;
+
+// Type-erased holder for the products stored by the pipeline:
+class ProductBase {
+ public:
+  virtual ~ProductBase() {};
+};
+
+template <class T> class Product : public ProductBase {
+ public:
+  Product(T *newValue, bool newOwner) : value(newValue), owner(newOwner) {};
+  virtual ~Product() { if (owner) delete value; };
+  T *getValue() { return value; };
+ private:
+  T *value;
+  bool owner;
+};
+
+// A single step of the analysis, with named inputs and outputs:
+class AnalysisStage {
+
+ public:
+
+  AnalysisStage(TString newName) : name(newName) {};
+  virtual ~AnalysisStage() {};
+
+  // Read the inputs from the pipeline and put the outputs into it:
+  virtual void run(AnalysisPipeline *pipeline) = 0;
+
+  // Caching of the outputs. Stages that do not override these always run:
+  virtual bool isCacheable() { return false; };
+  virtual void hashParameters(CacheKey &key) {};
+  virtual bool saveProducts(AnalysisPipeline *pipeline, std::ostream &output) {
+    return false;
+  };
+  virtual bool loadProducts(AnalysisPipeline *pipeline, std::istream &input) {
+    return false;
+  };
+
+  TString getName() { return name; };
+  std::vector<TString> getInputs() { return inputs; };
+  std::vector<TString> getOutputs() { return outputs; };
+
+ protected:
+
+  void addInput(TString productName) { inputs.push_back(productName); };
+  void addOutput(TString productName) { outputs.push_back(productName); };
+
+ private:
+
+  TString name;
+  std::vector<TString> inputs;
+  std::vector<TString> outputs;
+
+};
+
+class AnalysisPipeline {
+
+ public:
+
+  AnalysisPipeline();
+  virtual ~AnalysisPipeline();
+
+  // Mutators:
+  void addStage(AnalysisStage *stage);
+  void invalidate(TString productName);
+  void run(TString productName);
+  void setCache(ResultCache *newCache);
+  void setInputKey(TString productName, TString key);
+
+  /**
+     Store a product. Products that are not owned (e.g. the input trees) are
+     not deleted with the pipeline.
+     @param productName - the name of the product.
+     @param value - the product.
+     @param owner - true if the pipeline should delete the product.
+  */
+  template <class T> void put(TString productName, T *value, bool owner) {
+    removeProduct(productName);
+    products[(std::string)productName] = new Product<T>(value, owner);
+  };
+
+  /**
+     Get a product, running the stages that produce it if necessary.
+     @param productName - the name of the product.
+     @returns - a pointer to the product.
+  */
+  template <class T> T *get(TString productName) {
+    Product<T> *product = dynamic_cast<Product<T>*>(getProduct(productName));
+    if (!product) {
+      std::cout << "AnalysisPipeline: Product " << productName
+		<< " has an unexpected type." << std::endl;
+      exit(0);
+    }
+    return product->getValue();
+  };
+
+  // Accessors:
+  bool hasProduct(TString productName);
+  TString getKey(TString productName);
+  void printStages();
+
+ private:
+
+  ProductBase *getProduct(TString productName);
+  bool loadStage(int stageIndex, TString key);
+  void saveStage(int stageIndex, TString key);
+  void removeProduct(TString productName);
+
+  std::vector<AnalysisStage*> stages;
+  std::map<std::string,int> producers;// product name -> stage index
+  std::map<std::string,ProductBase*> products;
+  std::vector<bool> running;// for cycle detection
+
+  // Result caching:
+  ResultCache *cache;
+  std::map<std::string,TString> inputKeys;// keys of the input products
+  std::map<std::string,TString> productKeys;// computed stage keys
+
+};
+
+#endif
@@ -0,0 +1,904 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: AnalysisStages.cxx                                                  //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  The standard stages of the test beam analysis, for use with the           //
+//  AnalysisPipeline class. The input trees are provided by the caller as     //
+//  the products "TreeT3MAPS" (TreeT3MAPS) and "TreeFEI4" (TreeFEI4).         //
+//                                                                            //
+//  Stage        Inputs                           Outputs                     //
+//  EventBuild   TreeFEI4                         EventsFEI4                  //
+//  Occupancy    TreeT3MAPS, EventsFEI4           OccupancyT3MAPS/FEI4        //
+//  Mask         OccupancyT3MAPS/FEI4             MaskT3MAPS/FEI4             //
+//  Skim         EventsFEI4, MaskFEI4             SkimFEI4                    //
+//  Match        TreeT3MAPS, SkimFEI4, Masks      MatchCounts, BinnedCounts,  //
+//                                                PixelEfficiency             //
+//  Orientation  TreeT3MAPS, SkimFEI4, Masks      OrientationCounts,          //
+//                                                MatchCounts, BinnedCounts,  //
+//                                                PixelEfficiency             //
+//  Efficiency   MatchCounts                      Efficiency                  //
+//                                                                            //
+//  Orientation replaces Match when the chip orientation is not known. It     //
+//  matches the scans for all four orientations on parallel threads and       //
+//  gives the MatchCounts of the orientation with the best efficiency.        //
+//  BinnedCounts holds the same counts binned by the FEI4 rate and the        //
+//  T3MAPS multiplicity of the scans (see HitMatcher::setBinnedCounts()),     //
+//  and PixelEfficiency the counts of each T3MAPS pixel.                      //
+//                                                                            //
+//  All stages except Efficiency can store their outputs in the pipeline's    //
+//  ResultCache. Each one adds to the key the settings that change its        //
+//  outputs.                                                                  //
+//                                                                            //
+//  addInputTrees() and addSkimStages() set up the inputs and the stages up   //
+//  to Skim, which are the same in every program.                             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "AnalysisStages.h"
+
+#include "Instrument.h"
+
+/**
+   Group the FEI4 tree into events.
+*/
+EventBuildStage::EventBuildStage() : AnalysisStage("EventBuild") {
+  addInput("TreeFEI4");
+  addOutput("EventsFEI4");
+}
+
+/**
+   Read the FEI4 tree once and store the events.
+   @param pipeline - the pipeline holding the products.
+*/
+void EventBuildStage::run(AnalysisPipeline *pipeline) {
+  TreeFEI4 *cF = pipeline->get<TreeFEI4>("TreeFEI4");
+  EventBuilder *eventsFEI4 = new EventBuilder();
+  eventsFEI4->addEntries(cF);
+  pipeline->put<EventBuilder>("EventsFEI4", eventsFEI4, true);
+}
+
+/**
+   Save the FEI4 events to the cache.
+   @param pipeline - the pipeline holding the products.
+   @param output - the cache entry.
+   @returns - true on success.
+*/
+bool EventBuildStage::saveProducts(AnalysisPipeline *pipeline,
+				   std::ostream &output) {
+  pipeline->get<EventBuilder>("EventsFEI4")->write(output);
+  return true;
+}
+
+/**
+   Load the FEI4 events from the cache.
+   @param pipeline - the pipeline holding the products.
+   @param input - the cache entry.
+   @returns - true on success.
+*/
+bool EventBuildStage::loadProducts(AnalysisPipeline *pipeline,
+				   std::istream &input) {
+  EventBuilder *eventsFEI4 = new EventBuilder();
+  if (!eventsFEI4->read(input)) {
+    delete eventsFEI4;
+    return false;
+  }
+  pipeline->put<EventBuilder>("EventsFEI4", eventsFEI4, true);
+  return true;
+}
+
+/**
+   Fill the occupancy of every pixel in both chips.
+   @param newChips - the chip dimensions.
+*/
+OccupancyStage::OccupancyStage(ChipDimension *newChips)
+  : AnalysisStage("Occupancy") {
+  chips = newChips;
+  addInput("TreeT3MAPS");
+  addInput("EventsFEI4");
+  addOutput("OccupancyT3MAPS");
+  addOutput("OccupancyFEI4");
+}
+
+/**
+   Loop over the T3MAPS tree and the FEI4 hits once to fill the occupancies.
+   @param pipeline - the pipeline holding the products.
+*/
+void OccupancyStage::run(AnalysisPipeline *pipeline) {
+  TreeT3MAPS *cT = pipeline->get<TreeT3MAPS>("TreeT3MAPS");
+  EventBuilder *eventsFEI4 = pipeline->get<EventBuilder>("EventsFEI4");
+
+  INSTRUMENT_SCOPE("occupancy");
+  FixedHist *totOccFEI4 = bookOccupancy("FEI4");
+  FixedHist *totOccT3MAPS = bookOccupancy("T3MAPS");
+
+  // Loop over T3MAPS tree:
+  Long64_t entriesT3MAPS = cT->fChain->GetEntries();
+  for (Long64_t eventT3MAPS = 0; eventT3MAPS < entriesT3MAPS; eventT3MAPS++) {
+    {
+      INSTRUMENT_SCOPE("read.T3MAPS");
+      cT->fChain->GetEntry(eventT3MAPS);
+    }
+    for (int i_h = 0; i_h < (int)cT->hit_row->size(); i_h++) {
+      totOccT3MAPS->fill((*cT->hit_row)[i_h], (*cT->hit_column)[i_h]);
+    }
+  }
+  INSTRUMENT_COUNT("entries.T3MAPS", entriesT3MAPS);
+
+  // Loop over FEI4 hits:
+  for (Long64_t i_h = 0; i_h < eventsFEI4->getNHits(); i_h++) {
+    HitFEI4 *currHit = eventsFEI4->getHit(i_h);
+    totOccFEI4->fill(currHit->row-1, currHit->column-1);
+  }
+
+  pipeline->put<FixedHist>("OccupancyT3MAPS", totOccT3MAPS, true);
+  pipeline->put<FixedHist>("OccupancyFEI4", totOccFEI4, true);
+}
+
+/**
+   The occupancy binning depends on the chip dimensions.
+   @param key - the stage key.
+*/
+void OccupancyStage::hashParameters(CacheKey &key) {
+  key.addInt(chips->getNRow("FEI4"));
+  key.addInt(chips->getNCol("FEI4"));
+  key.addInt(chips->getNRow("T3MAPS"));
+  key.addInt(chips->getNCol("T3MAPS"));
+}
+
+/**
+   Save the occupancies to the cache.
+   @param pipeline - the pipeline holding the products.
+   @param output - the cache entry.
+   @returns - true on success.
+*/
+bool OccupancyStage::saveProducts(AnalysisPipeline *pipeline,
+				  std::ostream &output) {
+  pipeline->get<FixedHist>("OccupancyT3MAPS")->write(output);
+  pipeline->get<FixedHist>("OccupancyFEI4")->write(output);
+  return true;
+}
+
+/**
+   Load the occupancies from the cache.
+   @param pipeline - the pipeline holding the products.
+   @param input - the cache entry.
+   @returns - true on success.
+*/
+bool OccupancyStage::loadProducts(AnalysisPipeline *pipeline,
+				  std::istream &input) {
+  FixedHist *totOccT3MAPS = bookOccupancy("T3MAPS");
+  FixedHist *totOccFEI4 = bookOccupancy("FEI4");
+  if (!totOccT3MAPS->read(input) || !totOccFEI4->read(input)) {
+    delete totOccT3MAPS;
+    delete totOccFEI4;
+    return false;
+  }
+  pipeline->put<FixedHist>("OccupancyT3MAPS", totOccT3MAPS, true);
+  pipeline->put<FixedHist>("OccupancyFEI4", totOccFEI4, true);
+  return true;
+}
+
+/**
+   Book an empty occupancy histogram with one bin per pixel.
+   @param chipName - "FEI4" or "T3MAPS".
+   @returns - the histogram.
+*/
+FixedHist *OccupancyStage::bookOccupancy(std::string chipName) {
+  return new FixedHist(chips->getNRow(chipName), -0.5,
+		       (chips->getNRow(chipName) - 0.5),
+		       chips->getNCol(chipName), -0.5,
+		       (chips->getNCol(chipName) - 0.5));
+}
+
+/**
+   Find the noisy pixels from the occupancies.
+   @param newChips - the chip dimensions.
+   @param newThresholdFEI4 - FEI4 pixels with at least this many hits are masked.
+   @param newThresholdT3MAPS - T3MAPS pixels with more hits are masked.
+*/
+MaskStage::MaskStage(ChipDimension *newChips, int newThresholdFEI4,
+		     int newThresholdT3MAPS) : AnalysisStage("Mask") {
+  chips = newChips;
+  thresholdFEI4 = newThresholdFEI4;
+  thresholdT3MAPS = newThresholdT3MAPS;
+  addInput("OccupancyT3MAPS");
+  addInput("OccupancyFEI4");
+  addOutput("MaskT3MAPS");
+  addOutput("MaskFEI4");
+}
+
+/**
+   Make the mask lists. The programs store them in their results files.
+   @param pipeline - the pipeline holding the products.
+*/
+void MaskStage::run(AnalysisPipeline *pipeline) {
+  INSTRUMENT_SCOPE("mask");
+  FixedHist *totOccT3MAPS = pipeline->get<FixedHist>("OccupancyT3MAPS");
+  FixedHist *totOccFEI4 = pipeline->get<FixedHist>("OccupancyFEI4");
+  PixelList *maskT3MAPS = new PixelList();
+  PixelList *maskFEI4 = new PixelList();
+
+  // Get the FEI4 mask list:
+  for (int i_r = 1; i_r <= chips->getNRow("FEI4"); i_r++) {
+    for (int i_c = 1; i_c <= chips->getNCol("FEI4"); i_c++) {
+      int currNHits = (int)totOccFEI4->getBinContent(i_r, i_c);
+      if (currNHits >= thresholdFEI4) {
+	maskFEI4->push_back(std::make_pair(i_r-1, i_c-1));
+      }
+    }
+  }
+
+  // Get the T3MAPS mask list:
+  for (int i_r = 1; i_r <= chips->getNRow("T3MAPS"); i_r++) {
+    for (int i_c = 1; i_c <= chips->getNCol("T3MAPS"); i_c++) {
+      int currNHits = (int)totOccT3MAPS->getBinContent(i_r, i_c);
+      if (currNHits > thresholdT3MAPS) {
+	maskT3MAPS->push_back(std::make_pair(i_r-1, i_c-1));
+      }
+    }
+  }
+  std::cout << "MaskStage: Found pixels to mask: " << maskT3MAPS->size()
+	    << " in T3MAPS and " << maskFEI4->size() << " in FEI4."
+	    << std::endl;
+
+  pipeline->put<PixelList>("MaskT3MAPS", maskT3MAPS, true);
+  pipeline->put<PixelList>("MaskFEI4", maskFEI4, true);
+}
+
+/**
+   The masks depend on the thresholds.
+   @param key - the stage key.
+*/
+void MaskStage::hashParameters(CacheKey &key) {
+  key.addInt(thresholdFEI4);
+  key.addInt(thresholdT3MAPS);
+}
+
+/**
+   Save the mask lists to the cache.
+   @param pipeline - the pipeline holding the products.
+   @param output - the cache entry.
+   @returns - true on success.
+*/
+bool MaskStage::saveProducts(AnalysisPipeline *pipeline,
+			     std::ostream &output) {
+  ResultCache::writeVector(output, *pipeline->get<PixelList>("MaskT3MAPS"));
+  ResultCache::writeVector(output, *pipeline->get<PixelList>("MaskFEI4"));
+  return true;
+}
+
+/**
+   Load the mask lists from the cache.
+   @param pipeline - the pipeline holding the products.
+   @param input - the cache entry.
+   @returns - true on success.
+*/
+bool MaskStage::loadProducts(AnalysisPipeline *pipeline,
+			     std::istream &input) {
+  PixelList *maskT3MAPS = new PixelList();
+  PixelList *maskFEI4 = new PixelList();
+  if (!ResultCache::readVector(input, *maskT3MAPS) ||
+      !ResultCache::readVector(input, *maskFEI4)) {
+    delete maskT3MAPS;
+    delete maskFEI4;
+    return false;
+  }
+  std::cout << "MaskStage: Found pixels to mask: " << maskT3MAPS->size()
+	    << " in T3MAPS and " << maskFEI4->size() << " in FEI4."
+	    << std::endl;
+  pipeline->put<PixelList>("MaskT3MAPS", maskT3MAPS, true);
+  pipeline->put<PixelList>("MaskFEI4", maskFEI4, true);
+  return true;
+}
+
+/**
+   Keep only the FEI4 hits that can be used for matching. By default the
+   region is the whole chip except the noisy last column.
+   @param newChips - the chip dimensions.
+*/
+SkimStage::SkimStage(ChipDimension *newChips) : AnalysisStage("Skim") {
+  chips = newChips;
+  rowMin = 0;
+  rowMax = chips->getNRow("FEI4") - 1;
+  colMin = 0;
+  colMax = chips->getNCol("FEI4") - 2;
+  addInput("EventsFEI4");
+  addInput("MaskFEI4");
+  addOutput("SkimFEI4");
+}
+
+/**
+   Set the FEI4 region of interest (0-indexed, inclusive).
+   @param newRowMin - the lowest row.
+   @param newRowMax - the highest row.
+   @param newColMin - the lowest column.
+   @param newColMax - the highest column.
+*/
+void SkimStage::setRegion(int newRowMin, int newRowMax, int newColMin,
+			  int newColMax) {
+  rowMin = newRowMin;
+  rowMax = newRowMax;
+  colMin = newColMin;
+  colMax = newColMax;
+}
+
+/**
+   Copy the unmasked FEI4 hits inside the region into a new set of events.
+   @param pipeline - the pipeline holding the products.
+*/
+void SkimStage::run(AnalysisPipeline *pipeline) {
+  EventBuilder *eventsFEI4 = pipeline->get<EventBuilder>("EventsFEI4");
+  PixelList *maskFEI4 = pipeline->get<PixelList>("MaskFEI4");
+
+  // Flag the masked pixels for quick lookup:
+  int nColFEI4 = chips->getNCol("FEI4");
+  std::vector<bool> masked(chips->getNRow("FEI4") * nColFEI4, false);
+  for (int i_m = 0; i_m < (int)maskFEI4->size(); i_m++) {
+    masked[(*maskFEI4)[i_m].first * nColFEI4 + (*maskFEI4)[i_m].second] = true;
+  }
+
+  EventBuilder *skimFEI4 = new EventBuilder();
+  for (Long64_t i_e = 0; i_e < eventsFEI4->getNEvents(); i_e++) {
+    EventFEI4 *currEvent = eventsFEI4->getEvent(i_e);
+    for (Long64_t i_h = currEvent->offset;
+	 i_h < currEvent->offset + currEvent->length; i_h++) {
+      HitFEI4 *currHit = eventsFEI4->getHit(i_h);
+      int row = currHit->row - 1;
+      int col = currHit->column - 1;
+      if (row < rowMin || row > rowMax || col < colMin || col > colMax) {
+	continue;
+      }
+      if (masked[row * nColFEI4 + col]) continue;
+      skimFEI4->addHit(currEvent->event_number, currEvent->trigger_number,
+		       currEvent->LVL1ID, currEvent->timestamp_start,
+		       currEvent->timestamp_stop, currHit->row, currHit->column,
+		       currHit->tot, currHit->relative_BCID);
+    }
+  }
+  std::cout << "SkimStage: Kept " << skimFEI4->getNHits() << " of "
+	    << eventsFEI4->getNHits() << " FEI4 hits." << std::endl;
+  pipeline->put<EventBuilder>("SkimFEI4", skimFEI4, true);
+}
+
+/**
+   The skimmed hits depend on the region of interest.
+   @param key - the stage key.
+*/
+void SkimStage::hashParameters(CacheKey &key) {
+  key.addInt(rowMin);
+  key.addInt(rowMax);
+  key.addInt(colMin);
+  key.addInt(colMax);
+}
+
+/**
+   Save the skimmed FEI4 events to the cache.
+   @param pipeline - the pipeline holding the products.
+   @param output - the cache entry.
+   @returns - true on success.
+*/
+bool SkimStage::saveProducts(AnalysisPipeline *pipeline,
+			     std::ostream &output) {
+  pipeline->get<EventBuilder>("SkimFEI4")->write(output);
+  return true;
+}
+
+/**
+   Load the skimmed FEI4 events from the cache.
+   @param pipeline - the pipeline holding the products.
+   @param input - the cache entry.
+   @returns - true on success.
+*/
+bool SkimStage::loadProducts(AnalysisPipeline *pipeline,
+			     std::istream &input) {
+  EventBuilder *skimFEI4 = new EventBuilder();
+  if (!skimFEI4->read(input)) {
+    delete skimFEI4;
+    return false;
+  }
+  pipeline->put<EventBuilder>("SkimFEI4", skimFEI4, true);
+  return true;
+}
+
+/**
+   Match the T3MAPS scans to the skimmed FEI4 events.
+   @param newMapper - the geometrical map between the chips.
+   @param newChips - the chip dimensions.
+   @param newTimeOffset - the FEI4 - T3MAPS time offset in seconds.
+*/
+MatchStage::MatchStage(MapParameters *newMapper, ChipDimension *newChips,
+		       double newTimeOffset) : AnalysisStage("Match") {
+  mapper = newMapper;
+  chips = newChips;
+  timeOffset = newTimeOffset;
+  setScanCuts(12, 1, 16);
+  setRateBinWidth(5);
+  addInput("TreeT3MAPS");
+  addInput("SkimFEI4");
+  addInput("MaskT3MAPS");
+  addInput("MaskFEI4");
+  addOutput("MatchCounts");
+  addOutput("BinnedCounts");
+  addOutput("PixelEfficiency");
+}
+
+/**
+   Use a different map. Invalidate "MatchCounts" afterwards.
+   @param newMapper - the geometrical map between the chips.
+*/
+void MatchStage::setMapper(MapParameters *newMapper) {
+  mapper = newMapper;
+}
+
+/**
+   Set the width of the rate bins of "BinnedCounts".
+   @param newRateBinWidth - the number of FEI4 hits in the window per bin.
+*/
+void MatchStage::setRateBinWidth(int newRateBinWidth) {
+  rateBinWidth = newRateBinWidth;
+}
+
+/**
+   Set the T3MAPS quality cuts (see HitMatcher::setScanCuts()).
+   @param newMaxHits - scans with at least this many hits are skipped.
+   @param newRowMin - the lowest good T3MAPS row.
+   @param newRowMax - the highest good T3MAPS row.
+*/
+void MatchStage::setScanCuts(int newMaxHits, int newRowMin, int newRowMax) {
+  maxHitsT3MAPS = newMaxHits;
+  rowMinT3MAPS = newRowMin;
+  rowMaxT3MAPS = newRowMax;
+}
+
+/**
+   Use a different time offset. Invalidate "MatchCounts" afterwards.
+   @param newTimeOffset - the FEI4 - T3MAPS time offset in seconds.
+*/
+void MatchStage::setTimeOffset(double newTimeOffset) {
+  timeOffset = newTimeOffset;
+}
+
+/**
+   Loop over the T3MAPS scans and count the matched hits.
+   @param pipeline - the pipeline holding the products.
+*/
+void MatchStage::run(AnalysisPipeline *pipeline) {
+  TreeT3MAPS *cT = pipeline->get<TreeT3MAPS>("TreeT3MAPS");
+  EventBuilder *skimFEI4 = pipeline->get<EventBuilder>("SkimFEI4");
+
+  INSTRUMENT_SCOPE("match");
+  HitMatcher matcher(mapper, chips, timeOffset);
+  matcher.setScanCuts(maxHitsT3MAPS, rowMinT3MAPS, rowMaxT3MAPS);
+  matcher.setMask("T3MAPS", *pipeline->get<PixelList>("MaskT3MAPS"));
+  matcher.setMask("FEI4", *pipeline->get<PixelList>("MaskFEI4"));
+
+  MatchCounts *counts = new MatchCounts();
+  HitMatcher::resetCounts(*counts);
+  BinnedCounts *binned = new BinnedCounts();
+  HitMatcher::resetBinnedCounts(*binned, rateBinWidth);
+  matcher.setBinnedCounts(binned);
+  PixelEfficiency *pixels = new PixelEfficiency(chips->getNRow("T3MAPS"),
+						chips->getNCol("T3MAPS"));
+  matcher.setPixelEfficiency(pixels);
+  Long64_t eventFEI4 = 0;
+  Long64_t entriesT3MAPS = cT->fChain->GetEntries();
+  for (Long64_t eventT3MAPS = 0; eventT3MAPS < entriesT3MAPS; eventT3MAPS++) {
+    {
+      INSTRUMENT_SCOPE("read.T3MAPS");
+      cT->fChain->GetEntry(eventT3MAPS);
+    }
+    matcher.matchScan(cT->hit_row, cT->hit_column, cT->timestamp_start,
+		      cT->timestamp_stop, skimFEI4, eventFEI4, *counts);
+  }
+  INSTRUMENT_COUNT("entries.T3MAPS", entriesT3MAPS);
+  pipeline->put<MatchCounts>("MatchCounts", counts, true);
+  pipeline->put<BinnedCounts>("BinnedCounts", binned, true);
+  pipeline->put<PixelEfficiency>("PixelEfficiency", pixels, true);
+}
+
+/**
+   The counts depend on the time offset, the map in its current orientation,
+   the T3MAPS cuts and the rate bins.
+   @param key - the stage key.
+*/
+void MatchStage::hashParameters(CacheKey &key) {
+  key.addDouble(timeOffset);
+  key.addInt(mapper->getOrientation());
+  key.addInt(maxHitsT3MAPS);
+  key.addInt(rowMinT3MAPS);
+  key.addInt(rowMaxT3MAPS);
+  key.addInt(rateBinWidth);
+  for (int i_p = 0; i_p < 4; i_p++) {
+    key.addDouble(mapper->getMapVar(i_p));
+    key.addDouble(mapper->getMapErr(i_p));
+  }
+}
+
+/**
+   Save the matching counters to the cache.
+   @param pipeline - the pipeline holding the products.
+   @param output - the cache entry.
+   @returns - true on success.
+*/
+bool MatchStage::saveProducts(AnalysisPipeline *pipeline,
+			      std::ostream &output) {
+  ResultCache::writeValue(output, *pipeline->get<MatchCounts>("MatchCounts"));
+  ResultCache::writeValue(output,
+			  *pipeline->get<BinnedCounts>("BinnedCounts"));
+  pipeline->get<PixelEfficiency>("PixelEfficiency")->write(output);
+  return true;
+}
+
+/**
+   Load the matching counters from the cache.
+   @param pipeline - the pipeline holding the products.
+   @param input - the cache entry.
+   @returns - true on success.
+*/
+bool MatchStage::loadProducts(AnalysisPipeline *pipeline,
+			      std::istream &input) {
+  MatchCounts *counts = new MatchCounts();
+  BinnedCounts *binned = new BinnedCounts();
+  PixelEfficiency *pixels = new PixelEfficiency(chips->getNRow("T3MAPS"),
+						chips->getNCol("T3MAPS"));
+  if (!ResultCache::readValue(input, *counts) ||
+      !ResultCache::readValue(input, *binned) || !pixels->read(input)) {
+    delete counts;
+    delete binned;
+    delete pixels;
+    return false;
+  }
+  pipeline->put<MatchCounts>("MatchCounts", counts, true);
+  pipeline->put<BinnedCounts>("BinnedCounts", binned, true);
+  pipeline->put<PixelEfficiency>("PixelEfficiency", pixels, true);
+  return true;
+}
+
+// The number of T3MAPS scans read from the tree at a time by Orientation:
+static const int scanBlockSize = 4096;
+
+// A block of T3MAPS scans copied out of the tree, so that several threads
+// can match them at once. The vectors are reused from block to block:
+struct ScanBlock {
+  int nScans;
+  std::vector<std::vector<int> > rows;
+  std::vector<std::vector<int> > cols;
+  std::vector<double> starts;
+  std::vector<double> stops;
+};
+
+/**
+   Copy the next block of scans out of the T3MAPS tree.
+   @param cT - the T3MAPS tree.
+   @param firstEntry - the first entry to read.
+   @param block - the block to fill.
+   @returns - the entry following the block.
+*/
+static Long64_t readScanBlock(TreeT3MAPS *cT, Long64_t firstEntry,
+			      ScanBlock &block) {
+  INSTRUMENT_SCOPE("read.T3MAPS");
+  Long64_t entries = cT->fChain->GetEntries();
+  if ((int)block.rows.size() < scanBlockSize) {
+    block.rows.resize(scanBlockSize);
+    block.cols.resize(scanBlockSize);
+    block.starts.resize(scanBlockSize);
+    block.stops.resize(scanBlockSize);
+  }
+  block.nScans = 0;
+  Long64_t entry = firstEntry;
+  while (entry < entries && block.nScans < scanBlockSize) {
+    cT->fChain->GetEntry(entry);
+    block.rows[block.nScans] = *cT->hit_row;
+    block.cols[block.nScans] = *cT->hit_column;
+    block.starts[block.nScans] = cT->timestamp_start;
+    block.stops[block.nScans] = cT->timestamp_stop;
+    block.nScans++;
+    entry++;
+  }
+  INSTRUMENT_COUNT("entries.T3MAPS", block.nScans);
+  return entry;
+}
+
+// Matches one block of scans for one orientation. Each orientation has its
+// own matcher, FEI4 position and counters, so the tasks share nothing but
+// the (read-only) block, FEI4 events and map:
+class OrientationTask : public PoolTask {
+ public:
+  OrientationTask(ScanBlock *newBlock, HitMatcher *newMatcher,
+		  EventBuilder *newEventsFEI4, Long64_t *newEventFEI4,
+		  MatchCounts *newCounts) {
+    block = newBlock;
+    matcher = newMatcher;
+    eventsFEI4 = newEventsFEI4;
+    eventFEI4 = newEventFEI4;
+    counts = newCounts;
+  }
+  void run(ThreadPool *pool) {
+    INSTRUMENT_SCOPE("match.block");
+    for (int i_s = 0; i_s < block->nScans; i_s++) {
+      matcher->matchScan(&block->rows[i_s], &block->cols[i_s],
+			 block->starts[i_s], block->stops[i_s], eventsFEI4,
+			 *eventFEI4, *counts);
+    }
+  }
+ private:
+  ScanBlock *block;
+  HitMatcher *matcher;
+  EventBuilder *eventsFEI4;
+  Long64_t *eventFEI4;
+  MatchCounts *counts;
+};
+
+/**
+   Match the scans for all four chip orientations of the map.
+   @param newMapper - the geometrical map between the chips.
+   @param newChips - the chip dimensions.
+   @param newTimeOffset - the FEI4 - T3MAPS time offset in seconds.
+*/
+OrientationStage::OrientationStage(MapParameters *newMapper,
+				   ChipDimension *newChips,
+				   double newTimeOffset)
+  : AnalysisStage("Orientation") {
+  mapper = newMapper;
+  chips = newChips;
+  timeOffset = newTimeOffset;
+  setScanCuts(12, 1, 16);
+  setRateBinWidth(5);
+  addInput("TreeT3MAPS");
+  addInput("SkimFEI4");
+  addInput("MaskT3MAPS");
+  addInput("MaskFEI4");
+  addOutput("OrientationCounts");
+  addOutput("MatchCounts");
+  addOutput("BinnedCounts");
+  addOutput("PixelEfficiency");
+}
+
+/**
+   Set the width of the rate bins of "BinnedCounts".
+   @param newRateBinWidth - the number of FEI4 hits in the window per bin.
+*/
+void OrientationStage::setRateBinWidth(int newRateBinWidth) {
+  rateBinWidth = newRateBinWidth;
+}
+
+/**
+   Set the T3MAPS quality cuts (see HitMatcher::setScanCuts()).
+   @param newMaxHits - scans with at least this many hits are skipped.
+   @param newRowMin - the lowest good T3MAPS row.
+   @param newRowMax - the highest good T3MAPS row.
+*/
+void OrientationStage::setScanCuts(int newMaxHits, int newRowMin,
+				   int newRowMax) {
+  maxHitsT3MAPS = newMaxHits;
+  rowMinT3MAPS = newRowMin;
+  rowMaxT3MAPS = newRowMax;
+}
+
+/**
+   Use a different time offset. Invalidate "OrientationCounts" afterwards.
+   @param newTimeOffset - the FEI4 - T3MAPS time offset in seconds.
+*/
+void OrientationStage::setTimeOffset(double newTimeOffset) {
+  timeOffset = newTimeOffset;
+}
+
+/**
+   Read the T3MAPS scans in blocks and match each block for the four
+   orientations on four threads. The next block is read while the current
+   one is being matched.
+   @param pipeline - the pipeline holding the products.
+*/
+void OrientationStage::run(AnalysisPipeline *pipeline) {
+  TreeT3MAPS *cT = pipeline->get<TreeT3MAPS>("TreeT3MAPS");
+  EventBuilder *skimFEI4 = pipeline->get<EventBuilder>("SkimFEI4");
+  
+  OrientationCounts *result = new OrientationCounts();
+  HitMatcher *matchers[4];
+  PixelEfficiency *pixels[4];
+  Long64_t eventFEI4[4];
+  for (int i_h = 0; i_h < 4; i_h++) {
+    matchers[i_h] = new HitMatcher(mapper, chips, timeOffset);
+    matchers[i_h]->setOrientation(i_h);
+    matchers[i_h]->setScanCuts(maxHitsT3MAPS, rowMinT3MAPS, rowMaxT3MAPS);
+    matchers[i_h]->setMask("T3MAPS", *pipeline->get<PixelList>("MaskT3MAPS"));
+    matchers[i_h]->setMask("FEI4", *pipeline->get<PixelList>("MaskFEI4"));
+    HitMatcher::resetCounts(result->counts[i_h]);
+    HitMatcher::resetBinnedCounts(result->binned[i_h], rateBinWidth);
+    matchers[i_h]->setBinnedCounts(&result->binned[i_h]);
+    pixels[i_h] = new PixelEfficiency(chips->getNRow("T3MAPS"),
+				      chips->getNCol("T3MAPS"));
+    matchers[i_h]->setPixelEfficiency(pixels[i_h]);
+    eventFEI4[i_h] = 0;
+  }
+  
+  INSTRUMENT_SCOPE("match.orientations");
+  ThreadPool *pool = new ThreadPool(4);
+  ScanBlock blocks[2];
+  int current = 0;
+  Long64_t nextEntry = readScanBlock(cT, 0, blocks[current]);
+  while (blocks[current].nScans > 0) {
+    for (int i_h = 0; i_h < 4; i_h++) {
+      pool->submit(new OrientationTask(&blocks[current], matchers[i_h],
+				       skimFEI4, &eventFEI4[i_h],
+				       &result->counts[i_h]));
+    }
+    nextEntry = readScanBlock(cT, nextEntry, blocks[1-current]);
+    pool->wait();
+    current = 1 - current;
+  }
+  delete pool;
+  for (int i_h = 0; i_h < 4; i_h++) delete matchers[i_h];
+  
+  // Only the pixel counts of the best orientation are kept:
+  result->bestOrientation = getBestOrientation(*result);
+  for (int i_h = 0; i_h < 4; i_h++) {
+    if (i_h != result->bestOrientation) delete pixels[i_h];
+  }
+  putProducts(pipeline, result, pixels[result->bestOrientation]);
+}
+
+/**
+   The counts depend on the time offset, the map in all four orientations,
+   the T3MAPS cuts and the rate bins.
+   @param key - the stage key.
+*/
+void OrientationStage::hashParameters(CacheKey &key) {
+  key.addDouble(timeOffset);
+  key.addInt(maxHitsT3MAPS);
+  key.addInt(rowMinT3MAPS);
+  key.addInt(rowMaxT3MAPS);
+  key.addInt(rateBinWidth);
+  for (int i_h = 0; i_h < 4; i_h++) {
+    for (int i_p = 0; i_p < 4; i_p++) {
+      key.addDouble(mapper->getMapVar(i_p, i_h));
+      key.addDouble(mapper->getMapErr(i_p, i_h));
+    }
+  }
+}
+
+/**
+   Save the matching counters of all orientations to the cache.
+   @param pipeline - the pipeline holding the products.
+   @param output - the cache entry.
+   @returns - true on success.
+*/
+bool OrientationStage::saveProducts(AnalysisPipeline *pipeline,
+				    std::ostream &output) {
+  ResultCache::writeValue(output, *pipeline->get<OrientationCounts>
+			  ("OrientationCounts"));
+  pipeline->get<PixelEfficiency>("PixelEfficiency")->write(output);
+  return true;
+}
+
+/**
+   Load the matching counters of all orientations from the cache.
+   @param pipeline - the pipeline holding the products.
+   @param input - the cache entry.
+   @returns - true on success.
+*/
+bool OrientationStage::loadProducts(AnalysisPipeline *pipeline,
+				    std::istream &input) {
+  OrientationCounts *result = new OrientationCounts();
+  PixelEfficiency *pixels = new PixelEfficiency(chips->getNRow("T3MAPS"),
+						chips->getNCol("T3MAPS"));
+  if (!ResultCache::readValue(input, *result) || !pixels->read(input)) {
+    delete result;
+    delete pixels;
+    return false;
+  }
+  putProducts(pipeline, result, pixels);
+  return true;
+}
+
+/**
+   Find the orientation with the highest fraction of matched hits (both chips
+   together). The wrong orientations map most hits to the wrong pixels.
+   @param counts - the matching counters of the four orientations.
+   @returns - the best orientation (0-3).
+*/
+int OrientationStage::getBestOrientation(const OrientationCounts &counts) {
+  int best = 0;
+  double bestEfficiency = -1.0;
+  for (int i_h = 0; i_h < 4; i_h++) {
+    const MatchCounts &curr = counts.counts[i_h];
+    double efficiency
+      = HitMatcher::getEfficiency(curr.matchedT3MAPS + curr.matchedFEI4,
+				  curr.matchableT3MAPS + curr.matchableFEI4);
+    if (efficiency > bestEfficiency) {
+      best = i_h;
+      bestEfficiency = efficiency;
+    }
+  }
+  return best;
+}
+
+/**
+   Give the pipeline the counters of all orientations, and those of the best
+   orientation as "MatchCounts", "BinnedCounts" and "PixelEfficiency".
+   @param pipeline - the pipeline holding the products.
+   @param result - the counters of all orientations (owned by the pipeline).
+   @param pixels - the pixel counters of the best orientation (owned by the
+   pipeline).
+*/
+void OrientationStage::putProducts(AnalysisPipeline *pipeline,
+				   OrientationCounts *result,
+				   PixelEfficiency *pixels) {
+  MatchCounts *counts = new MatchCounts();
+  *counts = result->counts[result->bestOrientation];
+  BinnedCounts *binned = new BinnedCounts();
+  *binned = result->binned[result->bestOrientation];
+  pipeline->put<OrientationCounts>("OrientationCounts", result, true);
+  pipeline->put<MatchCounts>("MatchCounts", counts, true);
+  pipeline->put<BinnedCounts>("BinnedCounts", binned, true);
+  pipeline->put<PixelEfficiency>("PixelEfficiency", pixels, true);
+}
+
+/**
+   Compute the efficiencies from the matching counters.
+*/
+EfficiencyStage::EfficiencyStage() : AnalysisStage("Efficiency") {
+  addInput("MatchCounts");
+  addOutput("Efficiency");
+}
+
+/**
+   Divide the matched by the matchable hits in each chip (0 if there are no
+   matchable hits).
+   @param pipeline - the pipeline holding the products.
+*/
+void EfficiencyStage::run(AnalysisPipeline *pipeline) {
+  MatchCounts *counts = pipeline->get<MatchCounts>("MatchCounts");
+  EfficiencyResult *result = new EfficiencyResult();
+  result->effT3MAPS = HitMatcher::getEfficiency(counts->matchedT3MAPS,
+						counts->matchableT3MAPS);
+  result->effFEI4 = HitMatcher::getEfficiency(counts->matchedFEI4,
+					      counts->matchableFEI4);
+  pipeline->put<EfficiencyResult>("Efficiency", result, true);
+}
+
+/**
+   Open the T3MAPS and FEI4 trees of a run and put their readers into a
+   pipeline as "TreeT3MAPS" and "TreeFEI4". The readers are not owned by the
+   pipeline, and deleting them closes the files.
+   @param pipeline - the analysis pipeline.
+   @param inputT3MAPS - the T3MAPS ROOT file.
+   @param inputFEI4 - the FEI4 ROOT file.
+   @param cache - the cache for the stage products, or NULL for none. The
+   trees are keyed by their files, so that the products of earlier jobs with
+   the same inputs are reused.
+*/
+void addInputTrees(AnalysisPipeline *pipeline, TString inputT3MAPS,
+		   TString inputFEI4, ResultCache *cache) {
+  TFile *fileT3MAPS = new TFile(inputT3MAPS);
+  TTree *myTreeT3MAPS = (TTree*)fileT3MAPS->Get("TreeT3MAPS");
+  TFile *fileFEI4 = new TFile(inputFEI4);
+  TTree *myTreeFEI4 = (TTree*)fileFEI4->Get("Table");
+  pipeline->put<TreeT3MAPS>("TreeT3MAPS", new TreeT3MAPS(myTreeT3MAPS), false);
+  pipeline->put<TreeFEI4>("TreeFEI4", new TreeFEI4(myTreeFEI4), false);
+  if (cache) {
+    pipeline->setCache(cache);
+    pipeline->setInputKey("TreeT3MAPS", ResultCache::fileKey(inputT3MAPS));
+    pipeline->setInputKey("TreeFEI4", ResultCache::fileKey(inputFEI4));
+  }
+}
+
+/**
+   Add the event building, occupancy, masking and skimming stages to a
+   pipeline. The stages only run when one of their products is needed.
+   @param pipeline - the analysis pipeline.
+   @param chips - the chip dimensions.
+   @param noiseThresholdFEI4 - FEI4 pixels with at least this many hits are
+   masked.
+   @param noiseThresholdT3MAPS - T3MAPS pixels with more hits are masked.
+*/
+void addSkimStages(AnalysisPipeline *pipeline, ChipDimension *chips,
+		   int noiseThresholdFEI4, int noiseThresholdT3MAPS) {
+  pipeline->addStage(new EventBuildStage());
+  pipeline->addStage(new OccupancyStage(chips));
+  pipeline->addStage(new MaskStage(chips, noiseThresholdFEI4,
+				   noiseThresholdT3MAPS));
+  pipeline->addStage(new SkimStage(chips));
+}
@@ -0,0 +1,176 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: AnalysisStages.h                                                    //
+//  Class: AnalysisStages.cxx                                                 //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef AnalysisStages_h
+#define AnalysisStages_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "TFile.h"
+#include "TString.h"
+#include "TTree.h"
+
+#include "AnalysisPipeline.h"
+#include "ChipDimension.h"
+#include "EventBuilder.h"
+#include "FixedHist.h"
+#include "HitMatcher.h"
+#include "MapParameters.h"
+#include "PixelEfficiency.h"
+#include "ResultCache.h"
+#include "ThreadPool.h"
+#include "TreeFEI4.h"
+#include "TreeT3MAPS.h"
+
+// A list of (row, column) pixel positions:
+typedef std::vector<std::pair<int,int> > PixelList;
+
+// Track-by-track efficiencies (matched / matchable):
+struct EfficiencyResult {
+  double effT3MAPS;
+  double effFEI4;
+};
+
+// Track-by-track matching counters for each of the four chip orientations:
+struct OrientationCounts {
+  MatchCounts counts[4];
+  BinnedCounts binned[4];
+  int bestOrientation;
+};
+
+// TreeFEI4 -> EventsFEI4
+class EventBuildStage : public AnalysisStage {
+ public:
+  EventBuildStage();
+  void run(AnalysisPipeline *pipeline);
+  bool isCacheable() { return true; };
+  bool saveProducts(AnalysisPipeline *pipeline, std::ostream &output);
+  bool loadProducts(AnalysisPipeline *pipeline, std::istream &input);
+};
+
+// TreeT3MAPS, EventsFEI4 -> OccupancyT3MAPS, OccupancyFEI4
+class OccupancyStage : public AnalysisStage {
+ public:
+  OccupancyStage(ChipDimension *newChips);
+  void run(AnalysisPipeline *pipeline);
+  bool isCacheable() { return true; };
+  void hashParameters(CacheKey &key);
+  bool saveProducts(AnalysisPipeline *pipeline, std::ostream &output);
+  bool loadProducts(AnalysisPipeline *pipeline, std::istream &input);
+ private:
+  FixedHist *bookOccupancy(std::string chipName);
+  ChipDimension *chips;
+};
+
+// OccupancyT3MAPS, OccupancyFEI4 -> MaskT3MAPS, MaskFEI4
+class MaskStage : public AnalysisStage {
+ public:
+  MaskStage(ChipDimension *newChips, int newThresholdFEI4,
+	    int newThresholdT3MAPS);
+  void run(AnalysisPipeline *pipeline);
+  bool isCacheable() { return true; };
+  void hashParameters(CacheKey &key);
+  bool saveProducts(AnalysisPipeline *pipeline, std::ostream &output);
+  bool loadProducts(AnalysisPipeline *pipeline, std::istream &input);
+ private:
+  ChipDimension *chips;
+  int thresholdFEI4;
+  int thresholdT3MAPS;
+};
+
+// EventsFEI4, MaskFEI4 -> SkimFEI4
+class SkimStage : public AnalysisStage {
+ public:
+  SkimStage(ChipDimension *newChips);
+  void setRegion(int newRowMin, int newRowMax, int newColMin, int newColMax);
+  void run(AnalysisPipeline *pipeline);
+  bool isCacheable() { return true; };
+  void hashParameters(CacheKey &key);
+  bool saveProducts(AnalysisPipeline *pipeline, std::ostream &output);
+  bool loadProducts(AnalysisPipeline *pipeline, std::istream &input);
+ private:
+  ChipDimension *chips;
+  int rowMin;
+  int rowMax;
+  int colMin;
+  int colMax;
+};
+
+// TreeT3MAPS, SkimFEI4, MaskT3MAPS, MaskFEI4 -> MatchCounts, BinnedCounts,
+//                                                PixelEfficiency
+class MatchStage : public AnalysisStage {
+ public:
+  MatchStage(MapParameters *newMapper, ChipDimension *newChips,
+	     double newTimeOffset);
+  void setMapper(MapParameters *newMapper);
+  void setRateBinWidth(int newRateBinWidth);
+  void setScanCuts(int newMaxHits, int newRowMin, int newRowMax);
+  void setTimeOffset(double newTimeOffset);
+  void run(AnalysisPipeline *pipeline);
+  bool isCacheable() { return true; };
+  void hashParameters(CacheKey &key);
+  bool saveProducts(AnalysisPipeline *pipeline, std::ostream &output);
+  bool loadProducts(AnalysisPipeline *pipeline, std::istream &input);
+ private:
+  MapParameters *mapper;
+  ChipDimension *chips;
+  double timeOffset;
+  int maxHitsT3MAPS;
+  int rowMinT3MAPS;
+  int rowMaxT3MAPS;
+  int rateBinWidth;
+};
+
+// TreeT3MAPS, SkimFEI4, MaskT3MAPS, MaskFEI4 -> OrientationCounts,
+//                                                MatchCounts, BinnedCounts,
+//                                                PixelEfficiency
+class OrientationStage : public AnalysisStage {
+ public:
+  OrientationStage(MapParameters *newMapper, ChipDimension *newChips,
+		   double newTimeOffset);
+  void setRateBinWidth(int newRateBinWidth);
+  void setScanCuts(int newMaxHits, int newRowMin, int newRowMax);
+  void setTimeOffset(double newTimeOffset);
+  void run(AnalysisPipeline *pipeline);
+  bool isCacheable() { return true; };
+  void hashParameters(CacheKey &key);
+  bool saveProducts(AnalysisPipeline *pipeline, std::ostream &output);
+  bool loadProducts(AnalysisPipeline *pipeline, std::istream &input);
+  static int getBestOrientation(const OrientationCounts &counts);
+ private:
+  void putProducts(AnalysisPipeline *pipeline, OrientationCounts *result,
+		   PixelEfficiency *pixels);
+  MapParameters *mapper;
+  ChipDimension *chips;
+  double timeOffset;
+  int maxHitsT3MAPS;
+  int rowMinT3MAPS;
+  int rowMaxT3MAPS;
+  int rateBinWidth;
+};
+
+// MatchCounts -> Efficiency
+class EfficiencyStage : public AnalysisStage {
+ public:
+  EfficiencyStage();
+  void run(AnalysisPipeline *pipeline);
+};
+
+// The first part of every analysis, shared by the programs:
+void addInputTrees(AnalysisPipeline *pipeline, TString inputT3MAPS,
+		   TString inputFEI4, ResultCache *cache);
+void addSkimStages(AnalysisPipeline *pipeline, ChipDimension *chips,
+		   int noiseThresholdFEI4, int noiseThresholdT3MAPS);
+
+#endif
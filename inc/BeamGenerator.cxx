@@ -0,0 +1,367 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: BeamGenerator.cxx                                                   //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class generates synthetic test beam data in the formats of the real  //
+//  data: the FEI4 "Table" tree, the T3MAPS tree made by LoadT3MAPS and       //
+//  (optionally) the T3MAPS history.txt file. The chip map, orientation,      //
+//  time offset, efficiencies and noisy pixels are known, so the output of    //
+//  the analysis can be checked against them, and runs of any size can be     //
+//  made for benchmarks.                                                      //
+//                                                                            //
+//  The particles arrive at random times with a fixed rate, at positions      //
+//  from a Gaussian beam spot (in FEI4 coordinates). Each particle is an      //
+//  FEI4 trigger. It gives an FEI4 hit with probability effFEI4 if it is      //
+//  inside FEI4, and a T3MAPS hit with probability effT3MAPS if it crosses    //
+//  T3MAPS during an integration period. Noisy pixels add hits to the FEI4    //
+//  triggers and to the T3MAPS scans. The events are written as they are      //
+//  generated, so the memory use does not depend on the size of the run.      //
+//                                                                            //
+//  The settings are the "sim" settings of a run configuration (see           //
+//  RunConfig and config/synthetic.cfg), with the integrationTime and         //
+//  timeOffset of the run, so the analysis of the run uses the true values.   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "BeamGenerator.h"
+
+/**
+   Read the settings and choose the noisy pixels.
+   @param config - the run configuration with the generator settings.
+*/
+BeamGenerator::BeamGenerator(RunConfig *config) {
+  chips = new ChipDimension();
+  nRowFEI4 = chips->getNRow("FEI4");
+  nColFEI4 = chips->getNCol("FEI4");
+  nRowT3MAPS = chips->getNRow("T3MAPS");
+  nColT3MAPS = chips->getNCol("T3MAPS");
+  rowPitchFEI4 = chips->getRowPitch("FEI4");
+  colPitchFEI4 = chips->getColPitch("FEI4");
+  rowPitchT3MAPS = chips->getRowPitch("T3MAPS");
+  colPitchT3MAPS = chips->getColPitch("T3MAPS");
+
+  random = new TRandom3((UInt_t)config->getInt("simSeed"));
+  nScans = (Long64_t)config->getDouble("simScans");
+  startTime = config->getDouble("simStartTime");
+  integrationTime = config->getDouble("integrationTime");
+  scanGap = config->getDouble("simScanGap");
+  readoutTimeFEI4 = config->getDouble("simReadoutFEI4");
+  timeOffset = config->getDouble("timeOffset");
+  beamRate = config->getDouble("simBeamRate");
+  effFEI4 = config->getDouble("simEffFEI4");
+  effT3MAPS = config->getDouble("simEffT3MAPS");
+  nNoisyFEI4 = config->getInt("simNoisyFEI4");
+  noiseProbFEI4 = config->getDouble("simNoiseProbFEI4");
+  nNoisyT3MAPS = config->getInt("simNoisyT3MAPS");
+  noiseProbT3MAPS = config->getDouble("simNoiseProbT3MAPS");
+
+  // The true map, with the signs of MapParameters:
+  orientation = config->getInt("simOrientation");
+  rowOffset = config->getDouble("simRowOffset");
+  colOffset = config->getDouble("simColOffset");
+  rowSign = (orientation == 2 || orientation == 3) ? -1.0 : 1.0;
+  colSign = (orientation == 1 || orientation == 3) ? -1.0 : 1.0;
+
+  // A negative beam position centers the beam on the image of T3MAPS:
+  beamRow = config->getDouble("simBeamRow");
+  beamCol = config->getDouble("simBeamCol");
+  if (beamRow < 0.0) {
+    beamRow = rowOffset + rowSign * 0.5 * nRowT3MAPS * rowPitchT3MAPS;
+  }
+  if (beamCol < 0.0) {
+    beamCol = colOffset + colSign * 0.5 * nColT3MAPS * colPitchT3MAPS;
+  }
+  beamSigmaRow = config->getDouble("simBeamSigmaRow");
+  beamSigmaCol = config->getDouble("simBeamSigmaCol");
+
+  if (beamRate <= 0.0 || integrationTime <= 0.0 || readoutTimeFEI4 <= 0.0 ||
+      orientation < 0 || orientation > 3) {
+    std::cout << "BeamGenerator: Bad settings." << std::endl;
+    exit(0);
+  }
+
+  noisyFEI4.clear();
+  for (int i_n = 0; i_n < nNoisyFEI4; i_n++) {
+    noisyFEI4.push_back(std::make_pair((int)random->Integer(nRowFEI4),
+				       (int)random->Integer(nColFEI4)));
+  }
+  noisyT3MAPS.clear();
+  for (int i_n = 0; i_n < nNoisyT3MAPS; i_n++) {
+    noisyT3MAPS.push_back(std::make_pair((int)random->Integer(nRowT3MAPS),
+					 (int)random->Integer(nColT3MAPS)));
+  }
+
+  hit_row = new std::vector<int>();
+  hit_column = new std::vector<int>();
+}
+
+/**
+   Delete the generator.
+*/
+BeamGenerator::~BeamGenerator() {
+  delete hit_row;
+  delete hit_column;
+  delete random;
+  delete chips;
+}
+
+/**
+   Generate a run and write it to files.
+   @param fileT3MAPS - the T3MAPS ROOT file.
+   @param fileFEI4 - the FEI4 ROOT file.
+   @param fileHistory - the T3MAPS history text file ("" for none).
+   @returns - the numbers of particles, scans and hits generated.
+*/
+BeamSummary BeamGenerator::generate(TString fileT3MAPS, TString fileFEI4,
+				    TString fileHistory) {
+  summary.nParticles = 0;
+  summary.nScans = 0;
+  summary.nHitsFEI4 = 0;
+  summary.nNoiseHitsFEI4 = 0;
+  summary.nHitsT3MAPS = 0;
+  summary.nNoiseHitsT3MAPS = 0;
+  summary.nParticlesInT3MAPS = 0;
+  event_number = -1;
+  trigger_number = 0;
+
+  openTrees(fileT3MAPS, fileFEI4);
+  std::ofstream history;
+  if (!fileHistory.IsNull()) history.open(fileHistory.Data());
+
+  // The particle times are on the FEI4 clock, which is ahead of the T3MAPS
+  // clock by the time offset:
+  double scanPeriod = integrationTime + scanGap;
+  Long64_t currScan = 0;
+  scanStart = startTime;
+  scanStop = startTime + integrationTime;
+  scanHits.clear();
+  double time = startTime + timeOffset;
+  while (currScan < nScans) {
+    time += random->Exp(1.0 / beamRate);
+    double timeT3MAPS = time - timeOffset;
+
+    // Write the scans that ended before this particle:
+    while (currScan < nScans && timeT3MAPS >= scanStop) {
+      finishScan(history);
+      currScan++;
+      scanStart = startTime + currScan * scanPeriod;
+      scanStop = scanStart + integrationTime;
+      if (nScans >= 10 && currScan % (nScans / 10) == 0) {
+	std::cout << "BeamGenerator: " << currScan << " of " << nScans
+		  << " scans." << std::endl;
+      }
+    }
+    if (currScan >= nScans) break;
+    summary.nParticles++;
+
+    // The FEI4 trigger, read out in the period containing it:
+    event_number++;
+    trigger_number++;
+    LVL1ID = (UShort_t)(event_number % 4096);
+    BCID = (UShort_t)(event_number % 65536);
+    timestamp_start = floor(time / readoutTimeFEI4) * readoutTimeFEI4;
+    timestamp_stop = timestamp_start + readoutTimeFEI4;
+
+    // The particle position in FEI4 coordinates:
+    double rowPos = random->Gaus(beamRow, beamSigmaRow);
+    double colPos = random->Gaus(beamCol, beamSigmaCol);
+    int pixelRow = -1; int pixelCol = -1;
+    if (findPixelFEI4(rowPos, colPos, pixelRow, pixelCol) &&
+	random->Rndm() < effFEI4) {
+      fillHitFEI4(pixelRow, pixelCol);
+      summary.nHitsFEI4++;
+    }
+
+    // Noise hits in the same trigger:
+    if (nNoisyFEI4 > 0) {
+      int nNoise = random->Poisson(nNoisyFEI4 * noiseProbFEI4);
+      for (int i_n = 0; i_n < nNoise; i_n++) {
+	std::pair<int,int> pixel = noisyFEI4[random->Integer(nNoisyFEI4)];
+	fillHitFEI4(pixel.first, pixel.second);
+	summary.nNoiseHitsFEI4++;
+      }
+    }
+
+    // T3MAPS only records the particles during its integration periods:
+    if (timeT3MAPS >= scanStart &&
+	findPixelT3MAPS(rowPos, colPos, pixelRow, pixelCol)) {
+      summary.nParticlesInT3MAPS++;
+      if (random->Rndm() < effT3MAPS) {
+	scanHits.insert(std::make_pair(pixelRow, pixelCol));
+      }
+    }
+  }
+
+  outputT3MAPS->cd();
+  treeT3MAPS->Write();
+  outputT3MAPS->Close();
+  outputFEI4->cd();
+  treeFEI4->Write();
+  outputFEI4->Close();
+  if (history.is_open()) history.close();
+
+  std::cout << "BeamGenerator: Generated " << summary.nParticles
+	    << " particles in " << summary.nScans << " scans." << std::endl;
+  std::cout << "\tFEI4 hits = " << summary.nHitsFEI4 << " + "
+	    << summary.nNoiseHitsFEI4 << " noise" << std::endl;
+  std::cout << "\tT3MAPS hits = " << summary.nHitsT3MAPS << " + "
+	    << summary.nNoiseHitsT3MAPS << " noise, from "
+	    << summary.nParticlesInT3MAPS << " particles" << std::endl;
+  return summary;
+}
+
+/**
+   Print the settings, including the true map.
+*/
+void BeamGenerator::printSettings() {
+  std::cout << "BeamGenerator: Settings" << std::endl;
+  std::cout << "\tscans = " << nScans << " x (" << integrationTime << " + "
+	    << scanGap << ") s, starting " << (Long64_t)startTime << std::endl;
+  std::cout << "\tbeam = " << beamRate << " Hz at (" << beamRow << ", "
+	    << beamCol << ") +/- (" << beamSigmaRow << ", " << beamSigmaCol
+	    << ") mm" << std::endl;
+  std::cout << "\tefficiency FEI4 = " << effFEI4 << ", T3MAPS = " << effT3MAPS
+	    << std::endl;
+  std::cout << "\tnoisy pixels FEI4 = " << nNoisyFEI4 << " (" << noiseProbFEI4
+	    << " per trigger), T3MAPS = " << nNoisyT3MAPS << " ("
+	    << noiseProbT3MAPS << " per scan)" << std::endl;
+  std::cout << "\tmap: orientation = " << orientation << ", row offset = "
+	    << rowOffset << " mm, col offset = " << colOffset << " mm"
+	    << std::endl;
+  std::cout << "\ttime offset = " << timeOffset << " s, FEI4 readout = "
+	    << readoutTimeFEI4 << " s" << std::endl;
+}
+
+/**
+   Find the FEI4 pixel at a position, as ChipDimension::getRowFromPos().
+   @param rowPos - the row position in mm.
+   @param colPos - the column position in mm.
+   @param row - the row index (set).
+   @param col - the column index (set).
+   @returns - true iff the position is inside FEI4.
+*/
+bool BeamGenerator::findPixelFEI4(double rowPos, double colPos, int &row,
+				  int &col) {
+  if (rowPos < 0.0 || colPos < 0.0) return false;
+  row = (int)(rowPos / rowPitchFEI4);
+  col = (int)(colPos / colPitchFEI4);
+  return (row < nRowFEI4 && col < nColFEI4);
+}
+
+/**
+   Find the T3MAPS pixel behind an FEI4 position, using the true map.
+   @param rowPos - the FEI4 row position in mm.
+   @param colPos - the FEI4 column position in mm.
+   @param row - the T3MAPS row index (set).
+   @param col - the T3MAPS column index (set).
+   @returns - true iff the position is inside T3MAPS.
+*/
+bool BeamGenerator::findPixelT3MAPS(double rowPos, double colPos, int &row,
+				    int &col) {
+  double rowPosT3MAPS = rowSign * (rowPos - rowOffset);
+  double colPosT3MAPS = colSign * (colPos - colOffset);
+  if (rowPosT3MAPS < 0.0 || colPosT3MAPS < 0.0) return false;
+  row = (int)(rowPosT3MAPS / rowPitchT3MAPS);
+  col = (int)(colPosT3MAPS / colPitchT3MAPS);
+  return (row < nRowT3MAPS && col < nColT3MAPS);
+}
+
+/**
+   Create the output files and trees, with the branches of the real data.
+   @param fileT3MAPS - the T3MAPS ROOT file.
+   @param fileFEI4 - the FEI4 ROOT file.
+*/
+void BeamGenerator::openTrees(TString fileT3MAPS, TString fileFEI4) {
+  // Keep large runs in one file each:
+  TTree::SetMaxTreeSize(1000000000000000LL);
+
+  outputT3MAPS = new TFile(fileT3MAPS, "RECREATE");
+  treeT3MAPS = new TTree("TreeT3MAPS","TreeT3MAPS");
+  treeT3MAPS->Branch("nHits", &nHits, "nHits/I");
+  treeT3MAPS->Branch("timestamp_start", &scanStart, "timestamp_start/D");
+  treeT3MAPS->Branch("timestamp_stop", &scanStop, "timestamp_stop/D");
+  treeT3MAPS->Branch("hit_row", "std::vector<int>", &hit_row);
+  treeT3MAPS->Branch("hit_column", "std::vector<int>", &hit_column);
+
+  outputFEI4 = new TFile(fileFEI4, "RECREATE");
+  treeFEI4 = new TTree("Table", "Synthetic FEI4 data");
+  treeFEI4->Branch("event_number", &event_number, "event_number/L");
+  treeFEI4->Branch("trigger_number", &trigger_number, "trigger_number/i");
+  treeFEI4->Branch("relative_BCID", &relative_BCID, "relative_BCID/b");
+  treeFEI4->Branch("LVL1ID", &LVL1ID, "LVL1ID/s");
+  treeFEI4->Branch("column", &column, "column/b");
+  treeFEI4->Branch("row", &row, "row/s");
+  treeFEI4->Branch("tot", &tot, "tot/b");
+  treeFEI4->Branch("BCID", &BCID, "BCID/s");
+  treeFEI4->Branch("TDC", &TDC, "TDC/s");
+  treeFEI4->Branch("TDC_time_stamp", &TDC_time_stamp, "TDC_time_stamp/b");
+  treeFEI4->Branch("trigger_status", &trigger_status, "trigger_status/b");
+  treeFEI4->Branch("service_record", &service_record, "service_record/i");
+  treeFEI4->Branch("event_status", &event_status, "event_status/s");
+  treeFEI4->Branch("timestamp_start", &timestamp_start, "timestamp_start/D");
+  treeFEI4->Branch("timestamp_stop", &timestamp_stop, "timestamp_stop/D");
+  TDC = 0;
+  TDC_time_stamp = 0;
+  trigger_status = 0;
+  service_record = 0;
+  event_status = 0;
+}
+
+/**
+   Add a hit to the current FEI4 trigger. The tree counts rows and columns
+   from 1.
+   @param pixelRow - the (0-indexed) row.
+   @param pixelCol - the (0-indexed) column.
+*/
+void BeamGenerator::fillHitFEI4(int pixelRow, int pixelCol) {
+  row = (UShort_t)(pixelRow + 1);
+  column = (UChar_t)(pixelCol + 1);
+  tot = (UChar_t)(1 + random->Integer(14));
+  relative_BCID = (UChar_t)random->Integer(16);
+  treeFEI4->Fill();
+}
+
+/**
+   Add the noise to the current T3MAPS scan, then write it.
+   @param history - the history file (written if open).
+*/
+void BeamGenerator::finishScan(std::ofstream &history) {
+  summary.nHitsT3MAPS += (Long64_t)scanHits.size();
+  for (int i_n = 0; i_n < nNoisyT3MAPS; i_n++) {
+    if (random->Rndm() < noiseProbT3MAPS &&
+	scanHits.insert(noisyT3MAPS[i_n]).second) {
+      summary.nNoiseHitsT3MAPS++;
+    }
+  }
+
+  // The set is ordered by row, then column, as in the history file:
+  hit_row->clear();
+  hit_column->clear();
+  for (std::set<std::pair<int,int> >::iterator it = scanHits.begin();
+       it != scanHits.end(); it++) {
+    hit_row->push_back(it->first);
+    hit_column->push_back(it->second);
+  }
+  nHits = (int)hit_row->size();
+  treeT3MAPS->Fill();
+
+  // The history file has whole-second times, one line per row with the hit
+  // columns each followed by a space (see LoadT3MAPS::parseLine()):
+  if (history.is_open()) {
+    history << "BEGIN SCAN " << summary.nScans << "\n";
+    history << "START TIME\n" << (Long64_t)scanStart << "\n";
+    history << "STOP TIME\n" << (Long64_t)scanStop << "\n";
+    std::set<std::pair<int,int> >::iterator it = scanHits.begin();
+    for (int i_r = 0; i_r < nRowT3MAPS; i_r++) {
+      for (; it != scanHits.end() && it->first == i_r; it++) {
+	history << it->second << " ";
+      }
+      history << "\n";
+    }
+    history << "END SCAN\n";
+  }
+  scanHits.clear();
+  summary.nScans++;
+}
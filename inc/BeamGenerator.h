@@ -0,0 +1,131 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: BeamGenerator.h                                                     //
+//  Class: BeamGenerator.cxx                                                  //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef BeamGenerator_h
+#define BeamGenerator_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <math.h>
+#include <set>
+#include <string>
+#include <vector>
+
+#include "TFile.h"
+#include "TRandom3.h"
+#include "TString.h"
+#include "TTree.h"
+
+#include "ChipDimension.h"
+#include "RunConfig.h"
+
+// Counters of what was generated:
+struct BeamSummary {
+  Long64_t nParticles;
+  Long64_t nScans;
+  Long64_t nHitsFEI4;
+  Long64_t nNoiseHitsFEI4;
+  Long64_t nHitsT3MAPS;
+  Long64_t nNoiseHitsT3MAPS;
+  Long64_t nParticlesInT3MAPS;// crossing T3MAPS during a scan
+};
+
+class BeamGenerator {
+
+ public:
+
+  BeamGenerator(RunConfig *config);
+  virtual ~BeamGenerator();
+
+  // Mutators:
+  BeamSummary generate(TString fileT3MAPS, TString fileFEI4,
+		       TString fileHistory);
+
+  // Accessors:
+  void printSettings();
+
+ private:
+
+  bool findPixelFEI4(double rowPos, double colPos, int &row, int &col);
+  bool findPixelT3MAPS(double rowPos, double colPos, int &row, int &col);
+  void openTrees(TString fileT3MAPS, TString fileFEI4);
+  void fillHitFEI4(int row, int col);
+  void finishScan(std::ofstream &history);
+
+  ChipDimension *chips;
+  TRandom3 *random;
+
+  // The chip geometry, looked up once:
+  int nRowFEI4, nColFEI4, nRowT3MAPS, nColT3MAPS;
+  double rowPitchFEI4, colPitchFEI4, rowPitchT3MAPS, colPitchT3MAPS;
+
+  // Settings (times in seconds, positions in mm):
+  Long64_t nScans;
+  double startTime;
+  double integrationTime;
+  double scanGap;
+  double readoutTimeFEI4;
+  double timeOffset;
+  double beamRate;// particles per second
+  double beamRow;// center of the beam spot in FEI4
+  double beamCol;
+  double beamSigmaRow;
+  double beamSigmaCol;
+  double effFEI4;
+  double effT3MAPS;
+  int nNoisyFEI4;
+  double noiseProbFEI4;// per pixel and trigger
+  int nNoisyT3MAPS;
+  double noiseProbT3MAPS;// per pixel and scan
+
+  // The true map, as in MapParameters (FEI4 = sign * T3MAPS + offset):
+  int orientation;
+  double rowOffset;
+  double colOffset;
+  double rowSign;
+  double colSign;
+
+  // Noisy pixels, as (row, column):
+  std::vector<std::pair<int,int> > noisyFEI4;
+  std::vector<std::pair<int,int> > noisyT3MAPS;
+
+  // Output trees and the branch variables:
+  TFile *outputT3MAPS;
+  TTree *treeT3MAPS;
+  TFile *outputFEI4;
+  TTree *treeFEI4;
+  int nHits;
+  double scanStart;
+  double scanStop;
+  std::vector<int> *hit_row;
+  std::vector<int> *hit_column;
+  std::set<std::pair<int,int> > scanHits;
+  Long64_t event_number;
+  UInt_t trigger_number;
+  UChar_t relative_BCID;
+  UShort_t LVL1ID;
+  UChar_t column;
+  UShort_t row;
+  UChar_t tot;
+  UShort_t BCID;
+  UShort_t TDC;
+  UChar_t TDC_time_stamp;
+  UChar_t trigger_status;
+  UInt_t service_record;
+  UShort_t event_status;
+  double timestamp_start;
+  double timestamp_stop;
+
+  BeamSummary summary;
+
+};
+
+#endif
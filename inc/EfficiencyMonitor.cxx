@@ -0,0 +1,270 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: EfficiencyMonitor.cxx                                               //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class keeps the track-by-track matching counters for a run that is   //
+//  in progress. Besides the cumulative counters it keeps the same counters   //
+//  for a sliding window over the last windowLength seconds of T3MAPS data,   //
+//  which are updated incrementally as scans enter and leave the window.      //
+//                                                                            //
+//  The current state is published in two ways:                               //
+//    - a POSIX shared memory segment holding a MonitorSnapshot, updated      //
+//      after every publish() call. Readers use readShared(), which retries   //
+//      if the segment was being written at the same time.                    //
+//    - a small text file of "name value" lines, rewritten at most once per   //
+//      snapshotInterval seconds. It is written to a temporary file and then  //
+//      renamed, so readers never see a partial file.                         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "EfficiencyMonitor.h"
+
+/**
+   Initialize the monitor and create the shared memory segment.
+   @param newWindowLength - the sliding window length in seconds.
+   @param newSnapshotInterval - the minimum time between snapshot files.
+   @param newSnapshotFile - the snapshot file name ("" for none).
+   @param newSharedName - the shared memory name, e.g. "/TestBeamMonitor"
+   ("" for none).
+*/
+EfficiencyMonitor::EfficiencyMonitor(double newWindowLength,
+				     double newSnapshotInterval,
+				     TString newSnapshotFile,
+				     TString newSharedName) {
+  windowLength = newWindowLength;
+  snapshotInterval = newSnapshotInterval;
+  snapshotFile = newSnapshotFile;
+  sharedName = newSharedName;
+
+  HitMatcher::resetCounts(total);
+  HitMatcher::resetCounts(window);
+  windowScans.clear();
+  nScansTotal = 0;
+  lastDataTime = 0.0;
+  lastSnapshotTime = 0.0;
+
+  // Create and map the shared memory segment:
+  shared = NULL;
+  if (!sharedName.IsNull()) {
+    int fd = shm_open(sharedName.Data(), O_CREAT | O_RDWR, 0644);
+    if (fd >= 0 && ftruncate(fd, sizeof(MonitorSnapshot)) == 0) {
+      void *address = mmap(NULL, sizeof(MonitorSnapshot),
+			   PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+      if (address != MAP_FAILED) {
+	shared = (MonitorSnapshot*)address;
+	memset((void*)shared, 0, sizeof(MonitorSnapshot));
+      }
+    }
+    if (fd >= 0) close(fd);
+    if (!shared) {
+      std::cout << "EfficiencyMonitor: Could not create shared memory "
+		<< sharedName << std::endl;
+    }
+  }
+  std::cout << "EfficiencyMonitor: Window of " << windowLength
+	    << " s, snapshot every " << snapshotInterval << " s." << std::endl;
+}
+
+/**
+   Unmap and remove the shared memory segment.
+*/
+EfficiencyMonitor::~EfficiencyMonitor() {
+  if (shared) {
+    munmap((void*)shared, sizeof(MonitorSnapshot));
+    shm_unlink(sharedName.Data());
+  }
+}
+
+/**
+   Add the counters from one T3MAPS scan, and drop the scans that are no
+   longer inside the sliding window.
+   @param timestamp_stop - the end of the T3MAPS integration period.
+   @param scanCounts - the counters for this scan only.
+*/
+void EfficiencyMonitor::addScan(double timestamp_stop,
+				const MatchCounts &scanCounts) {
+  addCounts(total, scanCounts, 1);
+  nScansTotal++;
+  lastDataTime = timestamp_stop;
+
+  addCounts(window, scanCounts, 1);
+  windowScans.push_back(std::make_pair(timestamp_stop, scanCounts));
+  while (!windowScans.empty() &&
+	 windowScans.front().first <= lastDataTime - windowLength) {
+    addCounts(window, windowScans.front().second, -1);
+    windowScans.pop_front();
+  }
+}
+
+/**
+   Update the shared memory segment, and write the snapshot file if enough
+   time has passed since the last one.
+   @param force - write the snapshot file regardless of the interval.
+*/
+void EfficiencyMonitor::publish(bool force) {
+  MonitorSnapshot snapshot = getSnapshot();
+  if (shared) {
+    // Odd sequence numbers tell readers that an update is in progress:
+    unsigned int sequence = shared->sequence;
+    shared->sequence = sequence + 1;
+    __sync_synchronize();
+    snapshot.sequence = sequence + 1;
+    memcpy((void*)shared, (void*)&snapshot, sizeof(MonitorSnapshot));
+    __sync_synchronize();
+    shared->sequence = sequence + 2;
+  }
+
+  if (!snapshotFile.IsNull() &&
+      (force || snapshot.updateTime - lastSnapshotTime >= snapshotInterval)) {
+    writeSnapshotFile();
+    lastSnapshotTime = snapshot.updateTime;
+  }
+}
+
+/**
+   Get the cumulative counters.
+*/
+MatchCounts EfficiencyMonitor::getTotalCounts() {
+  return total;
+}
+
+/**
+   Get the counters for the sliding window.
+*/
+MatchCounts EfficiencyMonitor::getWindowCounts() {
+  return window;
+}
+
+/**
+   Fill a snapshot of the current state.
+   @returns - the snapshot (with sequence number 0).
+*/
+MonitorSnapshot EfficiencyMonitor::getSnapshot() {
+  MonitorSnapshot snapshot;
+  memset((void*)&snapshot, 0, sizeof(MonitorSnapshot));
+  snapshot.updateTime = (double)time(NULL);
+  snapshot.dataTime = lastDataTime;
+  snapshot.windowLength = windowLength;
+  snapshot.nScansTotal = nScansTotal;
+  snapshot.nScansWindow = (int)windowScans.size();
+  snapshot.total = total;
+  snapshot.window = window;
+  snapshot.effT3MAPS = HitMatcher::getEfficiency(total.matchedT3MAPS,
+						 total.matchableT3MAPS);
+  snapshot.effFEI4 = HitMatcher::getEfficiency(total.matchedFEI4,
+					       total.matchableFEI4);
+  snapshot.effT3MAPSWindow = HitMatcher::getEfficiency(window.matchedT3MAPS,
+						       window.matchableT3MAPS);
+  snapshot.effFEI4Window = HitMatcher::getEfficiency(window.matchedFEI4,
+						     window.matchableFEI4);
+
+  // Early in the run the window is not full yet:
+  double span = windowLength;
+  if (!windowScans.empty() && nScansTotal == (int)windowScans.size()) {
+    span = lastDataTime - windowScans.front().first;
+  }
+  if (span > 0.0) {
+    snapshot.rateT3MAPSWindow = ((double)window.totalT3MAPS) / span;
+    snapshot.rateFEI4Window = ((double)window.totalFEI4) / span;
+  }
+  return snapshot;
+}
+
+/**
+   Print a snapshot to the screen.
+   @param snapshot - the snapshot to print.
+*/
+void EfficiencyMonitor::printSnapshot(const MonitorSnapshot &snapshot) {
+  std::cout << "EfficiencyMonitor: scans=" << snapshot.nScansTotal
+	    << "\n\tT3MAPS eff = " << snapshot.total.matchedT3MAPS << "/"
+	    << snapshot.total.matchableT3MAPS << " = " << snapshot.effT3MAPS
+	    << "\tlast " << snapshot.windowLength << " s = "
+	    << snapshot.effT3MAPSWindow << "\trate = "
+	    << snapshot.rateT3MAPSWindow << " Hz"
+	    << "\n\tFEI4 eff = " << snapshot.total.matchedFEI4 << "/"
+	    << snapshot.total.matchableFEI4 << " = " << snapshot.effFEI4
+	    << "\tlast " << snapshot.windowLength << " s = "
+	    << snapshot.effFEI4Window << "\trate = "
+	    << snapshot.rateFEI4Window << " Hz" << std::endl;
+}
+
+/**
+   Read the snapshot published by another process.
+   @param sharedName - the shared memory name used by the publisher.
+   @param snapshot - filled with the published snapshot.
+   @returns - true iff a consistent snapshot was read.
+*/
+bool EfficiencyMonitor::readShared(TString sharedName,
+				   MonitorSnapshot &snapshot) {
+  int fd = shm_open(sharedName.Data(), O_RDONLY, 0);
+  if (fd < 0) return false;
+  void *address = mmap(NULL, sizeof(MonitorSnapshot), PROT_READ, MAP_SHARED,
+		       fd, 0);
+  close(fd);
+  if (address == MAP_FAILED) return false;
+  MonitorSnapshot *source = (MonitorSnapshot*)address;
+
+  // Retry until the sequence number is even and unchanged by the copy:
+  bool success = false;
+  for (int i_t = 0; i_t < 1000 && !success; i_t++) {
+    unsigned int sequence = source->sequence;
+    if (sequence % 2 == 1) continue;
+    __sync_synchronize();
+    memcpy((void*)&snapshot, (void*)source, sizeof(MonitorSnapshot));
+    __sync_synchronize();
+    success = (source->sequence == sequence);
+  }
+  munmap(address, sizeof(MonitorSnapshot));
+  return success;
+}
+
+/**
+   Add or subtract one set of counters from another.
+   @param sum - the counters to update.
+   @param delta - the counters to add.
+   @param sign - +1 to add, -1 to subtract.
+*/
+void EfficiencyMonitor::addCounts(MatchCounts &sum, const MatchCounts &delta,
+				  int sign) {
+  sum.totalT3MAPS += sign * delta.totalT3MAPS;
+  sum.matchableT3MAPS += sign * delta.matchableT3MAPS;
+  sum.matchedT3MAPS += sign * delta.matchedT3MAPS;
+  sum.totalFEI4 += sign * delta.totalFEI4;
+  sum.matchableFEI4 += sign * delta.matchableFEI4;
+  sum.matchedFEI4 += sign * delta.matchedFEI4;
+}
+
+/**
+   Write the snapshot file, replacing the previous one in a single step.
+*/
+void EfficiencyMonitor::writeSnapshotFile() {
+  MonitorSnapshot snapshot = getSnapshot();
+  TString tempFile = Form("%s.tmp", snapshotFile.Data());
+  std::ofstream outputFile(tempFile.Data());
+  if (!outputFile.is_open()) {
+    std::cout << "EfficiencyMonitor: Could not write " << tempFile
+	      << std::endl;
+    return;
+  }
+  outputFile.precision(12);
+  outputFile << "updateTime " << snapshot.updateTime << std::endl;
+  outputFile << "dataTime " << snapshot.dataTime << std::endl;
+  outputFile << "windowLength " << snapshot.windowLength << std::endl;
+  outputFile << "nScansTotal " << snapshot.nScansTotal << std::endl;
+  outputFile << "nScansWindow " << snapshot.nScansWindow << std::endl;
+  outputFile << "matchedT3MAPS " << snapshot.total.matchedT3MAPS << std::endl;
+  outputFile << "matchableT3MAPS " << snapshot.total.matchableT3MAPS
+	     << std::endl;
+  outputFile << "matchedFEI4 " << snapshot.total.matchedFEI4 << std::endl;
+  outputFile << "matchableFEI4 " << snapshot.total.matchableFEI4 << std::endl;
+  outputFile << "effT3MAPS " << snapshot.effT3MAPS << std::endl;
+  outputFile << "effFEI4 " << snapshot.effFEI4 << std::endl;
+  outputFile << "effT3MAPSWindow " << snapshot.effT3MAPSWindow << std::endl;
+  outputFile << "effFEI4Window " << snapshot.effFEI4Window << std::endl;
+  outputFile << "rateT3MAPSWindow " << snapshot.rateT3MAPSWindow << std::endl;
+  outputFile << "rateFEI4Window " << snapshot.rateFEI4Window << std::endl;
+  outputFile.close();
+  rename(tempFile.Data(), snapshotFile.Data());
+}
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: EfficiencyMonitor.h                                                 //
+//  Class: EfficiencyMonitor.cxx                                              //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef EfficiencyMonitor_h
+#define EfficiencyMonitor_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <deque>
+#include <ctime>
+#include <cstring>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TString.h"
+
+#include "HitMatcher.h"
+
+// The published state. It only holds plain values so that it can be placed
+// in shared memory. The sequence number is odd while an update is in progress.
+struct MonitorSnapshot {
+  volatile unsigned int sequence;
+  double updateTime;// wall-clock time of the update
+  double dataTime;// T3MAPS timestamp_stop of the latest scan
+  double windowLength;
+  int nScansTotal;
+  int nScansWindow;
+  MatchCounts total;
+  MatchCounts window;
+  double effT3MAPS;
+  double effFEI4;
+  double effT3MAPSWindow;
+  double effFEI4Window;
+  double rateT3MAPSWindow;// good hits per second
+  double rateFEI4Window;// good hits per second
+};
+
+class EfficiencyMonitor {
+
+ public:
+
+  EfficiencyMonitor(double newWindowLength, double newSnapshotInterval,
+		    TString newSnapshotFile, TString newSharedName);
+  virtual ~EfficiencyMonitor();
+
+  // Mutators:
+  void addScan(double timestamp_stop, const MatchCounts &scanCounts);
+  void publish(bool force);
+
+  // Accessors:
+  MatchCounts getTotalCounts();
+  MatchCounts getWindowCounts();
+  MonitorSnapshot getSnapshot();
+  static void printSnapshot(const MonitorSnapshot &snapshot);
+  static bool readShared(TString sharedName, MonitorSnapshot &snapshot);
+
+ private:
+
+  void addCounts(MatchCounts &sum, const MatchCounts &delta, int sign);
+  void writeSnapshotFile();
+
+  // Settings:
+  double windowLength;
+  double snapshotInterval;
+  TString snapshotFile;
+  TString sharedName;
+
+  // Cumulative counters:
+  MatchCounts total;
+  int nScansTotal;
+  double lastDataTime;
+
+  // Sliding window counters, kept equal to the sum over windowScans:
+  MatchCounts window;
+  std::deque<std::pair<double,MatchCounts> > windowScans;
+
+  // Publishing:
+  MonitorSnapshot *shared;
+  double lastSnapshotTime;
+
+};
+
+#endif
@@ -0,0 +1,229 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: EventBuilder.cxx                                                    //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class groups the FEI4 "Table" tree (one hit per entry) into compact  //
+//  event records. Consecutive entries sharing an event_number,               //
+//  trigger_number, LVL1ID and readout timestamps form one event, which       //
+//  stores an offset and length into a single flat array of hits.             //
+//                                                                            //
+//  Typical use:                                                              //
+//    1. EventBuilder() to initialize.                                        //
+//    2. addEntries(cF) to read the FEI4 tree once.                           //
+//    3. Loop over getEvent(i), then over the hits in [offset, offset+length) //
+//                                                                            //
+//  The events are kept in tree order, so they are time-ordered whenever the  //
+//  FEI4 tree is.                                                             //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "EventBuilder.h"
+
+#include "Instrument.h"
+
+/**
+   Initialize an empty event store.
+*/
+EventBuilder::EventBuilder() {
+  clear();
+}
+
+/**
+   Read all FEI4 entries that have not been read yet. Calling this again after
+   the tree has grown only reads the new entries.
+   @param cF - the FEI4 tree reader.
+*/
+void EventBuilder::addEntries(TreeFEI4 *cF) {
+  addEntries(cF, nEntriesRead, cF->fChain->GetEntries());
+}
+
+/**
+   Read a range of FEI4 entries and group them into events. Only the branches
+   needed for the event records are enabled during the loop.
+   @param cF - the FEI4 tree reader.
+   @param firstEntry - the first entry to read.
+   @param lastEntry - one past the last entry to read.
+*/
+void EventBuilder::addEntries(TreeFEI4 *cF, Long64_t firstEntry,
+			      Long64_t lastEntry) {
+  INSTRUMENT_SCOPE("read.FEI4");
+  cF->fChain->SetBranchStatus("*", 0);
+  cF->fChain->SetBranchStatus("event_number", 1);
+  cF->fChain->SetBranchStatus("trigger_number", 1);
+  cF->fChain->SetBranchStatus("relative_BCID", 1);
+  cF->fChain->SetBranchStatus("LVL1ID", 1);
+  cF->fChain->SetBranchStatus("column", 1);
+  cF->fChain->SetBranchStatus("row", 1);
+  cF->fChain->SetBranchStatus("tot", 1);
+  cF->fChain->SetBranchStatus("timestamp_start", 1);
+  cF->fChain->SetBranchStatus("timestamp_stop", 1);
+
+  for (Long64_t entry = firstEntry; entry < lastEntry; entry++) {
+    cF->fChain->GetEntry(entry);
+    addHit(cF->event_number, cF->trigger_number, cF->LVL1ID,
+	   cF->timestamp_start, cF->timestamp_stop, cF->row, cF->column,
+	   cF->tot, cF->relative_BCID);
+  }
+  if (lastEntry > nEntriesRead) nEntriesRead = lastEntry;
+  INSTRUMENT_COUNT("entries.FEI4", lastEntry - firstEntry);
+
+  cF->fChain->SetBranchStatus("*", 1);
+  std::cout << "EventBuilder: Built " << events.size() << " events from "
+	    << hits.size() << " FEI4 hits." << std::endl;
+}
+
+/**
+   Add a single hit, starting a new event if the hit does not belong to the
+   most recent one.
+   @param event_number - the FEI4 event number.
+   @param trigger_number - the FEI4 trigger number.
+   @param LVL1ID - the FEI4 LVL1 ID.
+   @param timestamp_start - start of the readout period.
+   @param timestamp_stop - end of the readout period.
+   @param row - the hit row (as stored in the tree).
+   @param column - the hit column (as stored in the tree).
+   @param tot - the hit time over threshold.
+   @param relative_BCID - the hit BCID relative to the trigger.
+*/
+void EventBuilder::addHit(Long64_t event_number, UInt_t trigger_number,
+			  UShort_t LVL1ID, Double_t timestamp_start,
+			  Double_t timestamp_stop, int row, int column, int tot,
+			  int relative_BCID) {
+
+  // Start a new event if any of the identifying quantities changed:
+  if (events.empty() ||
+      events.back().event_number != event_number ||
+      events.back().trigger_number != trigger_number ||
+      events.back().LVL1ID != LVL1ID ||
+      events.back().timestamp_start != timestamp_start ||
+      events.back().timestamp_stop != timestamp_stop) {
+    EventFEI4 newEvent;
+    newEvent.event_number = event_number;
+    newEvent.trigger_number = trigger_number;
+    newEvent.LVL1ID = LVL1ID;
+    newEvent.timestamp_start = timestamp_start;
+    newEvent.timestamp_stop = timestamp_stop;
+    newEvent.offset = (Long64_t)hits.size();
+    newEvent.length = 0;
+    events.push_back(newEvent);
+  }
+
+  HitFEI4 newHit;
+  newHit.row = (UShort_t)row;
+  newHit.column = (UChar_t)column;
+  newHit.tot = (UChar_t)tot;
+  newHit.relative_BCID = (UChar_t)relative_BCID;
+  hits.push_back(newHit);
+  events.back().length++;
+}
+
+/**
+   Remove the oldest events and their hits from the store, e.g. to bound the
+   memory used while following a growing file. The remaining events are
+   renumbered from 0, and the entries already read are not read again.
+   @param nDrop - the number of events to remove from the front.
+*/
+void EventBuilder::dropEvents(Long64_t nDrop) {
+  if (nDrop <= 0) return;
+  if (nDrop > (Long64_t)events.size()) nDrop = (Long64_t)events.size();
+  Long64_t nDropHits = (nDrop < (Long64_t)events.size()) ?
+    events[nDrop].offset : (Long64_t)hits.size();
+  events.erase(events.begin(), events.begin() + nDrop);
+  hits.erase(hits.begin(), hits.begin() + nDropHits);
+  for (int i_e = 0; i_e < (int)events.size(); i_e++) {
+    events[i_e].offset -= nDropHits;
+  }
+}
+
+/**
+   Remove all events and hits from the store.
+*/
+void EventBuilder::clear() {
+  events.clear();
+  hits.clear();
+  nEntriesRead = 0;
+}
+
+/**
+   Replace the contents of the store with those saved by write().
+   @param input - the input stream.
+   @returns - true iff the read succeeded.
+*/
+bool EventBuilder::read(std::istream &input) {
+  clear();
+  if (!ResultCache::readValue(input, nEntriesRead) ||
+      !ResultCache::readVector(input, events) ||
+      !ResultCache::readVector(input, hits)) {
+    clear();
+    return false;
+  }
+  return true;
+}
+
+/**
+   Save the events and hits in binary form, e.g. for the ResultCache.
+   @param output - the output stream.
+*/
+void EventBuilder::write(std::ostream &output) {
+  ResultCache::writeValue(output, nEntriesRead);
+  ResultCache::writeVector(output, events);
+  ResultCache::writeVector(output, hits);
+}
+
+/**
+   Get an event record.
+   @param eventIndex - the index of the event (0 to getNEvents()-1).
+   @returns - a pointer to the event record.
+*/
+EventFEI4 *EventBuilder::getEvent(Long64_t eventIndex) {
+  return &events[eventIndex];
+}
+
+/**
+   Get a hit from the flat hit array.
+   @param hitIndex - the index of the hit (from an event offset).
+   @returns - a pointer to the hit.
+*/
+HitFEI4 *EventBuilder::getHit(Long64_t hitIndex) {
+  return &hits[hitIndex];
+}
+
+/**
+   Get the number of events that have been built.
+*/
+Long64_t EventBuilder::getNEvents() {
+  return (Long64_t)events.size();
+}
+
+/**
+   Get the total number of hits in all events.
+*/
+Long64_t EventBuilder::getNHits() {
+  return (Long64_t)hits.size();
+}
+
+/**
+   Get the number of FEI4 tree entries that have been read.
+*/
+Long64_t EventBuilder::getNEntriesRead() {
+  return nEntriesRead;
+}
+
+/**
+   Find the first event that starts at or after the given time. Assumes that
+   the events are time-ordered.
+   @param time - the time of interest.
+   @returns - the index of the first such event, or getNEvents() if none.
+*/
+Long64_t EventBuilder::findFirstEvent(double time) {
+  Long64_t lo = 0;
+  Long64_t hi = (Long64_t)events.size();
+  while (lo < hi) {
+    Long64_t mid = lo + (hi - lo) / 2;
+    if (events[mid].timestamp_start < time) lo = mid + 1;
+    else hi = mid;
+  }
+  return lo;
+}
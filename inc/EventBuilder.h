@@ -0,0 +1,76 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: EventBuilder.h                                                      //
+//  Class: EventBuilder.cxx                                                   //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef EventBuilder_h
+#define EventBuilder_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <vector>
+
+#include "TTree.h"
+
+#include "ResultCache.h"
+#include "TreeFEI4.h"
+
+// A single FEI4 hit, stored with the raw (1-indexed) tree row and column:
+struct HitFEI4 {
+  UShort_t row;
+  UChar_t column;
+  UChar_t tot;
+  UChar_t relative_BCID;
+};
+
+// A group of consecutive FEI4 hits sharing one trigger and readout period:
+struct EventFEI4 {
+  Long64_t event_number;
+  UInt_t trigger_number;
+  UShort_t LVL1ID;
+  Double_t timestamp_start;
+  Double_t timestamp_stop;
+  Long64_t offset;// index of the first hit in the hit array
+  int length;// number of hits in the event
+};
+
+class EventBuilder {
+
+ public:
+
+  EventBuilder();
+  virtual ~EventBuilder() {};
+
+  // Mutators:
+  void addEntries(TreeFEI4 *cF);
+  void addEntries(TreeFEI4 *cF, Long64_t firstEntry, Long64_t lastEntry);
+  void addHit(Long64_t event_number, UInt_t trigger_number, UShort_t LVL1ID,
+	      Double_t timestamp_start, Double_t timestamp_stop, int row,
+	      int column, int tot, int relative_BCID);
+  void clear();
+  void dropEvents(Long64_t nDrop);
+  bool read(std::istream &input);
+
+  // Accessors:
+  EventFEI4 *getEvent(Long64_t eventIndex);
+  HitFEI4 *getHit(Long64_t hitIndex);
+  Long64_t getNEvents();
+  Long64_t getNHits();
+  Long64_t getNEntriesRead();
+  Long64_t findFirstEvent(double time);
+  void write(std::ostream &output);
+
+ private:
+
+  std::vector<EventFEI4> events;
+  std::vector<HitFEI4> hits;
+  Long64_t nEntriesRead;
+
+};
+
+#endif
@@ -0,0 +1,369 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: FixedHist.cxx                                                       //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class is a histogram of hit counts with fixed binning in 1, 2 or 3   //
+//  dimensions. It stores one integer per bin and nothing else, so filling    //
+//  is a bin lookup and an increment, with none of the statistics and error   //
+//  bookkeeping of the ROOT histograms. The bins are found exactly as ROOT    //
+//  finds them and the under- and overflow bins are kept, so a FixedHist      //
+//  converted with copyTo() has the same contents as a TH1 filled with the    //
+//  same values.                                                              //
+//                                                                            //
+//  A parallel loop gives each thread its own FixedHist with the same         //
+//  binning and combines them with add() at the end. The counts are integers, //
+//  so the result does not depend on the order of the merge.                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "FixedHist.h"
+
+#include "Instrument.h"
+
+/**
+   Book an empty 1D histogram.
+   @param nBinsX - the number of bins.
+   @param minX - the lower edge of the first bin.
+   @param maxX - the upper edge of the last bin.
+*/
+FixedHist::FixedHist(int nBinsX, double minX, double maxX) {
+  setAxis(0, nBinsX, minX, maxX);
+  book(1);
+}
+
+/**
+   Book an empty 2D histogram.
+   @param nBinsX - the number of x bins.
+   @param minX - the lower edge of the first x bin.
+   @param maxX - the upper edge of the last x bin.
+   @param nBinsY - the number of y bins.
+   @param minY - the lower edge of the first y bin.
+   @param maxY - the upper edge of the last y bin.
+*/
+FixedHist::FixedHist(int nBinsX, double minX, double maxX,
+		     int nBinsY, double minY, double maxY) {
+  setAxis(0, nBinsX, minX, maxX);
+  setAxis(1, nBinsY, minY, maxY);
+  book(2);
+}
+
+/**
+   Book an empty 3D histogram.
+   @param nBinsX - the number of x bins.
+   @param minX - the lower edge of the first x bin.
+   @param maxX - the upper edge of the last x bin.
+   @param nBinsY - the number of y bins.
+   @param minY - the lower edge of the first y bin.
+   @param maxY - the upper edge of the last y bin.
+   @param nBinsZ - the number of z bins.
+   @param minZ - the lower edge of the first z bin.
+   @param maxZ - the upper edge of the last z bin.
+*/
+FixedHist::FixedHist(int nBinsX, double minX, double maxX,
+		     int nBinsY, double minY, double maxY,
+		     int nBinsZ, double minZ, double maxZ) {
+  setAxis(0, nBinsX, minX, maxX);
+  setAxis(1, nBinsY, minY, maxY);
+  setAxis(2, nBinsZ, minZ, maxZ);
+  book(3);
+}
+
+/**
+   Add the counts of another histogram with the same binning.
+   @param other - the histogram to add.
+*/
+void FixedHist::add(const FixedHist &other) {
+  INSTRUMENT_SCOPE("hist.merge");
+  if (!hasSameBinning(other)) {
+    std::cout << "FixedHist: Cannot add histograms with different binning."
+	      << std::endl;
+    exit(0);
+  }
+  for (int i_c = 0; i_c < (int)counts.size(); i_c++) {
+    counts[i_c] += other.counts[i_c];
+  }
+  nEntries += other.nEntries;
+}
+
+/**
+   Count a value in a 1D histogram.
+   @param x - the value.
+*/
+void FixedHist::fill(double x) {
+  counts[findBin(0, x)]++;
+  nEntries++;
+}
+
+/**
+   Count a value in a 2D histogram.
+   @param x - the x value.
+   @param y - the y value.
+*/
+void FixedHist::fill(double x, double y) {
+  counts[getCell(findBin(0, x), findBin(1, y), 0)]++;
+  nEntries++;
+}
+
+/**
+   Count a value in a 3D histogram.
+   @param x - the x value.
+   @param y - the y value.
+   @param z - the z value.
+*/
+void FixedHist::fill(double x, double y, double z) {
+  counts[getCell(findBin(0, x), findBin(1, y), findBin(2, z))]++;
+  nEntries++;
+}
+
+/**
+   Set all of the counts to zero.
+*/
+void FixedHist::reset() {
+  counts.assign(counts.size(), 0);
+  nEntries = 0;
+}
+
+/**
+   Read the counts written by write() into a histogram with the same binning.
+   @param input - the input stream.
+   @returns - true iff the binning matches and the read succeeded.
+*/
+bool FixedHist::read(std::istream &input) {
+  int storedNDim = 0;
+  if (!ResultCache::readValue(input, storedNDim) || storedNDim != nDim) {
+    return false;
+  }
+  for (int i_a = 0; i_a < nDim; i_a++) {
+    int storedNBins = 0;
+    double storedMin = 0.0;
+    double storedMax = 0.0;
+    if (!ResultCache::readValue(input, storedNBins) ||
+	!ResultCache::readValue(input, storedMin) ||
+	!ResultCache::readValue(input, storedMax) ||
+	storedNBins != nBins[i_a] || storedMin != minEdge[i_a] ||
+	storedMax != maxEdge[i_a]) {
+      return false;
+    }
+  }
+  std::vector<Long64_t> storedCounts;
+  if (!ResultCache::readVector(input, storedCounts) ||
+      storedCounts.size() != counts.size() ||
+      !ResultCache::readValue(input, nEntries)) {
+    reset();
+    return false;
+  }
+  counts.swap(storedCounts);
+  return true;
+}
+
+/**
+   Find the bin of a value along one axis, in the same way as TAxis::FindBin.
+   @param axis - 0, 1 or 2 for x, y or z.
+   @param value - the value.
+   @returns - the bin (0 for underflow, nBins+1 for overflow).
+*/
+int FixedHist::findBin(int axis, double value) const {
+  if (value < minEdge[axis]) return 0;
+  if (!(value < maxEdge[axis])) return nBins[axis] + 1;
+  return 1 + (int)(nBins[axis] * (value - minEdge[axis]) /
+		   (maxEdge[axis] - minEdge[axis]));
+}
+
+/**
+   Get the count in a bin of a 1D histogram.
+   @param binX - the bin (0 for underflow, nBins+1 for overflow).
+*/
+Long64_t FixedHist::getBinContent(int binX) const {
+  return counts[getCell(binX, 0, 0)];
+}
+
+/**
+   Get the count in a bin of a 2D histogram.
+   @param binX - the x bin.
+   @param binY - the y bin.
+*/
+Long64_t FixedHist::getBinContent(int binX, int binY) const {
+  return counts[getCell(binX, binY, 0)];
+}
+
+/**
+   Get the count in a bin of a 3D histogram.
+   @param binX - the x bin.
+   @param binY - the y bin.
+   @param binZ - the z bin.
+*/
+Long64_t FixedHist::getBinContent(int binX, int binY, int binZ) const {
+  return counts[getCell(binX, binY, binZ)];
+}
+
+/**
+   Get the number of dimensions (1, 2 or 3).
+*/
+int FixedHist::getDimension() const {
+  return nDim;
+}
+
+/**
+   Get the number of values filled, including those out of range.
+*/
+Long64_t FixedHist::getEntries() const {
+  return nEntries;
+}
+
+/**
+   Get the sum of the counts in range, as TH1::Integral().
+*/
+Long64_t FixedHist::getIntegral() const {
+  Long64_t sum = 0;
+  int lastY = nDim > 1 ? nBins[1] : 0;
+  int lastZ = nDim > 2 ? nBins[2] : 0;
+  for (int i_z = (nDim > 2 ? 1 : 0); i_z <= lastZ; i_z++) {
+    for (int i_y = (nDim > 1 ? 1 : 0); i_y <= lastY; i_y++) {
+      for (int i_x = 1; i_x <= nBins[0]; i_x++) {
+	sum += counts[getCell(i_x, i_y, i_z)];
+      }
+    }
+  }
+  return sum;
+}
+
+/**
+   Get the number of bins along an axis.
+   @param axis - 0, 1 or 2 for x, y or z.
+*/
+int FixedHist::getNBins(int axis) const {
+  return axis < nDim ? nBins[axis] : 0;
+}
+
+/**
+   Check whether another histogram has the same binning.
+   @param other - the other histogram.
+*/
+bool FixedHist::hasSameBinning(const FixedHist &other) const {
+  if (other.nDim != nDim) return false;
+  for (int i_a = 0; i_a < nDim; i_a++) {
+    if (other.nBins[i_a] != nBins[i_a] || other.minEdge[i_a] != minEdge[i_a] ||
+	other.maxEdge[i_a] != maxEdge[i_a]) {
+      return false;
+    }
+  }
+  return true;
+}
+
+/**
+   Write the binning and the counts in binary form, e.g. for the ResultCache.
+   @param output - the output stream.
+*/
+void FixedHist::write(std::ostream &output) const {
+  ResultCache::writeValue(output, nDim);
+  for (int i_a = 0; i_a < nDim; i_a++) {
+    ResultCache::writeValue(output, nBins[i_a]);
+    ResultCache::writeValue(output, minEdge[i_a]);
+    ResultCache::writeValue(output, maxEdge[i_a]);
+  }
+  ResultCache::writeVector(output, counts);
+  ResultCache::writeValue(output, nEntries);
+}
+
+/**
+   Copy the counts (including under- and overflow) and the number of entries
+   into a ROOT histogram with the same binning.
+   @param hist - the histogram to fill.
+*/
+void FixedHist::copyTo(TH1 *hist) const {
+  if (hist->GetSize() != (int)counts.size()) {
+    std::cout << "FixedHist: Cannot copy to " << hist->GetName()
+	      << ", the binning is different." << std::endl;
+    exit(0);
+  }
+  for (int i_c = 0; i_c < (int)counts.size(); i_c++) {
+    hist->SetBinContent(i_c, (double)counts[i_c]);
+  }
+  hist->SetEntries((double)nEntries);
+}
+
+/**
+   Make a ROOT histogram with the contents of a 1D histogram.
+   @param name - the name of the new histogram.
+   @returns - the histogram (owned by the caller).
+*/
+TH1F *FixedHist::toTH1F(TString name) const {
+  TH1F *hist = new TH1F(name, name, nBins[0], minEdge[0], maxEdge[0]);
+  copyTo(hist);
+  return hist;
+}
+
+/**
+   Make a ROOT histogram with the contents of a 2D histogram.
+   @param name - the name of the new histogram.
+   @returns - the histogram (owned by the caller).
+*/
+TH2D *FixedHist::toTH2D(TString name) const {
+  TH2D *hist = new TH2D(name, name, nBins[0], minEdge[0], maxEdge[0],
+			nBins[1], minEdge[1], maxEdge[1]);
+  copyTo(hist);
+  return hist;
+}
+
+/**
+   Make a ROOT histogram with the contents of a 3D histogram.
+   @param name - the name of the new histogram.
+   @returns - the histogram (owned by the caller).
+*/
+TH3D *FixedHist::toTH3D(TString name) const {
+  TH3D *hist = new TH3D(name, name, nBins[0], minEdge[0], maxEdge[0],
+			nBins[1], minEdge[1], maxEdge[1],
+			nBins[2], minEdge[2], maxEdge[2]);
+  copyTo(hist);
+  return hist;
+}
+
+/**
+   Set the binning of one axis.
+   @param axis - 0, 1 or 2 for x, y or z.
+   @param newNBins - the number of bins.
+   @param min - the lower edge of the first bin.
+   @param max - the upper edge of the last bin.
+*/
+void FixedHist::setAxis(int axis, int newNBins, double min, double max) {
+  if (newNBins < 1 || !(min < max)) {
+    std::cout << "FixedHist: Bad binning " << newNBins << " bins in [" << min
+	      << ", " << max << ")" << std::endl;
+    exit(0);
+  }
+  nBins[axis] = newNBins;
+  minEdge[axis] = min;
+  maxEdge[axis] = max;
+}
+
+/**
+   Allocate the counters once the axes are set.
+   @param newNDim - the number of dimensions.
+*/
+void FixedHist::book(int newNDim) {
+  nDim = newNDim;
+  int nCells = 1;
+  for (int i_a = 0; i_a < 3; i_a++) {
+    if (i_a >= nDim) {
+      nBins[i_a] = 0;
+      minEdge[i_a] = 0.0;
+      maxEdge[i_a] = 0.0;
+    }
+    else nCells *= (nBins[i_a] + 2);
+  }
+  counts.assign(nCells, 0);
+  nEntries = 0;
+}
+
+/**
+   Get the index of a cell from its bin numbers.
+   @param binX - the x bin.
+   @param binY - the y bin (0 for 1D).
+   @param binZ - the z bin (0 for 1D and 2D).
+   @returns - the index in the counts, which is the ROOT global bin.
+*/
+int FixedHist::getCell(int binX, int binY, int binZ) const {
+  return binX + (nBins[0] + 2) * (binY + (nBins[1] + 2) * binZ);
+}
@@ -0,0 +1,82 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: FixedHist.h                                                         //
+//  Class: FixedHist.cxx                                                      //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef FixedHist_h
+#define FixedHist_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <vector>
+
+#include "TH1.h"
+#include "TH1F.h"
+#include "TH2D.h"
+#include "TH3D.h"
+#include "TString.h"
+
+#include "ResultCache.h"
+
+class FixedHist {
+
+ public:
+
+  FixedHist(int nBinsX, double minX, double maxX);
+  FixedHist(int nBinsX, double minX, double maxX,
+	    int nBinsY, double minY, double maxY);
+  FixedHist(int nBinsX, double minX, double maxX,
+	    int nBinsY, double minY, double maxY,
+	    int nBinsZ, double minZ, double maxZ);
+  virtual ~FixedHist() {};
+
+  // Mutators:
+  void add(const FixedHist &other);
+  void fill(double x);
+  void fill(double x, double y);
+  void fill(double x, double y, double z);
+  void reset();
+  bool read(std::istream &input);
+
+  // Accessors:
+  int findBin(int axis, double value) const;
+  Long64_t getBinContent(int binX) const;
+  Long64_t getBinContent(int binX, int binY) const;
+  Long64_t getBinContent(int binX, int binY, int binZ) const;
+  int getDimension() const;
+  Long64_t getEntries() const;
+  Long64_t getIntegral() const;
+  int getNBins(int axis) const;
+  bool hasSameBinning(const FixedHist &other) const;
+  void write(std::ostream &output) const;
+
+  // Conversion to ROOT histograms for output:
+  void copyTo(TH1 *hist) const;
+  TH1F *toTH1F(TString name) const;
+  TH2D *toTH2D(TString name) const;
+  TH3D *toTH3D(TString name) const;
+
+ private:
+
+  void setAxis(int axis, int nBins, double min, double max);
+  void book(int newNDim);
+  int getCell(int binX, int binY, int binZ) const;
+
+  int nDim;
+  int nBins[3];
+  double minEdge[3];
+  double maxEdge[3];
+
+  // One counter per cell, including the under- and overflow bins, with x
+  // varying fastest (the ROOT global bin numbering):
+  std::vector<Long64_t> counts;
+  Long64_t nEntries;
+
+};
+
+#endif
@@ -0,0 +1,432 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: HitMatcher.cxx                                                      //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class performs the track-by-track matching between one T3MAPS scan   //
+//  and the FEI4 events inside its (offset) integration window. It applies    //
+//  the standard quality cuts and pixel masks, and increments a set of        //
+//  MatchCounts, so that it can be used both in a loop over complete trees    //
+//  and online as scans arrive.                                               //
+//                                                                            //
+//  With setBinnedCounts(), the counts of each scan are also added to a bin   //
+//  of the FEI4 hits in its window and the T3MAPS hits in the scan, which     //
+//  gives the efficiency against the rate in the same pass. Likewise, with    //
+//  setPixelEfficiency() the hits are also counted per T3MAPS pixel, and      //
+//  with setNoiseSweeps() per pixel of each chip (see NoiseSweep).            //
+//                                                                            //
+//  Quality cuts (the T3MAPS cuts can be changed with setScanCuts()):         //
+//    - T3MAPS scans with 12 or more hits are skipped.                        //
+//    - T3MAPS hits must have 0 < row < 17.                                   //
+//    - FEI4 hits in column 80 (tree value) are excluded.                     //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "HitMatcher.h"
+
+#include "Instrument.h"
+
+/**
+   Initialize the matcher with no masked pixels.
+   @param newMapper - the geometrical map between the chips.
+   @param newChips - the chip dimensions.
+   @param newTimeOffset - the FEI4 - T3MAPS time offset in seconds.
+*/
+HitMatcher::HitMatcher(MapParameters *newMapper, ChipDimension *newChips,
+		       double newTimeOffset) {
+  mapper = newMapper;
+  chips = newChips;
+  timeOffset = newTimeOffset;
+  orientation = -1;
+  binned = NULL;
+  pixels = NULL;
+  sweepT3MAPS = NULL;
+  sweepFEI4 = NULL;
+  setScanCuts(12, 1, 16);
+  nRowFEI4 = chips->getNRow("FEI4");
+  nColFEI4 = chips->getNCol("FEI4");
+  nRowT3MAPS = chips->getNRow("T3MAPS");
+  nColT3MAPS = chips->getNCol("T3MAPS");
+  clearMasks();
+}
+
+/**
+   Unmask all pixels in both chips.
+*/
+void HitMatcher::clearMasks() {
+  maskFEI4.assign(nRowFEI4 * nColFEI4, false);
+  maskT3MAPS.assign(nRowT3MAPS * nColT3MAPS, false);
+}
+
+/**
+   Mask a single pixel.
+   @param chipName - "FEI4" or "T3MAPS".
+   @param row - the (0-indexed) row of the pixel.
+   @param col - the (0-indexed) column of the pixel.
+*/
+void HitMatcher::maskPixel(TString chipName, int row, int col) {
+  if (chipName.EqualTo("FEI4")) {
+    if (row >= 0 && row < nRowFEI4 && col >= 0 && col < nColFEI4) {
+      maskFEI4[row*nColFEI4 + col] = true;
+    }
+  }
+  else if (chipName.EqualTo("T3MAPS")) {
+    if (row >= 0 && row < nRowT3MAPS && col >= 0 && col < nColT3MAPS) {
+      maskT3MAPS[row*nColT3MAPS + col] = true;
+    }
+  }
+  else {
+    std::cout << "HitMatcher: Bad chip name " << chipName << std::endl;
+  }
+}
+
+/**
+   Add a list of pixels to the mask for one chip.
+   @param chipName - "FEI4" or "T3MAPS".
+   @param mask - the (row, column) pairs to mask.
+*/
+void HitMatcher::setMask(TString chipName,
+			 std::vector<std::pair<int,int> > mask) {
+  for (int i_m = 0; i_m < (int)mask.size(); i_m++) {
+    maskPixel(chipName, mask[i_m].first, mask[i_m].second);
+  }
+}
+
+/**
+   Also count the matchable and matched hits of each pixel of both chips, to
+   sweep the noise thresholds afterwards.
+   @param newSweepT3MAPS - the T3MAPS counters (not owned), or NULL to stop.
+   @param newSweepFEI4 - the FEI4 counters (not owned), or NULL to stop.
+*/
+void HitMatcher::setNoiseSweeps(NoiseSweep *newSweepT3MAPS,
+				NoiseSweep *newSweepFEI4) {
+  sweepT3MAPS = newSweepT3MAPS;
+  sweepFEI4 = newSweepFEI4;
+}
+
+/**
+   Use a different geometrical map.
+   @param newMapper - the geometrical map between the chips.
+*/
+void HitMatcher::setMapper(MapParameters *newMapper) {
+  mapper = newMapper;
+}
+
+/**
+   Match with a fixed chip orientation instead of the current orientation of
+   the mapper. The mapper itself is not changed, so matchers with different
+   orientations can share it (also between threads).
+   @param newOrientation - the orientation (0-3), or -1 to follow the mapper.
+*/
+void HitMatcher::setOrientation(int newOrientation) {
+  orientation = newOrientation;
+}
+
+/**
+   Set the T3MAPS quality cuts.
+   @param newMaxHits - scans with at least this many hits are skipped.
+   @param newRowMin - the lowest good T3MAPS row.
+   @param newRowMax - the highest good T3MAPS row.
+*/
+void HitMatcher::setScanCuts(int newMaxHits, int newRowMin, int newRowMax) {
+  maxHitsT3MAPS = newMaxHits;
+  rowMinT3MAPS = newRowMin;
+  rowMaxT3MAPS = newRowMax;
+}
+
+/**
+   Set the time offset between the FEI4 and T3MAPS clocks.
+   @param newTimeOffset - the time offset in seconds.
+*/
+void HitMatcher::setTimeOffset(double newTimeOffset) {
+  timeOffset = newTimeOffset;
+}
+
+/**
+   Also add the counts of each scan to a bin of rate and multiplicity.
+   @param newBinned - the binned counters (not owned), or NULL to stop.
+*/
+void HitMatcher::setBinnedCounts(BinnedCounts *newBinned) {
+  binned = newBinned;
+}
+
+/**
+   Also count the matchable and matched hits of each T3MAPS pixel.
+   @param newPixels - the pixel counters (not owned), or NULL to stop.
+*/
+void HitMatcher::setPixelEfficiency(PixelEfficiency *newPixels) {
+  pixels = newPixels;
+}
+
+/**
+   Set all counters to zero.
+   @param counts - the counters to reset.
+*/
+void HitMatcher::resetCounts(MatchCounts &counts) {
+  counts.totalT3MAPS = 0;
+  counts.matchableT3MAPS = 0;
+  counts.matchedT3MAPS = 0;
+  counts.totalFEI4 = 0;
+  counts.matchableFEI4 = 0;
+  counts.matchedFEI4 = 0;
+}
+
+/**
+   Set all binned counters to zero.
+   @param binned - the counters to reset.
+   @param rateBinWidth - the number of FEI4 hits per rate bin.
+*/
+void HitMatcher::resetBinnedCounts(BinnedCounts &binned, int rateBinWidth) {
+  binned.rateBinWidth = (rateBinWidth > 0) ? rateBinWidth : 1;
+  for (int i_r = 0; i_r < BinnedCounts::nRateBins; i_r++) {
+    for (int i_m = 0; i_m < BinnedCounts::nMultBins; i_m++) {
+      resetCounts(binned.counts[i_r][i_m]);
+    }
+  }
+}
+
+/**
+   Checks the masks to see whether the queried hit should be ignored.
+   @param chipName - "FEI4" or "T3MAPS".
+   @param row - the row number of the hit.
+   @param col - the column number of the hit.
+   @returns - true iff the hit should be masked.
+*/
+bool HitMatcher::isMasked(TString chipName, int row, int col) {
+  if (chipName.EqualTo("FEI4")) {
+    if (row < 0 || row >= nRowFEI4 || col < 0 || col >= nColFEI4) return false;
+    return maskFEI4[row*nColFEI4 + col];
+  }
+  else if (chipName.EqualTo("T3MAPS")) {
+    if (row < 0 || row >= nRowT3MAPS || col < 0 || col >= nColT3MAPS) {
+      return false;
+    }
+    return maskT3MAPS[row*nColT3MAPS + col];
+  }
+  return true;
+}
+
+/**
+   Get the orientation used for the map, which is the current orientation of
+   the mapper unless one was set with setOrientation().
+*/
+int HitMatcher::getMapOrientation() {
+  return orientation < 0 ? mapper->getOrientation() : orientation;
+}
+
+/**
+   Check whether a hit CAN be matched in the other chip.
+   @param chipName - the name of the chip to match
+   @param singleHit -the hit to be matched in the chipName chip.
+   @returns true iff singleHit is matched in the chipName chip.
+*/
+bool HitMatcher::canMatchHit(TString chipName, std::pair<int,int> singleHit) {
+  int mapOrient = getMapOrientation();
+  int rowNom = -1; int colNom = -1;
+  if (chipName.EqualTo("T3MAPS")) {
+    rowNom = mapper->getT3MAPSfromFEI4("rowVal", singleHit.first, mapOrient);
+    colNom = mapper->getT3MAPSfromFEI4("colVal", singleHit.second, mapOrient);
+  }
+  if (chipName.EqualTo("FEI4")) {
+    rowNom = mapper->getFEI4fromT3MAPS("rowVal", singleHit.first, mapOrient);
+    colNom = mapper->getFEI4fromT3MAPS("colVal", singleHit.second, mapOrient);
+  }
+  return chips->isInChip((std::string)chipName, rowNom, colNom);
+}
+
+/**
+   Check if the mapper expects a hit in one chip to be matched with any of the
+   hits in the other chip.
+   @param chipName - the chip containing hitList.
+   @param hitList - a list of hits in one chip
+   @param singleHit - a single hit in the other chip.
+   @returns - true if the single hit is matched with at least one of the hits
+   in the other chip.
+*/
+bool HitMatcher::isHitMatched(TString chipName,
+			      const std::vector<std::pair<int,int> > &hitList,
+			      std::pair<int,int> singleHit) {
+  // These are the nominal positions:
+  int mapOrient = getMapOrientation();
+  int rowNom; int colNom; int rowSigma; int colSigma;
+  if (chipName.EqualTo("T3MAPS")) {
+    rowNom = mapper->getT3MAPSfromFEI4("rowVal", singleHit.first, mapOrient);
+    colNom = mapper->getT3MAPSfromFEI4("colVal", singleHit.second, mapOrient);
+    rowSigma = mapper->getT3MAPSfromFEI4("rowSigma", singleHit.first,
+					 mapOrient);
+    colSigma = mapper->getT3MAPSfromFEI4("colSigma", singleHit.second,
+					 mapOrient);
+  }
+  else {
+    rowNom = mapper->getFEI4fromT3MAPS("rowVal", singleHit.first, mapOrient);
+    colNom = mapper->getFEI4fromT3MAPS("colVal", singleHit.second, mapOrient);
+    rowSigma = mapper->getFEI4fromT3MAPS("rowSigma", singleHit.first,
+					 mapOrient);
+    colSigma = mapper->getFEI4fromT3MAPS("colSigma", singleHit.second,
+					 mapOrient);
+  }
+
+  // Loop over hits, see if any are around the nominal +/- sigma position:
+  for (int i = 0; i < (int)hitList.size(); i++) {
+    if (hitList[i].first  >= (rowNom - rowSigma) &&
+	hitList[i].first  <= (rowNom + rowSigma) &&
+	hitList[i].second >= (colNom - colSigma) &&
+	hitList[i].second <= (colNom + colSigma)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+/**
+   Match one T3MAPS scan against the FEI4 events in its time window. The FEI4
+   event position is advanced past the window, so consecutive scans should be
+   passed in time order with the same eventFEI4 variable.
+   @param hit_row - the T3MAPS hit rows.
+   @param hit_column - the T3MAPS hit columns.
+   @param timestamp_start - the start of the T3MAPS integration period.
+   @param timestamp_stop - the end of the T3MAPS integration period.
+   @param eventsFEI4 - the FEI4 events.
+   @param eventFEI4 - the current position in the FEI4 events (updated).
+   @param counts - the hit counters to increment.
+   @returns - false if the scan failed the quality cuts.
+*/
+bool HitMatcher::matchScan(std::vector<int> *hit_row,
+			   std::vector<int> *hit_column,
+			   double timestamp_start, double timestamp_stop,
+			   EventBuilder *eventsFEI4, Long64_t &eventFEI4,
+			   MatchCounts &counts) {
+  // Remove T3MAPS events with too many hits in one integration period.
+  if ((int)hit_row->size() >= maxHitsT3MAPS) return false;
+  MatchCounts before = counts;
+
+  // Create list of good T3MAPS hits:
+  hitsInT3MAPS.clear();
+  for (int i_h = 0; i_h < (int)hit_row->size(); i_h++) {
+    int currRow = (*hit_row)[i_h];
+    int currCol = (*hit_column)[i_h];
+    if (isMasked("T3MAPS", currRow, currCol)) continue;
+    if (currRow >= rowMinT3MAPS && currRow <= rowMaxT3MAPS) {
+      std::pair<int,int> newHitT3MAPS(currRow, currCol);
+      counts.totalT3MAPS++;
+      if (canMatchHit("FEI4", newHitT3MAPS)) {
+	hitsInT3MAPS.push_back(newHitT3MAPS);
+	counts.matchableT3MAPS++;
+      }
+    }
+  }
+
+  // Advance position in the FEI4 events, store good FEI4 candidates:
+  hitsInFEI4.clear();
+  Long64_t nEventsFEI4 = eventsFEI4->getNEvents();
+  while (eventFEI4 < nEventsFEI4 &&
+	 (eventsFEI4->getEvent(eventFEI4)->timestamp_start <
+	  (timestamp_stop+timeOffset))) {
+    EventFEI4 *currEvent = eventsFEI4->getEvent(eventFEI4);
+
+    // Only consider events with timestamp inside that of T3MAPS
+    if (currEvent->timestamp_start >= (timestamp_start+timeOffset) &&
+	currEvent->timestamp_stop <= (timestamp_stop+timeOffset)) {
+      for (Long64_t i_h = currEvent->offset;
+	   i_h < currEvent->offset + currEvent->length; i_h++) {
+	HitFEI4 *currHit = eventsFEI4->getHit(i_h);
+
+	// Exclude column 79 and masked pixels:
+	if (currHit->column < 80 &&
+	    !isMasked("FEI4", currHit->row-1, currHit->column-1)) {
+	  std::pair<int,int> newHitFEI4(currHit->row-1, currHit->column-1);
+	  counts.totalFEI4++;
+	  if (canMatchHit("T3MAPS", newHitFEI4)) {
+	    hitsInFEI4.push_back(newHitFEI4);
+	    counts.matchableFEI4++;
+	  }
+	}
+      }
+    }
+    eventFEI4++;
+  }
+  INSTRUMENT_FILL("window.T3MAPS", hitsInT3MAPS.size());
+  INSTRUMENT_FILL("window.FEI4", hitsInFEI4.size());
+
+  // Loop over FEI4 hits, see if matched in T3MAPS. The FEI4 hits are
+  // counted for the T3MAPS pixel that they map onto:
+  int mapOrient = getMapOrientation();
+  for (int i_f = 0; i_f < (int)hitsInFEI4.size(); i_f++) {
+    bool matched = isHitMatched("T3MAPS", hitsInT3MAPS, hitsInFEI4[i_f]);
+    if (matched) counts.matchedFEI4++;
+    if (pixels) {
+      const std::pair<int,int> &hit = hitsInFEI4[i_f];
+      int rowMap = mapper->getT3MAPSfromFEI4("rowVal", hit.first, mapOrient);
+      int colMap = mapper->getT3MAPSfromFEI4("colVal", hit.second, mapOrient);
+      pixels->fill("FEI4", rowMap, colMap, matched);
+    }
+    if (sweepFEI4) {
+      sweepFEI4->fill(hitsInFEI4[i_f].first, hitsInFEI4[i_f].second, matched);
+    }
+  }
+
+  // Loop over T3MAPS hits, see if matched in FEI4.
+  for (int i_t = 0; i_t < (int)hitsInT3MAPS.size(); i_t++) {
+    bool matched = isHitMatched("FEI4", hitsInFEI4, hitsInT3MAPS[i_t]);
+    if (matched) counts.matchedT3MAPS++;
+    if (pixels) {
+      pixels->fill("T3MAPS", hitsInT3MAPS[i_t].first,
+		   hitsInT3MAPS[i_t].second, matched);
+    }
+    if (sweepT3MAPS) {
+      sweepT3MAPS->fill(hitsInT3MAPS[i_t].first, hitsInT3MAPS[i_t].second,
+			matched);
+    }
+  }
+
+  // Add this scan to the bin of its FEI4 rate and T3MAPS multiplicity:
+  if (binned) {
+    int rateBin = (counts.totalFEI4 - before.totalFEI4) / binned->rateBinWidth;
+    if (rateBin >= BinnedCounts::nRateBins) {
+      rateBin = BinnedCounts::nRateBins - 1;
+    }
+    int multBin = (int)hit_row->size();
+    if (multBin >= BinnedCounts::nMultBins) {
+      multBin = BinnedCounts::nMultBins - 1;
+    }
+    MatchCounts &bin = binned->counts[rateBin][multBin];
+    bin.totalT3MAPS += counts.totalT3MAPS - before.totalT3MAPS;
+    bin.matchableT3MAPS += counts.matchableT3MAPS - before.matchableT3MAPS;
+    bin.matchedT3MAPS += counts.matchedT3MAPS - before.matchedT3MAPS;
+    bin.totalFEI4 += counts.totalFEI4 - before.totalFEI4;
+    bin.matchableFEI4 += counts.matchableFEI4 - before.matchableFEI4;
+    bin.matchedFEI4 += counts.matchedFEI4 - before.matchedFEI4;
+  }
+  return true;
+}
+
+/**
+   Get the time offset between the FEI4 and T3MAPS clocks.
+*/
+double HitMatcher::getTimeOffset() {
+  return timeOffset;
+}
+
+/**
+   Calculate a matching efficiency.
+   @param matched - the number of matched hits.
+   @param matchable - the number of matchable hits.
+   @returns - the ratio, or 0 if there are no matchable hits.
+*/
+double HitMatcher::getEfficiency(int matched, int matchable) {
+  if (matchable <= 0) return 0.0;
+  return ((double)matched) / ((double)matchable);
+}
+
+/**
+   Calculate the binomial error of a matching efficiency.
+   @param matched - the number of matched hits.
+   @param matchable - the number of matchable hits.
+   @returns - the error, or 0 if there are no matchable hits.
+*/
+double HitMatcher::getEfficiencyError(int matched, int matchable) {
+  if (matchable <= 0) return 0.0;
+  double efficiency = getEfficiency(matched, matchable);
+  return sqrt(efficiency * (1.0 - efficiency) / ((double)matchable));
+}
@@ -0,0 +1,114 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: HitMatcher.h                                                        //
+//  Class: HitMatcher.cxx                                                     //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef HitMatcher_h
+#define HitMatcher_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <iostream>
+#include <vector>
+
+#include "TString.h"
+
+#include "ChipDimension.h"
+#include "EventBuilder.h"
+#include "MapParameters.h"
+#include "NoiseSweep.h"
+#include "PixelEfficiency.h"
+
+// Hit counters for the track-by-track efficiency:
+struct MatchCounts {
+  int totalT3MAPS;
+  int matchableT3MAPS;
+  int matchedT3MAPS;
+  int totalFEI4;
+  int matchableFEI4;
+  int matchedFEI4;
+};
+
+// Hit counters of the scans binned by the FEI4 hits in the scan window (the
+// instantaneous rate) and by the T3MAPS hits in the scan (the multiplicity).
+// The last bin of each axis also holds the overflows:
+struct BinnedCounts {
+  static const int nRateBins = 32;
+  static const int nMultBins = 16;
+  int rateBinWidth;// FEI4 hits per rate bin
+  MatchCounts counts[nRateBins][nMultBins];
+};
+
+class HitMatcher {
+
+ public:
+
+  HitMatcher(MapParameters *newMapper, ChipDimension *newChips,
+	     double newTimeOffset);
+  virtual ~HitMatcher() {};
+
+  // Mutators:
+  void clearMasks();
+  void maskPixel(TString chipName, int row, int col);
+  void setMask(TString chipName, std::vector<std::pair<int,int> > mask);
+  void setNoiseSweeps(NoiseSweep *newSweepT3MAPS, NoiseSweep *newSweepFEI4);
+  void setBinnedCounts(BinnedCounts *newBinned);
+  void setMapper(MapParameters *newMapper);
+  void setOrientation(int newOrientation);
+  void setPixelEfficiency(PixelEfficiency *newPixels);
+  void setScanCuts(int newMaxHits, int newRowMin, int newRowMax);
+  void setTimeOffset(double newTimeOffset);
+  static void resetCounts(MatchCounts &counts);
+  static void resetBinnedCounts(BinnedCounts &binned, int rateBinWidth);
+
+  // Accessors:
+  bool isMasked(TString chipName, int row, int col);
+  bool canMatchHit(TString chipName, std::pair<int,int> singleHit);
+  bool isHitMatched(TString chipName,
+		    const std::vector<std::pair<int,int> > &hitList,
+		    std::pair<int,int> singleHit);
+  bool matchScan(std::vector<int> *hit_row, std::vector<int> *hit_column,
+		 double timestamp_start, double timestamp_stop,
+		 EventBuilder *eventsFEI4, Long64_t &eventFEI4,
+		 MatchCounts &counts);
+  int getMapOrientation();
+  double getTimeOffset();
+  static double getEfficiency(int matched, int matchable);
+  static double getEfficiencyError(int matched, int matchable);
+
+ private:
+
+  MapParameters *mapper;
+  ChipDimension *chips;
+  double timeOffset;
+  int orientation;// -1 to use the current orientation of the mapper
+  BinnedCounts *binned;// NULL unless the scans are also binned
+  PixelEfficiency *pixels;// NULL unless the pixels are also counted
+  NoiseSweep *sweepT3MAPS;// NULL unless the noise thresholds are swept
+  NoiseSweep *sweepFEI4;
+
+  // T3MAPS quality cuts:
+  int maxHitsT3MAPS;
+  int rowMinT3MAPS;
+  int rowMaxT3MAPS;
+
+  // Masks stored as one flag per pixel, indexed by row*nCol + col:
+  int nRowFEI4;
+  int nColFEI4;
+  int nRowT3MAPS;
+  int nColT3MAPS;
+  std::vector<bool> maskFEI4;
+  std::vector<bool> maskT3MAPS;
+
+  // Scratch lists reused for every scan:
+  std::vector<std::pair<int,int> > hitsInT3MAPS;
+  std::vector<std::pair<int,int> > hitsInFEI4;
+
+};
+
+#endif
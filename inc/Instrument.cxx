@@ -0,0 +1,430 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: Instrument.cxx                                                      //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class collects the timers, counters and histograms of the            //
+//  instrumentation macros (see Instrument.h). The entries are kept in fixed  //
+//  arrays so that the recording needs no locks: only the registration of a   //
+//  new call site takes the mutex.                                            //
+//                                                                            //
+//  When the first entry is registered, a summary table and a JSON report     //
+//  are scheduled for the end of the program. The report goes to              //
+//  TestBeamOutput/instrument/<program>.json unless setReportFile() is        //
+//  called. Processes that leave with _exit() (e.g. the plot renderers) do    //
+//  not report.                                                               //
+//                                                                            //
+//  The trace keeps the spans of each thread in its own buffer, so recording  //
+//  a span takes no lock. Only the first span of a thread does. A thread      //
+//  keeps at most maxSpans spans, and the rest are counted as dropped.        //
+//                                                                            //
+//  With -DTESTBEAM_TRACK_ALLOC, operator new is replaced here so that every  //
+//  allocation is counted against the innermost timed scope of its thread.    //
+//  The counts of a scope exclude those of the scopes nested in it, and the   //
+//  summary and report list them per scope.                                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "Instrument.h"
+
+#include <sys/stat.h>
+#include <new>
+
+// One span of a timed scope:
+struct TraceSpan {
+  int timer;
+  Long64_t start;
+  Long64_t stop;
+};
+
+// The spans of one thread, kept until the end of the program:
+struct TraceThread {
+  int id;
+  TString name;
+  std::vector<TraceSpan> spans;
+  Long64_t nDropped;
+};
+
+static const int maxSpans = 1 << 20;
+static pthread_mutex_t traceMutex = PTHREAD_MUTEX_INITIALIZER;
+static std::vector<TraceThread*> traceThreads;
+static __thread TraceThread *currentThread = NULL;
+
+pthread_mutex_t Instrument::mutex = PTHREAD_MUTEX_INITIALIZER;
+bool Instrument::reportRegistered = false;
+TString Instrument::reportFile = "";
+Long64_t Instrument::startNs = Instrument::getTimeNs();
+
+bool Instrument::tracing = false;
+TString Instrument::traceFile = "";
+
+__thread int Instrument::currentScope = -1;
+Long64_t Instrument::allocCalls[Instrument::maxEntries+1];
+Long64_t Instrument::allocBytes[Instrument::maxEntries+1];
+
+const char *Instrument::timerNames[Instrument::maxEntries];
+Long64_t Instrument::timerCalls[Instrument::maxEntries];
+Long64_t Instrument::timerNs[Instrument::maxEntries];
+int Instrument::nTimers = 0;
+
+const char *Instrument::counterNames[Instrument::maxEntries];
+Long64_t Instrument::counterValues[Instrument::maxEntries];
+int Instrument::nCounters = 0;
+
+const char *Instrument::histNames[Instrument::maxEntries];
+Long64_t Instrument::histBins[Instrument::maxEntries][Instrument::nHistBins];
+Long64_t Instrument::histSums[Instrument::maxEntries];
+int Instrument::nHists = 0;
+
+/**
+   Get the index of a timer, adding it if it is new. Call sites with the same
+   name share the timer.
+   @param name - the name of the timer.
+   @returns - the index of the timer.
+*/
+int Instrument::getTimer(const char *name) {
+  return addEntry(timerNames, nTimers, name);
+}
+
+/**
+   Get the index of a counter, adding it if it is new.
+   @param name - the name of the counter.
+   @returns - the index of the counter.
+*/
+int Instrument::getCounter(const char *name) {
+  return addEntry(counterNames, nCounters, name);
+}
+
+/**
+   Get the index of a histogram, adding it if it is new.
+   @param name - the name of the histogram.
+   @returns - the index of the histogram.
+*/
+int Instrument::getHistogram(const char *name) {
+  return addEntry(histNames, nHists, name);
+}
+
+/**
+   Find or add a name in one of the lists. The names must stay valid for the
+   whole program (the macros give string literals). The new entries start at
+   zero, since the arrays are static.
+   @param names - the list of names.
+   @param nNames - the number of names in the list (increased if added).
+   @param name - the name.
+   @returns - the index of the name.
+*/
+int Instrument::addEntry(const char **names, int &nNames, const char *name) {
+  registerReport();
+  pthread_mutex_lock(&mutex);
+  int index = 0;
+  while (index < nNames && strcmp(names[index], name) != 0) index++;
+  if (index == nNames) {
+    if (nNames >= maxEntries) {
+      pthread_mutex_unlock(&mutex);
+      std::cout << "Instrument: Too many entries, increase maxEntries."
+		<< std::endl;
+      exit(0);
+    }
+    names[index] = name;
+    nNames++;
+  }
+  pthread_mutex_unlock(&mutex);
+  return index;
+}
+
+#ifdef TESTBEAM_TRACK_ALLOC
+
+// Every allocation of the program goes through these:
+void *operator new(size_t size) {
+  Instrument::addAllocation((Long64_t)size);
+  void *pointer = malloc(size > 0 ? size : 1);
+  if (!pointer) throw std::bad_alloc();
+  return pointer;
+}
+
+void *operator new[](size_t size) {
+  Instrument::addAllocation((Long64_t)size);
+  void *pointer = malloc(size > 0 ? size : 1);
+  if (!pointer) throw std::bad_alloc();
+  return pointer;
+}
+
+void operator delete(void *pointer) {
+  free(pointer);
+}
+
+void operator delete[](void *pointer) {
+  free(pointer);
+}
+
+#endif
+
+/**
+   Get the number of allocations counted so far (0 unless the program is
+   built with -DTESTBEAM_TRACK_ALLOC).
+*/
+Long64_t Instrument::getNAllocations() {
+  Long64_t total = 0;
+  for (int i_t = 0; i_t <= maxEntries; i_t++) total += allocCalls[i_t];
+  return total;
+}
+
+/**
+   Get the number of bytes allocated so far (0 unless the program is built
+   with -DTESTBEAM_TRACK_ALLOC).
+*/
+Long64_t Instrument::getNAllocatedBytes() {
+  Long64_t total = 0;
+  for (int i_t = 0; i_t <= maxEntries; i_t++) total += allocBytes[i_t];
+  return total;
+}
+
+/**
+   Schedule the report for the end of the program, once.
+*/
+void Instrument::registerReport() {
+  pthread_mutex_lock(&mutex);
+  if (!reportRegistered) {
+    atexit(reportAtExit);
+    reportRegistered = true;
+  }
+  pthread_mutex_unlock(&mutex);
+}
+
+/**
+   Print the totals of every timer, counter and histogram.
+*/
+void Instrument::printSummary() {
+  double wallTime = 1e-9 * (getTimeNs() - startNs);
+  printf("\nInstrument: Summary after %.3f s\n", wallTime);
+  printf("  %-28s %12s %12s %12s %7s\n", "timer", "calls", "total [s]",
+	 "mean [us]", "wall %");
+  for (int i_t = 0; i_t < nTimers; i_t++) {
+    double total = 1e-9 * timerNs[i_t];
+    double mean = timerCalls[i_t] > 0 ? 1e-3 * timerNs[i_t]/timerCalls[i_t] : 0;
+    printf("  %-28s %12lld %12.4f %12.3f %7.2f\n", timerNames[i_t],
+	   timerCalls[i_t], total, mean,
+	   wallTime > 0 ? 100.0 * total / wallTime : 0.0);
+  }
+  if (nCounters > 0) printf("  %-28s %12s\n", "counter", "value");
+  for (int i_c = 0; i_c < nCounters; i_c++) {
+    printf("  %-28s %12lld\n", counterNames[i_c], counterValues[i_c]);
+  }
+  if (nHists > 0) printf("  %-28s %12s %12s\n", "histogram", "entries", "mean");
+  for (int i_h = 0; i_h < nHists; i_h++) {
+    Long64_t entries = 0;
+    for (int i_b = 0; i_b < nHistBins; i_b++) entries += histBins[i_h][i_b];
+    printf("  %-28s %12lld %12.3f\n", histNames[i_h], entries,
+	   entries > 0 ? (double)histSums[i_h] / entries : 0.0);
+  }
+#ifdef TESTBEAM_TRACK_ALLOC
+  printf("  %-28s %12s %12s %12s\n", "allocations", "calls", "MB",
+	 "per call");
+  for (int i_t = 0; i_t <= nTimers; i_t++) {
+    int scope = (i_t < nTimers) ? i_t : maxEntries;
+    if (allocCalls[scope] == 0) continue;
+    printf("  %-28s %12lld %12.3f %12.3f\n",
+	   (i_t < nTimers) ? timerNames[i_t] : "(outside scopes)",
+	   allocCalls[scope], allocBytes[scope] / 1048576.0,
+	   (i_t < nTimers && timerCalls[i_t] > 0) ?
+	   (double)allocCalls[i_t] / timerCalls[i_t] : 0.0);
+  }
+#endif
+  fflush(stdout);
+}
+
+/**
+   Set the file of the report written at the end of the program.
+   @param fileName - the JSON file.
+*/
+void Instrument::setReportFile(TString fileName) {
+  reportFile = fileName;
+}
+
+/**
+   Write every timer, counter and histogram to a JSON file.
+   @param fileName - the JSON file.
+*/
+void Instrument::writeReport(TString fileName) {
+  std::ofstream output(fileName.Data());
+  if (!output.is_open()) {
+    std::cout << "Instrument: Could not write " << fileName << std::endl;
+    return;
+  }
+  output << "{\n  \"program\": \"" << getProgramName() << "\",\n";
+  output << "  \"wall_s\": " << 1e-9 * (getTimeNs() - startNs) << ",\n";
+  output << "  \"timers\": [";
+  for (int i_t = 0; i_t < nTimers; i_t++) {
+    output << (i_t > 0 ? ",\n" : "\n") << "    {\"name\": \""
+	   << timerNames[i_t] << "\", \"calls\": " << timerCalls[i_t]
+	   << ", \"total_s\": " << 1e-9 * timerNs[i_t] << "}";
+  }
+  output << "\n  ],\n  \"counters\": [";
+  for (int i_c = 0; i_c < nCounters; i_c++) {
+    output << (i_c > 0 ? ",\n" : "\n") << "    {\"name\": \""
+	   << counterNames[i_c] << "\", \"value\": " << counterValues[i_c]
+	   << "}";
+  }
+  output << "\n  ],\n  \"histograms\": [";
+  for (int i_h = 0; i_h < nHists; i_h++) {
+    output << (i_h > 0 ? ",\n" : "\n") << "    {\"name\": \""
+	   << histNames[i_h] << "\", \"sum\": " << histSums[i_h]
+	   << ", \"bins\": [";
+    for (int i_b = 0; i_b < nHistBins; i_b++) {
+      output << (i_b > 0 ? ", " : "") << histBins[i_h][i_b];
+    }
+    output << "]}";
+  }
+#ifdef TESTBEAM_TRACK_ALLOC
+  output << "\n  ],\n  \"allocations\": [";
+  for (int i_t = 0; i_t <= nTimers; i_t++) {
+    int scope = (i_t < nTimers) ? i_t : maxEntries;
+    output << (i_t > 0 ? ",\n" : "\n") << "    {\"name\": \""
+	   << ((i_t < nTimers) ? timerNames[i_t] : "(outside scopes)")
+	   << "\", \"calls\": " << allocCalls[scope] << ", \"bytes\": "
+	   << allocBytes[scope] << "}";
+  }
+#endif
+  output << "\n  ]\n}" << std::endl;
+  output.close();
+  std::cout << "Instrument: Report written to " << fileName << std::endl;
+}
+
+/**
+   Keep the spans of the timed scopes from now on, for a timeline of the
+   program written at exit. Call it from the main thread.
+   @param fileName - the trace file (default: next to the JSON report).
+*/
+void Instrument::startTrace(TString fileName) {
+  traceFile = fileName;
+  registerReport();
+  tracing = true;
+  setThreadName("main");
+}
+
+/**
+   Keep the span of a timed scope in the buffer of the calling thread.
+   @param timer - the timer of the scope.
+   @param start - the start time in ns.
+   @param stop - the end time in ns.
+*/
+void Instrument::addSpan(int timer, Long64_t start, Long64_t stop) {
+  if (!currentThread) {
+    setThreadName("");
+    if (!currentThread) return;
+  }
+  if ((int)currentThread->spans.size() >= maxSpans) {
+    currentThread->nDropped++;
+    return;
+  }
+  TraceSpan span;
+  span.timer = timer;
+  span.start = start;
+  span.stop = stop;
+  currentThread->spans.push_back(span);
+}
+
+/**
+   Name the calling thread in the trace. Does nothing unless tracing.
+   @param name - the name (default "thread <id>" if empty).
+*/
+void Instrument::setThreadName(TString name) {
+  if (!tracing) return;
+  if (!currentThread) {
+    TraceThread *thread = new TraceThread();
+    thread->nDropped = 0;
+    pthread_mutex_lock(&traceMutex);
+    thread->id = (int)traceThreads.size();
+    traceThreads.push_back(thread);
+    pthread_mutex_unlock(&traceMutex);
+    currentThread = thread;
+  }
+  currentThread->name = name.IsNull() ?
+    TString(Form("thread %d", currentThread->id)) : name;
+}
+
+/**
+   Write the spans of every thread in the trace event format. The times are
+   in microseconds from the start of the program. Must not be called while
+   other threads are recording.
+   @param fileName - the JSON file.
+*/
+void Instrument::writeTrace(TString fileName) {
+  std::ofstream output(fileName.Data());
+  if (!output.is_open()) {
+    std::cout << "Instrument: Could not write " << fileName << std::endl;
+    return;
+  }
+  int pid = (int)getpid();
+  char line[256];
+  Long64_t nSpans = 0;
+  Long64_t nDropped = 0;
+  output << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [\n";
+  output << "  {\"name\": \"process_name\", \"ph\": \"M\", \"pid\": " << pid
+	 << ", \"args\": {\"name\": \"" << getProgramName() << "\"}}";
+  pthread_mutex_lock(&traceMutex);
+  for (int i_t = 0; i_t < (int)traceThreads.size(); i_t++) {
+    TraceThread *thread = traceThreads[i_t];
+    output << ",\n  {\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": "
+	   << pid << ", \"tid\": " << thread->id << ", \"args\": {\"name\": \""
+	   << thread->name << "\"}}";
+    for (int i_s = 0; i_s < (int)thread->spans.size(); i_s++) {
+      const TraceSpan &span = thread->spans[i_s];
+      snprintf(line, sizeof(line), ",\n  {\"name\": \"%s\", \"cat\": "
+	       "\"instrument\", \"ph\": \"X\", \"pid\": %d, \"tid\": %d, "
+	       "\"ts\": %.3f, \"dur\": %.3f}", timerNames[span.timer], pid,
+	       thread->id, 1e-3 * (span.start - startNs),
+	       1e-3 * (span.stop - span.start));
+      output << line;
+    }
+    nSpans += (Long64_t)thread->spans.size();
+    nDropped += thread->nDropped;
+  }
+  pthread_mutex_unlock(&traceMutex);
+  output << "\n]}" << std::endl;
+  output.close();
+  std::cout << "Instrument: Trace of " << nSpans << " spans written to "
+	    << fileName << std::endl;
+  if (nDropped > 0) {
+    std::cout << "Instrument: Dropped " << nDropped
+	      << " spans beyond the limit per thread." << std::endl;
+  }
+}
+
+/**
+   Print the summary and write the report (and trace), at the end of the
+   program.
+*/
+void Instrument::reportAtExit() {
+  printSummary();
+  TString outputDir = "../TestBeamOutput/instrument";
+  if (reportFile.IsNull() || (tracing && traceFile.IsNull())) {
+    mkdir("../TestBeamOutput", 0755);
+    mkdir(outputDir.Data(), 0755);
+  }
+  TString fileName = reportFile;
+  if (fileName.IsNull()) {
+    fileName = Form("%s/%s.json", outputDir.Data(), getProgramName().Data());
+  }
+  writeReport(fileName);
+  if (tracing) {
+    tracing = false;
+    fileName = traceFile;
+    if (fileName.IsNull()) {
+      fileName = Form("%s/%s.trace.json", outputDir.Data(),
+		      getProgramName().Data());
+    }
+    writeTrace(fileName);
+  }
+}
+
+/**
+   Get the name of the running program (Linux only, "program" elsewhere).
+*/
+TString Instrument::getProgramName() {
+  std::ifstream comm("/proc/self/comm");
+  std::string name = "";
+  if (comm.is_open()) std::getline(comm, name);
+  return name.empty() ? "program" : name.c_str();
+}
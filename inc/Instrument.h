@@ -0,0 +1,193 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: Instrument.h                                                        //
+//  Class: Instrument.cxx                                                     //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  The hot paths are instrumented with the macros below:                     //
+//                                                                            //
+//    INSTRUMENT_SCOPE("match.scan");       // time the rest of the block     //
+//    INSTRUMENT_COUNT("read.FEI4", n);     // add n to a counter             //
+//    INSTRUMENT_FILL("hits.T3MAPS", n);    // histogram of small counts      //
+//                                                                            //
+//  Each call site looks up its entry once, and then only reads the clock     //
+//  and does atomic additions. Compiling with -DTESTBEAM_NO_INSTRUMENT        //
+//  removes the macros entirely.                                              //
+//                                                                            //
+//  After startTrace(), every timed scope is also kept as a span of its       //
+//  thread and written at exit in the trace event format, which can be        //
+//  opened in chrome://tracing or ui.perfetto.dev to see the timeline.        //
+//                                                                            //
+//  Compiling with -DTESTBEAM_TRACK_ALLOC also replaces operator new, and     //
+//  counts each allocation against the innermost timed scope of its thread.   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef Instrument_h
+#define Instrument_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <iostream>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <pthread.h>
+#include <unistd.h>
+
+#include "TString.h"
+
+class Instrument {
+
+ public:
+
+  static const int maxEntries = 128;
+  static const int nHistBins = 64;// the last bin counts the overflows
+
+  // Registration, once per call site (by the macros):
+  static int getTimer(const char *name);
+  static int getCounter(const char *name);
+  static int getHistogram(const char *name);
+
+  // Recording, safe from any thread:
+  static void addTime(int timer, Long64_t ns) {
+    __sync_fetch_and_add(&timerCalls[timer], (Long64_t)1);
+    __sync_fetch_and_add(&timerNs[timer], ns);
+  };
+  static void addCount(int counter, Long64_t n) {
+    __sync_fetch_and_add(&counterValues[counter], n);
+  };
+  static void fill(int histogram, Long64_t value) {
+    int bin = (value < 0) ? 0 : (value >= nHistBins - 1) ? nHistBins - 1 :
+      (int)value;
+    __sync_fetch_and_add(&histBins[histogram][bin], (Long64_t)1);
+    __sync_fetch_and_add(&histSums[histogram], value);
+  };
+  static void addAllocation(Long64_t bytes) {
+    int scope = (currentScope >= 0) ? currentScope : maxEntries;
+    __sync_fetch_and_add(&allocCalls[scope], (Long64_t)1);
+    __sync_fetch_and_add(&allocBytes[scope], bytes);
+  };
+  static Long64_t getNAllocations();
+  static Long64_t getNAllocatedBytes();
+  static Long64_t getTimeNs() {
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return (Long64_t)now.tv_sec * 1000000000LL + (Long64_t)now.tv_nsec;
+  };
+
+  // Reporting:
+  static void printSummary();
+  static void setReportFile(TString fileName);
+  static void writeReport(TString fileName);
+
+  // Timeline of the timed scopes:
+  static void startTrace(TString fileName = "");
+  static bool isTracing() { return tracing; };
+  static void addSpan(int timer, Long64_t start, Long64_t stop);
+  static void setThreadName(TString name);
+  static void writeTrace(TString fileName);
+
+ private:
+
+  static int addEntry(const char **names, int &nNames, const char *name);
+  static void registerReport();
+  static void reportAtExit();
+  static TString getProgramName();
+
+  static pthread_mutex_t mutex;
+  static bool reportRegistered;
+  static TString reportFile;
+  static Long64_t startNs;
+
+  static bool tracing;
+  static TString traceFile;
+
+  // The innermost timed scope of the thread (-1 outside), and the
+  // allocations of each timer (the last entry counts those outside scopes):
+  friend class InstrumentScope;
+  static __thread int currentScope;
+  static Long64_t allocCalls[maxEntries+1];
+  static Long64_t allocBytes[maxEntries+1];
+
+  static const char *timerNames[maxEntries];
+  static Long64_t timerCalls[maxEntries];
+  static Long64_t timerNs[maxEntries];
+  static int nTimers;
+
+  static const char *counterNames[maxEntries];
+  static Long64_t counterValues[maxEntries];
+  static int nCounters;
+
+  static const char *histNames[maxEntries];
+  static Long64_t histBins[maxEntries][nHistBins];
+  static Long64_t histSums[maxEntries];
+  static int nHists;
+
+};
+
+// Times the enclosing block with one of the timers:
+class InstrumentScope {
+
+ public:
+
+  InstrumentScope(int newTimer) {
+    timer = newTimer;
+#ifdef TESTBEAM_TRACK_ALLOC
+    outerScope = Instrument::currentScope;
+    Instrument::currentScope = timer;
+#endif
+    start = Instrument::getTimeNs();
+  };
+  ~InstrumentScope() {
+    Long64_t stop = Instrument::getTimeNs();
+    Instrument::addTime(timer, stop - start);
+    if (Instrument::isTracing()) Instrument::addSpan(timer, start, stop);
+#ifdef TESTBEAM_TRACK_ALLOC
+    Instrument::currentScope = outerScope;
+#endif
+  };
+
+ private:
+
+  int timer;
+  Long64_t start;
+#ifdef TESTBEAM_TRACK_ALLOC
+  int outerScope;
+#endif
+
+};
+
+#ifdef TESTBEAM_NO_INSTRUMENT
+
+#define INSTRUMENT_SCOPE(name)
+#define INSTRUMENT_COUNT(name, n)
+#define INSTRUMENT_FILL(name, value)
+
+#else
+
+#define INSTRUMENT_JOIN2(a, b) a##b
+#define INSTRUMENT_JOIN(a, b) INSTRUMENT_JOIN2(a, b)
+#define INSTRUMENT_SCOPE(name)						\
+  static int INSTRUMENT_JOIN(instrumentTimer, __LINE__)			\
+    = Instrument::getTimer(name);					\
+  InstrumentScope INSTRUMENT_JOIN(instrumentScope, __LINE__)		\
+    (INSTRUMENT_JOIN(instrumentTimer, __LINE__))
+#define INSTRUMENT_COUNT(name, n)					\
+  do {									\
+    static int instrumentCounter = Instrument::getCounter(name);	\
+    Instrument::addCount(instrumentCounter, (n));			\
+  } while (0)
+#define INSTRUMENT_FILL(name, value)					\
+  do {									\
+    static int instrumentHist = Instrument::getHistogram(name);		\
+    Instrument::fill(instrumentHist, (value));				\
+  } while (0)
+
+#endif
+
+#endif
@@ -15,6 +15,10 @@
 //                                                                            //
 //  The class will produce an output root file.                               //
 //                                                                            //
+//  With the "Follow" option the input file may still be growing. Each call   //
+//  to poll() parses newly completed scans, keeps the most recent ones in a   //
+//  buffer for online matching, and appends them to a rolling output file.    //
+//                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "LoadT3MAPS.h"
@@ -26,72 +30,32 @@
    @param outFileName - the name of the file in which the TTree will be saved. 
 */
 LoadT3MAPS::LoadT3MAPS(std::string inFileName, std::string outFileName) {
+  loadFile(inFileName, outFileName);
+}
+
+/**
+   Read the whole input textfile into a TTree and save it.
+   @param inFileName - the input text file with the T3MAPS hit tables.
+   @param outFileName - the name of the file in which the TTree will be saved. 
+*/
+void LoadT3MAPS::loadFile(std::string inFileName, std::string outFileName) {
   std::cout << "\nLoadT3MAPS: Initializing..." << "\n\tLoading " << inFileName
 	    << "\n\tReturning " << outFileName << std::endl;
   
   nEvents = 0;
-    
-  int currLineIndex = 0;
+  currLineIndex = 0;
+  followMode = false;
+  
   std::string currText;
-  char *outFileNameC = (char*)outFileName.c_str();
   // Load output file, configure output TTree:
-  outputT3MAPS = new TFile(outFileNameC,"recreate");
-  treeT3MAPS = new TTree("TreeT3MAPS","TreeT3MAPS");
-  treeT3MAPS->Branch("nHits", &nHits, "nHits/I");
-  treeT3MAPS->Branch("timestamp_start", &timestamp_start, "timestamp_start/D");
-  treeT3MAPS->Branch("timestamp_stop", &timestamp_stop, "timestamp_stop/D");
-  treeT3MAPS->Branch("hit_row", "std::vector<int>", &hit_row);
-  treeT3MAPS->Branch("hit_column", "std::vector<int>", &hit_column);
+  openOutput(outFileName);
   
   // Open input text file from T3MAPS run:
   char *inFileNameC = (char*)inFileName.c_str();
   ifstream historyFile(inFileNameC);
   if (historyFile.is_open()) {
     while (getline(historyFile, currText) ) {
-      
-      // Start counting the line numbers (one run is 0-23)
-      std::size_t foundText = currText.find("BEGIN SCAN");
-      if (foundText!=std::string::npos) {
-	currLineIndex = 0;
-	hit_row.clear();
-	hit_column.clear();
-	nHits = 0;
-	if (nEvents % 100 == 0) { std::cout << currText << std::endl; }
-      }
-      
-      // start time recorded:
-      if (currLineIndex == 2) { 
-	timestamp_start = atoi((char*)currText.c_str());
-      }
-      // stop time recorded:
-      else if (currLineIndex == 4) {
-	timestamp_stop = atoi((char*)currText.c_str());
-      }
-      
-      // get hit table information:
-      else if (currLineIndex > 4 && currLineIndex < 23) {
-	int currRow = currLineIndex - 5;
-	
-	std::vector<std::string> hitRows = delimString(currText, " ");
-	
-	// iterate over the columns that were hit in each row:
-	for (std::vector<std::string>::iterator it = hitRows.begin(); 
-	     it != hitRows.end(); ++it) {
-	  int currColumn = atoi(it->c_str());// + 1;
-	  hit_row.push_back(currRow);
-	  hit_column.push_back(currColumn);
-	  nHits++;
-	}
-      }
-      
-      // end scan, save event information:
-      else if (currLineIndex == 23) {
-	treeT3MAPS->Fill();
-	nEvents++;
-      }
-            
-      // increment the line number:
-      currLineIndex++;
+      if (parseLine(currText)) storeScan();
     }
   }
   
@@ -103,6 +67,259 @@ LoadT3MAPS::LoadT3MAPS(std::string inFileName, std::string outFileName) {
   return;
 }
 
+/**
+   Initialize the T3MAPS data class with options. Without the "Follow" option
+   this behaves like the two-argument constructor. With "Follow", nothing is
+   read yet: each call to poll() parses the scans that were appended to the
+   input file since the previous call, keeps the most recent ones in memory,
+   and writes them to a series of rolling output files.
+   @param inFileName - the input text file with the T3MAPS hit tables.
+   @param outFileName - the output ROOT file. In follow mode, "_N" is inserted
+   before the extension to number the rolling files.
+   @param options - "Follow" to watch a file that is still being written.
+*/
+LoadT3MAPS::LoadT3MAPS(std::string inFileName, std::string outFileName,
+		       TString options) {
+  if (!options.Contains("Follow")) {
+    loadFile(inFileName, outFileName);
+    return;
+  }
+  std::cout << "\nLoadT3MAPS: Following " << inFileName << std::endl;
+  
+  nEvents = 0;
+  currLineIndex = 0;
+  followMode = true;
+  inputName = inFileName;
+  readOffset = 0;
+  nOutputFiles = 0;
+  scansPerFile = 1000;
+  bufferSize = 1000;
+  firstBufferedScan = 0;
+  nRestarts = 0;
+  scanBuffer.clear();
+  
+  // Strip the extension so that the rolling files can be numbered:
+  TString outBase = outFileName;
+  if (outBase.EndsWith(".root")) outBase.Remove(outBase.Length()-5);
+  outputBase = (std::string)outBase;
+  openOutput(Form("%s_%d.root", outputBase.c_str(), nOutputFiles));
+  return;
+}
+
+/**
+   Create a new output file and TTree, with branches attached to the members.
+   @param fileName - the name of the output ROOT file.
+*/
+void LoadT3MAPS::openOutput(std::string fileName) {
+  outputT3MAPS = new TFile(fileName.c_str(),"recreate");
+  treeT3MAPS = new TTree("TreeT3MAPS","TreeT3MAPS");
+  treeT3MAPS->Branch("nHits", &nHits, "nHits/I");
+  treeT3MAPS->Branch("timestamp_start", &timestamp_start, "timestamp_start/D");
+  treeT3MAPS->Branch("timestamp_stop", &timestamp_stop, "timestamp_stop/D");
+  treeT3MAPS->Branch("hit_row", "std::vector<int>", &hit_row);
+  treeT3MAPS->Branch("hit_column", "std::vector<int>", &hit_column);
+}
+
+/**
+   Parse one line of the history file. A scan spans lines 0-23 counted from
+   "BEGIN SCAN": the start time is on line 2, the stop time on line 4, the
+   hit table on lines 5-22 (one line per row), and line 23 ends the scan.
+   @param currText - the line of input text (without the newline).
+   @returns - true iff the line completed a scan.
+*/
+bool LoadT3MAPS::parseLine(std::string currText) {
+  bool scanComplete = false;
+  
+  // Start counting the line numbers (one run is 0-23)
+  std::size_t foundText = currText.find("BEGIN SCAN");
+  if (foundText!=std::string::npos) {
+    currLineIndex = 0;
+    hit_row.clear();
+    hit_column.clear();
+    nHits = 0;
+    if (nEvents % 100 == 0) { std::cout << currText << std::endl; }
+  }
+  
+  // start time recorded:
+  if (currLineIndex == 2) { 
+    timestamp_start = atoi((char*)currText.c_str());
+  }
+  // stop time recorded:
+  else if (currLineIndex == 4) {
+    timestamp_stop = atoi((char*)currText.c_str());
+  }
+  
+  // get hit table information:
+  else if (currLineIndex > 4 && currLineIndex < 23) {
+    int currRow = currLineIndex - 5;
+    
+    std::vector<std::string> hitRows = delimString(currText, " ");
+    
+    // iterate over the columns that were hit in each row:
+    for (std::vector<std::string>::iterator it = hitRows.begin(); 
+	 it != hitRows.end(); ++it) {
+      int currColumn = atoi(it->c_str());// + 1;
+      hit_row.push_back(currRow);
+      hit_column.push_back(currColumn);
+      nHits++;
+    }
+  }
+  
+  // end scan, save event information:
+  else if (currLineIndex == 23) {
+    scanComplete = true;
+  }
+  
+  // increment the line number:
+  currLineIndex++;
+  return scanComplete;
+}
+
+/**
+   Save the scan that was just parsed. In follow mode the scan is also added
+   to the buffer, and the output file is rolled over every scansPerFile scans.
+*/
+void LoadT3MAPS::storeScan() {
+  treeT3MAPS->Fill();
+  nEvents++;
+  if (!followMode) return;
+  
+  ScanT3MAPS currScan;
+  currScan.timestamp_start = timestamp_start;
+  currScan.timestamp_stop = timestamp_stop;
+  currScan.hit_row = hit_row;
+  currScan.hit_column = hit_column;
+  scanBuffer.push_back(currScan);
+  while ((int)scanBuffer.size() > bufferSize) {
+    scanBuffer.pop_front();
+    firstBufferedScan++;
+  }
+  
+  if (nEvents % scansPerFile == 0) {
+    treeT3MAPS->Write();
+    outputT3MAPS->Close();
+    nOutputFiles++;
+    openOutput(Form("%s_%d.root", outputBase.c_str(), nOutputFiles));
+  }
+}
+
+/**
+   Forget everything read from the input file so far, so that it is read again
+   from the beginning. The buffered scans and any partially parsed scan are
+   discarded, scans are numbered from 0 again, and the scans written so far
+   are closed in the current rolling file before a new one is started.
+*/
+void LoadT3MAPS::restartFollow() {
+  // Parser state:
+  currLineIndex = 0;
+  nHits = 0;
+  hit_row.clear();
+  hit_column.clear();
+  
+  // Follow mode state:
+  readOffset = 0;
+  nEvents = 0;
+  firstBufferedScan = 0;
+  scanBuffer.clear();
+  nRestarts++;
+  
+  // Start a new rolling output file:
+  treeT3MAPS->Write();
+  outputT3MAPS->Close();
+  nOutputFiles++;
+  openOutput(Form("%s_%d.root", outputBase.c_str(), nOutputFiles));
+}
+
+/**
+   Read any complete lines that were appended to the input file since the
+   last call. A trailing line without a newline is left for the next call. If
+   the file has shrunk (e.g. it was truncated or replaced), reading restarts
+   from the beginning (see restartFollow()).
+   @returns - the number of new scans.
+*/
+int LoadT3MAPS::poll() {
+  if (!followMode) {
+    std::cout << "LoadT3MAPS: poll() requires the Follow option." << std::endl;
+    return 0;
+  }
+  
+  ifstream historyFile(inputName.c_str());
+  if (!historyFile.is_open()) return 0;
+  historyFile.seekg(0, std::ios::end);
+  Long64_t fileSize = (Long64_t)historyFile.tellg();
+  if (fileSize < readOffset) {
+    std::cout << "LoadT3MAPS: " << inputName << " shrank, restarting."
+	      << std::endl;
+    restartFollow();
+  }
+  historyFile.seekg(readOffset);
+  
+  int nNewScans = 0;
+  std::string currText;
+  while (readOffset < fileSize && getline(historyFile, currText)) {
+    // The writer has not finished this line yet:
+    if (historyFile.eof()) break;
+    readOffset += (Long64_t)currText.size() + 1;
+    if (parseLine(currText)) {
+      storeScan();
+      nNewScans++;
+    }
+  }
+  historyFile.close();
+  
+  // Make the new scans visible to readers of the output file:
+  if (nNewScans > 0) treeT3MAPS->AutoSave("SaveSelf");
+  return nNewScans;
+}
+
+/**
+   Set the number of recent scans kept in memory in follow mode.
+   @param size - the maximum number of buffered scans.
+*/
+void LoadT3MAPS::setBufferSize(int size) {
+  bufferSize = size;
+}
+
+/**
+   Set the number of scans written to each rolling output file.
+   @param nScans - the number of scans per file.
+*/
+void LoadT3MAPS::setScansPerFile(int nScans) {
+  if (nScans <= 0) {
+    std::cout << "LoadT3MAPS: Scans per file must be positive, not "
+	      << nScans << std::endl;
+    exit(0);
+  }
+  scansPerFile = nScans;
+}
+
+/**
+   Returns the number of times the input file shrank and was read again from
+   the beginning. Scan numbers start again from 0 after each restart.
+*/
+int LoadT3MAPS::getNRestarts() {
+  return nRestarts;
+}
+
+/**
+   Returns the index of the oldest scan still held in the buffer. Scans are
+   numbered from 0 in the order they were read.
+*/
+int LoadT3MAPS::getFirstBufferedScan() {
+  return firstBufferedScan;
+}
+
+/**
+   Returns a scan from the follow-mode buffer.
+   @param scanIndex - the scan number (from getFirstBufferedScan() up to
+   getNEvents()-1).
+   @returns - a pointer to the scan, or NULL if it is no longer buffered.
+*/
+ScanT3MAPS *LoadT3MAPS::getScan(int scanIndex) {
+  if (scanIndex < firstBufferedScan || scanIndex >= nEvents) return NULL;
+  return &scanBuffer[scanIndex - firstBufferedScan];
+}
+
 /**
    Returns the number of events in the data.
 */
@@ -121,6 +338,7 @@ TTree* LoadT3MAPS::getTree() {
    Close the input files and delete TTree from memory.
 */
 void LoadT3MAPS::closeFiles() {
+  if (followMode) treeT3MAPS->Write();
   outputT3MAPS->Close();
 }
 
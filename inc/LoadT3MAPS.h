@@ -17,18 +17,30 @@
 #include <iostream>
 #include <fstream>
 #include <vector>
+#include <deque>
 #include <string>
 
 #include "TFile.h"
+#include "TString.h"
 #include "TTree.h"
 #include "TROOT.h"
 
+// A single complete T3MAPS scan, as kept in the follow-mode buffer:
+struct ScanT3MAPS {
+  Double_t timestamp_start;
+  Double_t timestamp_stop;
+  std::vector<int> hit_row;
+  std::vector<int> hit_column;
+};
+
 class LoadT3MAPS 
 {
   
  public:
   
   LoadT3MAPS( std::string inFileName, std::string outFileName);
+  LoadT3MAPS( std::string inFileName, std::string outFileName, 
+	      TString options);
   virtual ~LoadT3MAPS() {};
   
   // Member functions:
@@ -36,12 +48,41 @@ class LoadT3MAPS
   TTree* getTree();
   void closeFiles();
   
+  // Follow mode:
+  int poll();
+  void setBufferSize(int size);
+  void setScansPerFile(int nScans);
+  int getNRestarts();
+  int getFirstBufferedScan();
+  ScanT3MAPS *getScan(int scanIndex);
+  
  private:
   
+  void loadFile(std::string inFileName, std::string outFileName);
+  void openOutput(std::string fileName);
+  bool parseLine(std::string currText);
+  void storeScan();
+  void restartFollow();
+  
   int nEvents;
   TFile *outputT3MAPS; 
   TTree *treeT3MAPS;
   
+  // Parser state:
+  int currLineIndex;
+  
+  // Follow mode state:
+  bool followMode;
+  std::string inputName;
+  std::string outputBase;
+  Long64_t readOffset;
+  int nOutputFiles;
+  int scansPerFile;
+  int bufferSize;
+  int firstBufferedScan;
+  int nRestarts;
+  std::deque<ScanT3MAPS> scanBuffer;
+  
   // variables stored in TTree:
   int nHits;
   Double_t timestamp_start;
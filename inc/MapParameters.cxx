@@ -25,10 +25,16 @@
 //  information for each chip to fix the slope parameters and only allow two  //
 //  free parameters for the maps. These will be chosen using a plot.          //
 //                                                                            //
+//  The maps are stored in the alignment database (see AlignmentDB), one      //
+//  entry per run and time interval. A map can be loaded for a run and time,  //
+//  interpolated between the calibrations of that run.                        //
+//                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "MapParameters.h"
 
+#include "Instrument.h"
+
 /**
    Initialize the class either using the results of a previous run or using the
    intputs from a loop over TTrees.
@@ -43,6 +49,16 @@ MapParameters::MapParameters(TString fileDir, TString option) {
 
   setOrientation(1);// What we believe to be correct
   
+  // Statistical uncertainties and the residual alignment are only known for
+  // maps made here, or for maps loaded with them (this must precede the load,
+  // which prints them):
+  for (int i_h = 0; i_h < 4; i_h++) {
+    for (int i_p = 0; i_p < 4; i_p++) mStatErr[i_h][i_p] = 0.0;
+    mSlopeCorr[i_h][0] = 0.0;
+    mSlopeCorr[i_h][1] = 0.0;
+    mRotation[i_h] = 0.0;
+  }
+  
   // Load map from file:
   if (option.Contains("FromFile")) {
     loadMapParameters(fileDir);
@@ -79,17 +95,17 @@ MapParameters::MapParameters(TString fileDir, TString option) {
 		  chips->getColPosition("T3MAPS",chips->getNCol("T3MAPS")));
   double cMax1 = chips->getColPosition("FEI4",chips->getNCol("FEI4"));
   double cMax2 = cMax1 - cMin1;
-  h2Sig[0] = new TH2D("h2Sig0","h2Sig0",nRBin,rMin1,rMax1,nCBin,cMin1,cMax1);
-  h2Bkg[0] = new TH2D("h2Bkg0","h2Bkg0",nRBin,rMin1,rMax1,nCBin,cMin1,cMax1);
+  h2Sig[0] = new FixedHist(nRBin,rMin1,rMax1,nCBin,cMin1,cMax1);
+  h2Bkg[0] = new FixedHist(nRBin,rMin1,rMax1,nCBin,cMin1,cMax1);
   h2Diff[0] = new TH2D("h2Diff0","h2Diff0",nRBin,rMin1,rMax1,nCBin,cMin1,cMax1);
-  h2Sig[1] = new TH2D("h2Sig1","h2Sig1",nRBin,rMin1,rMax1,nCBin,0.0,cMax2);
-  h2Bkg[1] = new TH2D("h2Bkg1","h2Bkg1",nRBin,rMin1,rMax1,nCBin,0.0,cMax2);
+  h2Sig[1] = new FixedHist(nRBin,rMin1,rMax1,nCBin,0.0,cMax2);
+  h2Bkg[1] = new FixedHist(nRBin,rMin1,rMax1,nCBin,0.0,cMax2);
   h2Diff[1] = new TH2D("h2Diff1","h2Diff1",nRBin,rMin1,rMax1,nCBin,0.0,cMax2);
-  h2Sig[2] = new TH2D("h2Sig2","h2Sig2",nRBin,0.0,rMax2,nCBin,cMin1,cMax1);
-  h2Bkg[2] = new TH2D("h2Bkg2","h2Bkg2",nRBin,0.0,rMax2,nCBin,cMin1,cMax1);
+  h2Sig[2] = new FixedHist(nRBin,0.0,rMax2,nCBin,cMin1,cMax1);
+  h2Bkg[2] = new FixedHist(nRBin,0.0,rMax2,nCBin,cMin1,cMax1);
   h2Diff[2] = new TH2D("h2Diff2","h2Diff2",nRBin,0.0,rMax2,nCBin,cMin1,cMax1);
-  h2Sig[3] = new TH2D("h2Sig3","h2Sig3",nRBin,0.0,rMax2,nCBin,0.0,cMax2);
-  h2Bkg[3] = new TH2D("h2Bkg3","h2Bkg3",nRBin,0.0,rMax2,nCBin,0.0,cMax2);
+  h2Sig[3] = new FixedHist(nRBin,0.0,rMax2,nCBin,0.0,cMax2);
+  h2Bkg[3] = new FixedHist(nRBin,0.0,rMax2,nCBin,0.0,cMax2);
   h2Diff[3] = new TH2D("h2Diff3","h2Diff3",nRBin,0.0,rMax2,nCBin,0.0,cMax2);
   
   std::cout << "MapParameters: Successfully initialized!" << std::endl;
@@ -113,10 +129,13 @@ void MapParameters::addPairToMap(PixelHit *hitFEI4, PixelHit *hitT3MAPS) {
   
   // Only fill if it falls within defined chip area:
   else {
-    for (int i_h = 0; i_h < 4; i_h++) {
-      h2Sig[i_h]->Fill(getRowOffset(hitFEI4->getRow(),hitT3MAPS->getRow(),i_h),
-		       getColOffset(hitFEI4->getCol(),hitT3MAPS->getCol(),i_h));
-    }
+    fillOrientations(h2Sig, hitFEI4, hitT3MAPS);
+    MapPair pair;
+    pair.rowFEI4 = (short)hitFEI4->getRow();
+    pair.colFEI4 = (short)hitFEI4->getCol();
+    pair.rowT3MAPS = (short)hitT3MAPS->getRow();
+    pair.colT3MAPS = (short)hitT3MAPS->getCol();
+    sigPairs.push_back(pair);
   }
   nSigHits++;
 }
@@ -138,19 +157,134 @@ void MapParameters::addPairToBkg(PixelHit *hitFEI4, PixelHit *hitT3MAPS) {
   }
   
   // Only fill if it falls within defined chip area:
-  else {
-    for (int i_h = 0; i_h < 4; i_h++) {
-      h2Bkg[i_h]->Fill(getRowOffset(hitFEI4->getRow(),hitT3MAPS->getRow(),i_h),
-		       getColOffset(hitFEI4->getCol(),hitT3MAPS->getCol(),i_h));
+  else fillOrientations(h2Bkg, hitFEI4, hitT3MAPS);
+  nBkgHits++;
+}
+
+/**
+   Fill the offsets of a hit pair for all four orientations. The chip
+   positions are looked up once, since the orientations only differ in the
+   signs of the T3MAPS positions (see getRowOffset() and getColOffset()).
+   @param hists - the signal or background histograms, one per orientation.
+   @param hitFEI4 - the hit in FEI4.
+   @param hitT3MAPS - the hit in T3MAPS.
+*/
+void MapParameters::fillOrientations(FixedHist *hists[4], PixelHit *hitFEI4,
+				     PixelHit *hitT3MAPS) {
+  double rowPosFEI4 = chips->getRowPosition("FEI4", hitFEI4->getRow());
+  double colPosFEI4 = chips->getColPosition("FEI4", hitFEI4->getCol());
+  double rowPosT3MAPS = chips->getRowPosition("T3MAPS", hitT3MAPS->getRow());
+  double colPosT3MAPS = chips->getColPosition("T3MAPS", hitT3MAPS->getCol());
+  for (int i_h = 0; i_h < 4; i_h++) {
+    hists[i_h]->fill(rowPosFEI4 - rowSign[i_h] * rowPosT3MAPS,
+		     colPosFEI4 - colSign[i_h] * colPosT3MAPS);
+  }
+}
+
+/**
+   Improve the map found by createMapFromHits() with the residuals of the
+   signal pairs (see ResidualAligner). Each pass keeps the pairs inside a
+   window around the current map, fits the offsets, slopes and rotation from
+   their residuals, and applies the corrections. The window starts at the
+   map errors and shrinks with each pass down to one pixel pitch, so that
+   fewer random pairs are kept as the map improves. The slopes and the
+   rotation are taken about the center of T3MAPS, so the offsets are those
+   at its center. Only the offsets can be used by the row and column maps.
+   @param nPasses - the maximum number of passes over the pairs.
+*/
+void MapParameters::alignFromPairs(int nPasses) {
+  INSTRUMENT_SCOPE("map.align");
+  std::cout << "MapParameters: Aligning with " << sigPairs.size()
+	    << " sig hit pairs." << std::endl;
+  
+  // The positions of the pixel centers, so that the passes need no lookups:
+  std::vector<double> rowPosFEI4(chips->getNRow("FEI4"));
+  std::vector<double> colPosFEI4(chips->getNCol("FEI4"));
+  std::vector<double> rowPosT3MAPS(chips->getNRow("T3MAPS"));
+  std::vector<double> colPosT3MAPS(chips->getNCol("T3MAPS"));
+  for (int i_r = 0; i_r < (int)rowPosFEI4.size(); i_r++) {
+    rowPosFEI4[i_r] = chips->getRowPosition("FEI4", i_r);
+  }
+  for (int i_c = 0; i_c < (int)colPosFEI4.size(); i_c++) {
+    colPosFEI4[i_c] = chips->getColPosition("FEI4", i_c);
+  }
+  for (int i_r = 0; i_r < (int)rowPosT3MAPS.size(); i_r++) {
+    rowPosT3MAPS[i_r] = chips->getRowPosition("T3MAPS", i_r);
+  }
+  for (int i_c = 0; i_c < (int)colPosT3MAPS.size(); i_c++) {
+    colPosT3MAPS[i_c] = chips->getColPosition("T3MAPS", i_c);
+  }
+  double rowCenter = 0.5 * (rowPosT3MAPS.front() + rowPosT3MAPS.back());
+  double colCenter = 0.5 * (colPosT3MAPS.front() + colPosT3MAPS.back());
+  double minRowWindow = std::max(chips->getRowPitch("FEI4"),
+				 chips->getRowPitch("T3MAPS"));
+  double minColWindow = std::max(chips->getColPitch("FEI4"),
+				 chips->getColPitch("T3MAPS"));
+  
+  ResidualAligner aligner;
+  for (int i_h = 0; i_h < 4; i_h++) {
+    double rowOffset = mVar[i_h][1];
+    double colOffset = mVar[i_h][3];
+    double rowSlope = 0.0;
+    double colSlope = 0.0;
+    double rotation = 0.0;
+    double rowWindow = std::max(mErr[i_h][1], minRowWindow);
+    double colWindow = std::max(mErr[i_h][3], minColWindow);
+    int nDone = 0;
+    for (int i_p = 0; i_p < nPasses; i_p++) {
+      aligner.reset();
+      for (int i_s = 0; i_s < (int)sigPairs.size(); i_s++) {
+	const MapPair &pair = sigPairs[i_s];
+	double row = rowSign[i_h] * (rowPosT3MAPS[pair.rowT3MAPS] - rowCenter);
+	double col = colSign[i_h] * (colPosT3MAPS[pair.colT3MAPS] - colCenter);
+	double rowResidual = (rowPosFEI4[pair.rowFEI4] - rowOffset -
+			      rowSign[i_h] * rowCenter - (1.0 + rowSlope) * row
+			      + rotation * col);
+	double colResidual = (colPosFEI4[pair.colFEI4] - colOffset -
+			      colSign[i_h] * colCenter - (1.0 + colSlope) * col
+			      - rotation * row);
+	if (fabs(rowResidual) < rowWindow && fabs(colResidual) < colWindow) {
+	  aligner.addPair(row, col, rowResidual, colResidual);
+	}
+      }
+      AlignmentCorrection correction;
+      if (!aligner.solve(correction)) break;
+      rowOffset += correction.rowOffset;
+      rowSlope += correction.rowSlope;
+      colOffset += correction.colOffset;
+      colSlope += correction.colSlope;
+      rotation += correction.rotation;
+      nDone++;
+      
+      // Stop once the offsets move by much less than a pixel:
+      if (fabs(correction.rowOffset) < 0.01 * minRowWindow &&
+	  fabs(correction.colOffset) < 0.01 * minColWindow) {
+	break;
+      }
+      rowWindow = std::max(0.7 * rowWindow, minRowWindow);
+      colWindow = std::max(0.7 * colWindow, minColWindow);
     }
+    if (nDone == 0) continue;
+    
+    setMapVar(1, rowOffset, i_h);
+    setMapVar(3, colOffset, i_h);
+    mStatErr[i_h][1] = aligner.getRowRMS() / sqrt(aligner.getNPairs());
+    mStatErr[i_h][3] = aligner.getColRMS() / sqrt(aligner.getNPairs());
+    mSlopeCorr[i_h][0] = rowSlope;
+    mSlopeCorr[i_h][1] = colSlope;
+    mRotation[i_h] = rotation;
+    std::cout << "\torientation " << i_h << ": " << nDone << " passes, "
+	      << aligner.getNPairs() << " pairs, residual RMS (row, col) = ("
+	      << aligner.getRowRMS() << ", " << aligner.getColRMS() << ") mm"
+	      << std::endl;
   }
-  nBkgHits++;
 }
 
 /**
    Extract linear map from linear fits to data.
 */
 void MapParameters::createMapFromHits() {
+  INSTRUMENT_SCOPE("map.create");
   std::cout << "MapParameters: Create map from " << nBkgHits << " bkg hits and "
 	    << nSigHits << " sig hits." << std::endl;
   
@@ -159,75 +293,240 @@ void MapParameters::createMapFromHits() {
   
   // Loop over 4 orientations:
   for (int i_h = 0; i_h < 4; i_h++) {
-    PlotUtil::plotTH2D(h2Sig[i_h], "row offset [mm]", "column offset [mm]", "hits", Form("../TestBeamOutput/MapParameters/sig_paraOff%d",i_h));
-    PlotUtil::plotTH2D(h2Bkg[i_h], "row offset [mm]", "column offset [mm]", "hits", Form("../TestBeamOutput/MapParameters/bkg_paraOff%d",i_h));
+    TH2D *sigPlot = h2Sig[i_h]->toTH2D(Form("h2Sig%d",i_h));
+    TH2D *bkgPlot = h2Bkg[i_h]->toTH2D(Form("h2Bkg%d",i_h));
+    PlotUtil::plotTH2D(sigPlot, "row offset [mm]", "column offset [mm]", "hits", Form("../TestBeamOutput/MapParameters/sig_paraOff%d",i_h));
+    PlotUtil::plotTH2D(bkgPlot, "row offset [mm]", "column offset [mm]", "hits", Form("../TestBeamOutput/MapParameters/bkg_paraOff%d",i_h));
+    delete sigPlot;
+    delete bkgPlot;
+    double integralSig = (double)h2Sig[i_h]->getIntegral();
+    double integralBkg = (double)h2Bkg[i_h]->getIntegral();
     for (int i_x = 1; i_x <= h2Diff[i_h]->GetNbinsX(); i_x++) {
       for (int i_y = 1; i_y <= h2Diff[i_h]->GetNbinsY(); i_y++) {
-	double para_weight = ((h2Sig[i_h]->GetBinContent(i_x,i_y) /
-			       h2Sig[i_h]->Integral()) - 
-			      (h2Bkg[i_h]->GetBinContent(i_x,i_y) / 
-			       h2Bkg[i_h]->Integral()));
+	double para_weight = ((h2Sig[i_h]->getBinContent(i_x,i_y) /
+			       integralSig) - 
+			      (h2Bkg[i_h]->getBinContent(i_x,i_y) / 
+			       integralBkg));
 	h2Diff[i_h]->SetBinContent(i_x, i_y, para_weight);
       }
     }
     
     PlotUtil::plotTH2D(h2Diff[i_h], "row offset [mm]", "column offset [mm]", "Sig-Bkg", Form("../TestBeamOutput/MapParameters/diff_paraOff%d",i_h));
     
-    // Offset parameters from the maps, slope from chip pitches:
+    // Offset parameters from the maps, slope from chip pitches. The errors
+    // (the matching window) stay one bin wide:
     int maxBinX = 1; int maxBinY = 1; int maxBinZ = 1; 
     int i = h2Diff[i_h]->GetMaximumBin(maxBinX, maxBinY, maxBinZ);
-    setMapVar(1, h2Diff[i_h]->GetXaxis()->GetBinCenter(maxBinX), i_h);
+    double peakX, peakY, statErrX, statErrY;
+    refinePeak(i_h, maxBinX, maxBinY, integralSig, peakX, statErrX, peakY,
+	       statErrY);
+    setMapVar(1, peakX, i_h);
     setMapErr(1, h2Diff[i_h]->GetXaxis()->GetBinWidth(maxBinX), i_h);
-    setMapVar(3, h2Diff[i_h]->GetYaxis()->GetBinCenter(maxBinY), i_h);
+    setMapVar(3, peakY, i_h);
     setMapErr(3, h2Diff[i_h]->GetYaxis()->GetBinWidth(maxBinY), i_h);
+    mStatErr[i_h][1] = statErrX;
+    mStatErr[i_h][3] = statErrY;
   }
   hasMap = true;
 }
 
 /**
-   Load parameters from previous mapping from file.
+   Find the peak of the difference map to better than one bin, from the
+   moments of the 3x3 bins around the maximum bin. The mean of the positive
+   contents gives the peak position (as for a Gaussian peak), and the spread
+   divided by the square root of the number of excess signal pairs gives its
+   statistical uncertainty. The spread within a single bin is at least that
+   of a flat bin (width/sqrt(12)). If the neighbourhood has no excess, the
+   center of the maximum bin is used, with the bin width as uncertainty.
+   @param valOrient - the orientation of the difference map.
+   @param maxBinX - the row offset bin of the maximum.
+   @param maxBinY - the column offset bin of the maximum.
+   @param integralSig - the number of signal pairs in the signal map.
+   @param peakX - the row offset of the peak (set).
+   @param errX - the statistical uncertainty of peakX (set).
+   @param peakY - the column offset of the peak (set).
+   @param errY - the statistical uncertainty of peakY (set).
+*/
+void MapParameters::refinePeak(int valOrient, int maxBinX, int maxBinY,
+			       double integralSig, double &peakX, double &errX,
+			       double &peakY, double &errY) {
+  TAxis *axisX = h2Diff[valOrient]->GetXaxis();
+  TAxis *axisY = h2Diff[valOrient]->GetYaxis();
+  double widthX = axisX->GetBinWidth(maxBinX);
+  double widthY = axisY->GetBinWidth(maxBinY);
+  peakX = axisX->GetBinCenter(maxBinX);
+  peakY = axisY->GetBinCenter(maxBinY);
+  errX = widthX;
+  errY = widthY;
+  
+  // Moments of the excess in the neighbourhood (sum, mean, mean square):
+  double sumW = 0.0;
+  double sumWX = 0.0; double sumWXX = 0.0;
+  double sumWY = 0.0; double sumWYY = 0.0;
+  for (int i_x = maxBinX - 1; i_x <= maxBinX + 1; i_x++) {
+    if (i_x < 1 || i_x > axisX->GetNbins()) continue;
+    for (int i_y = maxBinY - 1; i_y <= maxBinY + 1; i_y++) {
+      if (i_y < 1 || i_y > axisY->GetNbins()) continue;
+      double weight = h2Diff[valOrient]->GetBinContent(i_x, i_y);
+      if (weight <= 0.0) continue;
+      double x = axisX->GetBinCenter(i_x) - peakX;
+      double y = axisY->GetBinCenter(i_y) - peakY;
+      sumW += weight;
+      sumWX += weight * x;
+      sumWXX += weight * x * x;
+      sumWY += weight * y;
+      sumWYY += weight * y * y;
+    }
+  }
+  
+  // The weights are fractions of the signal pairs:
+  double nExcess = sumW * integralSig;
+  if (sumW <= 0.0 || nExcess < 1.0) return;
+  double meanX = sumWX / sumW;
+  double meanY = sumWY / sumW;
+  double varX = sumWXX / sumW - meanX * meanX + widthX * widthX / 12.0;
+  double varY = sumWYY / sumW - meanY * meanY + widthY * widthY / 12.0;
+  peakX += meanX;
+  peakY += meanY;
+  errX = sqrt(varX / nExcess);
+  errY = sqrt(varY / nExcess);
+}
+
+/**
+   Load the map that was saved last, whatever its run.
    @param inputDir - the directory containing the map parameters.
 */
 void MapParameters::loadMapParameters(TString inputDir) {
-  ifstream inputFile;
-  inputFile.open(Form("%s/MapParameters/mapParameters.txt",inputDir.Data()));
-  if (!inputFile) {
+  AlignmentDB database(Form("%s/MapParameters/alignment.db", inputDir.Data()));
+  AlignmentEntry entry;
+  if (!database.load() || !database.getLatest(entry)) {
     std::cout << "MapParameters: Map file nonexistent!" << std::endl;
     exit(0);
   }
-  
-  std::string pName;
-  double tempVar[4]; double tempErr[4];
-  int lineIndex = 0;
-  while (!inputFile.eof()) {
-    inputFile >> pName >> tempVar[0] >> tempErr[0] >> tempVar[1] >> tempErr[1]
-	      >> tempVar[2] >> tempErr[2] >> tempVar[3] >> tempErr[3];
-    for (int i_h = 0; i_h < 4; i_h++) {
-      mVar[i_h][lineIndex] = tempVar[i_h];
-      mErr[i_h][lineIndex] = tempErr[i_h];
+  setAlignment(entry);
+  printMapParameters();
+}
+
+/**
+   Load the map of a run. If the run has several calibration points, the map
+   is interpolated to the requested time.
+   @param inputDir - the directory containing the map parameters.
+   @param runName - the name of the run.
+   @param time - the time (unix time), or -1 for the latest map of the run.
+   @returns - false if there is no map for the run (the map is unchanged).
+*/
+bool MapParameters::loadMapParameters(TString inputDir, TString runName,
+				      double time) {
+  AlignmentDB database(Form("%s/MapParameters/alignment.db", inputDir.Data()));
+  AlignmentEntry entry;
+  if (!database.load() || !database.getAlignment(runName, time, entry)) {
+    std::cout << "MapParameters: No map for " << runName << std::endl;
+    return false;
+  }
+  setAlignment(entry);
+  return true;
+}
+
+/**
+   Add the current map to the alignment database.
+   @param outputDir - the directory in which the map parameters will be saved.
+   @param runName - the name of the run that was used.
+   @param startTime - the start of the interval the map is valid for.
+   @param stopTime - the end of the interval the map is valid for.
+   @param provenance - the program and inputs that made the map.
+*/
+void MapParameters::saveMapParameters(TString outputDir, TString runName,
+				      double startTime, double stopTime,
+				      TString provenance) {
+  AlignmentDB database(Form("%s/MapParameters/alignment.db", outputDir.Data()));
+  // Keep the entries that other jobs add while this one is saving:
+  if (!database.lock()) {
+    std::cout << "MapParameters: Map not saved for " << runName << std::endl;
+    return;
+  }
+  database.load();
+  AlignmentEntry entry;
+  getAlignment(entry);
+  AlignmentDB::setText(entry.runName, sizeof(entry.runName), runName);
+  AlignmentDB::setText(entry.provenance, sizeof(entry.provenance), provenance);
+  entry.startTime = startTime;
+  entry.stopTime = stopTime;
+  database.addEntry(entry);
+  database.save();
+  database.unlock();
+}
+
+/**
+   Use a map from the alignment database, with its statistical uncertainties
+   and residual alignment.
+   @param entry - the alignment.
+*/
+void MapParameters::setAlignment(const AlignmentEntry &entry) {
+  for (int i_h = 0; i_h < 4; i_h++) {
+    for (int i_p = 0; i_p < 4; i_p++) {
+      mVar[i_h][i_p] = entry.mapVar[i_h][i_p];
+      mErr[i_h][i_p] = entry.mapErr[i_h][i_p];
+      mStatErr[i_h][i_p] = entry.mapStatErr[i_h][i_p];
     }
-    lineIndex++;
+    mSlopeCorr[i_h][0] = entry.slopeCorr[i_h][0];
+    mSlopeCorr[i_h][1] = entry.slopeCorr[i_h][1];
+    mRotation[i_h] = entry.rotation[i_h];
   }
+  setOrientation(entry.orientation);
   setMapExists(true);
-  inputFile.close();
-  printMapParameters();
 }
 
 /**
-   Create output text file with map parameters.
-   @param outputDir - the directory in which the map parameters will be saved.
+   Copy the current map into an alignment entry, without run or interval.
+   @param entry - the entry to fill.
 */
-void MapParameters::saveMapParameters(TString outputDir) {
-  ofstream outputFile;
-  outputFile.open(Form("%s/MapParameters/mapParameters.txt",outputDir.Data()));
-  for (int i_p = 0; i_p < 4; i_p++) {
-    outputFile << "parameter" << i_p;
-    for (int i_h = 0; i_h < 4; i_h++) {
-      outputFile << " " << mVar[i_h][i_p] << " " << mErr[i_h][i_p];
+void MapParameters::getAlignment(AlignmentEntry &entry) {
+  memset(&entry, 0, sizeof(entry));
+  for (int i_h = 0; i_h < 4; i_h++) {
+    for (int i_p = 0; i_p < 4; i_p++) {
+      entry.mapVar[i_h][i_p] = mVar[i_h][i_p];
+      entry.mapErr[i_h][i_p] = mErr[i_h][i_p];
+      entry.mapStatErr[i_h][i_p] = mStatErr[i_h][i_p];
     }
-    outputFile << std::endl;
+    entry.slopeCorr[i_h][0] = mSlopeCorr[i_h][0];
+    entry.slopeCorr[i_h][1] = mSlopeCorr[i_h][1];
+    entry.rotation[i_h] = mRotation[i_h];
+  }
+  entry.orientation = orientation;
+}
+
+/**
+   Replace the signal and background hit pairs with those saved by
+   writeHits(). createMapFromHits() can then be called as usual.
+   @param input - the input stream.
+   @returns - true iff the read succeeded.
+*/
+bool MapParameters::readHits(std::istream &input) {
+  if (!ResultCache::readValue(input, nSigHits) ||
+      !ResultCache::readValue(input, nBkgHits)) {
+    return false;
+  }
+  for (int i_h = 0; i_h < 4; i_h++) {
+    if (!h2Sig[i_h]->read(input) || !h2Bkg[i_h]->read(input)) {
+      return false;
+    }
+  }
+  return ResultCache::readVector(input, sigPairs);
+}
+
+/**
+   Save the signal and background hit pairs added so far in binary form, e.g.
+   for the ResultCache.
+   @param output - the output stream.
+*/
+void MapParameters::writeHits(std::ostream &output) {
+  ResultCache::writeValue(output, nSigHits);
+  ResultCache::writeValue(output, nBkgHits);
+  for (int i_h = 0; i_h < 4; i_h++) {
+    h2Sig[i_h]->write(output);
+    h2Bkg[i_h]->write(output);
   }
-  outputFile.close();
+  ResultCache::writeVector(output, sigPairs);
 }
 
 /**
@@ -299,6 +598,19 @@ bool MapParameters::mapExists() {
    @param valT3MAPS - the value in T3MAPS.
 */
 int MapParameters::getFEI4fromT3MAPS(TString valName, int valT3MAPS) {
+  return getFEI4fromT3MAPS(valName, valT3MAPS, orientation);
+}
+
+/**
+   Converts T3MAPS row or col number to the corresponding FEI4 row or col,
+   assuming the given orientation instead of the current one. This does not
+   change the mapper, so several orientations can be evaluated at once.
+   @param valName - the value name.
+   @param valT3MAPS - the value in T3MAPS.
+   @param valOrient - the orientation to use.
+*/
+int MapParameters::getFEI4fromT3MAPS(TString valName, int valT3MAPS,
+				     int valOrient) {
   if (!mapExists()) {
     std::cout << "MapParameters: No map exists!" << std::endl;
     exit(0);
@@ -307,14 +619,14 @@ int MapParameters::getFEI4fromT3MAPS(TString valName, int valT3MAPS) {
   // Spell out map parameter definitions for easier reading:
   std::string param; double p0, p1, e0, e1, sign;
   if (valName.Contains("row")) { 
-    p0 = mVar[orientation][0];  p1 = mVar[orientation][1];
-    e0 = mErr[orientation][0];  e1 = mErr[orientation][1];
-    sign = rowSign[orientation];
+    p0 = mVar[valOrient][0];  p1 = mVar[valOrient][1];
+    e0 = mErr[valOrient][0];  e1 = mErr[valOrient][1];
+    sign = rowSign[valOrient];
     param = "row"; }
   else if (valName.Contains("col")) { 
-    p0 = mVar[orientation][2];  p1 = mVar[orientation][3];
-    e0 = mErr[orientation][2];  e1 = mErr[orientation][3];
-    sign = colSign[orientation];
+    p0 = mVar[valOrient][2];  p1 = mVar[valOrient][3];
+    e0 = mErr[valOrient][2];  e1 = mErr[valOrient][3];
+    sign = colSign[valOrient];
     param = "col"; }
   else {
     std::cout << "MapParameters: Bad val name: "<< std::endl;
@@ -348,6 +660,18 @@ int MapParameters::getFEI4fromT3MAPS(TString valName, int valT3MAPS) {
    @param valT3MAPS - the value in FEI4.
 */
 int MapParameters::getT3MAPSfromFEI4(TString valName, int valFEI4) {
+  return getT3MAPSfromFEI4(valName, valFEI4, orientation);
+}
+
+/**
+   Converts FEI4 row or col number to the corresponding T3MAPS row or col,
+   assuming the given orientation instead of the current one.
+   @param valName - the value name.
+   @param valFEI4 - the value in FEI4.
+   @param valOrient - the orientation to use.
+*/
+int MapParameters::getT3MAPSfromFEI4(TString valName, int valFEI4,
+				     int valOrient) {
   if (!mapExists()) {
     std::cout << "MapParameters: No map exists!" << std::endl;
     exit(0);
@@ -356,15 +680,15 @@ int MapParameters::getT3MAPSfromFEI4(TString valName, int valFEI4) {
   // Spell out map parameter definitions for easier reading:
   std::string param; double p0, p1, e0, e1, sign;
   if (valName.Contains("row")) { 
-    p0 = mVar[orientation][0];  p1 = mVar[orientation][1];
-    e0 = mErr[orientation][0];  e1 = mErr[orientation][1];
-    sign = rowSign[orientation];
+    p0 = mVar[valOrient][0];  p1 = mVar[valOrient][1];
+    e0 = mErr[valOrient][0];  e1 = mErr[valOrient][1];
+    sign = rowSign[valOrient];
     param = "row";
   }
   else if (valName.Contains("col")) { 
-    p0 = mVar[orientation][2];  p1 = mVar[orientation][3];
-    e0 = mErr[orientation][2];  e1 = mErr[orientation][3];
-    sign = colSign[orientation];
+    p0 = mVar[valOrient][2];  p1 = mVar[valOrient][3];
+    e0 = mErr[valOrient][2];  e1 = mErr[valOrient][3];
+    sign = colSign[valOrient];
     param = "col"; 
   }
   else {
@@ -446,13 +770,29 @@ double MapParameters::getRowSlope() {
   return rowSlope;
 }
 
+/**
+   Returns the current chip orientation index.
+*/
+int MapParameters::getOrientation() {
+  return orientation;
+}
+
 /**
    Returns the error on the 4 parameters for the linear maps. Index = 0,1,2,3
    @param varIndex - the index of the variable of interest.
 */
 double MapParameters::getMapErr(int varIndex) {
+  return getMapErr(varIndex, orientation);
+}
+
+/**
+   Returns the error on a map parameter for the given orientation.
+   @param varIndex - the index of the variable of interest.
+   @param valOrient - the orientation of interest.
+*/
+double MapParameters::getMapErr(int varIndex, int valOrient) {
   if (mapExists()) {
-    return mErr[orientation][varIndex];
+    return mErr[valOrient][varIndex];
   }
   else {
     std::cout << "MapParameters::getMapVar No map exists!" << std::endl;
@@ -460,13 +800,49 @@ double MapParameters::getMapErr(int varIndex) {
   }
 }
 
+/**
+   Returns the statistical uncertainty of a map parameter found by
+   createMapFromHits(), or stored with a map in the alignment database (0 for
+   maps saved before the uncertainties were stored, or set by hand).
+   @param varIndex - the index of the variable of interest.
+*/
+double MapParameters::getMapStatErr(int varIndex) {
+  return mStatErr[orientation][varIndex];
+}
+
+/**
+   Returns the rotation (in rad) found by alignFromPairs(), or stored with a
+   map in the alignment database.
+*/
+double MapParameters::getMapRotation() {
+  return mRotation[orientation];
+}
+
+/**
+   Returns the relative slope correction found by alignFromPairs(), or stored
+   with a map in the alignment database.
+   @param varIndex - 0 for the rows, 2 for the columns.
+*/
+double MapParameters::getMapSlopeCorr(int varIndex) {
+  return mSlopeCorr[orientation][varIndex < 2 ? 0 : 1];
+}
+
 /**
    Returns the parameters for the linear maps.
    @param varIndex - the index of the variable of interest.
 */
 double MapParameters::getMapVar(int varIndex) {
+  return getMapVar(varIndex, orientation);
+}
+
+/**
+   Returns a map parameter for the given orientation.
+   @param varIndex - the index of the variable of interest.
+   @param valOrient - the orientation of interest.
+*/
+double MapParameters::getMapVar(int varIndex, int valOrient) {
   if (mapExists()) {
-    return mVar[orientation][varIndex];
+    return mVar[valOrient][varIndex];
   }
   else {
     std::cout << "MapParameters::getMapVar No map exists!" << std::endl;
@@ -482,19 +858,34 @@ void MapParameters::printMapParameters() {
 	    << orientation << ":" << std::endl;
   for (int i = 0; i < 4; i++) {
     std::cout << "\tparameter(" << i << ") = " << mVar[orientation][i]
-	      << " +/- " << mErr[orientation][i] << std::endl;
+	      << " +/- " << mErr[orientation][i] << " (stat. "
+	      << mStatErr[orientation][i] << ")" << std::endl;
   }
   std::cout << "MapParameters: Interpretation:" << std::endl;
   std::cout << "\trow_FEI4 = " << mVar[orientation][0] << " * row_T3MAPS + "
 	    << mVar[orientation][1] << std::endl;
   std::cout << "\tcol_FEI4 = " << mVar[orientation][2] << " * col_T3MAPS + "
 	    << mVar[orientation][3] << std::endl;
+  std::cout << "\tnot applied: slope corrections (row, col) = ("
+	    << mSlopeCorr[orientation][0] << ", " << mSlopeCorr[orientation][1]
+	    << "), rotation = " << mRotation[orientation] << " rad"
+	    << std::endl;
 }
 
+/**
+   Get a map plot for the current orientation.
+   @param name - "sig", "bkg" or "diff".
+   @returns - the plot. The "sig" and "bkg" plots are new histograms owned by
+   the caller, while "diff" is the stored plot.
+*/
 TH2D *MapParameters::getParamPlot(TString name) {
   if (mapExists()) {
-    if (name.EqualTo("sig")) return h2Sig[orientation];
-    else if (name.EqualTo("bkg")) return h2Bkg[orientation];
+    if (name.EqualTo("sig")) {
+      return h2Sig[orientation]->toTH2D(Form("h2Sig%d",orientation));
+    }
+    else if (name.EqualTo("bkg")) {
+      return h2Bkg[orientation]->toTH2D(Form("h2Bkg%d",orientation));
+    }
     else if (name.EqualTo("diff")) return h2Diff[orientation];
   }
   else {
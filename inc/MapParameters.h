@@ -18,6 +18,8 @@
 #include <fstream>
 #include <vector>
 #include <string>
+#include <algorithm>
+#include <math.h>
 
 #include "TF1.h"
 #include "TGraph.h"
@@ -27,9 +29,21 @@
 #include "TString.h"
 #include "TTree.h"
 
+#include "AlignmentDB.h"
 #include "ChipDimension.h"
+#include "FixedHist.h"
 #include "PixelHit.h"
 #include "PlotUtil.h"
+#include "ResidualAligner.h"
+#include "ResultCache.h"
+
+// A signal hit pair, as pixel indices in both chips:
+struct MapPair {
+  short rowFEI4;
+  short colFEI4;
+  short rowT3MAPS;
+  short colT3MAPS;
+};
 
 class MapParameters {
   
@@ -41,12 +55,20 @@ class MapParameters {
   static const int nRBin = 89;
   static const int nCBin = 48;
   
+  // Changes whenever the format of writeHits() changes:
+  static const int hitsFormat = 2;
+  
   // Mutators:
   void addPairToMap(PixelHit *hitFEI4, PixelHit *hitT3MAPS);
   void addPairToBkg(PixelHit *hitFEI4, PixelHit *hitT3MAPS);
+  void alignFromPairs(int nPasses);
   void createMapFromHits();
   void loadMapParameters(TString inputDir);
-  void saveMapParameters(TString outputDir);
+  bool loadMapParameters(TString inputDir, TString runName, double time);
+  bool readHits(std::istream &input);
+  void saveMapParameters(TString outputDir, TString runName, double startTime,
+			 double stopTime, TString provenance);
+  void setAlignment(const AlignmentEntry &entry);
   void setOrientation(int orientation);
   void setMapErr(int varIndex, double value);
   void setMapErr(int varIndex, double value, int valOrient);
@@ -56,29 +78,53 @@ class MapParameters {
 
   // Accessors:
   bool mapExists();
+  void getAlignment(AlignmentEntry &entry);
   int getFEI4fromT3MAPS(TString valName, int valT3MAPS);
+  int getFEI4fromT3MAPS(TString valName, int valT3MAPS, int valOrient);
   int getT3MAPSfromFEI4(TString valName, int valFEI4);
+  int getT3MAPSfromFEI4(TString valName, int valFEI4, int valOrient);
   double getColOffset(int colFEI4, int colT3MAPS, int orientation);
   double getRowOffset(int rowFEI4, int rowT3MAPS, int orientation);
   double getColSlope();
   double getRowSlope();
   double getMapErr(int varIndex);
+  double getMapErr(int varIndex, int valOrient);
+  double getMapStatErr(int varIndex);
+  double getMapRotation();
+  double getMapSlopeCorr(int varIndex);
   double getMapVar(int varIndex);
+  double getMapVar(int varIndex, int valOrient);
+  int getOrientation();
   void printMapParameters();
+  void writeHits(std::ostream &output);
   TH2D *getParamPlot(TString name);
   
  private:
   
+  void fillOrientations(FixedHist *hists[4], PixelHit *hitFEI4,
+			PixelHit *hitT3MAPS);
+  void refinePeak(int valOrient, int maxBinX, int maxBinY, double integralSig,
+		  double &peakX, double &errX, double &peakY, double &errY);
+  
   ChipDimension *chips;
     
   // Array to store linear constants.
   double mVar[4][4];
-  double mErr[4][4];
+  double mErr[4][4];// also the matching window of HitMatcher
+  double mStatErr[4][4];// statistical uncertainty of the map peak
+  
+  // Corrections found by alignFromPairs(), which the row and column maps
+  // cannot apply (relative slopes of rows and columns, rotation in rad):
+  double mSlopeCorr[4][2];
+  double mRotation[4];
+  
+  // The signal hit pairs, kept for alignFromPairs():
+  std::vector<MapPair> sigPairs;
   bool hasMap;
   
-  // Maps of parameters:
-  TH2D *h2Sig[4];
-  TH2D *h2Bkg[4];
+  // Maps of parameters (hit pair counts, and their normalized difference):
+  FixedHist *h2Sig[4];
+  FixedHist *h2Bkg[4];
   TH2D *h2Diff[4];
   
   // Hit counters:
@@ -19,6 +19,8 @@
 
 #include "MatchMaker.h"
 
+#include "Instrument.h"
+
 /**
    All that is necessary for initializing the class is a mapping from the FEI4
    chip to the T3MAPS chip. 
@@ -43,6 +45,32 @@ MatchMaker::MatchMaker(MapParameters *mapper) {
   return;
 }
 
+/**
+   Delete the clusters. The hits belong to the caller.
+*/
+MatchMaker::~MatchMaker() {
+  clearHits();
+  delete myChips;
+}
+
+/**
+   Remove the hits and clusters, so that the next event can be matched.
+*/
+void MatchMaker::clearHits() {
+  for (int i = 0; i < (int)clustersFEI4.size(); i++) delete clustersFEI4[i];
+  for (int i = 0; i < (int)clustersT3MAPS.size(); i++) {
+    delete clustersT3MAPS[i];
+  }
+  clustersFEI4.clear();
+  clustersT3MAPS.clear();
+  hitsFEI4.clear();
+  hitsT3MAPS.clear();
+  nMatchedClusters["FEI4"] = 0;
+  nMatchedHits["FEI4"] = 0;
+  nMatchedClusters["T3MAPS"] = 0;
+  nMatchedHits["T3MAPS"] = 0;
+}
+
 /**
    Add a single pixel hit in the FEI4 chip.
  */
@@ -151,6 +179,7 @@ std::vector<PixelCluster*> MatchMaker::mergeClusters(std::vector<PixelCluster*>
     for (int j = 0; j < (int)result.size(); j++) {
       if (result[j]->isAdjacent(inList[i])) {
 	result[j]->addCluster(inList[i]);
+	delete inList[i];
 	couldMerge = true;
 	break;
       }
@@ -176,7 +205,12 @@ void MatchMaker::buildAndMatchClusters() {
    Combine individual hits in FEI4 into clusters.
 */
 void MatchMaker::buildFEI4Clusters() {
+  INSTRUMENT_SCOPE("cluster.FEI4");
+  INSTRUMENT_FILL("cluster.hits.FEI4", hitsFEI4.size());
   
+  for (int i = 0; i < (int)clustersFEI4.size(); i++) {
+    delete clustersFEI4[i];
+  }
   clustersFEI4.clear();
   nMatchedClusters["FEI4"] = 0;
   
@@ -207,7 +241,12 @@ void MatchMaker::buildFEI4Clusters() {
    Combine individual hits in T3MAPS into clusters.
 */
 void MatchMaker::buildT3MAPSClusters() {
+  INSTRUMENT_SCOPE("cluster.T3MAPS");
+  INSTRUMENT_FILL("cluster.hits.T3MAPS", hitsT3MAPS.size());
   
+  for (int i = 0; i < (int)clustersT3MAPS.size(); i++) {
+    delete clustersT3MAPS[i];
+  }
   clustersT3MAPS.clear();
   nMatchedClusters["T3MAPS"] = 0;
   
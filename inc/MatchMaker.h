@@ -38,6 +38,7 @@ class MatchMaker
   void addHitInT3MAPS(PixelHit *hit);
   void matchHits();
   void buildAndMatchClusters();
+  void clearHits();
   
     
   // Accessors:
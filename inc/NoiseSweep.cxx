@@ -0,0 +1,185 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: NoiseSweep.cxx                                                      //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class gives the efficiency and the hit rate of one chip for many     //
+//  noise thresholds from a single matching pass. The matching is done with   //
+//  the loosest mask of the sweep, and counts the matchable and matched hits  //
+//  of each pixel. The pixels are then sorted by occupancy, and each tighter  //
+//  threshold only subtracts the counts of the pixels that it newly masks.    //
+//                                                                            //
+//  Whether a hit can be matched depends only on the hits in the other chip,  //
+//  so the efficiency of a chip at each of its own thresholds is the same as  //
+//  that of a full analysis with that mask, provided the other chip keeps the //
+//  mask used in the matching.                                                //
+//                                                                            //
+//  As in the MaskStage, FEI4 pixels are masked with at least threshold hits  //
+//  and T3MAPS pixels with more than threshold hits.                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "NoiseSweep.h"
+
+#include "Instrument.h"
+
+/**
+   Initialize empty counters for every pixel of one chip.
+   @param newChipName - "FEI4" or "T3MAPS".
+   @param newNRow - the number of rows of the chip.
+   @param newNCol - the number of columns of the chip.
+*/
+NoiseSweep::NoiseSweep(TString newChipName, int newNRow, int newNCol) {
+  if (newNRow <= 0 || newNCol <= 0) {
+    std::cout << "NoiseSweep: Bad chip size " << newNRow << " x " << newNCol
+	      << std::endl;
+    exit(0);
+  }
+  chipName = newChipName;
+  nRow = newNRow;
+  nCol = newNCol;
+  matchable.assign(nRow * nCol, 0);
+  matched.assign(nRow * nCol, 0);
+  points.clear();
+
+  // The tree belongs to the sweep, not to the current ROOT directory:
+  tree = new TTree(Form("NoiseSweep%s", chipName.Data()),
+		   Form("NoiseSweep%s", chipName.Data()));
+  tree->SetDirectory(NULL);
+  tree->Branch("threshold", &point.threshold, "threshold/I");
+  tree->Branch("nMasked", &point.nMasked, "nMasked/I");
+  tree->Branch("hits", &point.hits, "hits/L");
+  tree->Branch("hitRate", &point.hitRate, "hitRate/D");
+  tree->Branch("matchable", &point.matchable, "matchable/L");
+  tree->Branch("matched", &point.matched, "matched/L");
+  tree->Branch("efficiency", &point.efficiency, "efficiency/D");
+  tree->Branch("efficiencyError", &point.efficiencyError,
+	       "efficiencyError/D");
+}
+
+/**
+   Delete the sweep and its tree.
+*/
+NoiseSweep::~NoiseSweep() {
+  delete tree;
+}
+
+/**
+   Compute the efficiency and the hit rate at evenly spaced thresholds, from
+   the loosest to the tightest. The matching must have used a mask at least
+   as loose as thresholdMax.
+   @param occupancy - the hits of each pixel (row, column) of the chip.
+   @param thresholdMin - the tightest threshold.
+   @param thresholdMax - the loosest threshold.
+   @param nSteps - the number of thresholds.
+   @param exposure - the time in seconds covered by the occupancy.
+*/
+void NoiseSweep::sweep(const FixedHist &occupancy, int thresholdMin,
+		       int thresholdMax, int nSteps, double exposure) {
+  INSTRUMENT_SCOPE("sweep");
+  if (nSteps < 1 || thresholdMin > thresholdMax) {
+    std::cout << "NoiseSweep: Bad thresholds " << thresholdMin << " - "
+	      << thresholdMax << " in " << nSteps << " steps." << std::endl;
+    exit(0);
+  }
+  
+  // Order the pixels from the noisiest to the quietest:
+  std::vector<std::pair<Long64_t,int> > pixels;
+  pixels.reserve(nRow * nCol);
+  point.hits = 0;
+  point.matchable = 0;
+  point.matched = 0;
+  for (int i_r = 0; i_r < nRow; i_r++) {
+    for (int i_c = 0; i_c < nCol; i_c++) {
+      Long64_t nHits = occupancy.getBinContent(i_r+1, i_c+1);
+      int index = i_r * nCol + i_c;
+      pixels.push_back(std::make_pair(nHits, index));
+      point.hits += nHits;
+      point.matchable += matchable[index];
+      point.matched += matched[index];
+    }
+  }
+  std::sort(pixels.begin(), pixels.end());
+  std::reverse(pixels.begin(), pixels.end());
+  
+  // Each step only removes the pixels masked since the previous step:
+  points.clear();
+  tree->Reset();
+  int nMasked = 0;
+  for (int i_s = 0; i_s < nSteps; i_s++) {
+    int threshold = thresholdMax;
+    if (nSteps > 1) {
+      threshold -= (int)floor(((double)(thresholdMax - thresholdMin)) * i_s
+			      / (nSteps - 1) + 0.5);
+    }
+    if (!points.empty() && threshold == points.back().threshold) continue;
+    while (nMasked < (int)pixels.size() &&
+	   isMasked(pixels[nMasked].first, threshold)) {
+      int index = pixels[nMasked].second;
+      point.hits -= pixels[nMasked].first;
+      point.matchable -= matchable[index];
+      point.matched -= matched[index];
+      nMasked++;
+    }
+    point.threshold = threshold;
+    point.nMasked = nMasked;
+    point.hitRate = (exposure > 0.0) ? ((double)point.hits) / exposure : 0.0;
+    point.efficiency = 0.0;
+    point.efficiencyError = 0.0;
+    if (point.matchable > 0) {
+      point.efficiency = ((double)point.matched) / ((double)point.matchable);
+      point.efficiencyError
+	= sqrt(point.efficiency * (1.0 - point.efficiency) /
+	       ((double)point.matchable));
+    }
+    points.push_back(point);
+    tree->Fill();
+  }
+}
+
+/**
+   Get the name of the chip.
+*/
+TString NoiseSweep::getChipName() {
+  return chipName;
+}
+
+/**
+   Get the number of thresholds in the sweep.
+*/
+int NoiseSweep::getNPoints() {
+  return (int)points.size();
+}
+
+/**
+   Get the results of one threshold.
+   @param index - the index of the threshold, from the loosest.
+   @returns - the efficiency and hit rate at that threshold.
+*/
+SweepPoint NoiseSweep::getPoint(int index) {
+  if (index < 0 || index >= (int)points.size()) {
+    std::cout << "NoiseSweep: No threshold with index " << index << std::endl;
+    exit(0);
+  }
+  return points[index];
+}
+
+/**
+   Get the sweep, one entry per threshold (owned by the sweep).
+*/
+TTree *NoiseSweep::getTree() {
+  return tree;
+}
+
+/**
+   Check whether a pixel is masked at a threshold, with the same convention
+   as the MaskStage.
+   @param nHits - the hits of the pixel.
+   @param threshold - the noise threshold.
+   @returns - true iff the pixel is masked.
+*/
+bool NoiseSweep::isMasked(Long64_t nHits, int threshold) {
+  if (chipName.EqualTo("FEI4")) return (nHits >= threshold);
+  return (nHits > threshold);
+}
@@ -0,0 +1,77 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: NoiseSweep.h                                                        //
+//  Class: NoiseSweep.cxx                                                     //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef NoiseSweep_h
+#define NoiseSweep_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <iostream>
+#include <vector>
+#include <algorithm>
+
+#include "TString.h"
+#include "TTree.h"
+
+#include "FixedHist.h"
+
+// The hits that survive the noise mask of one threshold:
+struct SweepPoint {
+  int threshold;
+  int nMasked;// pixels masked at this threshold
+  Long64_t hits;// unmasked hits in the occupancy
+  double hitRate;// unmasked hits per second
+  Long64_t matchable;
+  Long64_t matched;
+  double efficiency;
+  double efficiencyError;// binomial
+};
+
+class NoiseSweep {
+
+ public:
+
+  NoiseSweep(TString newChipName, int newNRow, int newNCol);
+  virtual ~NoiseSweep();
+
+  // Mutators:
+  void fill(int row, int col, bool isMatched) {
+    if (row < 0 || row >= nRow || col < 0 || col >= nCol) return;
+    matchable[row * nCol + col]++;
+    if (isMatched) matched[row * nCol + col]++;
+  };
+  void sweep(const FixedHist &occupancy, int thresholdMin, int thresholdMax,
+	     int nSteps, double exposure);
+
+  // Accessors:
+  TString getChipName();
+  int getNPoints();
+  SweepPoint getPoint(int index);
+  TTree *getTree();
+  bool isMasked(Long64_t nHits, int threshold);
+
+ private:
+
+  TString chipName;
+  int nRow;
+  int nCol;
+
+  // The counts of each pixel with the loosest mask, indexed by row*nCol + col:
+  std::vector<Long64_t> matchable;
+  std::vector<Long64_t> matched;
+
+  // One entry per threshold, from the loosest to the tightest:
+  std::vector<SweepPoint> points;
+  SweepPoint point;
+  TTree *tree;
+
+};
+
+#endif
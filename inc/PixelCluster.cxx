@@ -13,6 +13,8 @@
 
 #include "PixelCluster.h"
 
+#include "Instrument.h"
+
 /**
    Initialize a cluster:
  */
@@ -22,11 +24,20 @@ PixelCluster::PixelCluster(std::string newChipName) {
   return;
 }
 
+/**
+   Delete the cluster histogram and tracklet. The hits belong to the caller.
+*/
+PixelCluster::~PixelCluster() {
+  if (clusterHist) delete clusterHist;
+  if (tracklet) delete tracklet;
+}
+
 /** 
     Add another cluster to this cluster.
     @param cluster - the cluster to merge.
 */
 void PixelCluster::addCluster(PixelCluster *cluster) {
+  INSTRUMENT_SCOPE("cluster.merge");
   
   std::vector<PixelHit*> newClusterHits = cluster->getHits();
   std::vector<PixelHit*> newClusterMasks = cluster->getMasks();
@@ -90,6 +101,7 @@ void PixelCluster::clearCluster() {
    Fill the cluster histogram.
 */
 void PixelCluster::fillHistogram() {
+  INSTRUMENT_SCOPE("cluster.histogram");
   
   float colLo(80), colHi(0), rowLo(336), rowHi(0);
   
@@ -152,6 +164,7 @@ void PixelCluster::fillHistogram() {
     written by Simon Viel.
 */
 void PixelCluster::fitTracklet() {
+  INSTRUMENT_SCOPE("cluster.tracklet");
   
   bool vertical = false;
   
@@ -0,0 +1,257 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: PixelEfficiency.cxx                                                 //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class counts the matchable and matched hits of each T3MAPS pixel,    //
+//  and of the FEI4 region that maps onto each T3MAPS pixel, so that weak     //
+//  pixels and columns can be found. The counters are flat arrays indexed by  //
+//  pixel, so filling them from the matching loop is one increment.           //
+//                                                                            //
+//  The counts are integers and can be stored in binary form with             //
+//  writeFile() and summed over runs with add(). The efficiency maps are      //
+//  made from the counts afterwards, with binomial errors.                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "PixelEfficiency.h"
+
+// Identifies files written by writeFile():
+static const int pixelFileMagic = 0x54425045;// "TBPE"
+
+/**
+   Book empty counters for every pixel of the T3MAPS chip.
+   @param newNRow - the number of T3MAPS rows.
+   @param newNCol - the number of T3MAPS columns.
+*/
+PixelEfficiency::PixelEfficiency(int newNRow, int newNCol) {
+  if (newNRow <= 0 || newNCol <= 0) {
+    std::cout << "PixelEfficiency: Bad chip size " << newNRow << " x "
+	      << newNCol << std::endl;
+    exit(0);
+  }
+  nRow = newNRow;
+  nCol = newNCol;
+  matchableT3MAPS.assign(nRow * nCol, 0);
+  matchedT3MAPS.assign(nRow * nCol, 0);
+  matchableFEI4.assign(nRow * nCol, 0);
+  matchedFEI4.assign(nRow * nCol, 0);
+}
+
+/**
+   Add the counts of another run or orientation with the same chip size.
+   @param other - the counters to add.
+*/
+void PixelEfficiency::add(const PixelEfficiency &other) {
+  if (!hasSameSize(other)) {
+    std::cout << "PixelEfficiency: Cannot add maps of different size."
+	      << std::endl;
+    exit(0);
+  }
+  for (int i_p = 0; i_p < nRow * nCol; i_p++) {
+    matchableT3MAPS[i_p] += other.matchableT3MAPS[i_p];
+    matchedT3MAPS[i_p] += other.matchedT3MAPS[i_p];
+    matchableFEI4[i_p] += other.matchableFEI4[i_p];
+    matchedFEI4[i_p] += other.matchedFEI4[i_p];
+  }
+}
+
+/**
+   Set all of the counts to zero.
+*/
+void PixelEfficiency::reset() {
+  matchableT3MAPS.assign(nRow * nCol, 0);
+  matchedT3MAPS.assign(nRow * nCol, 0);
+  matchableFEI4.assign(nRow * nCol, 0);
+  matchedFEI4.assign(nRow * nCol, 0);
+}
+
+/**
+   Read the counts written by write() into counters of the same size.
+   @param input - the input stream.
+   @returns - true iff the size matches and the read succeeded.
+*/
+bool PixelEfficiency::read(std::istream &input) {
+  int storedNRow = 0;
+  int storedNCol = 0;
+  if (!ResultCache::readValue(input, storedNRow) ||
+      !ResultCache::readValue(input, storedNCol) ||
+      storedNRow != nRow || storedNCol != nCol) {
+    return false;
+  }
+  std::vector<Long64_t> stored[4];
+  for (int i_v = 0; i_v < 4; i_v++) {
+    if (!ResultCache::readVector(input, stored[i_v]) ||
+	(int)stored[i_v].size() != nRow * nCol) {
+      return false;
+    }
+  }
+  matchableT3MAPS.swap(stored[0]);
+  matchedT3MAPS.swap(stored[1]);
+  matchableFEI4.swap(stored[2]);
+  matchedFEI4.swap(stored[3]);
+  return true;
+}
+
+/**
+   Read the counts from a file written by writeFile().
+   @param fileName - the name of the file.
+   @returns - true iff the file exists, the size matches and the read
+   succeeded.
+*/
+bool PixelEfficiency::readFile(TString fileName) {
+  std::ifstream input(fileName.Data(), std::ios::in | std::ios::binary);
+  int magic = 0;
+  bool success = (input.is_open() && ResultCache::readValue(input, magic) &&
+		  magic == pixelFileMagic && read(input));
+  input.close();
+  return success;
+}
+
+/**
+   Get the number of T3MAPS rows.
+*/
+int PixelEfficiency::getNRow() const {
+  return nRow;
+}
+
+/**
+   Get the number of T3MAPS columns.
+*/
+int PixelEfficiency::getNCol() const {
+  return nCol;
+}
+
+/**
+   Get the number of matchable hits of one pixel.
+   @param chipName - "FEI4" or "T3MAPS".
+   @param row - the T3MAPS row.
+   @param col - the T3MAPS column.
+   @returns - the number of matchable hits.
+*/
+Long64_t PixelEfficiency::getMatchable(TString chipName, int row,
+				       int col) const {
+  if (row < 0 || row >= nRow || col < 0 || col >= nCol) return 0;
+  return chipName.EqualTo("FEI4") ? matchableFEI4[row * nCol + col] :
+    matchableT3MAPS[row * nCol + col];
+}
+
+/**
+   Get the number of matched hits of one pixel.
+   @param chipName - "FEI4" or "T3MAPS".
+   @param row - the T3MAPS row.
+   @param col - the T3MAPS column.
+   @returns - the number of matched hits.
+*/
+Long64_t PixelEfficiency::getMatched(TString chipName, int row,
+				     int col) const {
+  if (row < 0 || row >= nRow || col < 0 || col >= nCol) return 0;
+  return chipName.EqualTo("FEI4") ? matchedFEI4[row * nCol + col] :
+    matchedT3MAPS[row * nCol + col];
+}
+
+/**
+   Get the matching efficiency of one pixel.
+   @param chipName - "FEI4" or "T3MAPS".
+   @param row - the T3MAPS row.
+   @param col - the T3MAPS column.
+   @returns - the efficiency, or 0 if there are no matchable hits.
+*/
+double PixelEfficiency::getEfficiency(TString chipName, int row,
+				      int col) const {
+  Long64_t matchable = getMatchable(chipName, row, col);
+  if (matchable <= 0) return 0.0;
+  return ((double)getMatched(chipName, row, col)) / ((double)matchable);
+}
+
+/**
+   Check whether two sets of counters can be added.
+   @param other - the other counters.
+   @returns - true iff they have the same number of rows and columns.
+*/
+bool PixelEfficiency::hasSameSize(const PixelEfficiency &other) const {
+  return (nRow == other.nRow && nCol == other.nCol);
+}
+
+/**
+   Write the chip size and the counts in binary form, e.g. for the
+   ResultCache.
+   @param output - the output stream.
+*/
+void PixelEfficiency::write(std::ostream &output) const {
+  ResultCache::writeValue(output, nRow);
+  ResultCache::writeValue(output, nCol);
+  ResultCache::writeVector(output, matchableT3MAPS);
+  ResultCache::writeVector(output, matchedT3MAPS);
+  ResultCache::writeVector(output, matchableFEI4);
+  ResultCache::writeVector(output, matchedFEI4);
+}
+
+/**
+   Write the counts to a file that can be read and summed by later jobs.
+   @param fileName - the name of the file.
+*/
+void PixelEfficiency::writeFile(TString fileName) const {
+  std::ofstream output(fileName.Data(), std::ios::out | std::ios::binary);
+  if (!output.is_open()) {
+    std::cout << "PixelEfficiency: Cannot write " << fileName << std::endl;
+    exit(0);
+  }
+  ResultCache::writeValue(output, pixelFileMagic);
+  write(output);
+  output.close();
+}
+
+/**
+   Make a map of the efficiency of each pixel, with binomial errors. Pixels
+   without matchable hits are left empty.
+   @param name - the name of the new histogram.
+   @param chipName - "FEI4" or "T3MAPS".
+   @returns - the histogram (owned by the caller).
+*/
+TH2D *PixelEfficiency::toTH2D(TString name, TString chipName) const {
+  TH2D *hist = new TH2D(name, name, nCol, -0.5, nCol - 0.5,
+			nRow, -0.5, nRow - 0.5);
+  hist->SetDirectory(NULL);
+  hist->GetXaxis()->SetTitle("T3MAPS column");
+  hist->GetYaxis()->SetTitle("T3MAPS row");
+  for (int i_r = 0; i_r < nRow; i_r++) {
+    for (int i_c = 0; i_c < nCol; i_c++) {
+      double matchable = (double)getMatchable(chipName, i_r, i_c);
+      if (matchable <= 0.0) continue;
+      double efficiency = getEfficiency(chipName, i_r, i_c);
+      hist->SetBinContent(i_c+1, i_r+1, efficiency);
+      hist->SetBinError(i_c+1, i_r+1,
+			sqrt(efficiency * (1.0 - efficiency) / matchable));
+    }
+  }
+  return hist;
+}
+
+/**
+   Make a curve of the efficiency of each T3MAPS column (all rows together),
+   with binomial errors.
+   @param name - the name of the new histogram.
+   @param chipName - "FEI4" or "T3MAPS".
+   @returns - the histogram (owned by the caller).
+*/
+TH1D *PixelEfficiency::toColumnTH1D(TString name, TString chipName) const {
+  TH1D *hist = new TH1D(name, name, nCol, -0.5, nCol - 0.5);
+  hist->SetDirectory(NULL);
+  hist->GetXaxis()->SetTitle("T3MAPS column");
+  hist->GetYaxis()->SetTitle(Form("%s efficiency", chipName.Data()));
+  for (int i_c = 0; i_c < nCol; i_c++) {
+    double matched = 0.0;
+    double matchable = 0.0;
+    for (int i_r = 0; i_r < nRow; i_r++) {
+      matched += (double)getMatched(chipName, i_r, i_c);
+      matchable += (double)getMatchable(chipName, i_r, i_c);
+    }
+    if (matchable <= 0.0) continue;
+    double efficiency = matched / matchable;
+    hist->SetBinContent(i_c+1, efficiency);
+    hist->SetBinError(i_c+1, sqrt(efficiency * (1.0 - efficiency) / matchable));
+  }
+  return hist;
+}
@@ -0,0 +1,79 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: PixelEfficiency.h                                                   //
+//  Class: PixelEfficiency.cxx                                                //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef PixelEfficiency_h
+#define PixelEfficiency_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <math.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include "TH1D.h"
+#include "TH2D.h"
+#include "TString.h"
+
+#include "ResultCache.h"
+
+class PixelEfficiency {
+
+ public:
+
+  PixelEfficiency(int newNRow, int newNCol);
+  virtual ~PixelEfficiency() {};
+
+  // Mutators:
+  void add(const PixelEfficiency &other);
+  void fill(TString chipName, int row, int col, bool matched) {
+    if (row < 0 || row >= nRow || col < 0 || col >= nCol) return;
+    int index = row * nCol + col;
+    if (chipName.EqualTo("FEI4")) {
+      matchableFEI4[index]++;
+      if (matched) matchedFEI4[index]++;
+    }
+    else {
+      matchableT3MAPS[index]++;
+      if (matched) matchedT3MAPS[index]++;
+    }
+  };
+  void reset();
+  bool read(std::istream &input);
+  bool readFile(TString fileName);
+
+  // Accessors:
+  int getNRow() const;
+  int getNCol() const;
+  Long64_t getMatchable(TString chipName, int row, int col) const;
+  Long64_t getMatched(TString chipName, int row, int col) const;
+  double getEfficiency(TString chipName, int row, int col) const;
+  bool hasSameSize(const PixelEfficiency &other) const;
+  void write(std::ostream &output) const;
+  void writeFile(TString fileName) const;
+
+  // Efficiency maps for output, with binomial errors:
+  TH2D *toTH2D(TString name, TString chipName) const;
+  TH1D *toColumnTH1D(TString name, TString chipName) const;
+
+ private:
+
+  int nRow;
+  int nCol;
+
+  // One counter per T3MAPS pixel, indexed by row*nCol + col. The FEI4
+  // counters belong to the T3MAPS pixel that the FEI4 hit maps onto:
+  std::vector<Long64_t> matchableT3MAPS;
+  std::vector<Long64_t> matchedT3MAPS;
+  std::vector<Long64_t> matchableFEI4;
+  std::vector<Long64_t> matchedFEI4;
+
+};
+
+#endif
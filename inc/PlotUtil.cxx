@@ -8,10 +8,55 @@
 //                                                                            //
 //  This namespace stores ROOT plotting code that is reused in many places.   //
 //                                                                            //
+//  All plots are drawn on one shared canvas. By default a plot is drawn as   //
+//  soon as it is requested. A program can instead call setOutputOptions()    //
+//  to queue copies of the objects and draw them after the event loop (in a   //
+//  child process with "BackgroundPlots", since ROOT graphics are not thread  //
+//  safe), or to write the objects to a ROOT file and skip the images.        //
+//                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
 #include "PlotUtil.h"
 
+#include "Instrument.h"
+
+#include <unistd.h>
+#include <sys/wait.h>
+
+// The kinds of plot that can be queued:
+enum PlotType {kAnimateTH2D, kFinishAnimation, kTH1F, kTH1FAndFit, kTwoTH1Fs,
+	       kTH2D, kTGraph, kTGraphErrFit};
+
+// A plot waiting to be drawn. The range holds x1, x2, y1, y2, z1, z2 and the
+// flag is the log scale or normalization option of the plot:
+struct PlotRequest {
+  int type;
+  TObject *first;
+  TObject *second;
+  TString xname;
+  TString yname;
+  TString zname;
+  TString sname;
+  double range[6];
+  bool flag;
+};
+
+static PlotRequest makeRequest(int type, TObject *first, TObject *second,
+			       TString sname);
+static TObject *copyObject(TObject *object);
+static void submitPlot(PlotRequest request);
+static void waitForRenderers();
+static TCanvas *getCanvas();
+static void renderPlot(const PlotRequest &request);
+
+// The output state, set by setOutputOptions():
+static bool deferPlots = false;
+static bool backgroundPlots = false;
+static TFile *plotFile = NULL;
+static TCanvas *sharedCanvas = NULL;
+static std::vector<PlotRequest> plotQueue;
+static std::vector<pid_t> renderers;
+
 TStyle* PlotUtil::atlasStyle() {
   TStyle *atlasStyle = new TStyle("ATLAS","Atlas style");
 
@@ -95,47 +140,128 @@ void PlotUtil::setAtlasStyle() {
   gROOT->ForceStyle();
 }
 
+/**
+   Choose how the plots are written. By default each plot is drawn when it is
+   requested. With "DeferPlots" the plots are copied and queued until
+   flushPlots() or finishPlots(), and with "BackgroundPlots" the queue is
+   drawn in a child process while the job continues. With "ROOTPlotsOnly" the
+   objects are written to a ROOT file instead of being drawn.
+   @param options - the job options.
+   @param fileName - the ROOT file for "ROOTPlotsOnly".
+*/
+void PlotUtil::setOutputOptions(TString options, TString fileName) {
+  deferPlots = (options.Contains("DeferPlots") ||
+		options.Contains("BackgroundPlots"));
+  backgroundPlots = options.Contains("BackgroundPlots");
+  if (options.Contains("ROOTPlotsOnly") && !plotFile) {
+    // Keep the histograms booked later out of the plot file:
+    TDirectory *previous = gDirectory;
+    plotFile = new TFile(fileName, "RECREATE");
+    previous->cd();
+    std::cout << "PlotUtil: Writing plot objects to " << fileName
+	      << " without images." << std::endl;
+  }
+}
+
+/**
+   Check whether plots are drawn as images, so that programs drawing their
+   own canvases can skip them.
+*/
+bool PlotUtil::makesImages() {
+  return (plotFile == NULL);
+}
+
+/**
+   Write an object to the plot file, if there is one. The key is the file
+   name of the plot without its directory, and repeated keys get new cycles.
+   @param object - the object to write.
+   @param sname - the name of the plot.
+*/
+void PlotUtil::saveObject(TObject *object, TString sname) {
+  if (!plotFile || !object) return;
+  TString key = gSystem->BaseName(sname);
+  key.ReplaceAll(".eps", "");
+  plotFile->WriteTObject(object, key);
+}
+
+/**
+   Draw the queued plots, in the order they were requested. With
+   "BackgroundPlots" they are drawn by a child process, after any earlier
+   child has finished so that animations are appended in order.
+*/
+void PlotUtil::flushPlots() {
+  if (plotQueue.empty()) return;
+  INSTRUMENT_SCOPE("plot.flush");
+  pid_t pid = -1;
+  if (backgroundPlots) {
+    waitForRenderers();
+    std::cout.flush();
+    fflush(stdout);
+    pid = fork();
+    if (pid < 0) {
+      std::cout << "PlotUtil: Could not fork, drawing plots now." << std::endl;
+    }
+  }
+
+  // The child draws the plots and leaves without the parent's cleanup:
+  if (pid == 0) {
+    for (int i_p = 0; i_p < (int)plotQueue.size(); i_p++) {
+      renderPlot(plotQueue[i_p]);
+    }
+    _exit(0);
+  }
+  else if (pid > 0) {
+    renderers.push_back(pid);
+  }
+  else {
+    for (int i_p = 0; i_p < (int)plotQueue.size(); i_p++) {
+      renderPlot(plotQueue[i_p]);
+    }
+  }
+
+  for (int i_p = 0; i_p < (int)plotQueue.size(); i_p++) {
+    delete plotQueue[i_p].first;
+    delete plotQueue[i_p].second;
+  }
+  plotQueue.clear();
+}
+
+/**
+   Draw the remaining plots, wait for the background drawing to finish and
+   close the plot file. Call this at the end of the job.
+*/
+void PlotUtil::finishPlots() {
+  flushPlots();
+  waitForRenderers();
+  if (plotFile) {
+    plotFile->Close();
+    delete plotFile;
+    plotFile = NULL;
+  }
+}
+
 void PlotUtil::animateTH2D(TH2D *h2, TString xname, TString yname,
 			    TString zname, TString sname) {
-  TCanvas *can = new TCanvas("can","can",800,600);
-  can->cd();
-  can->Clear();
-  gPad->SetRightMargin(0.15);
-  h2->Draw("colz");
-  h2->GetXaxis()->SetTitle(xname);
-  h2->GetYaxis()->SetTitle(yname);
-  h2->GetZaxis()->SetTitle(zname);
-  can->Print(Form("%s.gif+5", sname.Data()));
-  delete can;
+  PlotRequest request = makeRequest(kAnimateTH2D, h2, NULL, sname);
+  request.xname = xname;
+  request.yname = yname;
+  request.zname = zname;
+  submitPlot(request);
 }
 
 void PlotUtil::finishAnimation(TString sname) {
-  TCanvas *can = new TCanvas("can","can",800,600);
-  can->cd();
-  TLatex text; text.SetNDC(); text.SetTextColor(1);
-  text.DrawLatex(0.4, 0.45, "END");
-  can->Print(Form("%s.gif++", sname.Data()));
-  delete can;
+  submitPlot(makeRequest(kFinishAnimation, NULL, NULL, sname));
 }
 
 void PlotUtil::plotTH1F(TH1F *h, TString xname, TString yname, TString sname, 
 			double x1, double x2, double y1, double y2, bool log) {
-  TCanvas *can = new TCanvas("can","can",800,600);
-  can->cd();
-  can->Clear();
-  h->SetFillColor(kBlue-10);
-  h->SetLineColor(kBlue+4);
-  h->Draw();
-  h->GetXaxis()->SetNoExponent(false);
-  if (log) gPad->SetLogy();
-  h->GetXaxis()->SetTitle(xname);
-  if (x1 != 0 || x2 != 0) h->GetXaxis()->SetRangeUser(x1,x2);
-  h->GetYaxis()->SetTitle(yname);
-  if (y1 != 0 || y2 != 0) h->GetYaxis()->SetRangeUser(y1,y2);
-  can->Print(Form("%s.eps", sname.Data()));
-  can->Print(Form("%s.gif+5", sname.Data()));
-  if (log) gPad->SetLogy(false);
-  delete can;
+  PlotRequest request = makeRequest(kTH1F, h, NULL, sname);
+  request.xname = xname;
+  request.yname = yname;
+  request.range[0] = x1;  request.range[1] = x2;
+  request.range[2] = y1;  request.range[3] = y2;
+  request.flag = log;
+  submitPlot(request);
 }
 
 void PlotUtil::plotTH1F(TH1F *h, TString xname, TString yname, TString sname, 
@@ -154,57 +280,33 @@ void PlotUtil::plotTH1F(TH1F *h, TString xname, TString yname, TString sname) {
 
 void PlotUtil::plotTH1FAndFit(TH1F *h, TF1 *f, TString xname, TString yname,
 			      TString sname, bool log) {
-  TCanvas *can = new TCanvas("can","can",800,600);
-  can->cd();
-  can->Clear();
-  h->Draw();
-  h->GetXaxis()->SetNoExponent(false);
-  if (log) gPad->SetLogy();
-  h->GetXaxis()->SetTitle(xname);
-  h->GetYaxis()->SetTitle(yname);
-  f->SetLineColor(kRed);
-  f->Draw("SAME");
-  can->Print(Form("%s.eps", sname.Data()));
-  can->Print(Form("%s.gif+5", sname.Data()));
-  if (log) gPad->SetLogy(false);
-  delete can;
+  PlotRequest request = makeRequest(kTH1FAndFit, h, f, sname);
+  request.xname = xname;
+  request.yname = yname;
+  request.flag = log;
+  submitPlot(request);
 }
 
 void PlotUtil::plotTwoTH1Fs(TH1F *h1, TH1F *h2, TString xname, TString yname, 
 			    TString sname, bool normalize) {
-  TCanvas *can = new TCanvas("can","can",800,600);
-  can->cd();
-  can->Clear();
-  if (normalize) {
-    h1->Scale(1.0/h1->GetSumOfWeights());
-    h2->Scale(1.0/h2->GetSumOfWeights());
-  }
-  h1->Draw();
-  h1->GetXaxis()->SetTitle(xname);
-  h1->GetYaxis()->SetTitle(yname);
-  h2->Draw("SAME");
-  can->Print(Form("%s.eps", sname.Data()));
-  can->Print(Form("%s.gif+5", sname.Data()));
-  delete can;
+  PlotRequest request = makeRequest(kTwoTH1Fs, h1, h2, sname);
+  request.xname = xname;
+  request.yname = yname;
+  request.flag = normalize;
+  submitPlot(request);
 }
 
 void PlotUtil::plotTH2D(TH2D *h2, TString xname, TString yname, TString zname,
 			TString sname, double x1=0, double x2=0, double y1=0,
 			double y2=0, double z1=0, double z2=0) {
-  TCanvas *can = new TCanvas("can","can",800,600);
-  can->cd();
-  can->Clear();
-  gPad->SetRightMargin(0.15);
-  h2->Draw("colz");
-  h2->GetXaxis()->SetTitle(xname);
-  if (x1 != 0 || x2 != 0) h2->GetXaxis()->SetRangeUser(x1,x2);
-  h2->GetYaxis()->SetTitle(yname);
-  if (y1 != 0 || y2 != 0) h2->GetYaxis()->SetRangeUser(y1,y2);
-  h2->GetZaxis()->SetTitle(zname);
-  if (z1 != 0 || z2 != 0) h2->GetZaxis()->SetRangeUser(z1,z2);
-  can->Print(Form("%s.eps", sname.Data()));
-  can->Print(Form("%s.gif+5", sname.Data()));
-  delete can;
+  PlotRequest request = makeRequest(kTH2D, h2, NULL, sname);
+  request.xname = xname;
+  request.yname = yname;
+  request.zname = zname;
+  request.range[0] = x1;  request.range[1] = x2;
+  request.range[2] = y1;  request.range[3] = y2;
+  request.range[4] = z1;  request.range[5] = z2;
+  submitPlot(request);
 }
 
 
@@ -215,25 +317,194 @@ void PlotUtil::plotTH2D(TH2D *h2, TString xname, TString yname, TString zname,
 
 void PlotUtil::plotTGraph(TGraph *g, TString xname, TString yname, 
 			  TString sname) {
-  TCanvas *can = new TCanvas("can","can",800,600);
-  can->cd();
-  can->Clear();
-  g->GetXaxis()->SetTitle(xname);
-  g->GetYaxis()->SetTitle(yname);
-  g->Draw("ALP");
-  can->Print(Form("%s.eps", sname.Data()));
-  delete can;
+  PlotRequest request = makeRequest(kTGraph, g, NULL, sname);
+  request.xname = xname;
+  request.yname = yname;
+  submitPlot(request);
 }
 
 void PlotUtil::plotTGraphErrFit(TGraphErrors *g, TF1 *fit, TString xname,
 				TString yname, TString sname) {
-  TCanvas *can = new TCanvas("can","can",800,600);
-  can->cd();
-  can->Clear();
-  g->GetXaxis()->SetTitle(xname);
-  g->GetYaxis()->SetTitle(yname);
-  g->Draw("AP");
-  fit->Draw("SAME");
-  can->Print(Form("%s.eps", sname.Data()));
-  delete can;
+  PlotRequest request = makeRequest(kTGraphErrFit, g, fit, sname);
+  request.xname = xname;
+  request.yname = yname;
+  submitPlot(request);
+}
+
+/**
+   Start a request for a plot.
+   @param type - the kind of plot.
+   @param first - the main object.
+   @param second - the second object (fit or histogram), or NULL.
+   @param sname - the name of the plot files, without extension.
+   @returns - the request, with no axis titles or ranges.
+*/
+static PlotRequest makeRequest(int type, TObject *first, TObject *second,
+			       TString sname) {
+  PlotRequest request;
+  request.type = type;
+  request.first = first;
+  request.second = second;
+  request.xname = "";
+  request.yname = "";
+  request.zname = "";
+  request.sname = sname;
+  for (int i_r = 0; i_r < 6; i_r++) request.range[i_r] = 0.0;
+  request.flag = false;
+  return request;
+}
+
+/**
+   Copy an object for the plot queue. Histogram copies are kept out of the
+   current directory so that they do not end up in an output file.
+   @param object - the object to copy.
+   @returns - the copy.
+*/
+static TObject *copyObject(TObject *object) {
+  if (!object) return NULL;
+  TObject *copy = object->Clone();
+  if (copy->InheritsFrom("TH1")) ((TH1*)copy)->SetDirectory(0);
+  return copy;
+}
+
+/**
+   Write, queue or draw a plot according to the output options.
+   @param request - the plot.
+*/
+static void submitPlot(PlotRequest request) {
+  INSTRUMENT_SCOPE("plot.submit");
+  if (plotFile) {
+    PlotUtil::saveObject(request.first, request.sname);
+    PlotUtil::saveObject(request.second, request.sname);
+  }
+  else if (deferPlots) {
+    // The caller may change or delete the objects after this call:
+    request.first = copyObject(request.first);
+    request.second = copyObject(request.second);
+    plotQueue.push_back(request);
+  }
+  else {
+    renderPlot(request);
+  }
+}
+
+/**
+   Wait for the child processes drawing plots in the background.
+*/
+static void waitForRenderers() {
+  for (int i_r = 0; i_r < (int)renderers.size(); i_r++) {
+    int status = 0;
+    waitpid(renderers[i_r], &status, 0);
+  }
+  renderers.clear();
+}
+
+/**
+   Get the canvas shared by all plots, cleared and with the style margins.
+*/
+static TCanvas *getCanvas() {
+  if (!sharedCanvas) {
+    sharedCanvas = new TCanvas("plotUtilCanvas", "plotUtilCanvas", 800, 600);
+  }
+  sharedCanvas->cd();
+  sharedCanvas->Clear();
+  sharedCanvas->SetLogy(false);
+  sharedCanvas->SetRightMargin(gStyle->GetPadRightMargin());
+  return sharedCanvas;
+}
+
+/**
+   Draw a plot and print its files.
+   @param request - the plot.
+*/
+static void renderPlot(const PlotRequest &request) {
+  INSTRUMENT_SCOPE("plot.render");
+  TCanvas *can = getCanvas();
+  const double *range = request.range;
+  const char *sname = request.sname.Data();
+
+  if (request.type == kAnimateTH2D || request.type == kTH2D) {
+    TH2D *h2 = (TH2D*)request.first;
+    gPad->SetRightMargin(0.15);
+    h2->Draw("colz");
+    h2->GetXaxis()->SetTitle(request.xname);
+    if (range[0] != 0 || range[1] != 0) {
+      h2->GetXaxis()->SetRangeUser(range[0], range[1]);
+    }
+    h2->GetYaxis()->SetTitle(request.yname);
+    if (range[2] != 0 || range[3] != 0) {
+      h2->GetYaxis()->SetRangeUser(range[2], range[3]);
+    }
+    h2->GetZaxis()->SetTitle(request.zname);
+    if (range[4] != 0 || range[5] != 0) {
+      h2->GetZaxis()->SetRangeUser(range[4], range[5]);
+    }
+    if (request.type == kTH2D) can->Print(Form("%s.eps", sname));
+    can->Print(Form("%s.gif+5", sname));
+  }
+  
+  else if (request.type == kFinishAnimation) {
+    TLatex text; text.SetNDC(); text.SetTextColor(1);
+    text.DrawLatex(0.4, 0.45, "END");
+    can->Print(Form("%s.gif++", sname));
+  }
+  
+  else if (request.type == kTH1F || request.type == kTH1FAndFit) {
+    TH1F *h = (TH1F*)request.first;
+    if (request.type == kTH1F) {
+      h->SetFillColor(kBlue-10);
+      h->SetLineColor(kBlue+4);
+    }
+    h->Draw();
+    h->GetXaxis()->SetNoExponent(false);
+    if (request.flag) gPad->SetLogy();
+    h->GetXaxis()->SetTitle(request.xname);
+    if (range[0] != 0 || range[1] != 0) {
+      h->GetXaxis()->SetRangeUser(range[0], range[1]);
+    }
+    h->GetYaxis()->SetTitle(request.yname);
+    if (range[2] != 0 || range[3] != 0) {
+      h->GetYaxis()->SetRangeUser(range[2], range[3]);
+    }
+    if (request.type == kTH1FAndFit) {
+      TF1 *f = (TF1*)request.second;
+      f->SetLineColor(kRed);
+      f->Draw("SAME");
+    }
+    can->Print(Form("%s.eps", sname));
+    can->Print(Form("%s.gif+5", sname));
+  }
+  
+  else if (request.type == kTwoTH1Fs) {
+    TH1F *h1 = (TH1F*)request.first;
+    TH1F *h2 = (TH1F*)request.second;
+    if (request.flag) {
+      h1->Scale(1.0/h1->GetSumOfWeights());
+      h2->Scale(1.0/h2->GetSumOfWeights());
+    }
+    h1->Draw();
+    h1->GetXaxis()->SetTitle(request.xname);
+    h1->GetYaxis()->SetTitle(request.yname);
+    h2->Draw("SAME");
+    can->Print(Form("%s.eps", sname));
+    can->Print(Form("%s.gif+5", sname));
+  }
+  
+  else if (request.type == kTGraph) {
+    TGraph *g = (TGraph*)request.first;
+    g->GetXaxis()->SetTitle(request.xname);
+    g->GetYaxis()->SetTitle(request.yname);
+    g->Draw("ALP");
+    can->Print(Form("%s.eps", sname));
+  }
+  
+  else if (request.type == kTGraphErrFit) {
+    TGraphErrors *g = (TGraphErrors*)request.first;
+    TF1 *fit = (TF1*)request.second;
+    g->GetXaxis()->SetTitle(request.xname);
+    g->GetYaxis()->SetTitle(request.yname);
+    g->Draw("AP");
+    fit->Draw("SAME");
+    can->Print(Form("%s.eps", sname));
+  }
 }
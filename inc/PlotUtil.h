@@ -71,6 +71,13 @@ namespace PlotUtil {
   
   void setAtlasStyle();
   
+  // Deferred, background or ROOT-file-only output of the plots below:
+  void setOutputOptions(TString options, TString fileName);
+  bool makesImages();
+  void saveObject(TObject *object, TString sname);
+  void flushPlots();
+  void finishPlots();
+  
   void animateTH2D(TH2D *h2, TString xname, TString yname, TString zname, 
 		    TString sname);
   void finishAnimation(TString sname);
@@ -0,0 +1,270 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: RateSeries.cxx                                                      //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class follows the T3MAPS integration periods and the FEI4 events of  //
+//  a run in one pass, and gives the live time, the dead time between the     //
+//  periods, the beam rate and the hits per period for fixed windows of time. //
+//  Only the open window is kept in memory: each window is written to the     //
+//  tree as soon as a later scan or event shows that it is over.              //
+//                                                                            //
+//  Typical use, with the scans and the events merged in time order:          //
+//    1. RateSeries(windowLength, timeOffset) to initialize.                  //
+//    2. addScan() for each T3MAPS scan and addEventFEI4() for the FEI4       //
+//       events, in the order of their start times.                           //
+//    3. finish(), then getTree() for the time series and the totals.         //
+//                                                                            //
+//  The windows start at the first T3MAPS scan, and the FEI4 times are moved  //
+//  to the T3MAPS clock with the time offset. FEI4 events before the first    //
+//  scan are ignored.                                                         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "RateSeries.h"
+
+/**
+   Initialize an empty series.
+   @param newWindowLength - the length of each window in seconds.
+   @param newTimeOffset - the FEI4 - T3MAPS time offset in seconds.
+*/
+RateSeries::RateSeries(double newWindowLength, double newTimeOffset) {
+  if (newWindowLength <= 0.0) {
+    std::cout << "RateSeries: Window length must be positive." << std::endl;
+    exit(0);
+  }
+  windowLength = newWindowLength;
+  timeOffset = newTimeOffset;
+  started = false;
+  finished = false;
+  runStart = 0.0;
+  runStop = 0.0;
+  activeStart = 0.0;
+  activeStop = 0.0;
+  nWindows = 0;
+  nScans = 0;
+  liveTime = 0.0;
+  deadTime = 0.0;
+  hitsFEI4 = 0;
+  window.windowStart = 0.0;
+  clearWindow();
+
+  // The tree belongs to the series, not to the current ROOT directory:
+  tree = new TTree("RateSeries", "RateSeries");
+  tree->SetDirectory(NULL);
+  tree->Branch("windowStart", &window.windowStart, "windowStart/D");
+  tree->Branch("windowLength", &window.windowLength, "windowLength/D");
+  tree->Branch("nScans", &window.nScans, "nScans/I");
+  tree->Branch("liveTime", &window.liveTime, "liveTime/D");
+  tree->Branch("deadTime", &window.deadTime, "deadTime/D");
+  tree->Branch("liveFraction", &window.liveFraction, "liveFraction/D");
+  tree->Branch("hitsT3MAPS", &window.hitsT3MAPS, "hitsT3MAPS/I");
+  tree->Branch("hitsFEI4", &window.hitsFEI4, "hitsFEI4/I");
+  tree->Branch("hitsFEI4Live", &window.hitsFEI4Live, "hitsFEI4Live/I");
+  tree->Branch("rateFEI4", &window.rateFEI4, "rateFEI4/D");
+  tree->Branch("hitsPerPeriodT3MAPS", &window.hitsPerPeriodT3MAPS,
+	       "hitsPerPeriodT3MAPS/D");
+  tree->Branch("hitsPerPeriodFEI4", &window.hitsPerPeriodFEI4,
+	       "hitsPerPeriodFEI4/D");
+}
+
+/**
+   Delete the series and its tree.
+*/
+RateSeries::~RateSeries() {
+  delete tree;
+}
+
+/**
+   Add a T3MAPS integration period.
+   @param timestamp_start - the start of the period.
+   @param timestamp_stop - the end of the period.
+   @param nHits - the number of T3MAPS hits in the period.
+*/
+void RateSeries::addScan(double timestamp_start, double timestamp_stop,
+			 int nHits) {
+  if (finished) return;
+  if (timestamp_stop < timestamp_start) timestamp_stop = timestamp_start;
+  if (!started) {
+    started = true;
+    runStart = timestamp_start;
+    runStop = timestamp_start;
+    activeStart = timestamp_start;
+    activeStop = timestamp_start;
+    window.windowStart = timestamp_start;
+  }
+  advanceTo(timestamp_start);
+
+  // The previous period ended in this window, so its live time is complete:
+  window.liveTime += getOverlap(activeStart, activeStop, window.windowStart,
+				window.windowStart + windowLength);
+  activeStart = timestamp_start;
+  activeStop = timestamp_stop;
+  if (timestamp_stop > runStop) runStop = timestamp_stop;
+  window.nScans++;
+  window.hitsT3MAPS += nHits;
+}
+
+/**
+   Add a FEI4 event. The hits are live if the event is inside the latest
+   T3MAPS integration period.
+   @param timestamp_start - the start of the event (FEI4 clock).
+   @param timestamp_stop - the end of the event (FEI4 clock).
+   @param nHits - the number of FEI4 hits in the event.
+*/
+void RateSeries::addEventFEI4(double timestamp_start, double timestamp_stop,
+			      int nHits) {
+  if (finished || !started) return;
+  double start = timestamp_start - timeOffset;
+  double stop = timestamp_stop - timeOffset;
+  if (start < runStart) return;
+  advanceTo(start);
+  if (stop > runStop) runStop = stop;
+  window.hitsFEI4 += nHits;
+  if (start >= activeStart && stop <= activeStop) window.hitsFEI4Live += nHits;
+}
+
+/**
+   Close the remaining windows, up to the end of the last scan or event.
+*/
+void RateSeries::finish() {
+  if (!started || finished) return;
+  do {
+    closeWindow();
+  } while (window.windowStart < runStop);
+  finished = true;
+}
+
+/**
+   Get the time series, one entry per window (owned by the series).
+*/
+TTree *RateSeries::getTree() {
+  return tree;
+}
+
+/**
+   Get the number of closed windows.
+*/
+int RateSeries::getNWindows() {
+  return nWindows;
+}
+
+/**
+   Get the number of T3MAPS integration periods in the closed windows.
+*/
+int RateSeries::getNScans() {
+  return nScans;
+}
+
+/**
+   Get the time covered by the closed windows.
+*/
+double RateSeries::getElapsedTime() {
+  return liveTime + deadTime;
+}
+
+/**
+   Get the T3MAPS integration time in the closed windows.
+*/
+double RateSeries::getLiveTime() {
+  return liveTime;
+}
+
+/**
+   Get the time between the T3MAPS integration periods in the closed windows.
+*/
+double RateSeries::getDeadTime() {
+  return deadTime;
+}
+
+/**
+   Get the live time fraction of the closed windows.
+*/
+double RateSeries::getLiveFraction() {
+  double elapsed = getElapsedTime();
+  return elapsed > 0.0 ? liveTime / elapsed : 0.0;
+}
+
+/**
+   Get the mean FEI4 hit rate of the closed windows, in hits per second.
+*/
+double RateSeries::getRateFEI4() {
+  double elapsed = getElapsedTime();
+  return elapsed > 0.0 ? ((double)hitsFEI4) / elapsed : 0.0;
+}
+
+/**
+   Close every window that ends before the given time.
+   @param time - the time of the next scan or event (T3MAPS clock).
+*/
+void RateSeries::advanceTo(double time) {
+  if (time > runStop) runStop = time;
+  while (time >= window.windowStart + windowLength) closeWindow();
+}
+
+/**
+   Complete the metrics of the open window, store it and open the next one.
+*/
+void RateSeries::closeWindow() {
+  double windowStop = window.windowStart + windowLength;
+  window.liveTime += getOverlap(activeStart, activeStop, window.windowStart,
+				windowStop);
+  window.windowLength = getOverlap(runStart, runStop, window.windowStart,
+				   windowStop);
+  if (window.liveTime > window.windowLength) {
+    window.liveTime = window.windowLength;
+  }
+  window.deadTime = window.windowLength - window.liveTime;
+  if (window.windowLength > 0.0) {
+    window.liveFraction = window.liveTime / window.windowLength;
+    window.rateFEI4 = ((double)window.hitsFEI4) / window.windowLength;
+  }
+  if (window.nScans > 0) {
+    window.hitsPerPeriodT3MAPS
+      = ((double)window.hitsT3MAPS) / ((double)window.nScans);
+    window.hitsPerPeriodFEI4
+      = ((double)window.hitsFEI4Live) / ((double)window.nScans);
+  }
+  tree->Fill();
+
+  nWindows++;
+  nScans += window.nScans;
+  liveTime += window.liveTime;
+  deadTime += window.deadTime;
+  hitsFEI4 += window.hitsFEI4;
+  clearWindow();
+  window.windowStart = windowStop;
+}
+
+/**
+   Reset the metrics of the open window (but not its start).
+*/
+void RateSeries::clearWindow() {
+  window.windowLength = 0.0;
+  window.nScans = 0;
+  window.liveTime = 0.0;
+  window.deadTime = 0.0;
+  window.liveFraction = 0.0;
+  window.hitsT3MAPS = 0;
+  window.hitsFEI4 = 0;
+  window.hitsFEI4Live = 0;
+  window.rateFEI4 = 0.0;
+  window.hitsPerPeriodT3MAPS = 0.0;
+  window.hitsPerPeriodFEI4 = 0.0;
+}
+
+/**
+   Get the length of the overlap of two time intervals.
+   @param start1 - the start of the first interval.
+   @param stop1 - the end of the first interval.
+   @param start2 - the start of the second interval.
+   @param stop2 - the end of the second interval.
+   @returns - the overlap in seconds (0 if they do not overlap).
+*/
+double RateSeries::getOverlap(double start1, double stop1, double start2,
+			      double stop2) {
+  double start = start1 > start2 ? start1 : start2;
+  double stop = stop1 < stop2 ? stop1 : stop2;
+  return stop > start ? stop - start : 0.0;
+}
@@ -0,0 +1,94 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: RateSeries.h                                                        //
+//  Class: RateSeries.cxx                                                     //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef RateSeries_h
+#define RateSeries_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+
+#include "TString.h"
+#include "TTree.h"
+
+// The metrics of one time window, as stored in each entry of the tree:
+struct RateWindow {
+  double windowStart;// T3MAPS clock
+  double windowLength;// the part of the window inside the run
+  int nScans;// T3MAPS integration periods starting in the window
+  double liveTime;// T3MAPS integration time inside the window
+  double deadTime;// time between the integration periods
+  double liveFraction;
+  int hitsT3MAPS;
+  int hitsFEI4;
+  int hitsFEI4Live;// FEI4 hits inside an integration period
+  double rateFEI4;// FEI4 hits per second (the beam rate)
+  double hitsPerPeriodT3MAPS;
+  double hitsPerPeriodFEI4;// live FEI4 hits per integration period
+};
+
+class RateSeries {
+
+ public:
+
+  RateSeries(double newWindowLength, double newTimeOffset);
+  virtual ~RateSeries();
+
+  // Mutators (the scans and the events must each be given in time order):
+  void addScan(double timestamp_start, double timestamp_stop, int nHits);
+  void addEventFEI4(double timestamp_start, double timestamp_stop,
+		    int nHits);
+  void finish();
+
+  // Accessors:
+  TTree *getTree();
+  int getNWindows();
+  int getNScans();
+  double getElapsedTime();
+  double getLiveTime();
+  double getDeadTime();
+  double getLiveFraction();
+  double getRateFEI4();
+
+ private:
+
+  void advanceTo(double time);
+  void closeWindow();
+  void clearWindow();
+  double getOverlap(double start1, double stop1, double start2,
+		    double stop2);
+
+  // Settings:
+  double windowLength;
+  double timeOffset;
+
+  // The run so far:
+  bool started;
+  bool finished;
+  double runStart;
+  double runStop;// latest end of an integration period
+  double activeStart;// the latest integration period
+  double activeStop;
+
+  // The open window:
+  RateWindow window;
+
+  // Totals of the closed windows:
+  int nWindows;
+  int nScans;
+  double liveTime;
+  double deadTime;
+  Long64_t hitsFEI4;
+
+  // One entry per closed window:
+  TTree *tree;
+
+};
+
+#endif
@@ -0,0 +1,156 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: ResidualAligner.cxx                                                 //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class finds linear corrections to a map between the chips from the   //
+//  residuals of matched hit pairs. For a T3MAPS position (row, col) already  //
+//  mapped into FEI4 and the FEI4 residuals (u, v), it fits                   //
+//                                                                            //
+//        u = rowOffset + rowSlope * row - rotation * col                     //
+//        v = colOffset + colSlope * col + rotation * row                     //
+//                                                                            //
+//  by least squares. Each pair only adds to a few sums, so a pass over the   //
+//  pairs needs no storage, and solve() gives the corrections from the sums   //
+//  alone. The map is improved by repeating: apply the corrections, compute   //
+//  new residuals, reset() and add the pairs again.                           //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ResidualAligner.h"
+
+/**
+   Initialize the aligner with no pairs.
+*/
+ResidualAligner::ResidualAligner() {
+  reset();
+}
+
+/**
+   Add a matched pair to the sums.
+   @param row - the T3MAPS row position in FEI4 coordinates (mm).
+   @param col - the T3MAPS column position in FEI4 coordinates (mm).
+   @param rowResidual - the FEI4 row position minus the mapped row (mm).
+   @param colResidual - the FEI4 column position minus the mapped col (mm).
+*/
+void ResidualAligner::addPair(double row, double col, double rowResidual,
+			      double colResidual) {
+  n += 1.0;
+  sumRow += row;
+  sumCol += col;
+  sumRowRow += row * row;
+  sumColCol += col * col;
+  sumRowCol += row * col;
+  sumU += rowResidual;
+  sumV += colResidual;
+  sumURow += rowResidual * row;
+  sumUCol += rowResidual * col;
+  sumVRow += colResidual * row;
+  sumVCol += colResidual * col;
+  sumUU += rowResidual * rowResidual;
+  sumVV += colResidual * colResidual;
+}
+
+/**
+   Remove all pairs, before the next pass.
+*/
+void ResidualAligner::reset() {
+  n = 0.0;
+  sumRow = 0.0; sumCol = 0.0;
+  sumRowRow = 0.0; sumColCol = 0.0; sumRowCol = 0.0;
+  sumU = 0.0; sumV = 0.0;
+  sumURow = 0.0; sumUCol = 0.0; sumVRow = 0.0; sumVCol = 0.0;
+  sumUU = 0.0; sumVV = 0.0;
+}
+
+/**
+   Get the number of pairs added since the last reset().
+*/
+int ResidualAligner::getNPairs() {
+  return (int)n;
+}
+
+/**
+   Get the RMS of the column residuals (before the corrections).
+*/
+double ResidualAligner::getColRMS() {
+  return n > 0.0 ? sqrt(sumVV / n) : 0.0;
+}
+
+/**
+   Get the RMS of the row residuals (before the corrections).
+*/
+double ResidualAligner::getRowRMS() {
+  return n > 0.0 ? sqrt(sumUU / n) : 0.0;
+}
+
+/**
+   Solve the normal equations for the corrections. If the pairs do not
+   constrain the slopes and the rotation (e.g. they all come from one pixel),
+   only the offsets are corrected.
+   @param correction - the corrections (set).
+   @returns - false if there are no pairs.
+*/
+bool ResidualAligner::solve(AlignmentCorrection &correction) {
+  correction.rowOffset = 0.0;
+  correction.rowSlope = 0.0;
+  correction.colOffset = 0.0;
+  correction.colSlope = 0.0;
+  correction.rotation = 0.0;
+  if (n < 1.0) return false;
+
+  // The normal equations in (rowOffset, rowSlope, colOffset, colSlope,
+  // rotation), with the right-hand side in the last column:
+  double matrix[5][6] = {
+    {n, sumRow, 0.0, 0.0, -sumCol, sumU},
+    {sumRow, sumRowRow, 0.0, 0.0, -sumRowCol, sumURow},
+    {0.0, 0.0, n, sumCol, sumRow, sumV},
+    {0.0, 0.0, sumCol, sumColCol, sumRowCol, sumVCol},
+    {-sumCol, -sumRowCol, sumRow, sumRowCol, sumRowRow + sumColCol,
+     sumVRow - sumUCol}
+  };
+
+  // Gaussian elimination with partial pivoting:
+  bool singular = false;
+  for (int i_c = 0; i_c < 5 && !singular; i_c++) {
+    int pivot = i_c;
+    for (int i_r = i_c + 1; i_r < 5; i_r++) {
+      if (fabs(matrix[i_r][i_c]) > fabs(matrix[pivot][i_c])) pivot = i_r;
+    }
+    if (fabs(matrix[pivot][i_c]) < 1e-12 * n) {
+      singular = true;
+      break;
+    }
+    for (int i_k = 0; i_k < 6; i_k++) {
+      double temp = matrix[i_c][i_k];
+      matrix[i_c][i_k] = matrix[pivot][i_k];
+      matrix[pivot][i_k] = temp;
+    }
+    for (int i_r = i_c + 1; i_r < 5; i_r++) {
+      double factor = matrix[i_r][i_c] / matrix[i_c][i_c];
+      for (int i_k = i_c; i_k < 6; i_k++) {
+	matrix[i_r][i_k] -= factor * matrix[i_c][i_k];
+      }
+    }
+  }
+
+  if (singular) {
+    correction.rowOffset = sumU / n;
+    correction.colOffset = sumV / n;
+    return true;
+  }
+
+  double result[5];
+  for (int i_r = 4; i_r >= 0; i_r--) {
+    double sum = matrix[i_r][5];
+    for (int i_k = i_r + 1; i_k < 5; i_k++) sum -= matrix[i_r][i_k]*result[i_k];
+    result[i_r] = sum / matrix[i_r][i_r];
+  }
+  correction.rowOffset = result[0];
+  correction.rowSlope = result[1];
+  correction.colOffset = result[2];
+  correction.colSlope = result[3];
+  correction.rotation = result[4];
+  return true;
+}
@@ -0,0 +1,58 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: ResidualAligner.h                                                   //
+//  Class: ResidualAligner.cxx                                                //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ResidualAligner_h
+#define ResidualAligner_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <math.h>
+
+// The corrections found by one pass of the aligner:
+struct AlignmentCorrection {
+  double rowOffset;// mm
+  double rowSlope;// relative, e.g. 0.01 for a 1% larger scale
+  double colOffset;// mm
+  double colSlope;// relative
+  double rotation;// rad, small angle
+};
+
+class ResidualAligner {
+
+ public:
+
+  ResidualAligner();
+  virtual ~ResidualAligner() {};
+
+  // Mutators:
+  void addPair(double row, double col, double rowResidual,
+	       double colResidual);
+  void reset();
+
+  // Accessors:
+  int getNPairs();
+  double getColRMS();
+  double getRowRMS();
+  bool solve(AlignmentCorrection &correction);
+
+ private:
+
+  // The sums of the normal equations, with (row, col) the T3MAPS position
+  // and (u, v) the residuals in FEI4:
+  double n;
+  double sumRow, sumCol;
+  double sumRowRow, sumColCol, sumRowCol;
+  double sumU, sumV;
+  double sumURow, sumUCol, sumVRow, sumVCol;
+  double sumUU, sumVV;
+
+};
+
+#endif
@@ -0,0 +1,208 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: ResultCache.cxx                                                     //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class stores analysis results in a local directory so that a job     //
+//  with unchanged inputs and settings can load them instead of recomputing   //
+//  them. Each entry is a binary file named <entry>_<key>.bin, where the key  //
+//  is a CacheKey hash of the input files and of the parameters that the      //
+//  result depends on. Changing any of them gives a new key, so stale         //
+//  entries are never read. Old entries are not removed automatically; the    //
+//  directory can be deleted at any time.                                     //
+//                                                                            //
+//  Input files enter the key through their path, size and modification       //
+//  time rather than their contents, which would take as long to hash as      //
+//  to read.                                                                  //
+//                                                                            //
+//  Entries are written to a temporary file and renamed when complete, so     //
+//  an interrupted job never leaves a partial entry behind, and parallel      //
+//  jobs writing the same entry do not corrupt it.                            //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ResultCache.h"
+
+// Identifies cache files and the layout version of their contents:
+static const ULong64_t cacheMagic = 0x54424341434845ULL;// "TBCACHE"
+static const int cacheVersion = 4;// 4: match counts per pixel
+
+// Its address differs between threads, which keeps their temporary files apart:
+static __thread char threadMarker = 0;
+
+/**
+   Start a new hash.
+*/
+CacheKey::CacheKey() {
+  hash = 14695981039346656037ULL;// FNV-1a 64-bit offset basis
+}
+
+/**
+   Add raw bytes to the hash.
+   @param data - the bytes to add.
+   @param size - the number of bytes.
+*/
+void CacheKey::addBytes(const void *data, int size) {
+  const unsigned char *bytes = (const unsigned char*)data;
+  for (int i_b = 0; i_b < size; i_b++) {
+    hash ^= (ULong64_t)bytes[i_b];
+    hash *= 1099511628211ULL;// FNV-1a 64-bit prime
+  }
+}
+
+/**
+   Add a floating point parameter to the hash.
+   @param value - the parameter value.
+*/
+void CacheKey::addDouble(double value) {
+  addBytes(&value, sizeof(double));
+}
+
+/**
+   Add an input file to the hash, identified by its path, size and
+   modification time.
+   @param fileName - the name of the file.
+*/
+void CacheKey::addFile(TString fileName) {
+  addString(fileName);
+  struct stat fileStat;
+  if (stat(fileName.Data(), &fileStat) == 0) {
+    addInt((Long64_t)fileStat.st_size);
+    addInt((Long64_t)fileStat.st_mtime);
+  }
+  else {
+    addInt(-1);
+  }
+}
+
+/**
+   Add an integer parameter to the hash.
+   @param value - the parameter value.
+*/
+void CacheKey::addInt(Long64_t value) {
+  addBytes(&value, sizeof(Long64_t));
+}
+
+/**
+   Add a string to the hash. The length is included so that consecutive
+   strings cannot run into each other.
+   @param value - the string to add.
+*/
+void CacheKey::addString(TString value) {
+  addInt(value.Length());
+  addBytes(value.Data(), value.Length());
+}
+
+/**
+   Get the hash as a string of 16 hexadecimal digits.
+   @returns - the key.
+*/
+TString CacheKey::getKey() {
+  return Form("%016llx", (unsigned long long)hash);
+}
+
+/**
+   Initialize the cache. The directory is created when the first entry is
+   written.
+   @param newCacheDir - the cache directory.
+*/
+ResultCache::ResultCache(TString newCacheDir) {
+  cacheDir = newCacheDir;
+}
+
+/**
+   Get the name of the file for a cache entry.
+   @param entryName - the name of the entry, e.g. the stage name.
+   @param key - the entry key.
+   @returns - the file name.
+*/
+TString ResultCache::getFileName(TString entryName, TString key) {
+  return Form("%s/%s_%s.bin", cacheDir.Data(), entryName.Data(), key.Data());
+}
+
+/**
+   Get the name of the temporary file used while writing a cache entry. It is
+   unique to the process and thread, so that jobs writing the same entry at
+   the same time do not mix their contents.
+   @param entryName - the name of the entry, e.g. the stage name.
+   @param key - the entry key.
+   @returns - the file name.
+*/
+TString ResultCache::getTempName(TString entryName, TString key) {
+  return Form("%s.%d.%lx.tmp", getFileName(entryName, key).Data(),
+	      (int)getpid(), (unsigned long)&threadMarker);
+}
+
+/**
+   Get the key of a single input file.
+   @param fileName - the name of the file.
+   @returns - the key.
+*/
+TString ResultCache::fileKey(TString fileName) {
+  CacheKey key;
+  key.addFile(fileName);
+  return key.getKey();
+}
+
+/**
+   Open a cache entry for reading.
+   @param entryName - the name of the entry, e.g. the stage name.
+   @param key - the entry key.
+   @param input - the stream to open.
+   @returns - true iff the entry exists and has the current layout.
+*/
+bool ResultCache::openInput(TString entryName, TString key,
+			    std::ifstream &input) {
+  input.open(getFileName(entryName, key).Data(), std::ios::binary);
+  if (!input.is_open()) return false;
+  ULong64_t magic = 0;
+  int version = 0;
+  if (!readValue(input, magic) || !readValue(input, version) ||
+      magic != cacheMagic || version != cacheVersion) {
+    input.close();
+    return false;
+  }
+  return true;
+}
+
+/**
+   Open a new cache entry for writing. closeOutput() must be called to
+   complete it.
+   @param entryName - the name of the entry, e.g. the stage name.
+   @param key - the entry key.
+   @param output - the stream to open.
+   @returns - true iff the temporary file could be created.
+*/
+bool ResultCache::openOutput(TString entryName, TString key,
+			     std::ofstream &output) {
+  gSystem->mkdir(cacheDir, kTRUE);
+  TString tempName = getTempName(entryName, key);
+  output.open(tempName.Data(), std::ios::binary | std::ios::trunc);
+  if (!output.is_open()) {
+    std::cout << "ResultCache: Could not write " << tempName << std::endl;
+    return false;
+  }
+  writeValue(output, cacheMagic);
+  writeValue(output, cacheVersion);
+  return true;
+}
+
+/**
+   Complete or discard a cache entry opened with openOutput().
+   @param entryName - the name of the entry, e.g. the stage name.
+   @param key - the entry key.
+   @param output - the stream opened by openOutput().
+   @param keep - false to discard the entry.
+   @returns - true iff the entry was stored.
+*/
+bool ResultCache::closeOutput(TString entryName, TString key,
+			      std::ofstream &output, bool keep) {
+  TString fileName = getFileName(entryName, key);
+  TString tempName = getTempName(entryName, key);
+  keep = keep && output.good();
+  output.close();
+  if (keep && rename(tempName.Data(), fileName.Data()) == 0) return true;
+  remove(tempName.Data());
+  return false;
+}
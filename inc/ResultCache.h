@@ -0,0 +1,100 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: ResultCache.h                                                       //
+//  Class: ResultCache.cxx                                                    //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ResultCache_h
+#define ResultCache_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "TString.h"
+#include "TSystem.h"
+
+// Builds a 64-bit FNV-1a hash of everything that determines a result:
+class CacheKey {
+
+ public:
+
+  CacheKey();
+  virtual ~CacheKey() {};
+
+  // Mutators:
+  void addBytes(const void *data, int size);
+  void addDouble(double value);
+  void addFile(TString fileName);
+  void addInt(Long64_t value);
+  void addString(TString value);
+
+  // Accessors:
+  TString getKey();
+
+ private:
+
+  ULong64_t hash;
+
+};
+
+class ResultCache {
+
+ public:
+
+  ResultCache(TString newCacheDir);
+  virtual ~ResultCache() {};
+
+  // Accessors:
+  TString getFileName(TString entryName, TString key);
+  TString getTempName(TString entryName, TString key);
+  static TString fileKey(TString fileName);
+
+  // Cache entries:
+  bool openInput(TString entryName, TString key, std::ifstream &input);
+  bool openOutput(TString entryName, TString key, std::ofstream &output);
+  bool closeOutput(TString entryName, TString key, std::ofstream &output,
+		   bool keep);
+
+  // Binary helpers for the cache entries:
+  template <class T> static void writeValue(std::ostream &output,
+					    const T &value) {
+    output.write((const char*)&value, sizeof(T));
+  };
+
+  template <class T> static bool readValue(std::istream &input, T &value) {
+    input.read((char*)&value, sizeof(T));
+    return input.good();
+  };
+
+  template <class T> static void writeVector(std::ostream &output,
+					     const std::vector<T> &values) {
+    Long64_t size = (Long64_t)values.size();
+    writeValue(output, size);
+    if (size > 0) output.write((const char*)&values[0], size * sizeof(T));
+  };
+
+  template <class T> static bool readVector(std::istream &input,
+					    std::vector<T> &values) {
+    Long64_t size = 0;
+    if (!readValue(input, size) || size < 0) return false;
+    values.resize(size);
+    if (size > 0) input.read((char*)&values[0], size * sizeof(T));
+    return input.good();
+  };
+
+ private:
+
+  TString cacheDir;
+
+};
+
+#endif
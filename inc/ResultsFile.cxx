@@ -0,0 +1,212 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: ResultsFile.cxx                                                     //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class stores the results of a program in a single ROOT file, so      //
+//  that later steps can load them with one open and no text parsing.         //
+//  Scalars are stored as TParameter<double>, pixel masks as a TVectorD of    //
+//  (row, column) pairs, and graphs, histograms and maps as themselves.       //
+//                                                                            //
+//  The entries are kept in a directory named after the layout version (e.g.  //
+//  "v1/effT3MAPS_t0.50"), and the file records the version it was written    //
+//  with. A reader can then keep loading old files when the layout changes,   //
+//  and refuses files written by a newer version of the code.                 //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ResultsFile.h"
+
+const int ResultsFile::currentVersion;
+
+/**
+   Open a results file.
+   @param newFileName - the name of the ROOT file.
+   @param newMode - "RECREATE" to start a new file, "UPDATE" to add to an
+   existing one or "READ" to load the results.
+*/
+ResultsFile::ResultsFile(TString newFileName, TString newMode) {
+  fileName = newFileName;
+  newMode.ToUpper();
+  writable = (newMode != "READ");
+
+  // The histograms read later must not be attached to the current file:
+  TDirectory *previous = gDirectory;
+  file = new TFile(fileName, newMode);
+  if (!file->IsOpen() || file->IsZombie()) {
+    std::cout << "ResultsFile: Could not open " << fileName << std::endl;
+    exit(0);
+  }
+
+  // New files get the current layout:
+  version = currentVersion;
+  if (file->GetKey("version")) {
+    TParameter<int> *stored = (TParameter<int>*)file->Get("version");
+    version = stored->GetVal();
+    delete stored;
+  }
+  else if (writable) {
+    TParameter<int> stored("version", currentVersion);
+    file->WriteTObject(&stored, "version");
+  }
+  if (version > currentVersion) {
+    std::cout << "ResultsFile: " << fileName << " has version " << version
+	      << ", newer than this code (" << currentVersion << ")."
+	      << std::endl;
+    exit(0);
+  }
+  if (writable && version != currentVersion) {
+    std::cout << "ResultsFile: Cannot add version " << currentVersion
+	      << " results to " << fileName << " (version " << version << ")."
+	      << std::endl;
+    exit(0);
+  }
+
+  TString directoryName = Form("v%d", version);
+  directory = file->GetDirectory(directoryName);
+  if (!directory && writable) directory = file->mkdir(directoryName);
+  if (!directory) {
+    std::cout << "ResultsFile: No results in " << fileName << std::endl;
+    exit(0);
+  }
+  if (previous) previous->cd();
+}
+
+/**
+   Close the file.
+*/
+ResultsFile::~ResultsFile() {
+  close();
+}
+
+/**
+   Write the entries to disk and close the file. Called by the destructor.
+*/
+void ResultsFile::close() {
+  if (!file) return;
+  file->Close();
+  delete file;
+  file = NULL;
+  directory = NULL;
+}
+
+/**
+   Store a list of pixels.
+   @param key - the name of the entry.
+   @param mask - the (row, column) pairs.
+*/
+void ResultsFile::writeMask(TString key,
+			    std::vector<std::pair<int,int> > mask) {
+  TVectorD pixels(2 * (int)mask.size());
+  for (int i_p = 0; i_p < (int)mask.size(); i_p++) {
+    pixels[2*i_p] = mask[i_p].first;
+    pixels[2*i_p+1] = mask[i_p].second;
+  }
+  writeObject(key, &pixels);
+}
+
+/**
+   Store an object, replacing any earlier entry with the same key.
+   @param key - the name of the entry.
+   @param object - the graph, histogram or other object to store.
+*/
+void ResultsFile::writeObject(TString key, TObject *object) {
+  if (!writable || !directory) {
+    std::cout << "ResultsFile: " << fileName << " is not open for writing."
+	      << std::endl;
+    exit(0);
+  }
+  directory->WriteTObject(object, key, "Overwrite");
+}
+
+/**
+   Store a number.
+   @param key - the name of the entry.
+   @param value - the value.
+*/
+void ResultsFile::writeValue(TString key, double value) {
+  TParameter<double> parameter(key, value);
+  writeObject(key, &parameter);
+}
+
+/**
+   Load a list of pixels stored with writeMask().
+   @param key - the name of the entry.
+   @returns - the (row, column) pairs.
+*/
+std::vector<std::pair<int,int> > ResultsFile::getMask(TString key) {
+  TVectorD *pixels = get<TVectorD>(key);
+  std::vector<std::pair<int,int> > mask; mask.clear();
+  for (int i_p = 0; i_p+1 < pixels->GetNrows(); i_p += 2) {
+    mask.push_back(std::make_pair((int)(*pixels)[i_p],
+				  (int)(*pixels)[i_p+1]));
+  }
+  delete pixels;
+  return mask;
+}
+
+/**
+   Load an object. Histograms are detached from the file, so the object
+   stays valid after the file is closed.
+   @param key - the name of the entry.
+   @returns - the object (owned by the caller).
+*/
+TObject *ResultsFile::getObject(TString key) {
+  TObject *object = readEntry(key);
+  if (object->InheritsFrom("TH1")) ((TH1*)object)->SetDirectory(0);
+  return object;
+}
+
+/**
+   Load a number stored with writeValue().
+   @param key - the name of the entry.
+   @returns - the value.
+*/
+double ResultsFile::getValue(TString key) {
+  TParameter<double> *parameter = get<TParameter<double> >(key);
+  double value = parameter->GetVal();
+  delete parameter;
+  return value;
+}
+
+/**
+   Get the layout version of the file.
+*/
+int ResultsFile::getVersion() {
+  return version;
+}
+
+/**
+   Check whether the file has an entry.
+   @param key - the name of the entry.
+*/
+bool ResultsFile::hasKey(TString key) {
+  return (directory && directory->GetKey(key));
+}
+
+/**
+   Build the key of a result that depends on the time offset, in the same
+   format as the old text file names.
+   @param name - the name of the result.
+   @param timeOffset - the FEI4 - T3MAPS time offset in seconds.
+   @returns - e.g. "effT3MAPS_t0.50".
+*/
+TString ResultsFile::offsetKey(TString name, double timeOffset) {
+  return Form("%s_t%2.2f", name.Data(), timeOffset);
+}
+
+/**
+   Read an entry of the file, or exit if it does not exist.
+   @param key - the name of the entry.
+   @returns - the object read.
+*/
+TObject *ResultsFile::readEntry(TString key) {
+  TObject *object = hasKey(key) ? directory->Get(key) : NULL;
+  if (!object) {
+    std::cout << "ResultsFile: No entry " << key << " in " << fileName
+	      << std::endl;
+    exit(0);
+  }
+  return object;
+}
@@ -0,0 +1,74 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: ResultsFile.h                                                       //
+//  Class: ResultsFile.cxx                                                    //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ResultsFile_h
+#define ResultsFile_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <vector>
+
+#include "TDirectory.h"
+#include "TFile.h"
+#include "TH1.h"
+#include "TKey.h"
+#include "TParameter.h"
+#include "TString.h"
+#include "TVectorD.h"
+
+class ResultsFile {
+
+ public:
+
+  ResultsFile(TString newFileName, TString newMode);
+  virtual ~ResultsFile();
+
+  // Mutators:
+  void close();
+  void writeMask(TString key, std::vector<std::pair<int,int> > mask);
+  void writeObject(TString key, TObject *object);
+  void writeValue(TString key, double value);
+
+  // Accessors:
+  std::vector<std::pair<int,int> > getMask(TString key);
+  TObject *getObject(TString key);
+  double getValue(TString key);
+  int getVersion();
+  bool hasKey(TString key);
+  static TString offsetKey(TString name, double timeOffset);
+
+  // Read an object of a known type (owned by the caller):
+  template <class T> T *get(TString key) {
+    TObject *object = getObject(key);
+    T *result = dynamic_cast<T*>(object);
+    if (!result) {
+      std::cout << "ResultsFile: " << key << " in " << fileName
+		<< " has the wrong type." << std::endl;
+      exit(0);
+    }
+    return result;
+  };
+
+  // The layout written by this version of the code:
+  static const int currentVersion = 1;
+
+ private:
+
+  TObject *readEntry(TString key);
+
+  TString fileName;
+  TFile *file;
+  TDirectory *directory;
+  int version;
+  bool writable;
+
+};
+
+#endif
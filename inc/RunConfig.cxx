@@ -0,0 +1,293 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: RunConfig.cxx                                                       //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class stores the settings of one test beam run: the input files,     //
+//  the noise thresholds for masking, the T3MAPS integration time and         //
+//  quality cuts, the clock frequency for the Fourier analysis and the        //
+//  measured time offset. The built-in runs "RunI" (May 3) and "RunII"        //
+//  (May 9) have their settings defined here; any other run is described      //
+//  in a configuration file (see config/runs.cfg):                            //
+//                                                                            //
+//    # comment                                                               //
+//    [RunName]                                                               //
+//    inputT3MAPS = ../TestBeamData/.../T3MAPS.root                           //
+//    noiseThresholdFEI4 = 300                                                //
+//                                                                            //
+//  Each [RunName] section starts from the default settings for that name     //
+//  (see the constructor), so only the values that differ need to be given.   //
+//  Unknown keys are an error, so that a misspelled setting is not silently   //
+//  ignored.                                                                  //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "RunConfig.h"
+
+/**
+   Trim the spaces, tabs and line endings from both ends of a string.
+   @param text - the string to trim.
+   @returns - the trimmed string.
+*/
+static std::string trimString(std::string text) {
+  size_t first = text.find_first_not_of(" \t\r\n");
+  if (first == std::string::npos) return "";
+  size_t last = text.find_last_not_of(" \t\r\n");
+  return text.substr(first, last - first + 1);
+}
+
+/**
+   Initialize a run with the default settings. "RunII" gets the May 9
+   settings, and every other run gets the May 3 ("RunI") settings.
+   @param newRunName - the name of the run.
+*/
+RunConfig::RunConfig(TString newRunName) {
+  runName = newRunName;
+  values.clear();
+  values["inputT3MAPS"]
+    = "../TestBeamData/TestBeamData_May3/T3MAPS_May3_RunI.root";
+  values["inputFEI4"] = "../TestBeamData/TestBeamData_May3/FEI4_May3_RunI.root";
+  values["noiseThresholdFEI4"] = "600";// masked if >= this many hits
+  values["noiseThresholdT3MAPS"] = "20";// masked if > this many hits
+  values["integrationTime"] = "1.0";// seconds
+  values["frequency"] = "2.6";// Hz, for the Fourier analysis
+  values["timeOffset"] = "0.67";// seconds
+  values["maxHitsT3MAPS"] = "12";// scans with at least this many are cut
+  values["rowMinT3MAPS"] = "1";// good T3MAPS rows, inclusive
+  values["rowMaxT3MAPS"] = "16";
+  values["rateBinWidth"] = "5";// FEI4 hits per scan window in each rate bin
+  values["sweepMinFEI4"] = "50";// noise thresholds swept by NoiseScan
+  values["sweepMaxFEI4"] = "3000";
+  values["sweepMinT3MAPS"] = "2";
+  values["sweepMaxT3MAPS"] = "100";
+  values["sweepSteps"] = "50";
+  values["rateWindow"] = "10.0";// seconds per window of the rate series
+  values["displayWindowStart"] = "1430686886";// FEI4 hits shown by Overview
+  values["displayWindowLength"] = "1.0";
+
+  // Synthetic data (see BeamGenerator), times in seconds, positions in mm:
+  values["simSeed"] = "1";
+  values["simScans"] = "1000";
+  values["simStartTime"] = "1430611200";// 3 May 2015
+  values["simScanGap"] = "1.0";// between T3MAPS integration periods
+  values["simReadoutFEI4"] = "0.01";// FEI4 timestamp granularity
+  values["simBeamRate"] = "20";// particles per second
+  values["simBeamRow"] = "-1";// beam center in FEI4, < 0 for T3MAPS center
+  values["simBeamCol"] = "-1";
+  values["simBeamSigmaRow"] = "2.0";
+  values["simBeamSigmaCol"] = "2.0";
+  values["simEffFEI4"] = "0.98";
+  values["simEffT3MAPS"] = "0.90";
+  values["simNoisyFEI4"] = "20";// number of noisy pixels
+  values["simNoiseProbFEI4"] = "0.05";// hit probability per trigger
+  values["simNoisyT3MAPS"] = "3";
+  values["simNoiseProbT3MAPS"] = "0.5";// hit probability per scan
+  values["simOrientation"] = "1";// as in MapParameters
+  values["simRowOffset"] = "8.0";// FEI4 position of T3MAPS row 0
+  values["simColOffset"] = "10.0";
+  if (runName.EqualTo("RunII")) {
+    values["inputT3MAPS"]
+      = "../TestBeamData/TestBeamData_May9/T3MAPS_May9_RunI.root";
+    values["inputFEI4"]
+      = "../TestBeamData/TestBeamData_May9/FEI4_May9_RunI.root";
+    values["noiseThresholdFEI4"] = "300";
+    values["noiseThresholdT3MAPS"] = "15";
+    values["integrationTime"] = "0.5";
+    values["frequency"] = "2.0";
+  }
+}
+
+/**
+   Read all of the runs in a configuration file, in the order they appear.
+   @param fileName - the name of the configuration file.
+   @returns - the runs (owned by the caller).
+*/
+std::vector<RunConfig*> RunConfig::loadRuns(TString fileName) {
+  std::vector<RunConfig*> runs; runs.clear();
+  std::ifstream configFile(fileName);
+  if (!configFile.is_open()) {
+    std::cout << "RunConfig: Could not open " << fileName << std::endl;
+    exit(0);
+  }
+
+  RunConfig *currRun = NULL;
+  std::string line;
+  int lineNumber = 0;
+  while (std::getline(configFile, line)) {
+    lineNumber++;
+    size_t comment = line.find_first_of("#;");
+    if (comment != std::string::npos) line = line.substr(0, comment);
+    line = trimString(line);
+    if (line.empty()) continue;
+
+    // A new run section:
+    if (line[0] == '[' && line[line.size()-1] == ']') {
+      std::string name = trimString(line.substr(1, line.size()-2));
+      for (int i_r = 0; i_r < (int)runs.size(); i_r++) {
+	if (runs[i_r]->getRunName().EqualTo(name.c_str())) {
+	  std::cout << "RunConfig: Run " << name << " defined twice in "
+		    << fileName << std::endl;
+	  exit(0);
+	}
+      }
+      currRun = new RunConfig(name.c_str());
+      runs.push_back(currRun);
+      continue;
+    }
+
+    // A setting of the current run:
+    size_t equals = line.find('=');
+    if (equals == std::string::npos || !currRun) {
+      std::cout << "RunConfig: Bad line " << lineNumber << " in " << fileName
+		<< ": " << line << std::endl;
+      exit(0);
+    }
+    currRun->setValue(trimString(line.substr(0, equals)).c_str(),
+		      trimString(line.substr(equals+1)).c_str());
+  }
+  configFile.close();
+
+  if (runs.empty()) {
+    std::cout << "RunConfig: No runs in " << fileName << std::endl;
+    exit(0);
+  }
+  return runs;
+}
+
+/**
+   Get the runs for a job: every run in the configuration file if one is
+   given, otherwise the built-in "RunI" or "RunII" selected by the options.
+   @param options - the job options.
+   @param fileName - the configuration file name ("" for none).
+   @returns - the runs (owned by the caller).
+*/
+std::vector<RunConfig*> RunConfig::getRuns(TString options, TString fileName) {
+  if (!fileName.IsNull()) return loadRuns(fileName);
+  std::vector<RunConfig*> runs; runs.clear();
+  runs.push_back(new RunConfig(options.Contains("RunII") ? "RunII" : "RunI"));
+  return runs;
+}
+
+/**
+   Get the run for a single-run job: the named run from the configuration
+   file if one is given, otherwise the built-in "RunI" or "RunII" selected by
+   the options. The run name may be omitted if the file has only one run.
+   @param options - the job options.
+   @param fileName - the configuration file name ("" for none).
+   @param runName - the name of the run in the file ("" for the only run).
+   @returns - the run (owned by the caller).
+*/
+RunConfig *RunConfig::getRun(TString options, TString fileName,
+			     TString runName) {
+  std::vector<RunConfig*> runs = getRuns(options, fileName);
+  if (runName.IsNull() && runs.size() > 1) {
+    std::cout << "RunConfig: Choose one of the runs in " << fileName << ":";
+    for (int i_r = 0; i_r < (int)runs.size(); i_r++) {
+      std::cout << " " << runs[i_r]->getRunName();
+    }
+    std::cout << std::endl;
+    exit(0);
+  }
+  RunConfig *selected = NULL;
+  for (int i_r = 0; i_r < (int)runs.size(); i_r++) {
+    if (!selected &&
+	(runName.IsNull() || runs[i_r]->getRunName().EqualTo(runName))) {
+      selected = runs[i_r];
+    }
+    else delete runs[i_r];
+  }
+  if (!selected) {
+    std::cout << "RunConfig: No run " << runName << " in " << fileName
+	      << std::endl;
+    exit(0);
+  }
+  return selected;
+}
+
+/**
+   Change one of the settings.
+   @param key - the name of the setting.
+   @param value - the new value.
+*/
+void RunConfig::setValue(TString key, TString value) {
+  if (!hasKey(key)) {
+    std::cout << "RunConfig: Unknown setting " << key << " for run "
+	      << runName << std::endl;
+    exit(0);
+  }
+  values[(std::string)key] = (std::string)value;
+}
+
+/**
+   Get the name of the run.
+*/
+TString RunConfig::getRunName() {
+  return runName;
+}
+
+/**
+   Get a setting as text.
+   @param key - the name of the setting.
+   @returns - the value.
+*/
+TString RunConfig::getString(TString key) {
+  if (!hasKey(key)) {
+    std::cout << "RunConfig: Unknown setting " << key << std::endl;
+    exit(0);
+  }
+  return values[(std::string)key].c_str();
+}
+
+/**
+   Get an integer setting.
+   @param key - the name of the setting.
+   @returns - the value.
+*/
+int RunConfig::getInt(TString key) {
+  TString value = getString(key);
+  char *end = NULL;
+  long result = strtol(value.Data(), &end, 10);
+  if (value.IsNull() || *end != '\0') {
+    std::cout << "RunConfig: Setting " << key << " = " << value
+	      << " is not an integer." << std::endl;
+    exit(0);
+  }
+  return (int)result;
+}
+
+/**
+   Get a floating point setting.
+   @param key - the name of the setting.
+   @returns - the value.
+*/
+double RunConfig::getDouble(TString key) {
+  TString value = getString(key);
+  char *end = NULL;
+  double result = strtod(value.Data(), &end);
+  if (value.IsNull() || *end != '\0') {
+    std::cout << "RunConfig: Setting " << key << " = " << value
+	      << " is not a number." << std::endl;
+    exit(0);
+  }
+  return result;
+}
+
+/**
+   Check whether a setting exists.
+   @param key - the name of the setting.
+*/
+bool RunConfig::hasKey(TString key) {
+  return (values.count((std::string)key) > 0);
+}
+
+/**
+   Print all of the settings of the run.
+*/
+void RunConfig::printConfig() {
+  std::cout << "RunConfig: Settings for run " << runName << std::endl;
+  for (std::map<std::string,std::string>::iterator it = values.begin();
+       it != values.end(); it++) {
+    std::cout << "\t" << it->first << " = " << it->second << std::endl;
+  }
+}
@@ -0,0 +1,54 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: RunConfig.h                                                         //
+//  Class: RunConfig.cxx                                                      //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef RunConfig_h
+#define RunConfig_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+
+#include "TString.h"
+
+class RunConfig {
+
+ public:
+
+  RunConfig(TString newRunName);
+  virtual ~RunConfig() {};
+
+  // Reading configurations:
+  static std::vector<RunConfig*> loadRuns(TString fileName);
+  static std::vector<RunConfig*> getRuns(TString options, TString fileName);
+  static RunConfig *getRun(TString options, TString fileName,
+			   TString runName);
+
+  // Mutators:
+  void setValue(TString key, TString value);
+
+  // Accessors:
+  TString getRunName();
+  TString getString(TString key);
+  int getInt(TString key);
+  double getDouble(TString key);
+  bool hasKey(TString key);
+  void printConfig();
+
+ private:
+
+  TString runName;
+  std::map<std::string,std::string> values;
+
+};
+
+#endif
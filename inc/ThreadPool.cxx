@@ -0,0 +1,297 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: ThreadPool.cxx                                                      //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class runs PoolTasks on a fixed number of worker threads. Each       //
+//  worker has its own queue of tasks. A task submitted from inside another   //
+//  task goes to the queue of the worker running it, and the worker takes     //
+//  its newest task first, so that the data of the task that spawned it is    //
+//  still in memory. A worker with an empty queue steals the oldest task of   //
+//  another worker, which is usually the largest piece of remaining work.     //
+//  Tasks submitted from outside the pool are spread over the workers.        //
+//                                                                            //
+//  MemoryBudget is a counting semaphore used by the submitting thread to     //
+//  cap the memory held by the tasks in flight. It lives here because it is   //
+//  only meaningful together with the pool.                                   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "ThreadPool.h"
+
+#include "Instrument.h"
+
+#include <unistd.h>
+
+// The index of the worker running on the current thread (-1 outside):
+static __thread int currentWorker = -1;
+
+/**
+   Initialize the budget.
+   @param newCapacity - the total amount that can be held at once.
+*/
+MemoryBudget::MemoryBudget(Long64_t newCapacity) {
+  capacity = newCapacity > 0 ? newCapacity : 1;
+  inUse = 0;
+  pthread_mutex_init(&mutex, NULL);
+  pthread_cond_init(&released, NULL);
+}
+
+/**
+   Destroy the budget.
+*/
+MemoryBudget::~MemoryBudget() {
+  pthread_cond_destroy(&released);
+  pthread_mutex_destroy(&mutex);
+}
+
+/**
+   Wait until the amount is available, then hold it. A request larger than
+   the capacity is reduced to the capacity, so that it runs alone instead of
+   waiting forever.
+   @param amount - the amount to hold.
+   @returns - the amount actually held, to be given back with release().
+*/
+Long64_t MemoryBudget::acquire(Long64_t amount) {
+  if (amount > capacity) amount = capacity;
+  if (amount < 0) amount = 0;
+  pthread_mutex_lock(&mutex);
+  while (inUse + amount > capacity) pthread_cond_wait(&released, &mutex);
+  inUse += amount;
+  pthread_mutex_unlock(&mutex);
+  return amount;
+}
+
+/**
+   Give back an amount held with acquire().
+   @param amount - the amount returned by acquire().
+*/
+void MemoryBudget::release(Long64_t amount) {
+  pthread_mutex_lock(&mutex);
+  inUse -= amount;
+  pthread_cond_broadcast(&released);
+  pthread_mutex_unlock(&mutex);
+}
+
+/**
+   Get the total amount that can be held at once.
+*/
+Long64_t MemoryBudget::getCapacity() {
+  return capacity;
+}
+
+/**
+   Get the amount currently held.
+*/
+Long64_t MemoryBudget::getInUse() {
+  pthread_mutex_lock(&mutex);
+  Long64_t result = inUse;
+  pthread_mutex_unlock(&mutex);
+  return result;
+}
+
+/**
+   Start the worker threads.
+   @param newNThreads - the number of workers (<= 0 for one per core).
+*/
+ThreadPool::ThreadPool(int newNThreads) {
+  nThreads = newNThreads > 0 ? newNThreads : getDefaultNThreads();
+  pthread_mutex_init(&stateMutex, NULL);
+  pthread_cond_init(&workAvailable, NULL);
+  pthread_cond_init(&allDone, NULL);
+  nQueued = 0;
+  nPending = 0;
+  nextQueue = 0;
+  stopping = false;
+
+  queues.clear();
+  for (int i_w = 0; i_w < nThreads; i_w++) {
+    WorkerQueue *queue = new WorkerQueue();
+    pthread_mutex_init(&queue->mutex, NULL);
+    queue->nRun = 0;
+    queue->nStolen = 0;
+    queues.push_back(queue);
+  }
+
+  // The arguments must not move once the threads have started:
+  workerArgs.resize(nThreads);
+  threads.resize(nThreads);
+  for (int i_w = 0; i_w < nThreads; i_w++) {
+    workerArgs[i_w].pool = this;
+    workerArgs[i_w].worker = i_w;
+    if (pthread_create(&threads[i_w], NULL, workerMain, &workerArgs[i_w])) {
+      std::cout << "ThreadPool: Could not start worker " << i_w << std::endl;
+      exit(0);
+    }
+  }
+}
+
+/**
+   Finish all submitted tasks, then stop the worker threads.
+*/
+ThreadPool::~ThreadPool() {
+  wait();
+  pthread_mutex_lock(&stateMutex);
+  stopping = true;
+  pthread_cond_broadcast(&workAvailable);
+  pthread_mutex_unlock(&stateMutex);
+  for (int i_w = 0; i_w < nThreads; i_w++) pthread_join(threads[i_w], NULL);
+
+  for (int i_w = 0; i_w < nThreads; i_w++) {
+    pthread_mutex_destroy(&queues[i_w]->mutex);
+    delete queues[i_w];
+  }
+  pthread_cond_destroy(&allDone);
+  pthread_cond_destroy(&workAvailable);
+  pthread_mutex_destroy(&stateMutex);
+}
+
+/**
+   Queue a task. The pool takes ownership of it.
+   @param task - the task to run.
+*/
+void ThreadPool::submit(PoolTask *task) {
+  int worker = currentWorker;
+  if (worker < 0 || worker >= nThreads) {
+    pthread_mutex_lock(&stateMutex);
+    worker = nextQueue;
+    nextQueue = (nextQueue + 1) % nThreads;
+    pthread_mutex_unlock(&stateMutex);
+  }
+  WorkerQueue *queue = queues[worker];
+  pthread_mutex_lock(&queue->mutex);
+  queue->tasks.push_back(task);
+  pthread_mutex_unlock(&queue->mutex);
+
+  pthread_mutex_lock(&stateMutex);
+  nQueued++;
+  nPending++;
+  pthread_cond_signal(&workAvailable);
+  pthread_mutex_unlock(&stateMutex);
+}
+
+/**
+   Wait until every submitted task (including the tasks they submit) has
+   finished. Must not be called from inside a task.
+*/
+void ThreadPool::wait() {
+  pthread_mutex_lock(&stateMutex);
+  while (nPending > 0) pthread_cond_wait(&allDone, &stateMutex);
+  pthread_mutex_unlock(&stateMutex);
+}
+
+/**
+   Get the number of worker threads.
+*/
+int ThreadPool::getNThreads() {
+  return nThreads;
+}
+
+/**
+   Get the index of the worker running the calling thread.
+   @returns - the worker index, or -1 outside of the pool.
+*/
+int ThreadPool::getCurrentWorker() {
+  return currentWorker;
+}
+
+/**
+   Get the number of processors available.
+*/
+int ThreadPool::getDefaultNThreads() {
+  long nCores = sysconf(_SC_NPROCESSORS_ONLN);
+  return nCores > 0 ? (int)nCores : 1;
+}
+
+/**
+   Print the number of tasks run and stolen by each worker.
+*/
+void ThreadPool::printStatistics() {
+  std::cout << "ThreadPool: " << nThreads << " workers" << std::endl;
+  for (int i_w = 0; i_w < nThreads; i_w++) {
+    pthread_mutex_lock(&queues[i_w]->mutex);
+    std::cout << "\tworker " << i_w << ": ran " << queues[i_w]->nRun
+	      << " tasks, " << queues[i_w]->nStolen << " stolen" << std::endl;
+    pthread_mutex_unlock(&queues[i_w]->mutex);
+  }
+}
+
+/**
+   The entry point of the worker threads.
+   @param arg - the WorkerArgs of the worker.
+*/
+void *ThreadPool::workerMain(void *arg) {
+  WorkerArgs *args = (WorkerArgs*)arg;
+  currentWorker = args->worker;
+  Instrument::setThreadName(Form("worker %d", args->worker));
+  args->pool->workerLoop(args->worker);
+  return NULL;
+}
+
+/**
+   Run tasks until the pool is stopped.
+   @param worker - the index of the worker.
+*/
+void ThreadPool::workerLoop(int worker) {
+  while (true) {
+    // Claim one of the queued tasks, or sleep until there is one:
+    pthread_mutex_lock(&stateMutex);
+    while (nQueued == 0 && !stopping) {
+      pthread_cond_wait(&workAvailable, &stateMutex);
+    }
+    if (nQueued == 0) {
+      pthread_mutex_unlock(&stateMutex);
+      return;
+    }
+    nQueued--;
+    pthread_mutex_unlock(&stateMutex);
+
+    // The claimed task is in one of the queues:
+    PoolTask *task = NULL;
+    while (!task) task = takeTask(worker);
+    task->run(this);
+    delete task;
+
+    pthread_mutex_lock(&stateMutex);
+    nPending--;
+    if (nPending == 0) pthread_cond_broadcast(&allDone);
+    pthread_mutex_unlock(&stateMutex);
+  }
+}
+
+/**
+   Take the newest task of the worker's own queue, or else the oldest task
+   of another worker.
+   @param worker - the index of the worker.
+   @returns - the task, or NULL if all of the queues are empty.
+*/
+PoolTask *ThreadPool::takeTask(int worker) {
+  PoolTask *task = NULL;
+  WorkerQueue *own = queues[worker];
+  pthread_mutex_lock(&own->mutex);
+  if (!own->tasks.empty()) {
+    task = own->tasks.back();
+    own->tasks.pop_back();
+    own->nRun++;
+  }
+  pthread_mutex_unlock(&own->mutex);
+  if (task) return task;
+
+  for (int i_o = 1; i_o < nThreads && !task; i_o++) {
+    WorkerQueue *victim = queues[(worker + i_o) % nThreads];
+    pthread_mutex_lock(&victim->mutex);
+    if (!victim->tasks.empty()) {
+      task = victim->tasks.front();
+      victim->tasks.pop_front();
+    }
+    pthread_mutex_unlock(&victim->mutex);
+  }
+  if (task) {
+    pthread_mutex_lock(&own->mutex);
+    own->nRun++;
+    own->nStolen++;
+    pthread_mutex_unlock(&own->mutex);
+  }
+  return task;
+}
@@ -0,0 +1,110 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: ThreadPool.h                                                        //
+//  Class: ThreadPool.cxx                                                     //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef ThreadPool_h
+#define ThreadPool_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <deque>
+#include <vector>
+
+#include <pthread.h>
+
+#include "TString.h"
+
+class ThreadPool;
+
+// A unit of work for the pool. The pool deletes each task after it runs:
+class PoolTask {
+ public:
+  virtual ~PoolTask() {};
+  virtual void run(ThreadPool *pool) = 0;
+};
+
+// Counting semaphore for the memory (in MB) held by the tasks in flight:
+class MemoryBudget {
+
+ public:
+
+  MemoryBudget(Long64_t newCapacity);
+  virtual ~MemoryBudget();
+
+  // Mutators:
+  Long64_t acquire(Long64_t amount);
+  void release(Long64_t amount);
+
+  // Accessors:
+  Long64_t getCapacity();
+  Long64_t getInUse();
+
+ private:
+
+  Long64_t capacity;
+  Long64_t inUse;
+  pthread_mutex_t mutex;
+  pthread_cond_t released;
+
+};
+
+class ThreadPool {
+
+ public:
+
+  ThreadPool(int newNThreads);
+  virtual ~ThreadPool();
+
+  // Mutators:
+  void submit(PoolTask *task);
+  void wait();
+
+  // Accessors:
+  int getNThreads();
+  static int getCurrentWorker();
+  static int getDefaultNThreads();
+  void printStatistics();
+
+ private:
+
+  // The tasks of one worker. The owner takes the newest task, thieves take
+  // the oldest:
+  struct WorkerQueue {
+    std::deque<PoolTask*> tasks;
+    pthread_mutex_t mutex;
+    int nRun;
+    int nStolen;
+  };
+
+  struct WorkerArgs {
+    ThreadPool *pool;
+    int worker;
+  };
+
+  static void *workerMain(void *arg);
+  void workerLoop(int worker);
+  PoolTask *takeTask(int worker);
+
+  int nThreads;
+  std::vector<WorkerQueue*> queues;
+  std::vector<WorkerArgs> workerArgs;
+  std::vector<pthread_t> threads;
+
+  // Shared state, protected by stateMutex:
+  pthread_mutex_t stateMutex;
+  pthread_cond_t workAvailable;
+  pthread_cond_t allDone;
+  int nQueued;// tasks in the queues and not yet claimed by a worker
+  int nPending;// tasks submitted and not yet finished
+  int nextQueue;// round-robin target for tasks submitted from outside
+  bool stopping;
+
+};
+
+#endif
@@ -0,0 +1,251 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: TimeIndex.cxx                                                       //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This class maps coarse time buckets onto entry ranges of the FEI4 tree,   //
+//  so that a time window can be read without scanning from entry 0. The      //
+//  index is built once per run and stored in a sidecar file next to the      //
+//  FEI4 ROOT file (<file>.tidx). It is rebuilt automatically if the number   //
+//  of tree entries or the bucket width no longer match.                      //
+//                                                                            //
+//  Bucket b covers [startTime + b*width, startTime + (b+1)*width), and       //
+//  bucketFirst[b] is the first entry with timestamp_start in bucket b or     //
+//  later. getEntryRange() therefore returns a span that contains every       //
+//  entry in the requested window, plus at most one bucket on either side.    //
+//  The caller should still apply the exact timestamp cut.                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#include "TimeIndex.h"
+
+// Identifies the sidecar file format:
+static const char indexMagic[8] = {'T','B','T','I','D','X','\0','\0'};
+static const int indexVersion = 1;
+
+/**
+   Initialize the index with a bucket width of one second.
+   @param inputFEI4 - the FEI4 ROOT file name (used for the sidecar name).
+   @param cF - the FEI4 tree reader.
+*/
+TimeIndex::TimeIndex(TString inputFEI4, TreeFEI4 *cF) {
+  initialize(inputFEI4, cF, 1.0);
+}
+
+/**
+   Initialize the index.
+   @param inputFEI4 - the FEI4 ROOT file name (used for the sidecar name).
+   @param cF - the FEI4 tree reader.
+   @param bucketWidth - the width of the time buckets in seconds.
+*/
+TimeIndex::TimeIndex(TString inputFEI4, TreeFEI4 *cF, double bucketWidth) {
+  initialize(inputFEI4, cF, bucketWidth);
+}
+
+/**
+   Load the sidecar index if it is up to date, otherwise build and save it.
+   @param inputFEI4 - the FEI4 ROOT file name (used for the sidecar name).
+   @param cF - the FEI4 tree reader.
+   @param bucketWidth - the width of the time buckets in seconds.
+*/
+void TimeIndex::initialize(TString inputFEI4, TreeFEI4 *cF,
+			   double bucketWidth) {
+  std::cout << "TimeIndex: Initializing..." << std::endl;
+  TString indexFileName = Form("%s.tidx", inputFEI4.Data());
+
+  if (loadIndex(indexFileName) && nEntries == cF->fChain->GetEntries() &&
+      width == bucketWidth) {
+    std::cout << "TimeIndex: Loaded " << indexFileName << std::endl;
+  }
+  else {
+    width = bucketWidth;
+    buildIndex(cF);
+    saveIndex(indexFileName);
+    std::cout << "TimeIndex: Saved " << indexFileName << std::endl;
+  }
+  std::cout << "TimeIndex: " << getNBuckets() << " buckets of " << width
+	    << " s for " << nEntries << " entries." << std::endl;
+}
+
+/**
+   Build the index with a single pass over the timestamp_start branch. Only
+   the last entry is also read for its timestamp_stop, to set the range.
+   @param cF - the FEI4 tree reader.
+*/
+void TimeIndex::buildIndex(TreeFEI4 *cF) {
+  nEntries = cF->fChain->GetEntries();
+  sorted = true;
+  bucketFirst.clear();
+  if (nEntries == 0) {
+    startTime = 0.0;
+    stopTime = 0.0;
+    bucketFirst.push_back(0);
+    return;
+  }
+
+  // The time range is set by the first and last entries:
+  cF->fChain->SetBranchStatus("*", 0);
+  cF->fChain->SetBranchStatus("timestamp_start", 1);
+  cF->fChain->SetBranchStatus("timestamp_stop", 1);
+  cF->fChain->GetEntry(0);
+  startTime = cF->timestamp_start;
+  cF->fChain->GetEntry(nEntries-1);
+  stopTime = cF->timestamp_stop > cF->timestamp_start ?
+    cF->timestamp_stop : cF->timestamp_start;
+  if (stopTime < startTime) stopTime = startTime;
+  cF->fChain->SetBranchStatus("timestamp_stop", 0);
+  Long64_t nBuckets = (Long64_t)floor((stopTime - startTime) / width) + 1;
+  if (nBuckets < 1) nBuckets = 1;
+  bucketFirst.assign(nBuckets+1, nEntries);
+
+  // Record the first entry at or after the start of each bucket:
+  Long64_t nextBucket = 0;
+  double previousTime = startTime;
+  for (Long64_t entry = 0; entry < nEntries; entry++) {
+    cF->fChain->GetEntry(entry);
+    double currTime = cF->timestamp_start;
+    if (currTime < previousTime) sorted = false;
+    previousTime = currTime;
+
+    Long64_t currBucket = (Long64_t)floor((currTime - startTime) / width);
+    if (currBucket < 0) currBucket = 0;
+    if (currBucket > nBuckets-1) currBucket = nBuckets-1;
+    while (nextBucket <= currBucket) {
+      bucketFirst[nextBucket] = entry;
+      nextBucket++;
+    }
+  }
+  cF->fChain->SetBranchStatus("*", 1);
+
+  if (!sorted) {
+    std::cout << "TimeIndex: Warning! FEI4 timestamps are not ordered. "
+	      << "Ranges will cover the full tree." << std::endl;
+  }
+}
+
+/**
+   Load the index from a sidecar file.
+   @param indexFileName - the name of the sidecar file.
+   @returns - true iff a valid index was loaded.
+*/
+bool TimeIndex::loadIndex(TString indexFileName) {
+  std::ifstream inputFile(indexFileName.Data(), std::ios::binary);
+  if (!inputFile.is_open()) return false;
+
+  char magic[8]; int version; int isSortedInt; Long64_t nBuckets;
+  inputFile.read(magic, sizeof(magic));
+  inputFile.read((char*)&version, sizeof(version));
+  if (!inputFile || memcmp(magic, indexMagic, sizeof(magic)) != 0 ||
+      version != indexVersion) {
+    std::cout << "TimeIndex: Ignoring outdated " << indexFileName << std::endl;
+    return false;
+  }
+  inputFile.read((char*)&nEntries, sizeof(nEntries));
+  inputFile.read((char*)&width, sizeof(width));
+  inputFile.read((char*)&startTime, sizeof(startTime));
+  inputFile.read((char*)&stopTime, sizeof(stopTime));
+  inputFile.read((char*)&isSortedInt, sizeof(isSortedInt));
+  inputFile.read((char*)&nBuckets, sizeof(nBuckets));
+  if (!inputFile || nBuckets < 0) return false;
+  sorted = (isSortedInt != 0);
+  bucketFirst.resize(nBuckets+1);
+  inputFile.read((char*)&bucketFirst[0], (nBuckets+1) * sizeof(Long64_t));
+  inputFile.close();
+  return !inputFile.fail();
+}
+
+/**
+   Save the index to a sidecar file.
+   @param indexFileName - the name of the sidecar file.
+*/
+void TimeIndex::saveIndex(TString indexFileName) {
+  std::ofstream outputFile(indexFileName.Data(), std::ios::binary);
+  if (!outputFile.is_open()) {
+    std::cout << "TimeIndex: Could not write " << indexFileName << std::endl;
+    return;
+  }
+  Long64_t nBuckets = getNBuckets();
+  int isSortedInt = sorted ? 1 : 0;
+  outputFile.write(indexMagic, sizeof(indexMagic));
+  outputFile.write((char*)&indexVersion, sizeof(indexVersion));
+  outputFile.write((char*)&nEntries, sizeof(nEntries));
+  outputFile.write((char*)&width, sizeof(width));
+  outputFile.write((char*)&startTime, sizeof(startTime));
+  outputFile.write((char*)&stopTime, sizeof(stopTime));
+  outputFile.write((char*)&isSortedInt, sizeof(isSortedInt));
+  outputFile.write((char*)&nBuckets, sizeof(nBuckets));
+  outputFile.write((char*)&bucketFirst[0], (nBuckets+1) * sizeof(Long64_t));
+  outputFile.close();
+}
+
+/**
+   Get the span of entries that covers the time window [t0, t1).
+   @param t0 - the start of the window.
+   @param t1 - the end of the window.
+   @param firstEntry - set to the first entry of the span.
+   @param lastEntry - set to one past the last entry of the span.
+   @returns - false if the index is unusable and the full tree is returned.
+*/
+bool TimeIndex::getEntryRange(double t0, double t1, Long64_t &firstEntry,
+			      Long64_t &lastEntry) {
+  if (!sorted) {
+    firstEntry = 0;
+    lastEntry = nEntries;
+    return false;
+  }
+  Long64_t nBuckets = getNBuckets();
+  Long64_t b0 = (Long64_t)floor((t0 - startTime) / width);
+  Long64_t b1 = (Long64_t)ceil((t1 - startTime) / width);
+  if (b0 < 0) b0 = 0;
+  if (b0 > nBuckets) b0 = nBuckets;
+  if (b1 < 0) b1 = 0;
+  if (b1 > nBuckets) b1 = nBuckets;
+  firstEntry = bucketFirst[b0];
+  lastEntry = bucketFirst[b1];
+  if (lastEntry < firstEntry) lastEntry = firstEntry;
+  return true;
+}
+
+/**
+   Get the width of the time buckets in seconds.
+*/
+double TimeIndex::getBucketWidth() {
+  return width;
+}
+
+/**
+   Get the number of time buckets in the index.
+*/
+Long64_t TimeIndex::getNBuckets() {
+  return (Long64_t)bucketFirst.size() - 1;
+}
+
+/**
+   Get the number of FEI4 entries covered by the index.
+*/
+Long64_t TimeIndex::getNEntries() {
+  return nEntries;
+}
+
+/**
+   Get the timestamp_start of the first FEI4 entry.
+*/
+double TimeIndex::getStartTime() {
+  return startTime;
+}
+
+/**
+   Get the latest timestamp of the last FEI4 entry.
+*/
+double TimeIndex::getStopTime() {
+  return stopTime;
+}
+
+/**
+   Check whether the FEI4 entries are ordered in time.
+   @returns - true iff the index can be used to restrict entry ranges.
+*/
+bool TimeIndex::isSorted() {
+  return sorted;
+}
@@ -0,0 +1,63 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: TimeIndex.h                                                         //
+//  Class: TimeIndex.cxx                                                      //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+#ifndef TimeIndex_h
+#define TimeIndex_h
+
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <cmath>
+#include <cstring>
+
+#include "TString.h"
+#include "TTree.h"
+
+#include "TreeFEI4.h"
+
+class TimeIndex {
+
+ public:
+
+  TimeIndex(TString inputFEI4, TreeFEI4 *cF);
+  TimeIndex(TString inputFEI4, TreeFEI4 *cF, double bucketWidth);
+  virtual ~TimeIndex() {};
+
+  // Mutators:
+  void buildIndex(TreeFEI4 *cF);
+  bool loadIndex(TString indexFileName);
+  void saveIndex(TString indexFileName);
+
+  // Accessors:
+  bool getEntryRange(double t0, double t1, Long64_t &firstEntry,
+		     Long64_t &lastEntry);
+  double getBucketWidth();
+  Long64_t getNBuckets();
+  Long64_t getNEntries();
+  double getStartTime();
+  double getStopTime();
+  bool isSorted();
+
+ private:
+
+  void initialize(TString inputFEI4, TreeFEI4 *cF, double bucketWidth);
+
+  // Index contents:
+  double width;
+  double startTime;
+  double stopTime;
+  bool sorted;
+  Long64_t nEntries;
+  std::vector<Long64_t> bucketFirst;// size nBuckets+1
+
+};
+
+#endif
@@ -7,7 +7,8 @@
 //  Date: 26/05/2015                                                          //
 //                                                                            //
 //  This program calculates the true efficiency of the T3MAPS and FEI4 chips  //
-//  using hit matching graphs for good and bad mappings.                      //
+//  using hit matching graphs for good and bad mappings, which are loaded     //
+//  from the TestBeamScanner results files.                                   //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -21,11 +22,12 @@
 #include <string>
 
 // ROOT includes:
-#include "TFile.h"
+#include "TH2D.h"
 #include "TString.h"
 
 // Package includes:
 #include "PlotUtil.h"
+#include "ResultsFile.h"
 
 using namespace std;
 
@@ -42,22 +44,23 @@ int main(int argc, char **argv) {
   }
   TString option = argv[1];
   
-  TFile *fileSig;
-  TFile *fileBkg;
+  TString sigName = "../TestBeamOutput/TestBeamScanner_SigI/results.root";
+  TString bkgName = "../TestBeamOutput/TestBeamScanner_BkgI/results.root";
   if (option.Contains("RunII")) {
-    fileSig=new TFile("../TestBeamOutput/TestBeamScanner_SigII/graphFile.root");
-    fileBkg=new TFile("../TestBeamOutput/TestBeamScanner_BkgII/graphFile.root");
-  }
-  else {
-    fileSig=new TFile("../TestBeamOutput/TestBeamScanner_SigI/graphFile.root");
-    fileBkg=new TFile("../TestBeamOutput/TestBeamScanner_BkgI/graphFile.root");
+    sigName = "../TestBeamOutput/TestBeamScanner_SigII/results.root";
+    bkgName = "../TestBeamOutput/TestBeamScanner_BkgII/results.root";
   }
   
-  TH2D *hSig_T3MAPS = fileSig->Get("g2Eff_T3MAPS");
-  TH2D *hSig_FEI4 = fileSig->Get("g2Eff_FEI4");
+  // Load the match rates of the good and bad mappings:
+  ResultsFile *fileSig = new ResultsFile(sigName, "READ");
+  TH2D *hSig_T3MAPS = fileSig->get<TH2D>("g2Eff_T3MAPS");
+  TH2D *hSig_FEI4 = fileSig->get<TH2D>("g2Eff_FEI4");
+  delete fileSig;
   
-  TH2D *hBkg_T3MAPS = fileBkg->Get("g2Eff_T3MAPS");
-  TH2D *hBkg_FEI4 = fileBkg->Get("g2Eff_FEI4");
+  ResultsFile *fileBkg = new ResultsFile(bkgName, "READ");
+  TH2D *hBkg_T3MAPS = fileBkg->get<TH2D>("g2Eff_T3MAPS");
+  TH2D *hBkg_FEI4 = fileBkg->get<TH2D>("g2Eff_FEI4");
+  delete fileBkg;
   
   TH2D *hEff_T3MAPS = new TH2D("hEff_T3MAPS","hEff_T3MAPS",
 			       hSig_T3MAPS->GetNbinsX(),
@@ -102,6 +105,13 @@ int main(int argc, char **argv) {
   PlotUtil::plotTH2D(hEff_FEI4, "#Delta_{row} [mm]", "#Delta_{col} [mm]",
 		     "Eff.", "../TestBeamOutput/Efficiency/eff_FEI4.eps");
   
+  // Store the efficiency maps:
+  ResultsFile *results
+    = new ResultsFile("../TestBeamOutput/Efficiency/results.root", "RECREATE");
+  results->writeObject("hEff_T3MAPS", hEff_T3MAPS);
+  results->writeObject("hEff_FEI4", hEff_FEI4);
+  delete results;
+  
   // Analysis is complete.
   std::cout << "\nEfficiency: Finished analysis." << std::endl;
   return 0;
@@ -0,0 +1,213 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: NoiseScan.cxx                                                       //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This program sweeps the noise thresholds used to mask the hot pixels of   //
+//  both chips, and gives the efficiency and the hit rate of each chip at     //
+//  every threshold. The matching of TestBeamTracks is done once, with the    //
+//  loosest masks of the sweep (sweepMaxFEI4 and sweepMaxT3MAPS), while the   //
+//  hits of each pixel are counted. The pixels are then sorted by occupancy,  //
+//  and each threshold step only subtracts the pixels that it newly masks     //
+//  (see NoiseSweep), so the whole sweep costs about one analysis pass.       //
+//                                                                            //
+//  The efficiency of each chip is swept against its own threshold, from      //
+//  sweepMax to sweepMin in sweepSteps steps, while the other chip keeps its  //
+//  loosest mask.                                                             //
+//                                                                            //
+//  A run configuration file (see config/runs.cfg) can be given after the     //
+//  option to scan several runs in turn. "NoCache" recomputes everything      //
+//  instead of using the results stored in TestBeamOutput/cache/.             //
+//                                                                            //
+//  The sweeps are stored as the trees "NoiseSweepT3MAPS" and                 //
+//  "NoiseSweepFEI4" in TestBeamOutput/NoiseScan/results.root (see            //
+//  ResultsFile), one entry per threshold.                                    //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// C++ includes:
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <iomanip>
+#include <fstream>
+#include <vector>
+#include <string>
+
+// ROOT includes:
+#include "TFile.h"
+#include "TString.h"
+#include "TTree.h"
+
+// Package includes:
+#include "AnalysisPipeline.h"
+#include "AnalysisStages.h"
+#include "ChipDimension.h"
+#include "HitMatcher.h"
+#include "Instrument.h"
+#include "MapParameters.h"
+#include "NoiseSweep.h"
+#include "ResultCache.h"
+#include "ResultsFile.h"
+#include "RunConfig.h"
+#include "TreeFEI4.h"
+#include "TreeT3MAPS.h"
+
+using namespace std;
+
+/**
+   Print the sweep of one chip, marking the threshold of the run settings.
+   @param sweep - the completed sweep.
+   @param threshold - the noise threshold of the run settings.
+*/
+void printSweep(NoiseSweep *sweep, int threshold) {
+  std::cout << "\nNoiseScan: Sweep of the " << sweep->getChipName()
+	    << " noise threshold." << std::endl;
+  std::cout << "\tthreshold\tmasked\thits/s\t\tefficiency" << std::endl;
+  for (int i_p = 0; i_p < sweep->getNPoints(); i_p++) {
+    SweepPoint point = sweep->getPoint(i_p);
+    std::cout << "\t" << point.threshold << "\t\t" << point.nMasked << "\t"
+	      << std::setw(10) << point.hitRate << "\t" << point.efficiency
+	      << " +/- " << point.efficiencyError;
+    if (point.threshold == threshold) std::cout << "\t(current)";
+    std::cout << std::endl;
+  }
+}
+
+/**
+   Sweep the noise thresholds for a single test beam run.
+   @param config - the run settings.
+   @param option - the job options.
+   @param tagOutput - true to add the run name to the output name.
+*/
+void analyzeRun(RunConfig *config, TString option, bool tagOutput) {
+  config->printConfig();
+  
+  // Fundamental job settings (as in TestBeamTracks):
+  TString runName = config->getRunName();
+  TString inputT3MAPS = config->getString("inputT3MAPS");
+  TString inputFEI4 = config->getString("inputFEI4");
+  double timeOffset = config->getDouble("timeOffset");
+  double integrationTime = config->getDouble("integrationTime");
+  int sweepSteps = config->getInt("sweepSteps");
+  int sweepMinFEI4 = config->getInt("sweepMinFEI4");
+  int sweepMaxFEI4 = config->getInt("sweepMaxFEI4");
+  int sweepMinT3MAPS = config->getInt("sweepMinT3MAPS");
+  int sweepMaxT3MAPS = config->getInt("sweepMaxT3MAPS");
+  
+  // Load the map of this run (and its orientation). A run without a map of
+  // its own is skipped:
+  MapParameters *mapper = new MapParameters("../TestBeamOutput", "");
+  if (!mapper->loadMapParameters("../TestBeamOutput", runName, -1)) {
+    std::cout << "NoiseScan: Skipping " << runName << ", which has no map."
+	      << std::endl;
+    delete mapper;
+    return;
+  }
+  
+  // Load the chip sizes:
+  ChipDimension *chips = new ChipDimension();
+  
+  // Event building, occupancy and masking (with the loosest thresholds) and
+  // skimming are stages of the analysis pipeline:
+  AnalysisPipeline *pipeline = new AnalysisPipeline();
+  ResultCache cache("../TestBeamOutput/cache");
+  addInputTrees(pipeline, inputT3MAPS, inputFEI4,
+		option.Contains("NoCache") ? NULL : &cache);
+  addSkimStages(pipeline, chips, sweepMaxFEI4, sweepMaxT3MAPS);
+  TreeT3MAPS *cT = pipeline->get<TreeT3MAPS>("TreeT3MAPS");
+  TreeFEI4 *cF = pipeline->get<TreeFEI4>("TreeFEI4");
+  EventBuilder *skimFEI4 = pipeline->get<EventBuilder>("SkimFEI4");
+  
+  // Match once, counting the hits of each pixel:
+  NoiseSweep *sweepT3MAPS = new NoiseSweep("T3MAPS", chips->getNRow("T3MAPS"),
+					   chips->getNCol("T3MAPS"));
+  NoiseSweep *sweepFEI4 = new NoiseSweep("FEI4", chips->getNRow("FEI4"),
+					 chips->getNCol("FEI4"));
+  HitMatcher matcher(mapper, chips, timeOffset);
+  matcher.setScanCuts(config->getInt("maxHitsT3MAPS"),
+		      config->getInt("rowMinT3MAPS"),
+		      config->getInt("rowMaxT3MAPS"));
+  matcher.setMask("T3MAPS", *pipeline->get<PixelList>("MaskT3MAPS"));
+  matcher.setMask("FEI4", *pipeline->get<PixelList>("MaskFEI4"));
+  matcher.setNoiseSweeps(sweepT3MAPS, sweepFEI4);
+  MatchCounts counts;
+  HitMatcher::resetCounts(counts);
+  Long64_t eventFEI4 = 0;
+  Long64_t entriesT3MAPS = cT->fChain->GetEntries();
+  {
+    INSTRUMENT_SCOPE("match");
+    for (Long64_t eventT3MAPS = 0; eventT3MAPS < entriesT3MAPS;
+	 eventT3MAPS++) {
+      {
+	INSTRUMENT_SCOPE("read.T3MAPS");
+	cT->fChain->GetEntry(eventT3MAPS);
+      }
+      matcher.matchScan(cT->hit_row, cT->hit_column, cT->timestamp_start,
+			cT->timestamp_stop, skimFEI4, eventFEI4, counts);
+    }
+  }
+  INSTRUMENT_COUNT("entries.T3MAPS", entriesT3MAPS);
+  
+  // The occupancies cover all T3MAPS scans and the whole FEI4 record:
+  double exposureT3MAPS = integrationTime * ((double)entriesT3MAPS);
+  double exposureFEI4 = 0.0;
+  EventBuilder *eventsFEI4 = pipeline->get<EventBuilder>("EventsFEI4");
+  if (eventsFEI4->getNEvents() > 0) {
+    exposureFEI4
+      = (eventsFEI4->getEvent(eventsFEI4->getNEvents()-1)->timestamp_stop -
+	 eventsFEI4->getEvent(0)->timestamp_start);
+  }
+  sweepT3MAPS->sweep(*pipeline->get<FixedHist>("OccupancyT3MAPS"),
+		     sweepMinT3MAPS, sweepMaxT3MAPS, sweepSteps,
+		     exposureT3MAPS);
+  sweepFEI4->sweep(*pipeline->get<FixedHist>("OccupancyFEI4"), sweepMinFEI4,
+		   sweepMaxFEI4, sweepSteps, exposureFEI4);
+  printSweep(sweepT3MAPS, config->getInt("noiseThresholdT3MAPS"));
+  printSweep(sweepFEI4, config->getInt("noiseThresholdFEI4"));
+  
+  // Store the sweeps:
+  TString resultsName = tagOutput ?
+    Form("../TestBeamOutput/NoiseScan/results_%s.root", runName.Data()) :
+    "../TestBeamOutput/NoiseScan/results.root";
+  ResultsFile *results = new ResultsFile(resultsName, "RECREATE");
+  results->writeObject("NoiseSweepT3MAPS", sweepT3MAPS->getTree());
+  results->writeObject("NoiseSweepFEI4", sweepFEI4->getTree());
+  delete results;
+  
+  // Deleting the tree readers also closes the input files:
+  delete sweepT3MAPS;
+  delete sweepFEI4;
+  delete pipeline;
+  delete cT;
+  delete cF;
+  
+  std::cout << "\nNoiseScan: Finished analysis of " << runName << "."
+	    << std::endl;
+}
+
+/**
+   The main method just requires an option to run. 
+   @param option - "RunI" or "RunII" to select the desired dataset.
+   @param config - (optional) a run configuration file. Every run in the file
+   is swept, one after the other.
+   @returns - 0. Stores the sweeps in the TestBeamOutput/NoiseScan/ directory.
+*/
+int main(int argc, char **argv) {
+  // Check arguments:
+  if (argc < 2) {
+    std::cout << "\nUsage: " << argv[0] << " <option> [run config]"
+	      << std::endl; 
+    exit(0);
+  }
+  TString option = argv[1];
+  TString configFile = argc > 2 ? argv[2] : "";
+  
+  std::vector<RunConfig*> runs = RunConfig::getRuns(option, configFile);
+  for (int i_r = 0; i_r < (int)runs.size(); i_r++) {
+    analyzeRun(runs[i_r], option, !configFile.IsNull());
+    delete runs[i_r];
+  }
+  return 0;
+}
@@ -0,0 +1,91 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: SyntheticBeam.cxx                                                   //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This program writes a synthetic test beam run with BeamGenerator, so that //
+//  the analysis can be benchmarked and checked without the real data. The    //
+//  output files are the inputT3MAPS and inputFEI4 of the run, so the same    //
+//  run configuration can be given to the analysis programs afterwards, e.g.  //
+//                                                                            //
+//    ./bin/SyntheticBeam Run config/synthetic.cfg Synthetic                  //
+//    ./bin/TestBeamStudies NoScan config/synthetic.cfg Synthetic             //
+//                                                                            //
+//  Program options:                                                          //
+//                                                                            //
+//    "History" also writes the T3MAPS history text file, to historyT3MAPS    //
+//    if the run gives it, otherwise next to inputT3MAPS with ".txt".         //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// C++ includes:
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <string>
+
+// ROOT includes:
+#include "TString.h"
+#include "TSystem.h"
+
+// Package includes:
+#include "BeamGenerator.h"
+#include "RunConfig.h"
+
+/**
+   The main method generates one run of the configuration file.
+   @param option - "History" to also write the T3MAPS text file.
+   @param config - the run configuration file.
+   @param run - (optional) the run to generate from the configuration file.
+   @returns - 0. Writes the files of the run.
+*/
+int main(int argc, char **argv) {
+  // Check arguments:
+  if (argc < 3) {
+    std::cout << "\nUsage: " << argv[0] << " <option> <run config> [run]"
+	      << std::endl;
+    exit(0);
+  }
+  TString options = argv[1];
+  RunConfig *config = RunConfig::getRun(options, argv[2],
+					argc > 3 ? argv[3] : "");
+
+  TString inputT3MAPS = config->getString("inputT3MAPS");
+  TString inputFEI4 = config->getString("inputFEI4");
+  TString historyT3MAPS = "";
+  if (options.Contains("History")) {
+    if (config->hasKey("historyT3MAPS")) {
+      historyT3MAPS = config->getString("historyT3MAPS");
+    }
+    else {
+      historyT3MAPS = inputT3MAPS;
+      if (historyT3MAPS.EndsWith(".root")) {
+	historyT3MAPS.Remove(historyT3MAPS.Length()-5);
+      }
+      historyT3MAPS += ".txt";
+    }
+  }
+
+  // Create the output directories:
+  gSystem->mkdir(gSystem->DirName(inputT3MAPS), kTRUE);
+  gSystem->mkdir(gSystem->DirName(inputFEI4), kTRUE);
+  if (!historyT3MAPS.IsNull()) {
+    gSystem->mkdir(gSystem->DirName(historyT3MAPS), kTRUE);
+  }
+
+  std::cout << "SyntheticBeam: Generating run " << config->getRunName()
+	    << std::endl;
+  BeamGenerator *generator = new BeamGenerator(config);
+  generator->printSettings();
+  generator->generate(inputT3MAPS, inputFEI4, historyT3MAPS);
+
+  std::cout << "SyntheticBeam: Wrote " << inputT3MAPS << " and " << inputFEI4
+	    << std::endl;
+  if (!historyT3MAPS.IsNull()) {
+    std::cout << "SyntheticBeam: Wrote " << historyT3MAPS << std::endl;
+  }
+  delete generator;
+  delete config;
+  return 0;
+}
@@ -0,0 +1,464 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: TestBeamBatch.cxx                                                   //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This program computes the track-by-track efficiency of every run in a     //
+//  run configuration file in parallel. Each run is one task on a ThreadPool  //
+//  that builds the FEI4 events, masks and skim, then splits the T3MAPS       //
+//  scans into blocks of time that are matched as separate tasks. Idle        //
+//  workers steal blocks from the busy ones, so a long run is shared by all   //
+//  cores once the short runs have finished. The last block of a run adds     //
+//  its results to TestBeamOutput/TestBeamBatch/<run name>/results.root.      //
+//                                                                            //
+//  The efficiencies are the same as those of TestBeamTracks with the same    //
+//  options. Each block starts at the FEI4 event where the sequential loop    //
+//  would have been after the previous blocks. Each block is matched in all   //
+//  four chip orientations, and as in TestBeamTracks the efficiency is given  //
+//  for the orientation that matches best over the whole run.                 //
+//                                                                            //
+//  A run is only started when its estimated memory fits in the budget given  //
+//  on the command line, so many large runs do not exhaust the memory.        //
+//                                                                            //
+//  Program options:                                                          //
+//                                                                            //
+//    "NoCache" recomputes everything instead of using the results stored in  //
+//    TestBeamOutput/cache/ by earlier jobs.                                  //
+//                                                                            //
+//    "Trace" writes a timeline of the run and block tasks on each worker to  //
+//    TestBeamOutput/instrument/TestBeamBatch.trace.json (see Instrument).    //
+//                                                                            //
+//    "FixedOrientation" only matches in the orientation of the map.          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// C++ includes:
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+
+#include <pthread.h>
+#include <sys/stat.h>
+
+// ROOT includes:
+#include "TFile.h"
+#include "TH1.h"
+#include "RVersion.h"
+#include "TROOT.h"
+#include "TStopwatch.h"
+#include "TString.h"
+#include "TSystem.h"
+#include "TThread.h"
+#include "TTree.h"
+
+// Package includes:
+#include "AnalysisPipeline.h"
+#include "AnalysisStages.h"
+#include "ChipDimension.h"
+#include "EventBuilder.h"
+#include "HitMatcher.h"
+#include "Instrument.h"
+#include "LoadT3MAPS.h"
+#include "MapParameters.h"
+#include "ResultCache.h"
+#include "ResultsFile.h"
+#include "RunConfig.h"
+#include "ThreadPool.h"
+#include "TreeFEI4.h"
+#include "TreeT3MAPS.h"
+
+using namespace std;
+
+// The number of T3MAPS scans matched by one task:
+int scansPerBlock = 2000;
+
+// Job settings shared by all of the runs:
+TString options;
+int nOrientations = 4;// 1 with "FixedOrientation"
+ResultCache *cache = NULL;
+MemoryBudget *budget = NULL;
+
+// Keeps the messages of different runs on separate lines:
+pthread_mutex_t printMutex = PTHREAD_MUTEX_INITIALIZER;
+
+// Everything belonging to one run of the batch:
+struct RunJob {
+  RunConfig *config;
+  TString outputDir;
+  Long64_t memory;// MB held in the budget
+
+  // Made by the RunTask and read by its BlockTasks:
+  AnalysisPipeline *pipeline;
+  ChipDimension *chips;
+  MapParameters *mapper;
+  EventBuilder *skimFEI4;
+  PixelList *maskT3MAPS;
+  PixelList *maskFEI4;
+  std::vector<ScanT3MAPS> scans;
+  std::vector<Long64_t> blockStarts;// first FEI4 event of each block
+  TStopwatch timer;
+
+  // Filled by the BlockTasks, nOrientations per block:
+  std::vector<MatchCounts> blockCounts;
+  int nBlocksLeft;
+  pthread_mutex_t mutex;
+};
+
+/**
+   Estimate the memory needed to analyse a run from the size of its inputs.
+   The FEI4 events are held uncompressed, which takes a few times the size of
+   the compressed file.
+   @param config - the run settings.
+   @returns - the estimate in MB.
+*/
+Long64_t estimateMemory(RunConfig *config) {
+  Long64_t fileBytes = 0;
+  struct stat fileStat;
+  if (stat(config->getString("inputFEI4").Data(), &fileStat) == 0) {
+    fileBytes += (Long64_t)fileStat.st_size;
+  }
+  if (stat(config->getString("inputT3MAPS").Data(), &fileStat) == 0) {
+    fileBytes += (Long64_t)fileStat.st_size;
+  }
+  return 64 + (4 * fileBytes) / (1024 * 1024);
+}
+
+/**
+   Write the results of a run and free its memory. Called once, by the last
+   task of the run.
+   @param job - the run.
+*/
+void finishRun(RunJob *job) {
+  INSTRUMENT_SCOPE("run.finish");
+  OrientationCounts orientationCounts;
+  for (int i_h = 0; i_h < nOrientations; i_h++) {
+    MatchCounts &curr = orientationCounts.counts[i_h];
+    HitMatcher::resetCounts(curr);
+    for (int i_b = i_h; i_b < (int)job->blockCounts.size();
+	 i_b += nOrientations) {
+      curr.totalT3MAPS += job->blockCounts[i_b].totalT3MAPS;
+      curr.matchableT3MAPS += job->blockCounts[i_b].matchableT3MAPS;
+      curr.matchedT3MAPS += job->blockCounts[i_b].matchedT3MAPS;
+      curr.totalFEI4 += job->blockCounts[i_b].totalFEI4;
+      curr.matchableFEI4 += job->blockCounts[i_b].matchableFEI4;
+      curr.matchedFEI4 += job->blockCounts[i_b].matchedFEI4;
+    }
+  }
+  
+  // Use the orientation that matches best, as TestBeamTracks does:
+  int orientation = job->mapper->getOrientation();
+  MatchCounts counts = orientationCounts.counts[0];
+  if (nOrientations == 4) {
+    orientation = OrientationStage::getBestOrientation(orientationCounts);
+    counts = orientationCounts.counts[orientation];
+  }
+  double fracT3MAPS = HitMatcher::getEfficiency(counts.matchedT3MAPS,
+						counts.matchableT3MAPS);
+  double fracFEI4 = HitMatcher::getEfficiency(counts.matchedFEI4,
+					      counts.matchableFEI4);
+  double timeOffset = job->config->getDouble("timeOffset");
+
+  ResultsFile *results
+    = new ResultsFile(Form("%s/results.root", job->outputDir.Data()),
+		      "UPDATE");
+  results->writeValue(ResultsFile::offsetKey("effT3MAPS", timeOffset),
+		      fracT3MAPS);
+  results->writeValue(ResultsFile::offsetKey("effFEI4", timeOffset), fracFEI4);
+  results->writeValue(ResultsFile::offsetKey("totalT3MAPS", timeOffset),
+		      counts.totalT3MAPS);
+  results->writeValue(ResultsFile::offsetKey("matchableT3MAPS", timeOffset),
+		      counts.matchableT3MAPS);
+  results->writeValue(ResultsFile::offsetKey("matchedT3MAPS", timeOffset),
+		      counts.matchedT3MAPS);
+  results->writeValue(ResultsFile::offsetKey("totalFEI4", timeOffset),
+		      counts.totalFEI4);
+  results->writeValue(ResultsFile::offsetKey("matchableFEI4", timeOffset),
+		      counts.matchableFEI4);
+  results->writeValue(ResultsFile::offsetKey("matchedFEI4", timeOffset),
+		      counts.matchedFEI4);
+  results->writeValue(ResultsFile::offsetKey("orientation", timeOffset),
+		      orientation);
+  if (nOrientations == 4) {
+    for (int i_h = 0; i_h < 4; i_h++) {
+      MatchCounts &curr = orientationCounts.counts[i_h];
+      results->writeValue(ResultsFile::offsetKey(Form("effT3MAPS_orient%d",
+						      i_h), timeOffset),
+			  HitMatcher::getEfficiency(curr.matchedT3MAPS,
+						    curr.matchableT3MAPS));
+      results->writeValue(ResultsFile::offsetKey(Form("effFEI4_orient%d", i_h),
+						 timeOffset),
+			  HitMatcher::getEfficiency(curr.matchedFEI4,
+						    curr.matchableFEI4));
+    }
+  }
+  results->writeMask("MaskT3MAPS", *job->maskT3MAPS);
+  results->writeMask("MaskFEI4", *job->maskFEI4);
+  delete results;
+
+  job->timer.Stop();
+  pthread_mutex_lock(&printMutex);
+  std::cout << "TestBeamBatch: Finished " << job->config->getRunName()
+	    << " in " << job->timer.RealTime() << " s: orientation "
+	    << orientation << ", T3MAPS = ("
+	    << counts.matchedT3MAPS << " / " << counts.matchableT3MAPS
+	    << ") = " << fracT3MAPS << ", FEI4 = (" << counts.matchedFEI4
+	    << " / " << counts.matchableFEI4 << ") = " << fracFEI4 << std::endl;
+  pthread_mutex_unlock(&printMutex);
+
+  // The pipeline owns the skim and the masks:
+  delete job->pipeline;
+  delete job->mapper;
+  delete job->chips;
+  job->pipeline = NULL;
+  job->mapper = NULL;
+  job->chips = NULL;
+  job->skimFEI4 = NULL;
+  job->maskT3MAPS = NULL;
+  job->maskFEI4 = NULL;
+  std::vector<ScanT3MAPS>().swap(job->scans);
+  budget->release(job->memory);
+}
+
+// Matches one block of T3MAPS scans of a run in each orientation:
+class BlockTask : public PoolTask {
+
+ public:
+
+  BlockTask(RunJob *newJob, int newBlock) {
+    job = newJob;
+    block = newBlock;
+  };
+
+  void run(ThreadPool *pool) {
+    INSTRUMENT_SCOPE("match.block");
+    RunConfig *config = job->config;
+    HitMatcher matcher(job->mapper, job->chips,
+		       config->getDouble("timeOffset"));
+    matcher.setScanCuts(config->getInt("maxHitsT3MAPS"),
+			config->getInt("rowMinT3MAPS"),
+			config->getInt("rowMaxT3MAPS"));
+    matcher.setMask("T3MAPS", *job->maskT3MAPS);
+    matcher.setMask("FEI4", *job->maskFEI4);
+
+    // The orientation is set on the matcher, so the mapper is not changed:
+    std::vector<MatchCounts> counts(nOrientations);
+    int first = block * scansPerBlock;
+    int last = first + scansPerBlock;
+    if (last > (int)job->scans.size()) last = (int)job->scans.size();
+    for (int i_h = 0; i_h < nOrientations; i_h++) {
+      matcher.setOrientation(nOrientations == 4 ? i_h : -1);
+      HitMatcher::resetCounts(counts[i_h]);
+      Long64_t eventFEI4 = job->blockStarts[block];
+      for (int i_s = first; i_s < last; i_s++) {
+	ScanT3MAPS &scan = job->scans[i_s];
+	matcher.matchScan(&scan.hit_row, &scan.hit_column,
+			  scan.timestamp_start, scan.timestamp_stop,
+			  job->skimFEI4, eventFEI4, counts[i_h]);
+      }
+    }
+
+    pthread_mutex_lock(&job->mutex);
+    for (int i_h = 0; i_h < nOrientations; i_h++) {
+      job->blockCounts[block*nOrientations + i_h] = counts[i_h];
+    }
+    job->nBlocksLeft--;
+    bool isLast = (job->nBlocksLeft == 0);
+    pthread_mutex_unlock(&job->mutex);
+    if (isLast) finishRun(job);
+  };
+
+ private:
+
+  RunJob *job;
+  int block;
+
+};
+
+// Prepares a run and submits its blocks:
+class RunTask : public PoolTask {
+
+ public:
+
+  RunTask(RunJob *newJob) {
+    job = newJob;
+  };
+
+  void run(ThreadPool *pool) {
+    INSTRUMENT_SCOPE("run.prepare");
+    RunConfig *config = job->config;
+    TString runName = config->getRunName();
+    TString inputT3MAPS = config->getString("inputT3MAPS");
+    TString inputFEI4 = config->getString("inputFEI4");
+    job->timer.Start();
+
+    // Each run has its own map (and orientation). A run without a map of its
+    // own is skipped:
+    job->mapper = new MapParameters("../TestBeamOutput", "");
+    if (!job->mapper->loadMapParameters("../TestBeamOutput", runName, -1)) {
+      pthread_mutex_lock(&printMutex);
+      std::cout << "TestBeamBatch: Skipping " << runName
+		<< ", which has no map." << std::endl;
+      pthread_mutex_unlock(&printMutex);
+      delete job->mapper;
+      job->mapper = NULL;
+      budget->release(job->memory);
+      return;
+    }
+
+    // Each run has its own files and geometry. Event building, occupancy,
+    // masking and skimming:
+    job->chips = new ChipDimension();
+    job->pipeline = new AnalysisPipeline();
+    addInputTrees(job->pipeline, inputT3MAPS, inputFEI4, cache);
+    addSkimStages(job->pipeline, job->chips,
+		  config->getInt("noiseThresholdFEI4"),
+		  config->getInt("noiseThresholdT3MAPS"));
+    TreeT3MAPS *cT = job->pipeline->get<TreeT3MAPS>("TreeT3MAPS");
+    TreeFEI4 *cF = job->pipeline->get<TreeFEI4>("TreeFEI4");
+    job->skimFEI4 = job->pipeline->get<EventBuilder>("SkimFEI4");
+    job->maskT3MAPS = job->pipeline->get<PixelList>("MaskT3MAPS");
+    job->maskFEI4 = job->pipeline->get<PixelList>("MaskFEI4");
+
+    // Load the scans, and find where the sequential loop over the FEI4 events
+    // would be at the start of each block. It is after the latest end of the
+    // scans that passed the hit cut:
+    double timeOffset = config->getDouble("timeOffset");
+    int maxHitsT3MAPS = config->getInt("maxHitsT3MAPS");
+    bool hasPassed = false;
+    double latestStop = 0.0;
+    Long64_t entriesT3MAPS = cT->fChain->GetEntries();
+    job->scans.resize(entriesT3MAPS);
+    job->blockStarts.clear();
+    for (Long64_t i_e = 0; i_e < entriesT3MAPS; i_e++) {
+      if (i_e % scansPerBlock == 0) {
+	job->blockStarts.push_back(hasPassed ? job->skimFEI4->findFirstEvent
+				   (latestStop + timeOffset) : 0);
+      }
+      cT->fChain->GetEntry(i_e);
+      ScanT3MAPS &scan = job->scans[i_e];
+      scan.timestamp_start = cT->timestamp_start;
+      scan.timestamp_stop = cT->timestamp_stop;
+      scan.hit_row = *cT->hit_row;
+      scan.hit_column = *cT->hit_column;
+      if ((int)scan.hit_row.size() < maxHitsT3MAPS &&
+	  (!hasPassed || scan.timestamp_stop > latestStop)) {
+	latestStop = scan.timestamp_stop;
+	hasPassed = true;
+      }
+    }
+
+    // The trees are not needed by the blocks. Deleting the tree readers also
+    // closes the input files:
+    delete cT;
+    delete cF;
+
+    int nBlocks = (int)job->blockStarts.size();
+    pthread_mutex_lock(&printMutex);
+    std::cout << "TestBeamBatch: " << runName << " has " << entriesT3MAPS
+	      << " scans in " << nBlocks << " blocks." << std::endl;
+    pthread_mutex_unlock(&printMutex);
+    if (nBlocks == 0) {
+      finishRun(job);
+      return;
+    }
+    MatchCounts empty;
+    HitMatcher::resetCounts(empty);
+    job->blockCounts.assign(nBlocks * nOrientations, empty);
+    job->nBlocksLeft = nBlocks;
+    for (int i_b = 0; i_b < nBlocks; i_b++) {
+      pool->submit(new BlockTask(job, i_b));
+    }
+  };
+
+ private:
+
+  RunJob *job;
+
+};
+
+/**
+   The main method requires the options and a run configuration file.
+   @param options - "NoCache" to recompute everything, "Trace" for a timeline,
+   "FixedOrientation" to only match in the orientation of the map.
+   @param config - the run configuration file. Every run in it is analysed.
+   @param threads - (optional) the number of threads (default: one per core).
+   @param memory - (optional) the memory budget in MB (default: 4096).
+   @returns - 0. Prints results to TestBeamOutput/TestBeamBatch/<run name>/.
+*/
+int main(int argc, char **argv) {
+  // Check arguments:
+  if (argc < 3) {
+    std::cout << "\nUsage: " << argv[0]
+	      << " <options> <run config> [threads] [memory MB]" << std::endl;
+    exit(0);
+  }
+  options = argv[1];
+  if (options.Contains("Trace")) Instrument::startTrace();
+  if (options.Contains("FixedOrientation")) nOrientations = 1;
+  TString configFile = argv[2];
+  int nThreads = argc > 3 ? atoi(argv[3]) : 0;
+  Long64_t memoryMB = argc > 4 ? atol(argv[4]) : 4096;
+
+  // Histograms are made on several threads, so they must not be registered
+  // in the shared current directory. ROOT 5 has no EnableThreadSafety():
+#if ROOT_VERSION_CODE >= ROOT_VERSION(6,4,0)
+  ROOT::EnableThreadSafety();
+#else
+  TThread::Initialize();
+#endif
+  TH1::AddDirectory(kFALSE);
+
+  if (!options.Contains("NoCache")) {
+    cache = new ResultCache("../TestBeamOutput/cache");
+  }
+  budget = new MemoryBudget(memoryMB);
+  std::vector<RunConfig*> runs = RunConfig::loadRuns(configFile);
+  std::vector<RunJob*> jobs;
+  jobs.clear();
+
+  TStopwatch timer;
+  timer.Start();
+  ThreadPool *pool = new ThreadPool(nThreads);
+  std::cout << "TestBeamBatch: " << runs.size() << " runs on "
+	    << pool->getNThreads() << " threads with " << memoryMB << " MB."
+	    << std::endl;
+
+  // Start each run as soon as its memory is available:
+  for (int i_r = 0; i_r < (int)runs.size(); i_r++) {
+    RunJob *job = new RunJob();
+    job->config = runs[i_r];
+    job->outputDir = Form("../TestBeamOutput/TestBeamBatch/%s",
+			  runs[i_r]->getRunName().Data());
+    gSystem->mkdir(job->outputDir, kTRUE);
+    job->pipeline = NULL;
+    job->chips = NULL;
+    job->mapper = NULL;
+    job->skimFEI4 = NULL;
+    job->maskT3MAPS = NULL;
+    job->maskFEI4 = NULL;
+    job->nBlocksLeft = 0;
+    pthread_mutex_init(&job->mutex, NULL);
+    job->memory = budget->acquire(estimateMemory(runs[i_r]));
+    jobs.push_back(job);
+    pool->submit(new RunTask(job));
+  }
+  pool->wait();
+  timer.Stop();
+  pool->printStatistics();
+  std::cout << "TestBeamBatch: Finished " << runs.size() << " runs in "
+	    << timer.RealTime() << " s." << std::endl;
+
+  delete pool;
+  for (int i_j = 0; i_j < (int)jobs.size(); i_j++) {
+    pthread_mutex_destroy(&jobs[i_j]->mutex);
+    delete jobs[i_j]->config;
+    delete jobs[i_j];
+  }
+  delete budget;
+  if (cache) delete cache;
+  return 0;
+}
@@ -0,0 +1,505 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: TestBeamBench.cxx                                                   //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This program times the core kernels of the analysis on synthetic inputs:  //
+//  the clustering and tracklet fits of PixelCluster, MatchMaker::matchHits,  //
+//  the two directions of the MapParameters map, HitMatcher::isMasked, the    //
+//  map filling of MapParameters, and the parsing of the T3MAPS history file  //
+//  by LoadT3MAPS. The kernels that depend on the number of hits are run for  //
+//  several fixed hit multiplicities.                                         //
+//                                                                            //
+//  Each kernel is repeated until it has run for at least minTime seconds,    //
+//  and the time and the memory allocations (counted by replacing operator    //
+//  new in this program, or by Instrument in builds with                      //
+//  -DTESTBEAM_TRACK_ALLOC) are reported per operation. The results are       //
+//  written as JSON, or as CSV with the "CSV" option, to the file given on    //
+//  the command line, e.g. "make bench" runs                                  //
+//                                                                            //
+//    ./bin/TestBeamBench JSON ../TestBeamOutput/TestBeamBench/micro.json     //
+//                                                                            //
+//  Program options:                                                          //
+//                                                                            //
+//    "CSV" writes CSV instead of JSON.                                       //
+//                                                                            //
+//    "Quick" runs each kernel for a shorter time, for a fast check.          //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// C++ includes:
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <iostream>
+#include <fstream>
+#include <new>
+#include <vector>
+#include <string>
+
+// ROOT includes:
+#include "TH1.h"
+#include "TRandom3.h"
+#include "TString.h"
+#include "TSystem.h"
+
+// Package includes:
+#include "BeamGenerator.h"
+#include "ChipDimension.h"
+#include "HitMatcher.h"
+#include "Instrument.h"
+#include "LoadT3MAPS.h"
+#include "MapParameters.h"
+#include "MatchMaker.h"
+#include "PixelCluster.h"
+#include "PixelHit.h"
+#include "RunConfig.h"
+
+using namespace std;
+
+#ifdef TESTBEAM_TRACK_ALLOC
+
+// Instrument replaces operator new in this build, and counts for us:
+static Long64_t getNAllocations() {
+  return Instrument::getNAllocations();
+}
+
+static Long64_t getNAllocatedBytes() {
+  return Instrument::getNAllocatedBytes();
+}
+
+#else
+
+// Counters of the memory allocations, for the whole program:
+static Long64_t nAllocations = 0;
+static Long64_t nAllocatedBytes = 0;
+
+void *operator new(size_t size) {
+  nAllocations++;
+  nAllocatedBytes += (Long64_t)size;
+  void *pointer = malloc(size > 0 ? size : 1);
+  if (!pointer) throw std::bad_alloc();
+  return pointer;
+}
+
+void operator delete(void *pointer) {
+  free(pointer);
+}
+
+static Long64_t getNAllocations() {
+  return nAllocations;
+}
+
+static Long64_t getNAllocatedBytes() {
+  return nAllocatedBytes;
+}
+
+#endif
+
+// The result of timing one kernel:
+struct BenchResult {
+  TString kernel;
+  int nHits;// hits per chip and event, 0 if the kernel does not depend on it
+  Long64_t nOperations;
+  double nsPerOperation;
+  double allocationsPerOperation;
+  double bytesPerOperation;
+};
+
+// A kernel to time. run() does nOperations operations:
+class BenchKernel {
+ public:
+  virtual ~BenchKernel() {};
+  virtual void run(Long64_t nOperations) = 0;
+};
+
+// The synthetic inputs:
+ChipDimension *chips = new ChipDimension();
+TRandom3 *randomGen = new TRandom3(1);
+
+// Number of different events that the kernels cycle through:
+const int nEvents = 64;
+
+/**
+   Get the monotonic clock time in nanoseconds.
+*/
+double getTimeNs() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return 1e9 * (double)now.tv_sec + (double)now.tv_nsec;
+}
+
+/**
+   Make the hits of one synthetic event in a chip. The hits come in small
+   clusters of up to three adjacent pixels, as from a particle crossing the
+   chip at an angle.
+   @param chipName - "FEI4" or "T3MAPS".
+   @param nHits - the number of hits.
+   @returns - the hits (owned by the caller).
+*/
+vector<PixelHit*> makeHits(string chipName, int nHits) {
+  int nRow = chips->getNRow(chipName);
+  int nCol = chips->getNCol(chipName);
+  vector<PixelHit*> hits; hits.clear();
+  int row = 0; int col = 0;
+  for (int i_h = 0; i_h < nHits; i_h++) {
+    if (i_h % 3 == 0 || randomGen->Rndm() < 0.3) {
+      row = (int)randomGen->Integer(nRow);
+      col = (int)randomGen->Integer(nCol);
+    }
+    else {
+      row = row + 1 < nRow ? row + 1 : row - 1;
+    }
+    hits.push_back(new PixelHit(row, col, 0, (int)randomGen->Integer(14),
+				false));
+  }
+  return hits;
+}
+
+// Builds the clusters in both chips with MatchMaker:
+class ClusterKernel : public BenchKernel {
+ public:
+  ClusterKernel(MapParameters *mapper, int nHits) {
+    for (int i_e = 0; i_e < nEvents; i_e++) {
+      matchers.push_back(new MatchMaker(mapper));
+      vector<PixelHit*> hitsFEI4 = makeHits("FEI4", nHits);
+      vector<PixelHit*> hitsT3MAPS = makeHits("T3MAPS", nHits);
+      for (int i_h = 0; i_h < nHits; i_h++) {
+	matchers[i_e]->addHitInFEI4(hitsFEI4[i_h]);
+	matchers[i_e]->addHitInT3MAPS(hitsT3MAPS[i_h]);
+      }
+    }
+  }
+  void run(Long64_t nOperations) {
+    for (Long64_t i_o = 0; i_o < nOperations; i_o++) {
+      matchers[i_o % nEvents]->buildAndMatchClusters();
+    }
+  }
+  vector<MatchMaker*> matchers;
+};
+
+// Matches the hits of both chips with MatchMaker:
+class MatchKernel : public ClusterKernel {
+ public:
+  MatchKernel(MapParameters *mapper, int nHits)
+    : ClusterKernel(mapper, nHits) {};
+  void run(Long64_t nOperations) {
+    for (Long64_t i_o = 0; i_o < nOperations; i_o++) {
+      matchers[i_o % nEvents]->matchHits();
+    }
+  }
+};
+
+// Fits the tracklet of a new cluster:
+class TrackletKernel : public BenchKernel {
+ public:
+  TrackletKernel(int nHits) {
+    for (int i_e = 0; i_e < nEvents; i_e++) {
+      // A straight track through adjacent pixels:
+      vector<PixelHit*> hits; hits.clear();
+      int row = 10 + (int)randomGen->Integer(250);
+      int col = 10 + (int)randomGen->Integer(60);
+      for (int i_h = 0; i_h < nHits; i_h++) {
+	hits.push_back(new PixelHit(row + i_h, col + (i_h / 4), 0,
+				    (int)randomGen->Integer(14), false));
+      }
+      events.push_back(hits);
+    }
+  }
+  void run(Long64_t nOperations) {
+    for (Long64_t i_o = 0; i_o < nOperations; i_o++) {
+      vector<PixelHit*> &hits = events[i_o % nEvents];
+      PixelCluster *cluster = new PixelCluster("FEI4");
+      for (int i_h = 0; i_h < (int)hits.size(); i_h++) {
+	cluster->addHit(hits[i_h]);
+      }
+      cluster->fitTracklet();
+      delete cluster;
+    }
+  }
+  vector<vector<PixelHit*> > events;
+};
+
+// Maps T3MAPS pixels to FEI4 (forward) or FEI4 pixels to T3MAPS (inverse):
+class MapKernel : public BenchKernel {
+ public:
+  MapKernel(MapParameters *newMapper, bool newForward) {
+    mapper = newMapper;
+    forward = newForward;
+    string chipName = forward ? "T3MAPS" : "FEI4";
+    for (int i_e = 0; i_e < nEvents; i_e++) {
+      rows.push_back((int)randomGen->Integer(chips->getNRow(chipName)));
+      cols.push_back((int)randomGen->Integer(chips->getNCol(chipName)));
+    }
+    result = 0;
+  }
+  void run(Long64_t nOperations) {
+    int sum = 0;
+    for (Long64_t i_o = 0; i_o < nOperations; i_o++) {
+      int i_e = (int)(i_o % nEvents);
+      if (forward) {
+	sum += mapper->getFEI4fromT3MAPS("rowVal", rows[i_e]);
+	sum += mapper->getFEI4fromT3MAPS("colVal", cols[i_e]);
+      }
+      else {
+	sum += mapper->getT3MAPSfromFEI4("rowVal", rows[i_e]);
+	sum += mapper->getT3MAPSfromFEI4("colVal", cols[i_e]);
+      }
+    }
+    result += sum;
+  }
+  MapParameters *mapper;
+  bool forward;
+  vector<int> rows;
+  vector<int> cols;
+  int result;
+};
+
+// Checks whether FEI4 pixels are masked:
+class MaskKernel : public BenchKernel {
+ public:
+  MaskKernel(HitMatcher *newMatcher) {
+    matcher = newMatcher;
+    for (int i_e = 0; i_e < nEvents; i_e++) {
+      rows.push_back((int)randomGen->Integer(chips->getNRow("FEI4")));
+      cols.push_back((int)randomGen->Integer(chips->getNCol("FEI4")));
+    }
+    result = 0;
+  }
+  void run(Long64_t nOperations) {
+    int sum = 0;
+    for (Long64_t i_o = 0; i_o < nOperations; i_o++) {
+      int i_e = (int)(i_o % nEvents);
+      if (matcher->isMasked("FEI4", rows[i_e], cols[i_e])) sum++;
+    }
+    result += sum;
+  }
+  HitMatcher *matcher;
+  vector<int> rows;
+  vector<int> cols;
+  int result;
+};
+
+// Adds hit pairs to the signal or background histograms of a map:
+class FillKernel : public BenchKernel {
+ public:
+  FillKernel(MapParameters *newMapper, bool newSignal) {
+    mapper = newMapper;
+    signal = newSignal;
+    hitsFEI4 = makeHits("FEI4", nEvents);
+    hitsT3MAPS = makeHits("T3MAPS", nEvents);
+  }
+  void run(Long64_t nOperations) {
+    for (Long64_t i_o = 0; i_o < nOperations; i_o++) {
+      int i_e = (int)(i_o % nEvents);
+      if (signal) mapper->addPairToMap(hitsFEI4[i_e], hitsT3MAPS[i_e]);
+      else mapper->addPairToBkg(hitsFEI4[i_e], hitsT3MAPS[i_e]);
+    }
+  }
+  MapParameters *mapper;
+  bool signal;
+  vector<PixelHit*> hitsFEI4;
+  vector<PixelHit*> hitsT3MAPS;
+};
+
+/**
+   Time a kernel. The number of operations is doubled until the kernel runs
+   for at least minTime seconds.
+   @param kernel - the kernel.
+   @param name - the name of the kernel in the output.
+   @param nHits - the hit multiplicity of the inputs (0 if not relevant).
+   @param minTime - the minimum time in seconds.
+   @returns - the time and allocations per operation.
+*/
+BenchResult timeKernel(BenchKernel *kernel, TString name, int nHits,
+		       double minTime) {
+  // One untimed operation to fill the caches:
+  kernel->run(1);
+
+  BenchResult result;
+  result.kernel = name;
+  result.nHits = nHits;
+  Long64_t nOperations = 1;
+  while (true) {
+    Long64_t allocationsBefore = getNAllocations();
+    Long64_t bytesBefore = getNAllocatedBytes();
+    double start = getTimeNs();
+    kernel->run(nOperations);
+    double elapsed = getTimeNs() - start;
+    if (elapsed >= 1e9 * minTime || nOperations >= (1LL << 40)) {
+      result.nOperations = nOperations;
+      result.nsPerOperation = elapsed / nOperations;
+      result.allocationsPerOperation
+	= (double)(getNAllocations() - allocationsBefore) / nOperations;
+      result.bytesPerOperation
+	= (double)(getNAllocatedBytes() - bytesBefore) / nOperations;
+      break;
+    }
+    nOperations *= 2;
+  }
+  cout << "TestBeamBench: " << name << " (" << nHits << " hits) = "
+       << result.nsPerOperation << " ns, "
+       << result.allocationsPerOperation << " allocations per operation"
+       << endl;
+  return result;
+}
+
+/**
+   Time the parsing of a synthetic T3MAPS history file by LoadT3MAPS.
+   @param nScans - the number of scans in the file.
+   @param beamRate - the beam rate, which sets the hits per scan.
+   @param outputDir - the directory for the synthetic files.
+   @returns - the time and allocations per scan.
+*/
+BenchResult timeParser(int nScans, double beamRate, TString outputDir) {
+  RunConfig *config = new RunConfig("TestBeamBench");
+  config->setValue("simScans", Form("%d", nScans));
+  config->setValue("simBeamRate", Form("%f", beamRate));
+  config->setValue("simScanGap", "0");
+  // Only the T3MAPS history is used, so no FEI4 hits are made:
+  config->setValue("simEffFEI4", "0");
+  config->setValue("simNoisyFEI4", "0");
+  TString history = Form("%s/history_rate%d.txt", outputDir.Data(),
+			 (int)beamRate);
+  BeamGenerator *generator = new BeamGenerator(config);
+  BeamSummary summary
+    = generator->generate(Form("%s/T3MAPS_gen.root", outputDir.Data()),
+			  Form("%s/FEI4_gen.root", outputDir.Data()), history);
+  delete generator;
+  delete config;
+  int nHits = (int)((summary.nHitsT3MAPS + summary.nNoiseHitsT3MAPS)
+		    / (summary.nScans > 0 ? summary.nScans : 1));
+
+  BenchResult result;
+  result.kernel = "LoadT3MAPS::parse";
+  result.nHits = nHits;
+  result.nOperations = nScans;
+  Long64_t allocationsBefore = getNAllocations();
+  Long64_t bytesBefore = getNAllocatedBytes();
+  double start = getTimeNs();
+  LoadT3MAPS *loader
+    = new LoadT3MAPS((string)history,
+		     (string)Form("%s/T3MAPS_parsed.root", outputDir.Data()));
+  double elapsed = getTimeNs() - start;
+  result.nsPerOperation = elapsed / nScans;
+  result.allocationsPerOperation
+    = (double)(getNAllocations() - allocationsBefore) / nScans;
+  result.bytesPerOperation
+    = (double)(getNAllocatedBytes() - bytesBefore) / nScans;
+  delete loader;
+
+  cout << "TestBeamBench: " << result.kernel << " (" << nHits << " hits) = "
+       << result.nsPerOperation << " ns, "
+       << result.allocationsPerOperation << " allocations per scan" << endl;
+  return result;
+}
+
+/**
+   The main method times every kernel and writes the results.
+   @param option - "CSV" for CSV output, "Quick" for short timing.
+   @param outputFile - (optional) the output file.
+   @returns - 0. Writes the results to the output file.
+*/
+int main(int argc, char **argv) {
+  // Check arguments:
+  if (argc < 2) {
+    cout << "\nUsage: " << argv[0] << " <option> [output file]" << endl;
+    exit(0);
+  }
+  TString options = argv[1];
+  bool useCSV = options.Contains("CSV");
+  TString outputFile = argc > 2 ? argv[2] :
+    (useCSV ? "../TestBeamOutput/TestBeamBench/micro.csv" :
+     "../TestBeamOutput/TestBeamBench/micro.json");
+  TString outputDir = gSystem->DirName(outputFile);
+  gSystem->mkdir(outputDir, kTRUE);
+  double minTime = options.Contains("Quick") ? 0.05 : 0.5;
+
+  // The cluster histograms all have the same name:
+  TH1::AddDirectory(kFALSE);
+
+  // A map for the matching, with the usual orientation and offsets:
+  MapParameters *mapper = new MapParameters("", "");
+  mapper->setMapVar(1, 8.0);
+  mapper->setMapVar(3, 10.0);
+  mapper->setMapErr(1, chips->getRowPitch("FEI4"));
+  mapper->setMapErr(3, chips->getColPitch("FEI4"));
+  mapper->setMapExists(true);
+
+  // A mask of 1% of the FEI4 pixels:
+  HitMatcher *matcher = new HitMatcher(mapper, chips, 0.0);
+  int nPixelsFEI4 = chips->getNRow("FEI4") * chips->getNCol("FEI4");
+  for (int i_p = 0; i_p < nPixelsFEI4 / 100; i_p++) {
+    matcher->maskPixel("FEI4", (int)randomGen->Integer(chips->getNRow("FEI4")),
+		       (int)randomGen->Integer(chips->getNCol("FEI4")));
+  }
+
+  vector<BenchResult> results; results.clear();
+
+  // The kernels that depend on the number of hits per event:
+  int multiplicities[4] = {1, 4, 16, 64};
+  for (int i_m = 0; i_m < 4; i_m++) {
+    int nHits = multiplicities[i_m];
+    ClusterKernel *clusterKernel = new ClusterKernel(mapper, nHits);
+    results.push_back(timeKernel(clusterKernel, "PixelCluster::clustering",
+				 nHits, minTime));
+    TrackletKernel *trackletKernel = new TrackletKernel(nHits);
+    results.push_back(timeKernel(trackletKernel, "PixelCluster::fitTracklet",
+				 nHits, minTime));
+    MatchKernel *matchKernel = new MatchKernel(mapper, nHits);
+    results.push_back(timeKernel(matchKernel, "MatchMaker::matchHits", nHits,
+				 minTime));
+  }
+
+  // The kernels of single pixels:
+  results.push_back(timeKernel(new MapKernel(mapper, true),
+			       "MapParameters::getFEI4fromT3MAPS", 0, minTime));
+  results.push_back(timeKernel(new MapKernel(mapper, false),
+			       "MapParameters::getT3MAPSfromFEI4", 0, minTime));
+  results.push_back(timeKernel(new MaskKernel(matcher), "HitMatcher::isMasked",
+			       0, minTime));
+  results.push_back(timeKernel(new FillKernel(mapper, true),
+			       "MapParameters::addPairToMap", 0, minTime));
+  results.push_back(timeKernel(new FillKernel(mapper, false),
+			       "MapParameters::addPairToBkg", 0, minTime));
+
+  // The parser, for a quiet and a busy beam:
+  int nScans = options.Contains("Quick") ? 1000 : 10000;
+  results.push_back(timeParser(nScans, 20.0, outputDir));
+  results.push_back(timeParser(nScans, 500.0, outputDir));
+
+  // Write the results:
+  ofstream output(outputFile.Data());
+  if (!output.is_open()) {
+    cout << "TestBeamBench: Could not open " << outputFile << endl;
+    exit(0);
+  }
+  if (useCSV) {
+    output << "kernel,hits,operations,ns_per_op,allocs_per_op,bytes_per_op"
+	   << endl;
+    for (int i_r = 0; i_r < (int)results.size(); i_r++) {
+      output << results[i_r].kernel << "," << results[i_r].nHits << ","
+	     << results[i_r].nOperations << ","
+	     << results[i_r].nsPerOperation << ","
+	     << results[i_r].allocationsPerOperation << ","
+	     << results[i_r].bytesPerOperation << endl;
+    }
+  }
+  else {
+    output << "{\n  \"benchmark\": \"TestBeamBench\",\n  \"results\": [\n";
+    for (int i_r = 0; i_r < (int)results.size(); i_r++) {
+      output << "    {\"kernel\": \"" << results[i_r].kernel
+	     << "\", \"hits\": " << results[i_r].nHits
+	     << ", \"operations\": " << results[i_r].nOperations
+	     << ", \"ns_per_op\": " << results[i_r].nsPerOperation
+	     << ", \"allocs_per_op\": " << results[i_r].allocationsPerOperation
+	     << ", \"bytes_per_op\": " << results[i_r].bytesPerOperation << "}"
+	     << (i_r + 1 < (int)results.size() ? ",\n" : "\n");
+    }
+    output << "  ]\n}" << endl;
+  }
+  output.close();
+  cout << "TestBeamBench: Results written to " << outputFile << endl;
+  return 0;
+}
@@ -0,0 +1,233 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: TestBeamMonitor.cxx                                                 //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This program follows the T3MAPS history.txt file and the FEI4 ROOT file   //
+//  while they are still being written, and matches each new T3MAPS scan to   //
+//  the FEI4 events as soon as the FEI4 data have moved past its integration  //
+//  window. The running efficiencies are printed after every update, so that  //
+//  they are available during beam time instead of after the run.             //
+//                                                                            //
+//  The cumulative and last-5-minute counters are also published in shared    //
+//  memory and in a snapshot file (see EfficiencyMonitor). Another process    //
+//  can print them with the "Watch" option.                                   //
+//                                                                            //
+//  The pixel masks are read from the results file that TestBeamTracks wrote  //
+//  for the same run. The map of each scan is interpolated to the time of     //
+//  the scan from the alignment database (see AlignmentDB), so that a slow    //
+//  drift of the alignment during the run is followed.                        //
+//                                                                            //
+//  Program options:                                                          //
+//    "RunI" or "RunII" select the pixel masks.                               //
+//    "Once" processes the data that are currently available, then exits.     //
+//    "Watch" only prints the counters published by a running monitor.        //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// C++ includes:
+#include <stdlib.h>
+#include <stdio.h>
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+
+// ROOT includes:
+#include "TFile.h"
+#include "TString.h"
+#include "TSystem.h"
+#include "TTree.h"
+
+// Package includes:
+#include "ChipDimension.h"
+#include "EfficiencyMonitor.h"
+#include "EventBuilder.h"
+#include "HitMatcher.h"
+#include "LoadT3MAPS.h"
+#include "MapParameters.h"
+#include "ResultsFile.h"
+#include "TreeFEI4.h"
+
+using namespace std;
+
+/**
+   Load the pixel masks that TestBeamTracks stored for the run. The matching
+   runs without masks if TestBeamTracks has not been run yet.
+   @param matcher - the hit matcher to mask.
+   @param runName - the name of the run.
+*/
+void loadMasks(HitMatcher *matcher, TString runName) {
+  TString fileName = Form("../TestBeamOutput/TestBeamTracks/results_%s.root",
+			  runName.Data());
+  if (gSystem->AccessPathName(fileName)) {
+    std::cout << "TestBeamMonitor: No mask file " << fileName << std::endl;
+    return;
+  }
+  ResultsFile *results = new ResultsFile(fileName, "READ");
+  matcher->setMask("FEI4", results->getMask("MaskFEI4"));
+  matcher->setMask("T3MAPS", results->getMask("MaskT3MAPS"));
+  delete results;
+}
+
+/**
+   The main method requires an option, the T3MAPS history file and the FEI4
+   ROOT file. The time offset is optional.
+   @param option - "RunI" or "RunII" to select the masks, plus "Once" or
+   "Watch".
+   @returns - 0. Prints the efficiencies as scans are matched.
+*/
+int main(int argc, char **argv) {
+  TString options = argc > 1 ? argv[1] : "";
+  int pollInterval = 2000;// milliseconds
+  TString runName = options.Contains("RunII") ? "RunII" : "RunI";
+  TString sharedName = Form("/TestBeamMonitor_%s", runName.Data());
+  
+  // Print the counters from a monitor running in another process:
+  if (options.Contains("Watch")) {
+    MonitorSnapshot snapshot;
+    while (true) {
+      if (EfficiencyMonitor::readShared(sharedName, snapshot)) {
+	EfficiencyMonitor::printSnapshot(snapshot);
+      }
+      else std::cout << "TestBeamMonitor: No monitor running." << std::endl;
+      gSystem->Sleep(pollInterval);
+    }
+  }
+  
+  // Check arguments:
+  if (argc < 4) {
+    std::cout << "\nUsage: " << argv[0]
+	      << " <option> <history.txt> <FEI4.root> [timing]" << std::endl;
+    exit(0);
+  }
+  std::string inputT3MAPS = argv[2];
+  TString inputFEI4 = argv[3];
+  double timeOffset = (argc > 4) ? atof(argv[4]) : 0.67;
+
+  // Load the chip sizes and the map:
+  ChipDimension *chips = new ChipDimension();
+  MapParameters *mapper = new MapParameters("../TestBeamOutput","FromFile");
+  mapper->setOrientation(1);
+  
+  // The maps of this run, to follow the alignment as it drifts:
+  AlignmentDB *alignments
+    = new AlignmentDB("../TestBeamOutput/MapParameters/alignment.db");
+  AlignmentEntry alignment;
+  bool followAlignment = (alignments->load() &&
+			  alignments->getAlignment(runName, -1, alignment));
+  if (!followAlignment) {
+    std::cout << "TestBeamMonitor: No alignment for " << runName
+	      << ", using the latest map." << std::endl;
+  }
+
+  // Load the masks from the offline analysis:
+  HitMatcher *matcher = new HitMatcher(mapper, chips, timeOffset);
+  loadMasks(matcher, runName);
+
+  // Follow the T3MAPS text file, writing rolling ROOT files:
+  LoadT3MAPS *lT = new LoadT3MAPS(inputT3MAPS, "../TestBeamOutput/TestBeamMonitor/T3MAPS_live.root", "Follow");
+
+  TreeFEI4 *cF = NULL;
+  EventBuilder *eventsFEI4 = new EventBuilder();
+  Long64_t eventFEI4 = 0;
+  int nextScan = 0;
+  int nRestartsT3MAPS = 0;
+  MatchCounts scanCounts;
+  
+  // Keep the counters for the whole run and for the last 5 minutes:
+  EfficiencyMonitor *monitor = new EfficiencyMonitor(300.0, 10.0, Form("../TestBeamOutput/TestBeamMonitor/snapshot_%s.txt", runName.Data()), sharedName);
+
+  std::cout << "TestBeamMonitor: Following " << inputT3MAPS << " and "
+	    << inputFEI4 << std::endl;
+  while (true) {
+
+    // Read new T3MAPS scans:
+    int nNewScans = lT->poll();
+    
+    // The history file was replaced, so its scans are numbered from 0 again:
+    if (lT->getNRestarts() != nRestartsT3MAPS) {
+      nRestartsT3MAPS = lT->getNRestarts();
+      nextScan = 0;
+      eventFEI4 = 0;
+    }
+
+    // Open the FEI4 file once it exists, then read only the new entries:
+    bool newFEI4 = false;
+    if (!cF) {
+      TFile *fileFEI4 = new TFile(inputFEI4);
+      TTree *myTreeFEI4 = fileFEI4->IsOpen() ?
+	(TTree*)fileFEI4->Get("Table") : NULL;
+      if (myTreeFEI4) cF = new TreeFEI4(myTreeFEI4);
+      else delete fileFEI4;
+    }
+    else cF->fChain->Refresh();
+    if (cF && cF->fChain->GetEntries() > eventsFEI4->getNEntriesRead()) {
+      eventsFEI4->addEntries(cF);
+      newFEI4 = true;
+    }
+
+    // Match the scans whose window the FEI4 data have already passed:
+    int nMatchedScans = 0;
+    Long64_t nEventsFEI4 = eventsFEI4->getNEvents();
+    double timeFEI4 = nEventsFEI4 > 0 ?
+      eventsFEI4->getEvent(nEventsFEI4-1)->timestamp_start : 0.0;
+    while (nextScan < lT->getNEvents()) {
+      if (nextScan < lT->getFirstBufferedScan()) {
+	std::cout << "TestBeamMonitor: Scans " << nextScan << " to "
+		  << lT->getFirstBufferedScan()-1
+		  << " left the buffer before they were matched." << std::endl;
+	nextScan = lT->getFirstBufferedScan();
+      }
+      ScanT3MAPS *currScan = lT->getScan(nextScan);
+      if (!options.Contains("Once") &&
+	  currScan->timestamp_stop + timeOffset >= timeFEI4) break;
+      if (followAlignment) {
+	alignments->getAlignment(runName, currScan->timestamp_start, alignment);
+	mapper->setAlignment(alignment);
+      }
+      HitMatcher::resetCounts(scanCounts);
+      matcher->matchScan(&currScan->hit_row, &currScan->hit_column,
+			 currScan->timestamp_start, currScan->timestamp_stop,
+			 eventsFEI4, eventFEI4, scanCounts);
+      monitor->addScan(currScan->timestamp_stop, scanCounts);
+      nextScan++;
+      nMatchedScans++;
+    }
+
+    // Drop the FEI4 events that are older than every buffered scan:
+    if (lT->getNEvents() > lT->getFirstBufferedScan()) {
+      ScanT3MAPS *oldestScan = lT->getScan(lT->getFirstBufferedScan());
+      Long64_t nDrop = eventsFEI4->findFirstEvent(oldestScan->timestamp_start
+						  + timeOffset);
+      // Keep the event at the cursor and the one still being read:
+      if (nDrop > eventFEI4) nDrop = eventFEI4;
+      if (nDrop > eventsFEI4->getNEvents() - 1) {
+	nDrop = eventsFEI4->getNEvents() - 1;
+      }
+      if (nDrop > 0) {
+	eventsFEI4->dropEvents(nDrop);
+	eventFEI4 -= nDrop;
+      }
+    }
+    
+    // Publish and print the running efficiencies:
+    if (nMatchedScans > 0) {
+      monitor->publish(false);
+      monitor->printSnapshot(monitor->getSnapshot());
+    }
+    
+    if (options.Contains("Once")) break;
+    if (nNewScans == 0 && !newFEI4) gSystem->Sleep(pollInterval);
+  }
+
+  monitor->publish(true);
+  lT->closeFiles();
+  if (cF) delete cF;
+  delete eventsFEI4;
+  delete monitor;
+  delete alignments;
+  std::cout << "\nTestBeamMonitor: Finished." << std::endl;
+  return 0;
+}
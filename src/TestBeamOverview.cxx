@@ -15,7 +15,18 @@
 //                   hits for the integration period.                         //
 //                                                                            //
 //    "RunI" or "RunII" as an option will implement the proper cuts and load  //
-//    the corresponding datasets.                                             //
+//    the corresponding datasets. Alternatively, give a run configuration     //
+//    file (see config/runs.cfg) and the name of the run in it.               //
+//                                                                            //
+//  The T3MAPS scans and the FEI4 events are read together in one pass, in    //
+//  time order, which gives the live time, the dead time between the scans,   //
+//  the beam rate and the hits per integration period of each rateWindow      //
+//  seconds of the run (see RateSeries).                                      //
+//                                                                            //
+//  The occupancies, pixel masks, rates and the "RateSeries" time series are  //
+//  stored in the results file                                                //
+//  TestBeamOutput/TestBeamOverview/results_<run name>.root (see              //
+//  ResultsFile).                                                             //
 //                                                                            //
 // WARNING! MUST UPDATE totalPixFEI4 corresponding to the overlapping area.   //
 //                                                                            //
@@ -38,10 +49,16 @@
 
 // Package includes:
 #include "ChipDimension.h"
+#include "EventBuilder.h"
+#include "FixedHist.h"
 #include "MatchMaker.h"
 #include "PixelCluster.h"
 #include "PixelHit.h"
+#include "RateSeries.h"
+#include "ResultsFile.h"
+#include "RunConfig.h"
 #include "TreeFEI4.h"
+#include "TimeIndex.h"
 #include "TreeT3MAPS.h"
 #include "PlotUtil.h"
 #include "MapParameters.h"
@@ -51,26 +68,34 @@ using namespace std;
 /**
    The main method just requires an option to run. 
    @param option - "RunI" or "RunII" to select the desired dataset.
+   @param config - (optional) a run configuration file.
+   @param run - (optional) the run to analyse from the configuration file.
    @returns - 0. Prints plots to TestBeamOutput/TestBeamOverview/ directory.
 */
 int main(int argc, char **argv) {
   // Check arguments:
   if (argc < 2) {
-    std::cout << "\nUsage: " << argv[0] << " <option>" << std::endl; 
+    std::cout << "\nUsage: " << argv[0] << " <option> [run config] [run]"
+	      << std::endl; 
     exit(0);
   }
   TString options = argv[1];
+  RunConfig *config = RunConfig::getRun(options, argc > 2 ? argv[2] : "",
+					argc > 3 ? argv[3] : "");
+  config->printConfig();
   
   // Fundamental job settings:
-  TString inputT3MAPS = options.Contains("RunII") ?
-    "../TestBeamData/TestBeamData_May9/T3MAPS_May9_RunI.root" :
-    "../TestBeamData/TestBeamData_May3/T3MAPS_May3_RunI.root";
-  TString inputFEI4 = options.Contains("RunII") ?
-    "../TestBeamData/TestBeamData_May9/FEI4_May9_RunI.root" :
-    "../TestBeamData/TestBeamData_May3/FEI4_May3_RunI.root";
-  int noiseThresholdFEI4 = options.Contains("RunII") ? 300 : 600;
-  int noiseThresholdT3MAPS = options.Contains("RunII") ? 15 : 20;
-  double integrationTime = options.Contains("RunII") ? 0.5 : 1.0;
+  TString runName = config->getRunName();
+  TString inputT3MAPS = config->getString("inputT3MAPS");
+  TString inputFEI4 = config->getString("inputFEI4");
+  int noiseThresholdFEI4 = config->getInt("noiseThresholdFEI4");
+  int noiseThresholdT3MAPS = config->getInt("noiseThresholdT3MAPS");
+  double integrationTime = config->getDouble("integrationTime");
+  int maxHitsT3MAPS = config->getInt("maxHitsT3MAPS");
+  double timeOffset = config->getDouble("timeOffset");
+  double rateWindow = config->getDouble("rateWindow");
+  double windowStart = config->getDouble("displayWindowStart");
+  double windowStop = windowStart + config->getDouble("displayWindowLength");
   
   // MUST UPDATE:
   int totalPixFEI4 = 462;//nominal
@@ -92,18 +117,16 @@ int main(int argc, char **argv) {
   // Load the chip sizes (but use defaults!)
   ChipDimension *chips = new ChipDimension();
   
-  // Book histograms:
-  TH2D *occFEI4 = new TH2D("occFEI4", "occFEI4", 
-			   chips->getNRow("FEI4"), -0.5,
-			   (chips->getNRow("FEI4") - 0.5),
-			   chips->getNCol("FEI4"), -0.5,
-			   (chips->getNCol("FEI4") - 0.5));
+  // Book histograms (occupancies are converted to TH2D for plotting):
+  FixedHist *occFEI4 = new FixedHist(chips->getNRow("FEI4"), -0.5,
+				     (chips->getNRow("FEI4") - 0.5),
+				     chips->getNCol("FEI4"), -0.5,
+				     (chips->getNCol("FEI4") - 0.5));
   
-  TH2D *occT3MAPS = new TH2D("occT3MAPS", "occT3MAPS",
-			     chips->getNRow("T3MAPS"), -0.5,
-			     (chips->getNRow("T3MAPS") - 0.5),
-			     chips->getNCol("T3MAPS"), -0.5,
-			     (chips->getNCol("T3MAPS") - 0.5));
+  FixedHist *occT3MAPS = new FixedHist(chips->getNRow("T3MAPS"), -0.5,
+				       (chips->getNRow("T3MAPS") - 0.5),
+				       chips->getNCol("T3MAPS"), -0.5,
+				       (chips->getNCol("T3MAPS") - 0.5));
   
   TH1F *hitPerEvtT3MAPS = new TH1F("hitPerEvtT3MAPS","hitPerEvtT3MAPS",20,0,20);
   TH1F *hitPerEvtFEI4 = new TH1F("hitPerEvtFEI4","hitPerEvtFEI4",100,0,400);
@@ -129,18 +152,69 @@ int main(int argc, char **argv) {
   std::vector<std::pair<int,int> > maskFEI4; maskFEI4.clear();
   std::vector<std::pair<int,int> > maskT3MAPS; maskT3MAPS.clear();
   
+  // Read the FEI4 tree once and group the hits into events:
+  Long64_t entriesFEI4 = cF->fChain->GetEntries();
+  std::cout << "TestBeamOverview: FEI4 entries = " << entriesFEI4 << std::endl;
+  EventBuilder *eventsFEI4 = new EventBuilder();
+  eventsFEI4->addEntries(cF);
+  Long64_t nEventsFEI4 = eventsFEI4->getNEvents();
+  Long64_t eventFEI4 = 0;
+  
+  // The live time, rates and hits per period, followed in one pass:
+  RateSeries *series = new RateSeries(rateWindow, timeOffset);
+  int hitsInPeriod = 0;
+  double periodStart = 0.0;
+  double periodStop = 0.0;
+  
   int plotNum = 0;
-  // Loop over T3MAPS tree.
+  // Loop over T3MAPS tree. The FEI4 events starting before each scan are
+  // processed first, and all of the remaining ones after the last scan:
   Long64_t entriesT3MAPS = cT->fChain->GetEntries();
   std::cout << "TestBeamOverview: T3MAPS entries = " << entriesT3MAPS
 	    << std::endl;
-  for (Long64_t eventT3MAPS = 0; eventT3MAPS < entriesT3MAPS; eventT3MAPS++) {
+  for (Long64_t eventT3MAPS = 0; eventT3MAPS <= entriesT3MAPS; eventT3MAPS++) {
     
-    cT->fChain->GetEntry(eventT3MAPS);
+    bool hasScan = (eventT3MAPS < entriesT3MAPS);
+    if (hasScan) cT->fChain->GetEntry(eventT3MAPS);
+    
+    // Loop over FEI4 events up to the scan:
+    while (eventFEI4 < nEventsFEI4 &&
+	   (!hasScan || (eventsFEI4->getEvent(eventFEI4)->timestamp_start
+			 - timeOffset) < cT->timestamp_start)) {
+      EventFEI4 *currEvent = eventsFEI4->getEvent(eventFEI4);
+      hitPerEvtFEI4->Fill(currEvent->length);
+      series->addEventFEI4(currEvent->timestamp_start,
+			   currEvent->timestamp_stop, currEvent->length);
+      
+      // Count the hits inside the latest integration period:
+      if (eventT3MAPS > 0 &&
+	  currEvent->timestamp_start - timeOffset >= periodStart &&
+	  currEvent->timestamp_stop - timeOffset <= periodStop) {
+	hitsInPeriod += currEvent->length;
+      }
+      
+      // Loop over hits in the event, fill FEI4 occupancy plot:
+      for (Long64_t i_h = currEvent->offset;
+	   i_h < currEvent->offset + currEvent->length; i_h++) {
+	HitFEI4 *currHit = eventsFEI4->getHit(i_h);
+	occFEI4->fill(currHit->row-1, currHit->column-1);
+	nHitsFEI4_total++;
+      }
+      eventFEI4++;
+    }
+    
+    // The previous integration period is complete:
+    if (eventT3MAPS > 0) hitPerPeriodFEI4->Fill(hitsInPeriod);
+    if (!hasScan) break;
+    hitsInPeriod = 0;
+    periodStart = cT->timestamp_start;
+    periodStop = cT->timestamp_stop;
+    series->addScan(cT->timestamp_start, cT->timestamp_stop,
+		    (int)cT->hit_row->size());
     
     int hitsInT3MAPS = 0;
     for (int i_h = 0; i_h < (int)cT->hit_row->size(); i_h++) {
-      occT3MAPS->Fill((*cT->hit_row)[i_h], (*cT->hit_column)[i_h]);
+      occT3MAPS->fill((*cT->hit_row)[i_h], (*cT->hit_column)[i_h]);
       nHitsT3MAPS_total++;
       hitsInT3MAPS++;
     }    
@@ -163,102 +237,65 @@ int main(int argc, char **argv) {
 		 << std::endl;
     }  
   }// end of T3MAPS loop
+  series->finish();
   
-  // Counters and histograms for the FEI4 tree loop:
-  int currEvtFEI4 = 0;
-  int hitsInFEI4 = 0;
-  int hitsInPeriod = 0;
-  double previousTime = 0;  
   TH2D *matchEvtFEI4 = new TH2D("matchEvtFEI4", "matchEvtFEI4",
 				chips->getNRow("FEI4"), -0.5,
 				(chips->getNRow("FEI4") - 0.5),
 				chips->getNCol("FEI4"), -0.5,
 				(chips->getNCol("FEI4") - 0.5));
   
-  // Loop over FEI4 tree:
-  Long64_t entriesFEI4 = cF->fChain->GetEntries();
-  std::cout << "TestBeamOverview: FEI4 entries = " << entriesFEI4 << std::endl;
-  for (Long64_t eventFEI4 = 0; eventFEI4 < entriesFEI4; eventFEI4++) {
-    
-    cF->fChain->GetEntry(eventFEI4);
-    
-    if (cF->event_number != currEvtFEI4) {
-      hitPerEvtFEI4->Fill(hitsInFEI4);
-      hitsInFEI4 = 0;
-    }
-    else {
-      hitsInFEI4++;
-    }
-    
-    // integration time with +/- 1 second window
-    if (cF->timestamp_start > 1430686886 && cF->timestamp_stop < 1430686887) {
-      matchEvtFEI4->Fill(cF->row-1, cF->column-1);
-    }
-    
-    if (cF->timestamp_start >= previousTime && 
-	cF->timestamp_stop < previousTime + integrationTime) {
-      hitsInPeriod++;
-    }
-    else {
-      hitPerPeriodFEI4->Fill(hitsInPeriod);
-      previousTime = cF->timestamp_start;
-      hitsInPeriod = 0;
+  // Seek directly to the display window (FEI4 clock):
+  TimeIndex *indexFEI4 = new TimeIndex(inputFEI4, cF);
+  Long64_t firstEntry = 0; Long64_t lastEntry = 0;
+  indexFEI4->getEntryRange(windowStart, windowStop, firstEntry, lastEntry);
+  EventBuilder *windowFEI4 = new EventBuilder();
+  windowFEI4->addEntries(cF, firstEntry, lastEntry);
+  for (Long64_t i_e = 0; i_e < windowFEI4->getNEvents(); i_e++) {
+    EventFEI4 *currEvent = windowFEI4->getEvent(i_e);
+    if (currEvent->timestamp_start > windowStart &&
+	currEvent->timestamp_stop < windowStop) {
+      for (Long64_t i_h = currEvent->offset;
+	   i_h < currEvent->offset + currEvent->length; i_h++) {
+	HitFEI4 *currHit = windowFEI4->getHit(i_h);
+	matchEvtFEI4->Fill(currHit->row-1, currHit->column-1);
+      }
     }
-    
-    // Fill FEI4 occupancy plot:
-    occFEI4->Fill(cF->row-1, cF->column-1);
-    nHitsFEI4_total++;
   }
   
   std::cout << "TestBeamOverview: Ending loops over data." << std::endl;
   
-  // Save the BusyT3MAPS pixels:
-  ofstream fBusyFEI4;
-  ofstream fBusyT3MAPS;
-  if (options.Contains("RunII")) {
-    fBusyT3MAPS.open("../TestBeamOutput/TestBeamOverview/busyT3MAPS_RunII.txt");
-    fBusyFEI4.open("../TestBeamOutput/TestBeamOverview/busyFEI4_RunII.txt");
-  }
-  else {
-    fBusyT3MAPS.open("../TestBeamOutput/TestBeamOverview/busyT3MAPS_RunI.txt");
-    fBusyFEI4.open("../TestBeamOutput/TestBeamOverview/busyFEI4_RunI.txt");
-  }
-  
   // Fill the FEI4 hit per pixel plots, get mask list:
   for (int i_r = 1; i_r <= chips->getNRow("FEI4"); i_r++) {
     for (int i_c = 1; i_c <= chips->getNCol("FEI4"); i_c++) {
-      int currNHits = (int)occFEI4->GetBinContent(i_r, i_c);
+      int currNHits = (int)occFEI4->getBinContent(i_r, i_c);
       hitPerPixFEI4->Fill(currNHits);
       if (currNHits >= noiseThresholdFEI4) {
 	std::pair<int,int> pairFEI4;
 	pairFEI4.first = i_r-1;
 	pairFEI4.second = i_c-1;
 	maskFEI4.push_back(pairFEI4);
-	fBusyFEI4 << i_r << " " << i_c << std::endl;
       }
     }
   }
-  fBusyFEI4.close();
   
   // Fill the T3MAPS hit per pixel plots, get mask list:
   for (int i_r = 1; i_r <= chips->getNRow("T3MAPS"); i_r++) {
     for (int i_c = 1; i_c <= chips->getNCol("T3MAPS"); i_c++) {
-      int currNHits = (int)occT3MAPS->GetBinContent(i_r, i_c);
+      int currNHits = (int)occT3MAPS->getBinContent(i_r, i_c);
       hitPerPixT3MAPS->Fill(currNHits);
       if (currNHits > noiseThresholdT3MAPS) {
 	std::pair<int,int> pairT3MAPS;
 	pairT3MAPS.first = i_r-1;
 	pairT3MAPS.second = i_c-1;
 	maskT3MAPS.push_back(pairT3MAPS);
-	fBusyT3MAPS << i_r << " " << i_c << std::endl;
       }
     }
   }
-  fBusyT3MAPS.close();
   
   // Start plotting the results:
-  PlotUtil::plotTH2D(occFEI4, "row_{FEI4}", "column_{FEI4}", "hits", "../TestBeamOutput/TestBeamOverview/occupancyFEI4");
-  PlotUtil::plotTH2D(occT3MAPS, "row_{T3MAPS}", "column_{T3MAPS}", "hits", "../TestBeamOutput/TestBeamOverview/occupancyT3MAPS");
+  PlotUtil::plotTH2D(occFEI4->toTH2D("occFEI4"), "row_{FEI4}", "column_{FEI4}", "hits", "../TestBeamOutput/TestBeamOverview/occupancyFEI4");
+  PlotUtil::plotTH2D(occT3MAPS->toTH2D("occT3MAPS"), "row_{T3MAPS}", "column_{T3MAPS}", "hits", "../TestBeamOutput/TestBeamOverview/occupancyT3MAPS");
   PlotUtil::plotTH1F(hitPerEvtFEI4, "hits per event", "entries", "../TestBeamOutput/TestBeamOverview/hitsPerEvtFEI4", true);
   PlotUtil::plotTH1F(hitPerEvtT3MAPS, "hits per event", "entries", "../TestBeamOutput/TestBeamOverview/hitsPerEvtT3MAPS", true);
   PlotUtil::plotTH1F(hitPerPeriodFEI4, "hits per integration period", "entries", "../TestBeamOutput/TestBeamOverview/hitsPerPeriodFEI4", true);
@@ -280,21 +317,24 @@ int main(int argc, char **argv) {
 	    <<  hitPerEvtT3MAPS->GetMean() << std::endl;
   std::cout << "The FEI4 mean hits/integration is "
 	    << hitPerPeriodFEI4->GetMean() << std::endl;
+  std::cout << "Over " << series->getNWindows() << " windows of "
+	    << rateWindow << " s: live time = " << series->getLiveTime()
+	    << " s, dead time = " << series->getDeadTime()
+	    << " s, FEI4 rate = " << series->getRateFEI4() << " hits/s"
+	    << std::endl;
   
   //**********//
   // Start Part Two of the analysis, with cuts implemented:
   std::cout << "\n\nTestBeamOverview: Part Two - Apply Cuts" << std::endl;
 
-  TH2D *cutOccFEI4 = new TH2D("cutOccFEI4", "cutOccFEI4", 
-			      chips->getNRow("FEI4"), -0.5,
-			      (chips->getNRow("FEI4") - 0.5),
-			      chips->getNCol("FEI4"), -0.5,
-			      (chips->getNCol("FEI4") - 0.5));
-  TH2D *cutOccT3MAPS = new TH2D("cutOccT3MAPS", "cutOccT3MAPS", 
-				chips->getNRow("T3MAPS"), -0.5,
-				(chips->getNRow("T3MAPS") - 0.5),
-				chips->getNCol("T3MAPS"), -0.5,
-				(chips->getNCol("T3MAPS") - 0.5));
+  FixedHist *cutOccFEI4 = new FixedHist(chips->getNRow("FEI4"), -0.5,
+					(chips->getNRow("FEI4") - 0.5),
+					chips->getNCol("FEI4"), -0.5,
+					(chips->getNCol("FEI4") - 0.5));
+  FixedHist *cutOccT3MAPS = new FixedHist(chips->getNRow("T3MAPS"), -0.5,
+					  (chips->getNRow("T3MAPS") - 0.5),
+					  chips->getNCol("T3MAPS"), -0.5,
+					  (chips->getNCol("T3MAPS") - 0.5));
   int nPassCutsT3MAPS = 0;
   int nPassCutsFEI4 = 0;
   
@@ -308,8 +348,8 @@ int main(int argc, char **argv) {
   for (Long64_t eventT3MAPS = 0; eventT3MAPS < entriesT3MAPS; eventT3MAPS++) {
     cT->fChain->GetEntry(eventT3MAPS);
     
-    // Remove events with 12 or more hits in one integration period.
-    if ((*cT->hit_row).size() >= 12) continue;
+    // Remove events with too many hits in one integration period.
+    if ((int)(*cT->hit_row).size() >= maxHitsT3MAPS) continue;
 
     if (nIntegrationPeriods == 0) startTime = cT->timestamp_start; 
     stopTime = cT->timestamp_stop;
@@ -329,31 +369,33 @@ int main(int argc, char **argv) {
       }
       if (maskCut) continue;
       
-      cutOccT3MAPS->Fill((*cT->hit_row)[i_h], (*cT->hit_column)[i_h]);
+      cutOccT3MAPS->fill((*cT->hit_row)[i_h], (*cT->hit_column)[i_h]);
       nPassCutsT3MAPS++;
     }// End of loop over T3MAPS hits in each event
   }// End of loop over T3MAPS events
   
-   // Loop over FEI4 tree, again:
+  // Loop over FEI4 hits, again:
   std::cout << "TestBeamOverview: Second loop over FEI4." << std::endl;
-  for (Long64_t eventFEI4 = 0; eventFEI4 < entriesFEI4; eventFEI4++) {
-    cF->fChain->GetEntry(eventFEI4);
+  for (Long64_t i_h = 0; i_h < eventsFEI4->getNHits(); i_h++) {
+    HitFEI4 *currHit = eventsFEI4->getHit(i_h);
     
     // Exclude noisy column 79. 
-    if (cF->column >= 80) continue;
+    if (currHit->column >= 80) continue;
         
     //Uncertainty range:
-    //if (cF->column > 68 || cF->column < 56 || cF->row > 97 || cF->row < 12) {
+    //if (currHit->column > 68 || currHit->column < 56 ||
+    //    currHit->row > 97 || currHit->row < 12) {
     // Nominal range:
-    if (cF->column > 64 || cF->column < 58 || cF->row > 92 || cF->row < 15) {
+    if (currHit->column > 64 || currHit->column < 58 ||
+	currHit->row > 92 || currHit->row < 15) {
       continue;
     }
     
     // Cut masked channels:
     bool maskCut = false;
     for (int i_c = 0; i_c < (int)maskFEI4.size(); i_c++) {
-      if (maskFEI4[i_c].first == (cF->row-1) &&
-	  maskFEI4[i_c].second == (cF->column-1) ) {
+      if (maskFEI4[i_c].first == (currHit->row-1) &&
+	  maskFEI4[i_c].second == (currHit->column-1) ) {
 	maskCut = true;
 	break;
       }
@@ -361,9 +403,9 @@ int main(int argc, char **argv) {
     if (maskCut) continue;
     
     // Fill FEI4 occupancy plot:
-    cutOccFEI4->Fill(cF->row-1, cF->column-1);
+    cutOccFEI4->fill(currHit->row-1, currHit->column-1);
     nPassCutsFEI4++;
-  }// End of loop over FEI4 events.
+  }// End of loop over FEI4 hits.
   
   std::cout << "TestBeamOverview: Finished analysis." << std::endl;
   std::cout << "T3MAPS hits passing cuts = " << nPassCutsT3MAPS << " \t"
@@ -408,7 +450,37 @@ int main(int argc, char **argv) {
   std::cout << "Observe " << (100 * meanHitsPerGoodPixT3MAPS / expOccT3MAPS)
 	    << "% efficiency." << std::endl;
   
-  PlotUtil::plotTH2D(cutOccFEI4, "row_{FEI4}", "column_{FEI4}", "hits", "../TestBeamOutput/TestBeamOverview/cutOccupancyFEI4");
-  PlotUtil::plotTH2D(cutOccT3MAPS, "row_{T3MAPS}", "column_{T3MAPS}", "hits", "../TestBeamOutput/TestBeamOverview/cutOccupancyT3MAPS");
+  PlotUtil::plotTH2D(cutOccFEI4->toTH2D("cutOccFEI4"), "row_{FEI4}", "column_{FEI4}", "hits", "../TestBeamOutput/TestBeamOverview/cutOccupancyFEI4");
+  PlotUtil::plotTH2D(cutOccT3MAPS->toTH2D("cutOccT3MAPS"), "row_{T3MAPS}", "column_{T3MAPS}", "hits", "../TestBeamOutput/TestBeamOverview/cutOccupancyT3MAPS");
+  
+  // Store the occupancies, masks and rates of the run:
+  ResultsFile *results
+    = new ResultsFile(Form("../TestBeamOutput/TestBeamOverview/results_%s.root",
+			   runName.Data()), "RECREATE");
+  FixedHist *occupancies[4] = {occFEI4, occT3MAPS, cutOccFEI4, cutOccT3MAPS};
+  TString occupancyNames[4] = {"occFEI4", "occT3MAPS", "cutOccFEI4",
+			       "cutOccT3MAPS"};
+  for (int i_o = 0; i_o < 4; i_o++) {
+    TH2D *occupancy = occupancies[i_o]->toTH2D(occupancyNames[i_o]);
+    results->writeObject(occupancyNames[i_o], occupancy);
+    delete occupancy;
+  }
+  results->writeMask("MaskT3MAPS", maskT3MAPS);
+  results->writeMask("MaskFEI4", maskFEI4);
+  results->writeValue("nHitsT3MAPS_total", nHitsT3MAPS_total);
+  results->writeValue("nHitsFEI4_total", nHitsFEI4_total);
+  results->writeValue("nPassCutsT3MAPS", nPassCutsT3MAPS);
+  results->writeValue("nPassCutsFEI4", nPassCutsFEI4);
+  results->writeValue("liveFraction", liveFraction);
+  results->writeValue("liveTime", series->getLiveTime());
+  results->writeValue("deadTime", series->getDeadTime());
+  results->writeValue("liveFractionAll", series->getLiveFraction());
+  results->writeValue("rateFEI4", series->getRateFEI4());
+  results->writeObject("RateSeries", series->getTree());
+  results->writeValue("expOccT3MAPS", expOccT3MAPS);
+  results->writeValue("occupancyEfficiency",
+		      meanHitsPerGoodPixT3MAPS / expOccT3MAPS);
+  delete results;
+  delete series;
   return 0;
 }
@@ -13,7 +13,32 @@
 //  of SetAtlasStyle(); Perhaps it would be useful to create a plotting class.//
 //                                                                            //
 //  Options:                                                                  //
-//    "RunI", "RunII", "NoScan"                                               //
+//    "RunI", "RunII", "NoScan", "NoCache", "NoAlign", "DeferPlots",          //
+//    "BackgroundPlots", "ROOTPlotsOnly", "Trace"                             //
+//  Instead of "RunI" or "RunII", a run configuration file (see               //
+//  config/runs.cfg) and the name of a run in it can follow the options.      //
+//                                                                            //
+//  Unless "NoCache" is given, the hit pairs collected for each time offset   //
+//  are stored in TestBeamOutput/cache/ and reused by later jobs with the     //
+//  same inputs, masks and offset.                                            //
+//                                                                            //
+//  The map offsets from the histogram peaks are then refined with a few      //
+//  passes over the signal hit pairs (see MapParameters::alignFromPairs()),   //
+//  unless "NoAlign" is given.                                                //
+//                                                                            //
+//  The hit counters, occupancies, map parameter scans and pixel masks are    //
+//  stored in TestBeamOutput/TestBeamStudies/results.root (see ResultsFile),  //
+//  and the map made with "NoScan" is added to the alignment database for     //
+//  the run (TestBeamOutput/MapParameters/alignment.db, see AlignmentDB).     //
+//                                                                            //
+//  "DeferPlots" draws the plots after the timing scan instead of during it,  //
+//  "BackgroundPlots" draws them in a separate process while the job goes on, //
+//  and "ROOTPlotsOnly" writes the plotted objects to                         //
+//  TestBeamOutput/TestBeamStudies/plots.root without drawing any images.     //
+//                                                                            //
+//  "Trace" writes a timeline of the job (tree reading, mapping, histogram    //
+//  merges and plot rendering) to TestBeamOutput/instrument/ (see             //
+//  Instrument).                                                              //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -32,13 +57,21 @@
 #include "TVirtualFFT.h"
 
 // Package includes:
+#include "AnalysisPipeline.h"
+#include "AnalysisStages.h"
 #include "ChipDimension.h"
+#include "EventBuilder.h"
+#include "FixedHist.h"
+#include "Instrument.h"
 #include "MatchMaker.h"
 #include "PixelCluster.h"
 #include "PixelHit.h"
 #include "TreeFEI4.h"
 #include "TreeT3MAPS.h"
 #include "PlotUtil.h"
+#include "ResultCache.h"
+#include "ResultsFile.h"
+#include "RunConfig.h"
 #include "MapParameters.h"
 
 using namespace std;
@@ -100,30 +133,37 @@ double GetFFTValue(TH1F *h, double frequency) {
    chips (FEI4 and T3MAPS) and produces plots to help identify the mapping.
    @param options - "RunI" or "RunII" to specify the dataset, or "NoScan" to 
    avoid scanning all of the different time offsets for the chip clocks.
+   @param config - (optional) a run configuration file.
+   @param run - (optional) the run to analyse from the configuration file.
  */
 int main(int argc, char **argv) {
   // Check arguments:
   if (argc < 2) {
-    std::cout << "\nUsage: " << argv[0] << " <options>" << std::endl; 
+    std::cout << "\nUsage: " << argv[0] << " <options> [run config] [run]"
+	      << std::endl; 
     exit(0);
   }
   TString options = argv[1];
+  if (options.Contains("Trace")) Instrument::startTrace();
+  RunConfig *config = RunConfig::getRun(options, argc > 2 ? argv[2] : "",
+					argc > 3 ? argv[3] : "");
+  config->printConfig();
   
   // Fundamental job settings:
-  TString inputT3MAPS = options.Contains("RunII") ?
-    "../TestBeamData/TestBeamData_May9/T3MAPS_May9_RunI.root" :
-    "../TestBeamData/TestBeamData_May3/T3MAPS_May3_RunI.root";
-  TString inputFEI4 = options.Contains("RunII") ?
-    "../TestBeamData/TestBeamData_May9/FEI4_May9_RunI.root" :
-    "../TestBeamData/TestBeamData_May3/FEI4_May3_RunI.root";
-  int noiseThresholdFEI4 = options.Contains("RunII") ? 300 : 600;
-  int noiseThresholdT3MAPS = options.Contains("RunII") ? 15 : 20;
-  double integrationTime = options.Contains("RunII") ? 0.5 : 1.0;
+  TString runName = config->getRunName();
+  TString inputT3MAPS = config->getString("inputT3MAPS");
+  TString inputFEI4 = config->getString("inputFEI4");
+  int noiseThresholdFEI4 = config->getInt("noiseThresholdFEI4");
+  int noiseThresholdT3MAPS = config->getInt("noiseThresholdT3MAPS");
+  double integrationTime = config->getDouble("integrationTime");
+  int maxHitsT3MAPS = config->getInt("maxHitsT3MAPS");
+  int rowMinT3MAPS = config->getInt("rowMinT3MAPS");
+  int rowMaxT3MAPS = config->getInt("rowMaxT3MAPS");
   // For Fourier analysis:
-  double frequency = options.Contains("RunII") ? 2.0 : 2.6;
+  double frequency = config->getDouble("frequency");
   
   // Settings for the time offset and offset scan:
-  double measuredOffset = 0.670;
+  double measuredOffset = config->getDouble("timeOffset");
   double timeOffsetMin = -5.0;
   double timeOffsetMax = 5.0;
   double timeOffsetInterval = 0.1;
@@ -133,123 +173,55 @@ int main(int argc, char **argv) {
   maskFEI4.clear();
   maskT3MAPS.clear();
   
-  // Set the plot style:
+  // Set the plot style and output:
   PlotUtil::setAtlasStyle();
-  
-  // Load the T3MAPS TTree:
-  TFile *fileT3MAPS = new TFile(inputT3MAPS);
-  TTree *myTreeT3MAPS = (TTree*)fileT3MAPS->Get("TreeT3MAPS");
-  TreeT3MAPS *cT = new TreeT3MAPS(myTreeT3MAPS);
-  
-  // Load the FEI4 TTree:
-  TFile *fileFEI4 = new TFile(inputFEI4);
-  TTree *myTreeFEI4 = (TTree*)fileFEI4->Get("Table");
-  TreeFEI4 *cF = new TreeFEI4(myTreeFEI4);
+  PlotUtil::setOutputOptions(options,
+			     "../TestBeamOutput/TestBeamStudies/plots.root");
   
   // Load the chip sizes (but use defaults!)
   ChipDimension *chips = new ChipDimension();
   
-  // Occupancy for masking:
-  TH2D *totOccFEI4 = new TH2D("totOccFEI4", "totOccFEI4", 
-			      chips->getNRow("FEI4"), -0.5,
-			      (chips->getNRow("FEI4") - 0.5),
-			      chips->getNCol("FEI4"), -0.5,
-			      (chips->getNCol("FEI4") - 0.5));
-  TH2D *totOccT3MAPS = new TH2D("totOccT3MAPS", "totOccT3MAPS", 
-				chips->getNRow("T3MAPS"), -0.5,
-				(chips->getNRow("T3MAPS") - 0.5),
-				chips->getNCol("T3MAPS"), -0.5,
-				(chips->getNCol("T3MAPS") - 0.5));
-    
   //----------------------------------------//
-  // Loop over trees initially to identify hot pixels and mask them.
-  // Loop over T3MAPS tree:
-  Long64_t entriesT3MAPS = cT->fChain->GetEntries();
-  std::cout << "TestBeamStudies: T3MAPS entries = " << entriesT3MAPS
-	    << std::endl;
-  for (Long64_t eventT3MAPS = 0; eventT3MAPS < entriesT3MAPS; eventT3MAPS++) {
-    cT->fChain->GetEntry(eventT3MAPS);
-    // Loop over hits in the event:
-    for (int i_h = 0; i_h < (int)cT->hit_row->size(); i_h++) {
-      totOccT3MAPS->Fill((*cT->hit_row)[i_h], (*cT->hit_column)[i_h]);
-    }
-  }// End of T3MAPS loop
-  
-  // Loop over FEI4 tree:
-  Long64_t entriesFEI4 = cF->fChain->GetEntries();
-  std::cout << "TestBeamOverview: FEI4 entries = " << entriesFEI4 << std::endl;
-  for (Long64_t eventFEI4 = 0; eventFEI4 < entriesFEI4; eventFEI4++) {
-    cF->fChain->GetEntry(eventFEI4);
-    totOccFEI4->Fill(cF->row-1, cF->column-1);
-  }// End of FEI4 loop
-  
-  // Save the BusyT3MAPS pixels:
-  ofstream fBusyFEI4;
-  ofstream fBusyT3MAPS;
-  if (options.Contains("RunII")) {
-    fBusyT3MAPS.open("../TestBeamOutput/TestBeamStudies/busyT3MAPS_RunII.txt");
-    fBusyFEI4.open("../TestBeamOutput/TestBeamStudies/busyFEI4_RunII.txt");
-  }
-  else {
-    fBusyT3MAPS.open("../TestBeamOutput/TestBeamStudies/busyT3MAPS_RunI.txt");
-    fBusyFEI4.open("../TestBeamOutput/TestBeamStudies/busyFEI4_RunI.txt");
+  // Build the FEI4 events and identify hot pixels with the analysis pipeline.
+  // The stage products of earlier jobs with the same inputs are reused:
+  AnalysisPipeline *pipeline = new AnalysisPipeline();
+  ResultCache *cache = NULL;
+  if (!options.Contains("NoCache")) {
+    cache = new ResultCache("../TestBeamOutput/cache");
   }
+  addInputTrees(pipeline, inputT3MAPS, inputFEI4, cache);
+  addSkimStages(pipeline, chips, noiseThresholdFEI4, noiseThresholdT3MAPS);
+  TreeT3MAPS *cT = pipeline->get<TreeT3MAPS>("TreeT3MAPS");
+  TreeFEI4 *cF = pipeline->get<TreeFEI4>("TreeFEI4");
   
-  // Fill the FEI4 hit per pixel plots, get mask list:
-  for (int i_r = 1; i_r <= chips->getNRow("FEI4"); i_r++) {
-    for (int i_c = 1; i_c <= chips->getNCol("FEI4"); i_c++) {
-      int currNHits = (int)totOccFEI4->GetBinContent(i_r, i_c);
-      if (currNHits >= noiseThresholdFEI4) {
-	std::pair<int,int> pairFEI4;
-	pairFEI4.first = i_r-1;
-	pairFEI4.second = i_c-1;
-	maskFEI4.push_back(pairFEI4);
-	fBusyFEI4 << i_r << " " << i_c << std::endl;
-      }
-    }
-  }
-  fBusyFEI4.close();
+  std::cout << "TestBeamStudies: T3MAPS entries = "
+	    << cT->fChain->GetEntries() << std::endl;
+  std::cout << "TestBeamStudies: FEI4 entries = " << cF->fChain->GetEntries()
+	    << std::endl;
   
-  // Fill the T3MAPS hit per pixel plots, get mask list:
-  for (int i_r = 1; i_r <= chips->getNRow("T3MAPS"); i_r++) {
-    for (int i_c = 1; i_c <= chips->getNCol("T3MAPS"); i_c++) {
-      int currNHits = (int)totOccT3MAPS->GetBinContent(i_r, i_c);
-      if (currNHits > noiseThresholdT3MAPS) {
-	std::pair<int,int> pairT3MAPS;
-	pairT3MAPS.first = i_r-1;
-	pairT3MAPS.second = i_c-1;
-	maskT3MAPS.push_back(pairT3MAPS);
-	fBusyT3MAPS << i_r << " " << i_c << std::endl;
-      }
-    }
-  }
-  fBusyT3MAPS.close();
-  std::cout << "TestBeamStudies: Found pixels to mask: " << maskT3MAPS.size() 
-	    << " in T3MAPS and " << maskFEI4.size() << " in FEI4." << std::endl;
+  // The time span of the run, which the saved map is valid for:
+  cT->fChain->GetEntry(0);
+  double runStartTime = cT->timestamp_start;
+  cT->fChain->GetEntry(cT->fChain->GetEntries() - 1);
+  double runStopTime = cT->timestamp_stop;
+  Long64_t entriesT3MAPS = cT->fChain->GetEntries();
+  
+  maskFEI4 = *pipeline->get<PixelList>("MaskFEI4");
+  maskT3MAPS = *pipeline->get<PixelList>("MaskT3MAPS");
   
   //----------------------------------------//
   // Initialize histograms, counters, and graphs for mapping & scanning:
-  // Book histograms:
-  TH2D *occFEI4 = new TH2D("occFEI4", "occFEI4", 
-			   chips->getNRow("FEI4"), -0.5,
-			   (chips->getNRow("FEI4") - 0.5),
-			   chips->getNCol("FEI4"), -0.5,
-			   (chips->getNCol("FEI4") - 0.5));
-  TH2D *occOverlapFEI4 = new TH2D("occOverlapFEI4", "occOverlapFEI4",
-				  chips->getNRow("FEI4"), -0.5,
-				  (chips->getNRow("FEI4") - 0.5),
-				  chips->getNCol("FEI4"), -0.5,
-				  (chips->getNCol("FEI4") - 0.5));
-  TH2D *occExcludeFEI4 = new TH2D("occExcludeFEI4", "occExcludeFEI4",
-				  chips->getNRow("FEI4"), -0.5,
-				  (chips->getNRow("FEI4") - 0.5),
-				  chips->getNCol("FEI4"), -0.5,
-				  (chips->getNCol("FEI4") - 0.5));
-  TH2D *occT3MAPS = new TH2D("occT3MAPS", "occT3MAPS",
-			     chips->getNRow("T3MAPS"), -0.5,
-			     (chips->getNRow("T3MAPS") - 0.5),
-			     chips->getNCol("T3MAPS"), -0.5,
-			     (chips->getNCol("T3MAPS") - 0.5));
+  // Book histograms (occupancies are converted to TH2D after the scan):
+  FixedHist *occFEI4 = new FixedHist(chips->getNRow("FEI4"), -0.5,
+				     (chips->getNRow("FEI4") - 0.5),
+				     chips->getNCol("FEI4"), -0.5,
+				     (chips->getNCol("FEI4") - 0.5));
+  FixedHist *occOverlapFEI4 = new FixedHist(*occFEI4);
+  FixedHist *occExcludeFEI4 = new FixedHist(*occFEI4);
+  FixedHist *occT3MAPS = new FixedHist(chips->getNRow("T3MAPS"), -0.5,
+				       (chips->getNRow("T3MAPS") - 0.5),
+				       chips->getNCol("T3MAPS"), -0.5,
+				       (chips->getNCol("T3MAPS") - 0.5));
   
   // Hit counters:
   int nHitsT3MAPS_noCuts = 0;
@@ -285,6 +257,9 @@ int main(int argc, char **argv) {
   //----------------------------------------//
   // Loop over scan timing offsets, or consider measured time offset:
   int graphPoint = 0;
+  // The FEI4 events are only built if some offset is not in the cache:
+  EventBuilder *eventsFEI4 = NULL;
+  Long64_t nEventsFEI4 = 0;
   double timeOffset = timeOffsetMin;
   // Only consider the measured offset if not doing a scan:
   if (options.Contains("NoScan")) {
@@ -298,114 +273,220 @@ int main(int argc, char **argv) {
     // Instantiate the mapping utility:
     MapParameters *mapper = new MapParameters("","");
     
-    // Prepare FEI4 tree for loop inside T3MAPS tree's loop.
-    Long64_t eventFEI4 = 0;
-    cF->fChain->GetEntry(eventFEI4);
+    // The hit pairs for this offset may be stored by an earlier job. The
+    // first offset also stores the occupancies and the hit counters:
+    TString mapKey = "";
+    if (cache) {
+      CacheKey key;
+      key.addString(pipeline->getKey("MaskT3MAPS"));
+      key.addString(pipeline->getKey("EventsFEI4"));
+      key.addDouble(timeOffset);
+      key.addInt(maxHitsT3MAPS);
+      key.addInt(rowMinT3MAPS);
+      key.addInt(rowMaxT3MAPS);
+      key.addInt(graphPoint == 0);
+      key.addInt(MapParameters::hitsFormat);
+      mapKey = key.getKey();
+    }
+    bool fromCache = false;
+    std::ifstream cacheInput;
+    if (!mapKey.IsNull() && cache->openInput("MapHits", mapKey, cacheInput)) {
+      int addCounts[5];
+      fromCache = mapper->readHits(cacheInput);
+      for (int i_c = 0; i_c < 5; i_c++) {
+	fromCache = fromCache && ResultCache::readValue(cacheInput,
+							addCounts[i_c]);
+      }
+      if (fromCache && graphPoint == 0) {
+	fromCache = (occFEI4->read(cacheInput) &&
+		     occOverlapFEI4->read(cacheInput) &&
+		     occExcludeFEI4->read(cacheInput) &&
+		     occT3MAPS->read(cacheInput));
+      }
+      cacheInput.close();
+      if (fromCache) {
+	std::cout << "TestBeamStudies: Loaded hit pairs from cache."
+		  << std::endl;
+	nHitsT3MAPS_noCuts += addCounts[0];
+	nHitsT3MAPS_afterCuts += addCounts[1];
+	nHitsFEI4_total += addCounts[2];
+	nHitsFEI4_overlapping += addCounts[3];
+	nHitsFEI4_excluding += addCounts[4];
+      }
+      else {
+	std::cout << "TestBeamStudies: Cache entry unreadable." << std::endl;
+	delete mapper;
+	mapper = new MapParameters("","");
+	if (graphPoint == 0) {
+	  occFEI4->reset();
+	  occOverlapFEI4->reset();
+	  occExcludeFEI4->reset();
+	  occT3MAPS->reset();
+	}
+      }
+    }
+    
+    if (!fromCache) {
+      INSTRUMENT_SCOPE("map.fill");
+      if (!eventsFEI4) {
+	eventsFEI4 = pipeline->get<EventBuilder>("EventsFEI4");
+	nEventsFEI4 = eventsFEI4->getNEvents();
+      }
+      int startCounts[5] = {nHitsT3MAPS_noCuts, nHitsT3MAPS_afterCuts,
+			    nHitsFEI4_total, nHitsFEI4_overlapping,
+			    nHitsFEI4_excluding};
+      // Prepare FEI4 events for loop inside T3MAPS tree's loop.
+      Long64_t eventFEI4 = 0;
         
-    // Define the map from T3MAPS <--> FEI4
-    std::cout << "TestBeamStudies: Entering loop to define maps." << std::endl;
-    for (Long64_t eventT3MAPS = 0; eventT3MAPS < entriesT3MAPS; eventT3MAPS++) {
-      cT->fChain->GetEntry(eventT3MAPS);
+      // Define the map from T3MAPS <--> FEI4
+      std::cout << "TestBeamStudies: Entering loop to define maps."
+		<< std::endl;
+      for (Long64_t eventT3MAPS = 0; eventT3MAPS < entriesT3MAPS;
+	   eventT3MAPS++) {
+	cT->fChain->GetEntry(eventT3MAPS);
             
-      // For map definition, cut on events with no T3MAPS hits:
-      //if (cT->nHits == 0) continue;
+	// For map definition, cut on events with no T3MAPS hits:
+	//if (cT->nHits == 0) continue;
       
-      // Add to total hit counter:
-      if (graphPoint == 0) nHitsT3MAPS_noCuts += cT->nHits;
+	// Add to total hit counter:
+	if (graphPoint == 0) nHitsT3MAPS_noCuts += cT->nHits;
       
-      // Start quality cuts:
-      // Remove T3MAPS events with 12 or more hits in one integration period.
-      if ((*cT->hit_row).size() >= 12) continue;
+	// Start quality cuts:
+	// Remove T3MAPS events with too many hits in one integration period.
+	if ((int)(*cT->hit_row).size() >= maxHitsT3MAPS) continue;
       
-      // Create list of GOOD T3MAPS hits:
-      std::vector<std::pair<int,int> > hitsInT3MAPS; hitsInT3MAPS.clear();
-      for (int i_h = 0; i_h < (int)cT->hit_row->size(); i_h++) {
-	// Check for masked T3MAPS pixels:
-	if (!isMasked((*cT->hit_row)[i_h],(*cT->hit_column)[i_h],"T3MAPS")) {
-	  if ((*cT->hit_row)[i_h] > 0 && (*cT->hit_row)[i_h] < 17) {
-	    std::pair<int,int> newHitT3MAPS;
-	    newHitT3MAPS.first = (*cT->hit_row)[i_h];
-	    newHitT3MAPS.second = (*cT->hit_column)[i_h];
-	    hitsInT3MAPS.push_back(newHitT3MAPS);
-	    if (graphPoint == 0) {
-	      occT3MAPS->Fill((*cT->hit_row)[i_h], (*cT->hit_column)[i_h]);
+	// Create list of GOOD T3MAPS hits:
+	std::vector<std::pair<int,int> > hitsInT3MAPS; hitsInT3MAPS.clear();
+	for (int i_h = 0; i_h < (int)cT->hit_row->size(); i_h++) {
+	  // Check for masked T3MAPS pixels:
+	  if (!isMasked((*cT->hit_row)[i_h],(*cT->hit_column)[i_h],"T3MAPS")) {
+	    if ((*cT->hit_row)[i_h] >= rowMinT3MAPS &&
+		(*cT->hit_row)[i_h] <= rowMaxT3MAPS) {
+	      std::pair<int,int> newHitT3MAPS;
+	      newHitT3MAPS.first = (*cT->hit_row)[i_h];
+	      newHitT3MAPS.second = (*cT->hit_column)[i_h];
+	      hitsInT3MAPS.push_back(newHitT3MAPS);
+	      if (graphPoint == 0) {
+		occT3MAPS->fill((*cT->hit_row)[i_h], (*cT->hit_column)[i_h]);
+	      }
+	      nHitsT3MAPS_afterCuts++;
 	    }
-	    nHitsT3MAPS_afterCuts++;
 	  }
 	}
-      }
             
-      // Advance position in the FEI4 tree:
-      while (cF->timestamp_start < (cT->timestamp_stop+timeOffset) &&
-	     eventFEI4 < entriesFEI4) {
+	// Advance position in the FEI4 events:
+	while (eventFEI4 < nEventsFEI4 &&
+	       (eventsFEI4->getEvent(eventFEI4)->timestamp_start <
+		(cT->timestamp_stop+timeOffset))) {
+	  EventFEI4 *currEvent = eventsFEI4->getEvent(eventFEI4);
+	
+	  // Only consider events with timestamp inside that of T3MAPS
+	  bool inWindow
+	    = (currEvent->timestamp_start >= (cT->timestamp_start+timeOffset) &&
+	       currEvent->timestamp_stop <= (cT->timestamp_stop+timeOffset));
 	
-	// Exclude column 79 and masked pixels:
-	if (cF->column < 80 && !isMasked(cF->row-1, cF->column-1, "FEI4")) {
+	  // Loop over hits in the FEI4 event:
+	  for (Long64_t i_f = currEvent->offset;
+	       i_f < currEvent->offset + currEvent->length; i_f++) {
+	    HitFEI4 *currHit = eventsFEI4->getHit(i_f);
 	  
-	  PixelHit *currFEI4Hit = new PixelHit(cF->row-1, cF->column-1,
-					       cF->LVL1ID, cF->tot, false);
+	    // Exclude column 79 and masked pixels:
+	    if (currHit->column >= 80 ||
+		isMasked(currHit->row-1, currHit->column-1, "FEI4")) {
+	      continue;
+	    }
 	  
-	  // Fill FEI4 occupancy plot:
-	  if (graphPoint == 0) {
-	    occFEI4->Fill(currFEI4Hit->getRow(), currFEI4Hit->getCol());
-	    nHitsFEI4_total++;
-	  }
+	    PixelHit *currFEI4Hit = new PixelHit(currHit->row-1,
+						 currHit->column-1,
+						 currEvent->LVL1ID,
+						 currHit->tot, false);
 	  
-	  // Only consider events with timestamp inside that of T3MAPS
-	  if (cF->timestamp_start >= (cT->timestamp_start+timeOffset) &&
-	      cF->timestamp_stop <= (cT->timestamp_stop+timeOffset)) {
+	    // Fill FEI4 occupancy plot:
+	    if (graphPoint == 0) {
+	      occFEI4->fill(currFEI4Hit->getRow(), currFEI4Hit->getCol());
+	      nHitsFEI4_total++;
+	    }
+	  
+	    if (inWindow) {
 	    
-	    if (cT->nHits > 0) {
+	      if (cT->nHits > 0) {
 
-	      // Fill overlapping FEI4 hit occupancy plot:
-	      if (graphPoint == 0) { 
-		nHitsFEI4_overlapping++;
-		occOverlapFEI4->Fill(currFEI4Hit->getRow(),
-				     currFEI4Hit->getCol());
-	      }
+		// Fill overlapping FEI4 hit occupancy plot:
+		if (graphPoint == 0) { 
+		  nHitsFEI4_overlapping++;
+		  occOverlapFEI4->fill(currFEI4Hit->getRow(),
+				       currFEI4Hit->getCol());
+		}
 	      
-	      // Loop over good T3MAPS hits:
-	      for (int i_h = 0; i_h < (int)hitsInT3MAPS.size(); i_h++) {
-		PixelHit *currT3MAPSHit = new PixelHit(hitsInT3MAPS[i_h].first,
-						       hitsInT3MAPS[i_h].second,
-						       1, 1, false);
-		mapper->addPairToMap(currFEI4Hit, currT3MAPSHit);
-		delete currT3MAPSHit;
-	      }
-	    }
-	    // If timestamps don't match up, use as background estimate:
-	    else {	
-	      if (graphPoint == 0) { 
-		nHitsFEI4_excluding++;
-		occExcludeFEI4->Fill(currFEI4Hit->getRow(),
-				     currFEI4Hit->getCol());
+		// Loop over good T3MAPS hits:
+		for (int i_h = 0; i_h < (int)hitsInT3MAPS.size(); i_h++) {
+		  PixelHit *currT3MAPSHit
+		    = new PixelHit(hitsInT3MAPS[i_h].first,
+				   hitsInT3MAPS[i_h].second, 1, 1, false);
+		  mapper->addPairToMap(currFEI4Hit, currT3MAPSHit);
+		  delete currT3MAPSHit;
+		}
 	      }
-	      // Loop over possible T3MAPS hits:
+	      // If timestamps don't match up, use as background estimate:
+	      else {	
+		if (graphPoint == 0) { 
+		  nHitsFEI4_excluding++;
+		  occExcludeFEI4->fill(currFEI4Hit->getRow(),
+				       currFEI4Hit->getCol());
+		}
+		// Loop over possible T3MAPS hits:
 	      
-	      for (int i_r = 0; i_r < chips->getNRow("T3MAPS"); i_r++) {
-		for (int i_c = 0; i_c < chips->getNCol("T3MAPS"); i_c++) {
-		  PixelHit *missingT3MAPSHit = new PixelHit(i_r,i_c,1,1,false);
-		  mapper->addPairToBkg(currFEI4Hit, missingT3MAPSHit);
-		  delete missingT3MAPSHit;
+		for (int i_r = 0; i_r < chips->getNRow("T3MAPS"); i_r++) {
+		  for (int i_c = 0; i_c < chips->getNCol("T3MAPS"); i_c++) {
+		    PixelHit *missingT3MAPSHit = new PixelHit(i_r,i_c,1,1,false);
+		    mapper->addPairToBkg(currFEI4Hit, missingT3MAPSHit);
+		    delete missingT3MAPSHit;
+		  }
 		}
 	      }
 	    }
-	  }
-	  delete currFEI4Hit;
-	}// if passes quality cuts
+	    delete currFEI4Hit;
+	  }// End of loop over hits in the FEI4 event
 	
-	// Then advance to the next FEI4 entry
-	eventFEI4++;
-	cF->fChain->GetEntry(eventFEI4);
+	  // Then advance to the next FEI4 event
+	  eventFEI4++;
 	
-      }// End of loop over FEI4 hits
-    }// End of loop over T3MAPS events
-    std::cout << "TestBeamStudies: Ending loop to define maps." << std::endl;
+	}// End of loop over FEI4 events
+      }// End of loop over T3MAPS events
+      std::cout << "TestBeamStudies: Ending loop to define maps." << std::endl;
+      
+      // Store the hit pairs and what this offset added to the counters:
+      std::ofstream cacheOutput;
+      if (!mapKey.IsNull() &&
+	  cache->openOutput("MapHits", mapKey, cacheOutput)) {
+	mapper->writeHits(cacheOutput);
+	ResultCache::writeValue(cacheOutput,
+				nHitsT3MAPS_noCuts - startCounts[0]);
+	ResultCache::writeValue(cacheOutput,
+				nHitsT3MAPS_afterCuts - startCounts[1]);
+	ResultCache::writeValue(cacheOutput, nHitsFEI4_total - startCounts[2]);
+	ResultCache::writeValue(cacheOutput,
+				nHitsFEI4_overlapping - startCounts[3]);
+	ResultCache::writeValue(cacheOutput,
+				nHitsFEI4_excluding - startCounts[4]);
+	if (graphPoint == 0) {
+	  occFEI4->write(cacheOutput);
+	  occOverlapFEI4->write(cacheOutput);
+	  occExcludeFEI4->write(cacheOutput);
+	  occT3MAPS->write(cacheOutput);
+	}
+	cache->closeOutput("MapHits", mapKey, cacheOutput, true);
+      }
+    }
     
     mapper->createMapFromHits();
+    if (!options.Contains("NoAlign")) mapper->alignFromPairs(5);
     if (options.Contains("NoScan")) {
-      mapper->saveMapParameters("../TestBeamOutput");
       mapper->setOrientation(1);// Use what I think is correct orientation.
+      mapper->saveMapParameters("../TestBeamOutput", runName, runStartTime,
+				runStopTime, Form("TestBeamStudies %s t=%2.2f",
+						  gSystem->BaseName(inputT3MAPS),
+						  timeOffset));
       mapper->printMapParameters();
     }
     
@@ -428,7 +509,8 @@ int main(int argc, char **argv) {
 	for (int i_y = 1; i_y <= tempDiffHist->GetNbinsY(); i_y++) {
 	  double diffVal = tempDiffHist->GetBinContent(i_x,i_y);
 	  histDev->Fill(diffVal);
-	  hTime[i_h][i_x-1][i_y-1]->SetBinContent(timeOffset, diffVal);
+	  TH1F *currTime = hTime[i_h][i_x-1][i_y-1];
+	  currTime->SetBinContent(currTime->FindBin(timeOffset), diffVal);
 	}
       }
       tempDiffHist->Delete();
@@ -437,18 +519,26 @@ int main(int argc, char **argv) {
     graphPoint++;
     delete mapper;
     timeOffset+=timeOffsetInterval;
+    
+    // Draw the map plots of this offset while the next one is processed:
+    if (options.Contains("BackgroundPlots")) PlotUtil::flushPlots();
   
   }// End of timing scan.
   std::cout << "TestBeamStudies: Finished timing scan." << std::endl;
+  PlotUtil::flushPlots();
   
   //----------------------------------------//
   // Post-scan analysis:
   
   // Plot occupancy for FEI4 and T3MAPS:
-  PlotUtil::plotTH2D(occFEI4, "row_{FEI4}", "column_{FEI4}", "hits", "../TestBeamOutput/TestBeamStudies/occupancyFEI4");
-  PlotUtil::plotTH2D(occOverlapFEI4, "row_{FEI4}", "column_{FEI4}", "hits", "../TestBeamOutput/TestBeamStudies/occupancyOverlappingFEI4");
-  PlotUtil::plotTH2D(occExcludeFEI4, "row_{FEI4}", "column_{FEI4}", "hits", "../TestBeamOutput/TestBeamStudies/occupancyExcludingFEI4");
-  PlotUtil::plotTH2D(occT3MAPS, "row_{T3MAPS}", "column_{T3MAPS}", "hits", "../TestBeamOutput/TestBeamStudies/occupancyT3MAPS");
+  TH2D *h2OccFEI4 = occFEI4->toTH2D("occFEI4");
+  TH2D *h2OccOverlapFEI4 = occOverlapFEI4->toTH2D("occOverlapFEI4");
+  TH2D *h2OccExcludeFEI4 = occExcludeFEI4->toTH2D("occExcludeFEI4");
+  TH2D *h2OccT3MAPS = occT3MAPS->toTH2D("occT3MAPS");
+  PlotUtil::plotTH2D(h2OccFEI4, "row_{FEI4}", "column_{FEI4}", "hits", "../TestBeamOutput/TestBeamStudies/occupancyFEI4");
+  PlotUtil::plotTH2D(h2OccOverlapFEI4, "row_{FEI4}", "column_{FEI4}", "hits", "../TestBeamOutput/TestBeamStudies/occupancyOverlappingFEI4");
+  PlotUtil::plotTH2D(h2OccExcludeFEI4, "row_{FEI4}", "column_{FEI4}", "hits", "../TestBeamOutput/TestBeamStudies/occupancyExcludingFEI4");
+  PlotUtil::plotTH2D(h2OccT3MAPS, "row_{T3MAPS}", "column_{T3MAPS}", "hits", "../TestBeamOutput/TestBeamStudies/occupancyT3MAPS");
   
   // Plot deviations in map parameter histograms to find significant points:
   PlotUtil::plotTH1F(histMax, "maximum value of (s-b)", "entries", "../TestBeamOutput/TestBeamStudies/histMax");
@@ -467,20 +557,20 @@ int main(int argc, char **argv) {
   }
   
   // Make subtraction plot:
-  occOverlapFEI4->Scale(1.0/occOverlapFEI4->Integral());
-  occExcludeFEI4->Scale(1.0/occExcludeFEI4->Integral());
+  h2OccOverlapFEI4->Scale(1.0/h2OccOverlapFEI4->Integral());
+  h2OccExcludeFEI4->Scale(1.0/h2OccExcludeFEI4->Integral());
   TH2D *occDiffFEI4 = new TH2D("occDiffFEI4", "occDiffFEI4",
 			       (int)(((double)chips->getNRow("FEI4"))/8.0),
 			       -0.5, (chips->getNRow("FEI4") - 0.5),
 			       (int)(((double)chips->getNCol("FEI4"))/8.0),
 			       -0.5, (chips->getNCol("FEI4") - 0.5));
-  for (int i_x = 1; i_x <= occOverlapFEI4->GetNbinsX(); i_x++) {
-    for (int i_y = 1; i_y <= occOverlapFEI4->GetNbinsY(); i_y++) {
-      double value = (occOverlapFEI4->GetBinContent(i_x,i_y) -
-		      occExcludeFEI4->GetBinContent(i_x,i_y));
+  for (int i_x = 1; i_x <= h2OccOverlapFEI4->GetNbinsX(); i_x++) {
+    for (int i_y = 1; i_y <= h2OccOverlapFEI4->GetNbinsY(); i_y++) {
+      double value = (h2OccOverlapFEI4->GetBinContent(i_x,i_y) -
+		      h2OccExcludeFEI4->GetBinContent(i_x,i_y));
       //occDiffFEI4->SetBinContent(i_x, i_y, value);
-      occDiffFEI4->Fill(occOverlapFEI4->GetXaxis()->GetBinCenter(i_x),
-			occOverlapFEI4->GetYaxis()->GetBinCenter(i_y), value);
+      occDiffFEI4->Fill(h2OccOverlapFEI4->GetXaxis()->GetBinCenter(i_x),
+			h2OccOverlapFEI4->GetYaxis()->GetBinCenter(i_y), value);
     }
   }
   
@@ -494,6 +584,38 @@ int main(int argc, char **argv) {
   std::cout << "\tFEI4 overlapping = " << nHitsFEI4_overlapping << std::endl;
   std::cout << "\tFEI4 excluding = " << nHitsFEI4_excluding << std::endl;
   
+  // Store the counters, occupancies, map scan and masks:
+  ResultsFile *results
+    = new ResultsFile("../TestBeamOutput/TestBeamStudies/results.root",
+		      "RECREATE");
+  results->writeValue("nHitsT3MAPS_noCuts", nHitsT3MAPS_noCuts);
+  results->writeValue("nHitsT3MAPS_afterCuts", nHitsT3MAPS_afterCuts);
+  results->writeValue("nHitsFEI4_total", nHitsFEI4_total);
+  results->writeValue("nHitsFEI4_overlapping", nHitsFEI4_overlapping);
+  results->writeValue("nHitsFEI4_excluding", nHitsFEI4_excluding);
+  results->writeObject("occFEI4", h2OccFEI4);
+  results->writeObject("occT3MAPS", h2OccT3MAPS);
+  results->writeObject("occDiffFEI4", occDiffFEI4);
+  results->writeObject("histMax", histMax);
+  results->writeObject("histDev", histDev);
+  if (!options.Contains("NoScan")) {
+    for (int i_h = 0; i_h < 4; i_h++) {
+      for (int i_p = 0; i_p < 4; i_p++) {
+	results->writeObject(Form("mapVal%d_orient%d",i_p,i_h),
+			     graphMapVar[i_h][i_p]);
+	results->writeObject(Form("mapErr%d_orient%d",i_p,i_h),
+			     graphMapErr[i_h][i_p]);
+      }
+      results->writeObject(Form("mapDiffMax_orient%d",i_h), graphDiffMax[i_h]);
+    }
+  }
+  results->writeMask("MaskT3MAPS", maskT3MAPS);
+  results->writeMask("MaskFEI4", maskFEI4);
+  delete results;
+  
+  // Wait for the remaining plots:
+  PlotUtil::finishPlots();
+  
   // End of analysis.
   std::cout << "TestBeamStudies: Finished analysis." << std::endl;
   return 0;
@@ -0,0 +1,369 @@
+////////////////////////////////////////////////////////////////////////////////
+//                                                                            //
+//  Name: TestBeamThroughput.cxx                                              //
+//                                                                            //
+//  Date: 18/10/2026                                                          //
+//                                                                            //
+//  This program measures the throughput of the full analysis on the fixed    //
+//  synthetic run of config/benchmark.cfg. The run is written by              //
+//  SyntheticBeam if it does not exist yet, and then TestBeamStudies (for     //
+//  the map), TestBeamTracks and TestBeamScanner are run on it, each as a     //
+//  separate process. For each program the wall time, peak memory (RSS),      //
+//  bytes read and events (T3MAPS scans and FEI4 hits) per second are         //
+//  recorded.                                                                 //
+//                                                                            //
+//  The efficiencies found by TestBeamTracks and TestBeamScanner are then     //
+//  compared to the golden values in config/benchmark_golden.txt, so that a   //
+//  faster analysis can be checked to give the same results. The program      //
+//  returns 1 if any value differs by more than the tolerance in that file.   //
+//  It also returns 1 if the file has no golden values, outside of            //
+//  "SaveGolden", and 2 if one of the programs fails.                         //
+//  The measurements and the comparison are written to                        //
+//  TestBeamOutput/TestBeamThroughput/throughput.json.                        //
+//                                                                            //
+//  Program options:                                                          //
+//                                                                            //
+//    "SaveGolden" writes the current efficiencies to the golden file         //
+//    instead of comparing them, for example after a change to the physics.   //
+//                                                                            //
+////////////////////////////////////////////////////////////////////////////////
+
+// C++ includes:
+#include <stdlib.h>
+#include <stdio.h>
+#include <time.h>
+#include <math.h>
+#include <iostream>
+#include <fstream>
+#include <sstream>
+#include <map>
+#include <vector>
+#include <string>
+
+#include <sys/resource.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+// ROOT includes:
+#include "TFile.h"
+#include "TH2D.h"
+#include "TString.h"
+#include "TSystem.h"
+#include "TTree.h"
+
+// Package includes:
+#include "ResultsFile.h"
+#include "RunConfig.h"
+
+using namespace std;
+
+// The measurements of one program:
+struct StepResult {
+  TString name;
+  TString command;
+  double wallTime;// seconds
+  double peakMemory;// MB
+  Long64_t bytesRead;// -1 if not known
+  int exitStatus;
+};
+
+/**
+   Get the monotonic clock time in seconds.
+*/
+double getTime() {
+  struct timespec now;
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (double)now.tv_sec + 1e-9 * (double)now.tv_nsec;
+}
+
+/**
+   Get the bytes read by a process from /proc/<pid>/io. This also works for a
+   process that has finished but has not been reaped yet.
+   @param pid - the process.
+   @returns - the bytes read, or -1 if they are not known.
+*/
+Long64_t getBytesRead(pid_t pid) {
+  ifstream io(Form("/proc/%d/io", (int)pid));
+  string key;
+  Long64_t value;
+  while (io >> key >> value) {
+    if (key == "rchar:") return value;
+  }
+  return -1;
+}
+
+/**
+   Run a program and measure it. Exits with status 2 if the program cannot be
+   run or fails, so that a broken analysis does not pass the benchmark.
+   @param name - the name of the step in the output.
+   @param arguments - the program and its arguments.
+   @returns - the measurements.
+*/
+StepResult runStep(TString name, vector<string> arguments) {
+  StepResult result;
+  result.name = name;
+  result.command = "";
+  for (int i_a = 0; i_a < (int)arguments.size(); i_a++) {
+    result.command += (i_a > 0 ? " " : "") + (TString)arguments[i_a];
+  }
+  cout << "\nTestBeamThroughput: Running " << result.command << endl;
+
+  vector<char*> argv;
+  for (int i_a = 0; i_a < (int)arguments.size(); i_a++) {
+    argv.push_back((char*)arguments[i_a].c_str());
+  }
+  argv.push_back(NULL);
+
+  double start = getTime();
+  pid_t pid = fork();
+  if (pid == 0) {
+    execv(argv[0], &argv[0]);
+    cout << "TestBeamThroughput: Could not run " << argv[0] << endl;
+    _exit(127);
+  }
+  else if (pid < 0) {
+    cout << "TestBeamThroughput: Could not start " << name << endl;
+    exit(2);
+  }
+
+  // Wait for the end, but read the I/O counters before the process is gone:
+  siginfo_t info;
+  waitid(P_PID, pid, &info, WEXITED | WNOWAIT);
+  result.wallTime = getTime() - start;
+  result.bytesRead = getBytesRead(pid);
+  int status = 0;
+  struct rusage usage;
+  wait4(pid, &status, 0, &usage);
+  result.peakMemory = usage.ru_maxrss / 1024.0;// kB on Linux
+  result.exitStatus = WIFEXITED(status) ? WEXITSTATUS(status) : -1;
+
+  cout << "TestBeamThroughput: " << name << " took " << result.wallTime
+       << " s, peak memory " << result.peakMemory << " MB" << endl;
+  if (result.exitStatus != 0) {
+    cout << "TestBeamThroughput: " << name << " failed with status "
+	 << result.exitStatus << endl;
+    exit(2);
+  }
+  return result;
+}
+
+/**
+   Count the entries of a tree. Exits with status 2 if there is no tree.
+   @param fileName - the ROOT file.
+   @param treeName - the name of the tree.
+   @returns - the number of entries.
+*/
+Long64_t countEntries(TString fileName, TString treeName) {
+  TFile file(fileName, "READ");
+  TTree *tree = file.IsOpen() ? (TTree*)file.Get(treeName) : NULL;
+  if (!tree) {
+    cout << "TestBeamThroughput: No " << treeName << " in " << fileName
+	 << endl;
+    exit(2);
+  }
+  Long64_t nEntries = tree->GetEntries();
+  file.Close();
+  return nEntries;
+}
+
+/**
+   Read the golden values. Each line is "key = value", and the key
+   "tolerance" gives the largest allowed difference.
+   @param fileName - the golden file.
+   @returns - the values by key (empty if the file does not exist).
+*/
+map<string,double> readGolden(TString fileName) {
+  map<string,double> golden; golden.clear();
+  ifstream input(fileName.Data());
+  string line;
+  while (getline(input, line)) {
+    size_t comment = line.find('#');
+    if (comment != string::npos) line = line.substr(0, comment);
+    size_t equals = line.find('=');
+    if (equals == string::npos) continue;
+    istringstream key(line.substr(0, equals));
+    istringstream value(line.substr(equals + 1));
+    string name;
+    double number;
+    if (key >> name && value >> number) golden[name] = number;
+  }
+  return golden;
+}
+
+/**
+   The main method runs the analysis and checks the results.
+   @param option - "SaveGolden" to store the results as the golden values.
+   @param config - (optional) the run configuration file.
+   @param run - (optional) the run in the configuration file.
+   @returns - 1 if the results differ from the golden values or there are no
+   golden values, 2 if a program failed, otherwise 0.
+*/
+int main(int argc, char **argv) {
+  // Check arguments:
+  if (argc < 2) {
+    cout << "\nUsage: " << argv[0] << " <option> [run config] [run]" << endl;
+    exit(0);
+  }
+  TString options = argv[1];
+  string configFile = argc > 2 ? argv[2] : "config/benchmark.cfg";
+  string runName = argc > 3 ? argv[3] : "Benchmark";
+  TString goldenFile = "config/benchmark_golden.txt";
+  TString outputDir = "../TestBeamOutput/TestBeamThroughput";
+  gSystem->mkdir(outputDir, kTRUE);
+
+  RunConfig *config = RunConfig::getRun(options, configFile, runName);
+  TString inputT3MAPS = config->getString("inputT3MAPS");
+  TString inputFEI4 = config->getString("inputFEI4");
+  string timeOffset = (string)config->getString("timeOffset");
+  delete config;
+
+  // Write the synthetic run if it does not exist yet (not timed):
+  if (gSystem->AccessPathName(inputT3MAPS) ||
+      gSystem->AccessPathName(inputFEI4)) {
+    vector<string> arguments;
+    arguments.push_back("./bin/SyntheticBeam");
+    arguments.push_back("Run");
+    arguments.push_back(configFile);
+    arguments.push_back(runName);
+    runStep("SyntheticBeam", arguments);
+  }
+  Long64_t nScans = countEntries(inputT3MAPS, "TreeT3MAPS");
+  Long64_t nHitsFEI4 = countEntries(inputFEI4, "Table");
+  Long64_t nEvents = nScans + nHitsFEI4;
+
+  // The workloads, without cached results or plots:
+  vector<StepResult> steps; steps.clear();
+  vector<string> arguments;
+  arguments.push_back("./bin/TestBeamStudies");
+  arguments.push_back("NoScan_NoCache_ROOTPlotsOnly");
+  arguments.push_back(configFile);
+  arguments.push_back(runName);
+  steps.push_back(runStep("TestBeamStudies", arguments));
+
+  arguments.clear();
+  arguments.push_back("./bin/TestBeamTracks");
+  arguments.push_back("NoCache");
+  arguments.push_back(timeOffset);
+  arguments.push_back(configFile);
+  steps.push_back(runStep("TestBeamTracks", arguments));
+
+  arguments.clear();
+  arguments.push_back("./bin/TestBeamScanner");
+  arguments.push_back("NoCache_ROOTPlotsOnly");
+  arguments.push_back(configFile);
+  arguments.push_back(runName);
+  steps.push_back(runStep("TestBeamScanner", arguments));
+
+  // The physics results:
+  map<string,double> values;
+  ResultsFile *tracks
+    = new ResultsFile(Form("../TestBeamOutput/TestBeamTracks/results_%s.root",
+			   runName.c_str()), "READ");
+  double offset = atof(timeOffset.c_str());
+  const char *trackKeys[3] = {"effT3MAPS", "effFEI4", "orientation"};
+  for (int i_k = 0; i_k < 3; i_k++) {
+    TString key = ResultsFile::offsetKey(trackKeys[i_k], offset);
+    values[(string)("tracks_" + key)] = tracks->getValue(key);
+  }
+  delete tracks;
+  ResultsFile *scanner
+    = new ResultsFile("../TestBeamOutput/TestBeamScanner/results.root", "READ");
+  const char *scannerKeys[2] = {"g2Eff_T3MAPS", "g2Eff_FEI4"};
+  for (int i_k = 0; i_k < 2; i_k++) {
+    TH2D *hist = scanner->get<TH2D>(scannerKeys[i_k]);
+    values[(string)"scanner_" + scannerKeys[i_k] + "_sum"] = hist->Integral();
+    values[(string)"scanner_" + scannerKeys[i_k] + "_max"]
+      = hist->GetMaximum();
+    delete hist;
+  }
+  delete scanner;
+
+  // Store or compare with the golden values. Without golden values the
+  // results cannot be verified, which is a failure:
+  bool allMatch = true;
+  bool missingGolden = false;
+  map<string,double> golden = readGolden(goldenFile);
+  double tolerance = golden.count("tolerance") ? golden["tolerance"] : 1e-6;
+  bool checkGolden = (!options.Contains("SaveGolden") &&
+		      golden.size() > golden.count("tolerance"));
+  if (options.Contains("SaveGolden")) {
+    ofstream output(goldenFile.Data());
+    output << "# Golden results of TestBeamThroughput for " << configFile
+	   << " [" << runName << "]\n";
+    output << "tolerance = " << tolerance << "\n";
+    output.precision(12);
+    for (map<string,double>::iterator it = values.begin();
+	 it != values.end(); it++) {
+      output << it->first << " = " << it->second << "\n";
+    }
+    output.close();
+    cout << "TestBeamThroughput: Saved golden values to " << goldenFile
+	 << endl;
+  }
+  else if (!checkGolden) {
+    cout << "TestBeamThroughput: ERROR! No golden values in " << goldenFile
+	 << ", so the results cannot be checked. Run with SaveGolden first."
+	 << endl;
+    missingGolden = true;
+  }
+
+  // Write the measurements and the comparison:
+  TString outputFile = outputDir + "/throughput.json";
+  ofstream output(outputFile.Data());
+  output << "{\n  \"benchmark\": \"TestBeamThroughput\",\n";
+  output << "  \"run\": \"" << runName << "\",\n";
+  output << "  \"scans\": " << nScans << ",\n";
+  output << "  \"hits_FEI4\": " << nHitsFEI4 << ",\n";
+  output << "  \"steps\": [\n";
+  for (int i_s = 0; i_s < (int)steps.size(); i_s++) {
+    output << "    {\"name\": \"" << steps[i_s].name
+	   << "\", \"wall_s\": " << steps[i_s].wallTime
+	   << ", \"peak_rss_mb\": " << steps[i_s].peakMemory
+	   << ", \"bytes_read\": " << steps[i_s].bytesRead
+	   << ", \"events_per_s\": " << nEvents / steps[i_s].wallTime << "}"
+	   << (i_s + 1 < (int)steps.size() ? ",\n" : "\n");
+  }
+  output << "  ],\n  \"results\": [\n";
+  output.precision(12);
+  int nWritten = 0;
+  for (map<string,double>::iterator it = values.begin(); it != values.end();
+       it++) {
+    bool hasGolden = golden.count(it->first) > 0;
+    bool match = hasGolden && fabs(it->second - golden[it->first]) <= tolerance;
+    if (checkGolden && !match) {
+      allMatch = false;
+      cout << "TestBeamThroughput: " << it->first << " = " << it->second
+	   << " differs from the golden value "
+	   << (hasGolden ? Form("%f", golden[it->first]) : "(none)") << endl;
+    }
+    output << "    {\"key\": \"" << it->first << "\", \"value\": "
+	   << it->second;
+    if (hasGolden) output << ", \"golden\": " << golden[it->first];
+    output << ", \"match\": " << (match ? "true" : "false") << "}"
+	   << (++nWritten < (int)values.size() ? ",\n" : "\n");
+  }
+  output << "  ],\n  \"golden_checked\": " << (checkGolden ? "true" : "false");
+  if (checkGolden) {
+    output << ",\n  \"golden_match\": " << (allMatch ? "true" : "false");
+  }
+  output << "\n}" << endl;
+  output.close();
+
+  cout << "\nTestBeamThroughput: Summary for " << nEvents << " events"
+       << endl;
+  for (int i_s = 0; i_s < (int)steps.size(); i_s++) {
+    cout << "\t" << steps[i_s].name << ": " << steps[i_s].wallTime << " s, "
+	 << nEvents / steps[i_s].wallTime << " events/s, "
+	 << steps[i_s].peakMemory << " MB" << endl;
+  }
+  if (checkGolden) {
+    cout << "TestBeamThroughput: Golden results "
+	 << (allMatch ? "match." : "DO NOT match.") << endl;
+  }
+  else if (missingGolden) {
+    cout << "TestBeamThroughput: Golden results NOT CHECKED." << endl;
+  }
+  cout << "TestBeamThroughput: Results written to " << outputFile << endl;
+  return (allMatch && !missingGolden) ? 0 : 1;
+}
@@ -13,7 +13,36 @@
 //  Program options:                                                          //
 //                                                                            //
 //    "RunI" or "RunII" as an option will implement the proper cuts and load  //
-//    the corresponding datasets.                                             //
+//    the corresponding datasets. Alternatively, a run configuration file     //
+//    (see config/runs.cfg) can be given as the last argument, and all of     //
+//    the runs in it are analysed in turn.                                    //
+//                                                                            //
+//    "NoCache" recomputes everything instead of using the results stored in  //
+//    TestBeamOutput/cache/ by earlier jobs.                                  //
+//                                                                            //
+//    The matching is done for all four chip orientations at once, and the    //
+//    efficiency is given for the orientation that matches best. With         //
+//    "FixedOrientation" only the orientation of the map is used.             //
+//                                                                            //
+//    The matching counts are also binned by the FEI4 hits in each T3MAPS     //
+//    window (the instantaneous rate, rateBinWidth hits per bin) and by the   //
+//    T3MAPS hits in the scan, in the same pass over the data.                //
+//                                                                            //
+//    "Trace" writes a timeline of the tree reading and matching threads to   //
+//    TestBeamOutput/instrument/TestBeamTracks.trace.json (see Instrument).   //
+//                                                                            //
+//  The efficiencies and hit counts of each time offset and the pixel masks   //
+//  are added to TestBeamOutput/TestBeamTracks/results_<run name>.root (see   //
+//  ResultsFile), e.g. "effT3MAPS_t0.50" for an offset of 0.5 s, as well as   //
+//  the orientation used and the efficiencies of each orientation. The        //
+//  efficiencies against the rate and the multiplicity are stored as TH1D     //
+//  with binomial errors, e.g. "effVsRateT3MAPS_t0.50", and so are the        //
+//  efficiency maps of the T3MAPS pixels ("pixelEffT3MAPS_t0.50") and         //
+//  columns ("columnEffT3MAPS_t0.50"), with the FEI4 hits counted for the     //
+//  T3MAPS pixel that they map onto. The pixel counts are also written to     //
+//  pixelEfficiency_<run name>_t0.50.bin (see PixelEfficiency), and when      //
+//  several runs are analysed their sum is stored under the run name          //
+//  "allRuns".                                                                //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -28,18 +57,27 @@
 
 // ROOT includes:
 #include "TFile.h"
+#include "TH1D.h"
+#include "TH2D.h"
 #include "TString.h"
 #include "TTree.h"
 #include "TVirtualFFT.h"
 
 // Package includes:
+#include "AnalysisPipeline.h"
+#include "AnalysisStages.h"
 #include "ChipDimension.h"
+#include "Instrument.h"
 #include "MatchMaker.h"
 #include "PixelCluster.h"
+#include "PixelEfficiency.h"
 #include "PixelHit.h"
 #include "TreeFEI4.h"
 #include "TreeT3MAPS.h"
 #include "PlotUtil.h"
+#include "ResultCache.h"
+#include "ResultsFile.h"
+#include "RunConfig.h"
 #include "MapParameters.h"
 
 using namespace std;
@@ -50,328 +88,296 @@ MapParameters *mapper;
 // Stores the chip geometry:
 ChipDimension *chips = new ChipDimension();
 
-// Store masked pixel locations:
-std::vector<std::pair<int,int> > maskFEI4;
-std::vector<std::pair<int,int> > maskT3MAPS;
+// Sums the pixel counts of all runs:
+PixelEfficiency *pixelsAllRuns = NULL;
 
 /**
-   Checks the mask lists above to see whether the queried hit should be ignored.
-   @param row - the row number of the hit.
-   @param col - the column number of the hit.
-   @param chipName - "FEI4" or "T3MAPS"
-   @returns - true iff the hit should be masked.
- */
-bool isMasked(int row, int col, TString chipName) {
-  std::vector<std::pair<int,int> > currMask;
-  if (chipName.EqualTo("FEI4")) currMask = maskFEI4;
-  else if (chipName.EqualTo("T3MAPS")) currMask = maskT3MAPS;
-  else return true;
-  for (int i_c = 0; i_c < (int)currMask.size(); i_c++) {
-    if ((currMask[i_c].first == row) && (currMask[i_c].second == col)) {
-      return true;
-    }
-  }
-  return false;
-}
-
-/**
-   Check if the mapper expects a hit in one chip to be matched with any of the
-   hits in the other chip.
-   @param hitList - a list of hits in one chip
-   @param singleHit - a single hit in the other chip.
-   @returns - true if the single hit is matched with at least one of the hits
-   in the other chip.
+   Make a curve of the efficiency of one chip against the FEI4 rate or the
+   T3MAPS multiplicity of the scans, with binomial errors.
+   @param name - the name of the histogram.
+   @param binned - the binned matching counters.
+   @param chipName - "FEI4" or "T3MAPS".
+   @param versusRate - true for the rate, false for the multiplicity.
+   @returns - the histogram (owned by the caller).
 */
-bool isHitMatched(TString chipName, std::vector<std::pair<int,int> > hitList,
-		  std::pair<int,int> singleHit) {
-  
-  // These are the nominal positions:
-  int rowNom; int colNom; int rowSigma; int colSigma;
-  if (chipName.EqualTo("T3MAPS")) {
-    rowNom = mapper->getT3MAPSfromFEI4("rowVal", singleHit.first);
-    colNom = mapper->getT3MAPSfromFEI4("colVal", singleHit.second);
-    rowSigma = mapper->getT3MAPSfromFEI4("rowSigma", singleHit.first);
-    colSigma = mapper->getT3MAPSfromFEI4("colSigma", singleHit.second);
+TH1D *getEfficiencyCurve(TString name, const BinnedCounts &binned,
+			 TString chipName, bool versusRate) {
+  int nBins = BinnedCounts::nMultBins;
+  int nOther = BinnedCounts::nRateBins;
+  double width = 1.0;
+  if (versusRate) {
+    nBins = BinnedCounts::nRateBins;
+    nOther = BinnedCounts::nMultBins;
+    width = (double)binned.rateBinWidth;
   }
-  else {
-    rowNom = mapper->getFEI4fromT3MAPS("rowVal", singleHit.first);
-    colNom = mapper->getFEI4fromT3MAPS("colVal", singleHit.second);
-    rowSigma = mapper->getFEI4fromT3MAPS("rowSigma", singleHit.first);
-    colSigma = mapper->getFEI4fromT3MAPS("colSigma", singleHit.second);
-  }
-  
-  // loop over T3MAPS hits, see if any are around the nominal +/- sigma position
-  for (int i = 0; i < (int)hitList.size(); i++) {
-    if (hitList[i].first  >= (rowNom - rowSigma) &&
-	hitList[i].first  <= (rowNom + rowSigma) &&
-	hitList[i].second >= (colNom - colSigma) &&
-	hitList[i].second <= (colNom + colSigma)) {
-      return true;
+  TH1D *curve = new TH1D(name, name, nBins, 0.0, width * nBins);
+  curve->SetDirectory(NULL);
+  curve->GetXaxis()->SetTitle(versusRate ? "FEI4 hits per T3MAPS window" :
+			      "T3MAPS hits per scan");
+  curve->GetYaxis()->SetTitle(Form("%s efficiency", chipName.Data()));
+  for (int i_b = 0; i_b < nBins; i_b++) {
+    int matched = 0;
+    int matchable = 0;
+    for (int i_o = 0; i_o < nOther; i_o++) {
+      const MatchCounts &curr = versusRate ? binned.counts[i_b][i_o] :
+	binned.counts[i_o][i_b];
+      if (chipName.EqualTo("FEI4")) {
+	matched += curr.matchedFEI4;
+	matchable += curr.matchableFEI4;
+      }
+      else {
+	matched += curr.matchedT3MAPS;
+	matchable += curr.matchableT3MAPS;
+      }
     }
+    curve->SetBinContent(i_b+1, HitMatcher::getEfficiency(matched, matchable));
+    curve->SetBinError(i_b+1,
+		       HitMatcher::getEfficiencyError(matched, matchable));
   }
-  return false;
+  return curve;
 }
 
 /**
-   Check whether a hit CAN be matched in the other chip.
-   @param chipName - the name of the chip to match
-   @param singleHit -the hit to be matched in the chipName chip.
-   @returns true iff singleHit is matched in the chipName chip.
+   Store the efficiency maps of the T3MAPS pixels and columns, and the pixel
+   counts in binary form so that they can be summed over runs.
+   @param pixels - the pixel counters.
+   @param runName - the name of the run, or "allRuns" for the sum.
+   @param timeOffset - the FEI4 - T3MAPS time offset in seconds.
 */
-bool canMatchHit(TString chipName, std::pair<int,int> singleHit) {
-  // Check if the hit can be matched in the other chip.
-  int rowNom; int colNom;
-  if (chipName.EqualTo("T3MAPS")) {
-    rowNom = mapper->getT3MAPSfromFEI4("rowVal", singleHit.first);
-    colNom = mapper->getT3MAPSfromFEI4("colVal", singleHit.second);
-  }
-  if (chipName.EqualTo("FEI4")) {
-    rowNom = mapper->getFEI4fromT3MAPS("rowVal", singleHit.first);
-    colNom = mapper->getFEI4fromT3MAPS("colVal", singleHit.second);
+void writePixelEfficiency(PixelEfficiency *pixels, TString runName,
+			  double timeOffset) {
+  TString outputDir = "../TestBeamOutput/TestBeamTracks";
+  TString countsName
+    = ResultsFile::offsetKey(Form("pixelEfficiency_%s", runName.Data()),
+			     timeOffset);
+  pixels->writeFile(Form("%s/%s.bin", outputDir.Data(), countsName.Data()));
+  
+  ResultsFile *results
+    = new ResultsFile(Form("%s/results_%s.root", outputDir.Data(),
+			   runName.Data()), "UPDATE");
+  TString chipNames[2] = {"T3MAPS", "FEI4"};
+  for (int i_c = 0; i_c < 2; i_c++) {
+    TString name = ResultsFile::offsetKey(Form("pixelEff%s",
+					       chipNames[i_c].Data()),
+					  timeOffset);
+    TH2D *map = pixels->toTH2D(name, chipNames[i_c]);
+    results->writeObject(name, map);
+    delete map;
+    name = ResultsFile::offsetKey(Form("columnEff%s", chipNames[i_c].Data()),
+				  timeOffset);
+    TH1D *columns = pixels->toColumnTH1D(name, chipNames[i_c]);
+    results->writeObject(name, columns);
+    delete columns;
   }
-  return chips->isInChip((string)chipName, rowNom, colNom);
+  delete results;
 }
 
 /**
-   The main method just requires an option to run. 
-   @param option - "RunI" or "RunII" to select the desired dataset.
-   @returns - 0. Prints plots to TestBeamOutput/TestBeamTracks/ directory.
+   Run the analysis for a single test beam run.
+   @param config - the run settings.
+   @param options - the job options.
+   @param timeOffset - the FEI4 - T3MAPS time offset in seconds.
 */
-int main(int argc, char **argv) {
-  // Check arguments:
-  if (argc < 3) {
-    std::cout << "\nUsage: " << argv[0] << " <option> <timing>" << std::endl; 
-    exit(0);
-  }
-  TString options = argv[1];
-  double timeOffset = atof(argv[2]);//0.67
+void analyzeRun(RunConfig *config, TString options, double timeOffset) {
+  config->printConfig();
   
   // Fundamental job settings:
-  TString inputT3MAPS = options.Contains("RunII") ?
-    "../TestBeamData/TestBeamData_May9/T3MAPS_May9_RunI.root" :
-    "../TestBeamData/TestBeamData_May3/T3MAPS_May3_RunI.root";
-  TString inputFEI4 = options.Contains("RunII") ?
-    "../TestBeamData/TestBeamData_May9/FEI4_May9_RunI.root" :
-    "../TestBeamData/TestBeamData_May3/FEI4_May3_RunI.root";
-  int noiseThresholdFEI4 = options.Contains("RunII") ? 300 : 600;
-  int noiseThresholdT3MAPS = options.Contains("RunII") ? 15 : 20;
-  double integrationTime = options.Contains("RunII") ? 0.5 : 1.0;
+  TString runName = config->getRunName();
+  TString inputT3MAPS = config->getString("inputT3MAPS");
+  TString inputFEI4 = config->getString("inputFEI4");
+  int noiseThresholdFEI4 = config->getInt("noiseThresholdFEI4");
+  int noiseThresholdT3MAPS = config->getInt("noiseThresholdT3MAPS");
+  int rateBinWidth = config->getInt("rateBinWidth");
+  double integrationTime = config->getDouble("integrationTime");
     
+  // Instantiate the mapping utility with the map of this run (and its
+  // orientation). A run without a map of its own is skipped:
+  mapper = new MapParameters("../TestBeamOutput", "");
+  if (!mapper->loadMapParameters("../TestBeamOutput", runName, -1)) {
+    std::cout << "TestBeamTracks: Skipping " << runName
+	      << ", which has no map." << std::endl;
+    delete mapper;
+    mapper = NULL;
+    return;
+  }
+  
   // Set the output plot style:
   PlotUtil::setAtlasStyle();  
   
-  // Load T3MAPS data:
-  TFile *fileT3MAPS = new TFile(inputT3MAPS);
-  TTree *myTreeT3MAPS = (TTree*)fileT3MAPS->Get("TreeT3MAPS");
-  TreeT3MAPS *cT = new TreeT3MAPS(myTreeT3MAPS);
-  
-  // Load FEI4 data:
-  TFile *fileFEI4 = new TFile(inputFEI4);
-  TTree *myTreeFEI4 = (TTree*)fileFEI4->Get("Table");
-  TreeFEI4 *cF = new TreeFEI4(myTreeFEI4);
-  
   // Load the chip sizes (but use defaults!)
   chips = new ChipDimension();
   
   //----------------------------------------//
-  // Loop over trees initially to identify hot pixels and mask them.
-  // Occupancy for masking:
-  TH2D *totOccFEI4 = new TH2D("totOccFEI4", "totOccFEI4", 
-			      chips->getNRow("FEI4"), -0.5,
-			      (chips->getNRow("FEI4") - 0.5),
-			      chips->getNCol("FEI4"), -0.5,
-			      (chips->getNCol("FEI4") - 0.5));
-  TH2D *totOccT3MAPS = new TH2D("totOccT3MAPS", "totOccT3MAPS", 
-				chips->getNRow("T3MAPS"), -0.5,
-				(chips->getNRow("T3MAPS") - 0.5),
-				chips->getNCol("T3MAPS"), -0.5,
-				(chips->getNCol("T3MAPS") - 0.5));
-  
-  // Loop over T3MAPS tree:
-  Long64_t entriesT3MAPS = cT->fChain->GetEntries();
-  std::cout << "TestBeamTracks: T3MAPS entries = " << entriesT3MAPS
+  // Part One (event building, occupancy and masking) and Part Two (track by
+  // track matching) are stages of the analysis pipeline. The stage products
+  // of earlier jobs with the same inputs are reused:
+  AnalysisPipeline *pipeline = new AnalysisPipeline();
+  ResultCache cache("../TestBeamOutput/cache");
+  addInputTrees(pipeline, inputT3MAPS, inputFEI4,
+		options.Contains("NoCache") ? NULL : &cache);
+  TreeT3MAPS *cT = pipeline->get<TreeT3MAPS>("TreeT3MAPS");
+  TreeFEI4 *cF = pipeline->get<TreeFEI4>("TreeFEI4");
+  std::cout << "TestBeamTracks: T3MAPS entries = "
+	    << cT->fChain->GetEntries() << std::endl;
+  std::cout << "TestBeamTracks: FEI4 entries = " << cF->fChain->GetEntries()
 	    << std::endl;
-  for (Long64_t eventT3MAPS = 0; eventT3MAPS < entriesT3MAPS; eventT3MAPS++) {
-    cT->fChain->GetEntry(eventT3MAPS);
-    // Loop over hits in the event:
-    for (int i_h = 0; i_h < (int)cT->hit_row->size(); i_h++) {
-      totOccT3MAPS->Fill((*cT->hit_row)[i_h], (*cT->hit_column)[i_h]);
-    }
-  }// End of T3MAPS loop
-  
-  // Loop over FEI4 tree:
-  Long64_t entriesFEI4 = cF->fChain->GetEntries();
-  std::cout << "TestBeamOverview: FEI4 entries = " << entriesFEI4 << std::endl;
-  for (Long64_t eventFEI4 = 0; eventFEI4 < entriesFEI4; eventFEI4++) {
-    cF->fChain->GetEntry(eventFEI4);
-    totOccFEI4->Fill(cF->row-1, cF->column-1);
-  }// End of FEI4 loop
-  
-  // Save the BusyT3MAPS pixels:
-  ofstream fBusyFEI4;
-  ofstream fBusyT3MAPS;
-  if (options.Contains("RunII")) {
-    fBusyT3MAPS.open("../TestBeamOutput/TestBeamTracks/busyT3MAPS_RunII.txt");
-    fBusyFEI4.open("../TestBeamOutput/TestBeamTracks/busyFEI4_RunII.txt");
+  addSkimStages(pipeline, chips, noiseThresholdFEI4, noiseThresholdT3MAPS);
+  bool allOrientations = !options.Contains("FixedOrientation");
+  if (allOrientations) {
+    OrientationStage *orientationStage
+      = new OrientationStage(mapper, chips, timeOffset);
+    orientationStage->setScanCuts(config->getInt("maxHitsT3MAPS"),
+				  config->getInt("rowMinT3MAPS"),
+				  config->getInt("rowMaxT3MAPS"));
+    orientationStage->setRateBinWidth(rateBinWidth);
+    pipeline->addStage(orientationStage);
   }
   else {
-    fBusyT3MAPS.open("../TestBeamOutput/TestBeamTracks/busyT3MAPS_RunI.txt");
-    fBusyFEI4.open("../TestBeamOutput/TestBeamTracks/busyFEI4_RunI.txt");
+    MatchStage *matchStage = new MatchStage(mapper, chips, timeOffset);
+    matchStage->setScanCuts(config->getInt("maxHitsT3MAPS"),
+			    config->getInt("rowMinT3MAPS"),
+			    config->getInt("rowMaxT3MAPS"));
+    matchStage->setRateBinWidth(rateBinWidth);
+    pipeline->addStage(matchStage);
   }
+  pipeline->addStage(new EfficiencyStage());
   
-  // Clear masks:
-  maskFEI4.clear();
-  maskT3MAPS.clear();
-  
-  // Fill the FEI4 hit per pixel plots, get mask list:
-  for (int i_r = 1; i_r <= chips->getNRow("FEI4"); i_r++) {
-    for (int i_c = 1; i_c <= chips->getNCol("FEI4"); i_c++) {
-      int currNHits = (int)totOccFEI4->GetBinContent(i_r, i_c);
-      if (currNHits >= noiseThresholdFEI4) {
-	std::pair<int,int> pairFEI4;
-	pairFEI4.first = i_r-1;
-	pairFEI4.second = i_c-1;
-	maskFEI4.push_back(pairFEI4);
-	fBusyFEI4 << i_r << " " << i_c << std::endl;
-      }
-    }
-  }
-  fBusyFEI4.close();
+  std::cout << "TestBeamTracks: Entering loop over events." << std::endl;
+  MatchCounts counts = *pipeline->get<MatchCounts>("MatchCounts");
+  std::cout << "TestBeamTracks: Ending loop over events." << std::endl;
   
-  // Fill the T3MAPS hit per pixel plots, get mask list:
-  for (int i_r = 1; i_r <= chips->getNRow("T3MAPS"); i_r++) {
-    for (int i_c = 1; i_c <= chips->getNCol("T3MAPS"); i_c++) {
-      int currNHits = (int)totOccT3MAPS->GetBinContent(i_r, i_c);
-      if (currNHits > noiseThresholdT3MAPS) {
-	std::pair<int,int> pairT3MAPS;
-	pairT3MAPS.first = i_r-1;
-	pairT3MAPS.second = i_c-1;
-	maskT3MAPS.push_back(pairT3MAPS);
-	fBusyT3MAPS << i_r << " " << i_c << std::endl;
-      }
+  // Use the orientation that matches best from here on:
+  OrientationCounts *orientationCounts = NULL;
+  if (allOrientations) {
+    orientationCounts
+      = pipeline->get<OrientationCounts>("OrientationCounts");
+    std::cout << "\nPrinting efficiencies for each orientation." << std::endl;
+    for (int i_h = 0; i_h < 4; i_h++) {
+      MatchCounts &curr = orientationCounts->counts[i_h];
+      std::cout << "\torientation " << i_h << ": T3MAPS = "
+		<< HitMatcher::getEfficiency(curr.matchedT3MAPS,
+					     curr.matchableT3MAPS)
+		<< "\tFEI4 = "
+		<< HitMatcher::getEfficiency(curr.matchedFEI4,
+					     curr.matchableFEI4) << std::endl;
     }
+    std::cout << "\tUsing orientation " << orientationCounts->bestOrientation
+	      << std::endl;
+    mapper->setOrientation(orientationCounts->bestOrientation);
   }
-  fBusyT3MAPS.close();
-  std::cout << "TestBeamTracks: Found pixels to mask: " << maskT3MAPS.size() 
-	    << " in T3MAPS and " << maskFEI4.size() << " in FEI4." << std::endl;
   
-  //----------------------------------------//
-  // Start Part Two of the analysis -- track by track matching!
-  std::cout << "\n\nTestBeamTracks: Part Two - Track matching" << std::endl;
+  std::cout << "\nPrinting matching statistics." << std::endl;
+  std::cout << "\tTotal Hits T3MAPS = " << counts.totalT3MAPS
+	    << "\tTotal Hits FEI4 = " << counts.totalFEI4 << std::endl;
   
-  int goodHitsT3MAPS_total = 0;
-  int goodHitsT3MAPS_matchable = 0;
-  int goodHitsT3MAPS_matched = 0;
-  int goodHitsFEI4_total = 0;
-  int goodHitsFEI4_matchable = 0;
-  int goodHitsFEI4_matched = 0;
+  EfficiencyResult *efficiency = pipeline->get<EfficiencyResult>("Efficiency");
+  double fracT3MAPS = efficiency->effT3MAPS;
+  double fracFEI4 = efficiency->effFEI4;
+  std::cout << "\tT3MAPS (matched/matchable) = (" << counts.matchedT3MAPS
+	    << " / " << counts.matchableT3MAPS << " ) = " << fracT3MAPS
+	    << std::endl;
   
-  // Instantiate the mapping utility:
-  mapper = new MapParameters("../TestBeamOutput","FromFile");
-  mapper->setOrientation(1);
-    
-  // Prepare FEI4 tree for loop inside T3MAPS tree's loop.
-  Long64_t eventFEI4 = 0;
-  cF->fChain->GetEntry(eventFEI4);
+  std::cout << "\tFEI4 (matched/matchable) = (" << counts.matchedFEI4 << " / "
+	    << counts.matchableFEI4 << " ) = " << fracFEI4 << std::endl;
   
-  // Define the map from T3MAPS <--> FEI4
-  std::cout << "TestBeamTracks: Entering loop over events." << std::endl;
-  for (Long64_t eventT3MAPS = 0; eventT3MAPS < entriesT3MAPS; eventT3MAPS++) {
-    cT->fChain->GetEntry(eventT3MAPS);
-    
-    // Start quality cuts:
-    // Remove T3MAPS events with 12 or more hits in one integration period.
-    if ((*cT->hit_row).size() >= 12) continue;
-    
-    // Create list of good T3MAPS hits:
-    std::vector<std::pair<int,int> > hitsInT3MAPS; hitsInT3MAPS.clear();
-    for (int i_h = 0; i_h < (int)cT->hit_row->size(); i_h++) {
-      // Check for masked T3MAPS pixels:
-      if (!isMasked((*cT->hit_row)[i_h],(*cT->hit_column)[i_h],"T3MAPS")) {
-	if ((*cT->hit_row)[i_h] > 0 && (*cT->hit_row)[i_h] < 17) {
-	  
-	  std::pair<int,int> newHitT3MAPS;
-	  newHitT3MAPS.first = (*cT->hit_row)[i_h];
-	  newHitT3MAPS.second = (*cT->hit_column)[i_h];
-	  goodHitsT3MAPS_total++;
-	
-	  if (canMatchHit("FEI4", newHitT3MAPS)) {
-	    hitsInT3MAPS.push_back(newHitT3MAPS);
-	    goodHitsT3MAPS_matchable++;
-	  }
-	}
-      }
+  // Add the efficiencies of this offset and the masks to the run results:
+  ResultsFile *results
+    = new ResultsFile(Form("../TestBeamOutput/TestBeamTracks/results_%s.root",
+			   runName.Data()), "UPDATE");
+  results->writeValue(ResultsFile::offsetKey("effT3MAPS", timeOffset),
+		      fracT3MAPS);
+  results->writeValue(ResultsFile::offsetKey("effFEI4", timeOffset), fracFEI4);
+  results->writeValue(ResultsFile::offsetKey("totalT3MAPS", timeOffset),
+		      counts.totalT3MAPS);
+  results->writeValue(ResultsFile::offsetKey("matchableT3MAPS", timeOffset),
+		      counts.matchableT3MAPS);
+  results->writeValue(ResultsFile::offsetKey("matchedT3MAPS", timeOffset),
+		      counts.matchedT3MAPS);
+  results->writeValue(ResultsFile::offsetKey("totalFEI4", timeOffset),
+		      counts.totalFEI4);
+  results->writeValue(ResultsFile::offsetKey("matchableFEI4", timeOffset),
+		      counts.matchableFEI4);
+  results->writeValue(ResultsFile::offsetKey("matchedFEI4", timeOffset),
+		      counts.matchedFEI4);
+  results->writeValue(ResultsFile::offsetKey("orientation", timeOffset),
+		      mapper->getOrientation());
+  if (orientationCounts) {
+    for (int i_h = 0; i_h < 4; i_h++) {
+      MatchCounts &curr = orientationCounts->counts[i_h];
+      results->writeValue(ResultsFile::offsetKey(Form("effT3MAPS_orient%d",
+						      i_h), timeOffset),
+			  HitMatcher::getEfficiency(curr.matchedT3MAPS,
+						    curr.matchableT3MAPS));
+      results->writeValue(ResultsFile::offsetKey(Form("effFEI4_orient%d", i_h),
+						 timeOffset),
+			  HitMatcher::getEfficiency(curr.matchedFEI4,
+						    curr.matchableFEI4));
     }
-    
-    // Advance position in the FEI4 tree, store good FEI4 candidates:
-    std::vector<std::pair<int,int> > hitsInFEI4; hitsInFEI4.clear();
-    while (cF->timestamp_start < (cT->timestamp_stop+timeOffset) &&
-	   eventFEI4 < entriesFEI4) {
-      
-      // Exclude column 79 and masked pixels:
-      if (cF->column < 80 && !isMasked(cF->row-1, cF->column-1, "FEI4")) {
-	
-	// Only consider events with timestamp inside that of T3MAPS
-	if (cF->timestamp_start >= (cT->timestamp_start+timeOffset) &&
-	    cF->timestamp_stop <= (cT->timestamp_stop+timeOffset)) {
-	  
-	  std::pair<int,int> newHitFEI4;
-	  newHitFEI4.first = cF->row-1;
-	  newHitFEI4.second = cF->column-1;
-	  goodHitsFEI4_total++;
-	
-	  if (canMatchHit("T3MAPS", newHitFEI4)) {
-	    hitsInFEI4.push_back(newHitFEI4);
-	    goodHitsFEI4_matchable++;
-	  }
-	}
-      }// if passes quality cuts
-      
-      // Then advance to the next FEI4 entry
-      eventFEI4++;
-      cF->fChain->GetEntry(eventFEI4);
-    }// End of loop over FEI4 hits
-    
-    // Now have lists of T3MAPS and FEI4 hits. Check for matches.
-
-    // Loop over FEI4 hits, see if matched in T3MAPS.
-    for (int i_f = 0; i_f < (int)hitsInFEI4.size(); i_f++) {
-      if (isHitMatched("T3MAPS", hitsInT3MAPS, hitsInFEI4[i_f])) {
-	goodHitsFEI4_matched++;
-      }
-    }
-    
-    // Loop over T3MAPS hits, see if matched in FEI4.
-    for (int i_t = 0; i_t < (int)hitsInT3MAPS.size(); i_t++) {
-      if (isHitMatched("FEI4", hitsInFEI4, hitsInT3MAPS[i_t])) {
-	goodHitsT3MAPS_matched++;
-      }
+  }
+  
+  // The efficiencies against the rate and the multiplicity:
+  BinnedCounts *binned = pipeline->get<BinnedCounts>("BinnedCounts");
+  TString chipNames[2] = {"T3MAPS", "FEI4"};
+  for (int i_c = 0; i_c < 2; i_c++) {
+    for (int i_v = 0; i_v < 2; i_v++) {
+      TString name = Form("effVs%s%s", (i_v == 0) ? "Rate" : "Mult",
+			  chipNames[i_c].Data());
+      name = ResultsFile::offsetKey(name, timeOffset);
+      TH1D *curve = getEfficiencyCurve(name, *binned, chipNames[i_c],
+				       i_v == 0);
+      results->writeObject(name, curve);
+      delete curve;
     }
-        
-  }// End of loop over T3MAPS events
-  std::cout << "TestBeamTracks: Ending loop over events." << std::endl;
+  }
+  results->writeMask("MaskT3MAPS", *pipeline->get<PixelList>("MaskT3MAPS"));
+  results->writeMask("MaskFEI4", *pipeline->get<PixelList>("MaskFEI4"));
+  delete results;
   
-  std::cout << "\nPrinting matching statistics." << std::endl;
-  std::cout << "\tTotal Hits T3MAPS = " << goodHitsT3MAPS_total 
-	    << "\tTotal Hits FEI4 = " << goodHitsFEI4_total << std::endl;
+  // The efficiency of each T3MAPS pixel, for this run and all runs so far:
+  PixelEfficiency *pixels
+    = pipeline->get<PixelEfficiency>("PixelEfficiency");
+  writePixelEfficiency(pixels, runName, timeOffset);
+  if (!pixelsAllRuns) {
+    pixelsAllRuns = new PixelEfficiency(pixels->getNRow(), pixels->getNCol());
+  }
+  pixelsAllRuns->add(*pixels);
   
-  double fracT3MAPS = (((double)goodHitsT3MAPS_matched) / 
-		     ((double)goodHitsT3MAPS_matchable));
-  double fracFEI4 = (((double)goodHitsFEI4_matched) / 
-		     ((double)goodHitsFEI4_matchable));
-  std::cout << "\tT3MAPS (matched/matchable) = (" << goodHitsT3MAPS_matched
-	    << " / " << goodHitsT3MAPS_matchable << " ) = " << fracT3MAPS
+  // Deleting the tree readers also closes the input files:
+  delete pipeline;
+  delete cT;
+  delete cF;
+  std::cout << "\nTestBeamTracks: Finished analysis of " << runName << "."
 	    << std::endl;
+}
+
+/**
+   The main method just requires an option to run. 
+   @param option - "RunI" or "RunII" to select the desired dataset.
+   @param timing - the FEI4 - T3MAPS time offset in seconds.
+   @param config - (optional) a run configuration file. Every run in the file
+   is analysed, one after the other.
+   @returns - 0. Prints plots to TestBeamOutput/TestBeamTracks/ directory.
+*/
+int main(int argc, char **argv) {
+  // Check arguments:
+  if (argc < 3) {
+    std::cout << "\nUsage: " << argv[0] << " <option> <timing> [run config]"
+	      << std::endl; 
+    exit(0);
+  }
+  TString options = argv[1];
+  double timeOffset = atof(argv[2]);//0.67
+  TString configFile = argc > 3 ? argv[3] : "";
+  if (options.Contains("Trace")) Instrument::startTrace();
   
-  std::cout << "\tFEI4 (matched/matchable) = (" << goodHitsFEI4_matched << " / "
-	    << goodHitsFEI4_matchable << " ) = " << fracFEI4 << std::endl;
-  
-  // Write efficiencies to file:
-  ofstream effFile(Form("../TestBeamOutput/TestBeamTracks/eff_t%2.2f.txt",
-			timeOffset));
-  effFile << fracT3MAPS << "\t" << fracFEI4 << std::endl;
-  effFile.close();
-  
-  std::cout << "\nTestBeamTracks: Finished analysis." << std::endl;
+  std::vector<RunConfig*> runs = RunConfig::getRuns(options, configFile);
+  for (int i_r = 0; i_r < (int)runs.size(); i_r++) {
+    analyzeRun(runs[i_r], options, timeOffset);
+    delete runs[i_r];
+  }
+  if (runs.size() > 1 && pixelsAllRuns) {
+    writePixelEfficiency(pixelsAllRuns, "allRuns", timeOffset);
+  }
+  delete pixelsAllRuns;
   return 0;
 }
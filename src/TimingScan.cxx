@@ -7,7 +7,15 @@
 //  Date: 14/05/2015                                                          //
 //                                                                            //
 //  This program cross-checks the timing offset between two chips by          //
-//  maximizing the efficiency measurement in TestBeamTracks.cxx.              //
+//  maximizing the efficiency measurement in TestBeamTracks.cxx. The same     //
+//  analysis pipeline is used, so the event building, masking and skimming    //
+//  run once and only the matching is repeated for each offset.               //
+//                                                                            //
+//  A run configuration file (see config/runs.cfg) can be given after the     //
+//  option to scan several runs in turn.                                      //
+//                                                                            //
+//  The efficiency graphs and the best offset are stored in                   //
+//  TestBeamOutput/TimingScan/results.root (see ResultsFile).                 //
 //                                                                            //
 ////////////////////////////////////////////////////////////////////////////////
 
@@ -23,28 +31,70 @@
 // ROOT includes:
 #include "TFile.h"
 #include "TString.h"
+#include "TTree.h"
 
 // Package includes:
+#include "AnalysisPipeline.h"
+#include "AnalysisStages.h"
+#include "ChipDimension.h"
+#include "MapParameters.h"
 #include "PlotUtil.h"
+#include "ResultCache.h"
+#include "ResultsFile.h"
+#include "RunConfig.h"
+#include "TreeFEI4.h"
+#include "TreeT3MAPS.h"
 
 using namespace std;
 
 /**
-   The main method just requires an option to run. 
-   @param option - "RunI" or "RunII" to select the desired dataset.
-   @returns - 0. Prints plots to TestBeamOutput/TimingScan/ directory.
+   Scan the timing offset for a single test beam run.
+   @param config - the run settings.
+   @param option - the job options.
+   @param tagOutput - true to add the run name to the plot name.
 */
-int main(int argc, char **argv) {
-  // Check arguments:
-  if (argc < 2) {
-    std::cout << "\nUsage: " << argv[0] << std::endl; 
-    exit(0);
-  }
-  TString option = argv[1];
+void analyzeRun(RunConfig *config, TString option, bool tagOutput) {
+  config->printConfig();
+  
+  // Fundamental job settings (as in TestBeamTracks):
+  TString runName = config->getRunName();
+  TString inputT3MAPS = config->getString("inputT3MAPS");
+  TString inputFEI4 = config->getString("inputFEI4");
+  int noiseThresholdFEI4 = config->getInt("noiseThresholdFEI4");
+  int noiseThresholdT3MAPS = config->getInt("noiseThresholdT3MAPS");
   
   // Set the output plot style:
   PlotUtil::setAtlasStyle();  
   
+  // Load the map of this run (and its orientation). A run without a map of
+  // its own is skipped:
+  MapParameters *mapper = new MapParameters("../TestBeamOutput", "");
+  if (!mapper->loadMapParameters("../TestBeamOutput", runName, -1)) {
+    std::cout << "TimingScan: Skipping " << runName << ", which has no map."
+	      << std::endl;
+    delete mapper;
+    return;
+  }
+  
+  // Load the chip sizes:
+  ChipDimension *chips = new ChipDimension();
+  
+  // Set up the analysis pipeline, reusing the stage products of earlier jobs
+  // with the same inputs:
+  AnalysisPipeline *pipeline = new AnalysisPipeline();
+  ResultCache cache("../TestBeamOutput/cache");
+  addInputTrees(pipeline, inputT3MAPS, inputFEI4,
+		option.Contains("NoCache") ? NULL : &cache);
+  addSkimStages(pipeline, chips, noiseThresholdFEI4, noiseThresholdT3MAPS);
+  TreeT3MAPS *cT = pipeline->get<TreeT3MAPS>("TreeT3MAPS");
+  TreeFEI4 *cF = pipeline->get<TreeFEI4>("TreeFEI4");
+  MatchStage *matchStage = new MatchStage(mapper, chips, 0.0);
+  matchStage->setScanCuts(config->getInt("maxHitsT3MAPS"),
+			  config->getInt("rowMinT3MAPS"),
+			  config->getInt("rowMaxT3MAPS"));
+  pipeline->addStage(matchStage);
+  pipeline->addStage(new EfficiencyStage());
+  
   // Graphs for results:
   TGraph *gEffT3MAPS = new TGraph();
   TGraph *gEffFEI4 = new TGraph();
@@ -61,13 +111,13 @@ int main(int argc, char **argv) {
   // Loop over timing offsets:
   for (double timing = -4.0; timing <= 4.0; timing += 0.1) {
     
-    // Run the track efficiency program:
-    system(Form("./bin/TestBeamTracks %s %f",option.Data(),timing));
-    
-    // Read the output file:
-    ifstream eFile;
-    eFile.open(Form("../TestBeamOutput/TestBeamTracks/eff_t%2.2f.txt",timing));
-    while (!eFile.eof()) eFile >> effT3MAPS >> effFEI4;
+    // Redo the matching with the new offset:
+    matchStage->setTimeOffset(timing);
+    pipeline->invalidate("MatchCounts");
+    EfficiencyResult *efficiency
+      = pipeline->get<EfficiencyResult>("Efficiency");
+    effT3MAPS = efficiency->effT3MAPS;
+    effFEI4 = efficiency->effFEI4;
     
     // Add efficiencies to graphs:
     gEffT3MAPS->SetPoint(point, timing, effT3MAPS);
@@ -109,10 +159,56 @@ int main(int argc, char **argv) {
   line->SetLineColor(kBlack);
   line->DrawLine(timingMax, gEffT3MAPS->GetYaxis()->GetXmin(),
 		 timingMax, gEffT3MAPS->GetYaxis()->GetXmax());
-  can->Print("../TestBeamOutput/TimingScan/timeEffScan.eps");
+  if (tagOutput) {
+    can->Print(Form("../TestBeamOutput/TimingScan/timeEffScan_%s.eps",
+		    runName.Data()));
+  }
+  else can->Print("../TestBeamOutput/TimingScan/timeEffScan.eps");
   can->Clear();
+  delete can;
   
-  std::cout << "\nTimingScan: Finished analysis." << std::endl;
+  // Store the scan:
+  TString resultsName = tagOutput ?
+    Form("../TestBeamOutput/TimingScan/results_%s.root", runName.Data()) :
+    "../TestBeamOutput/TimingScan/results.root";
+  ResultsFile *results = new ResultsFile(resultsName, "RECREATE");
+  results->writeObject("gEffT3MAPS", gEffT3MAPS);
+  results->writeObject("gEffFEI4", gEffFEI4);
+  results->writeValue("timingMax", timingMax);
+  results->writeValue("effMax", effMax);
+  delete results;
+  
+  // Deleting the tree readers also closes the input files:
+  delete pipeline;
+  delete cT;
+  delete cF;
+  
+  std::cout << "\nTimingScan: Finished analysis of " << runName << "."
+	    << std::endl;
   std::cout << "\t Efficiency maximized for timing=" << timingMax << std::endl;
+}
+
+/**
+   The main method just requires an option to run. 
+   @param option - "RunI" or "RunII" to select the desired dataset.
+   @param config - (optional) a run configuration file. Every run in the file
+   is scanned, one after the other.
+   @returns - 0. Prints plots to TestBeamOutput/TimingScan/ directory.
+*/
+int main(int argc, char **argv) {
+  // Check arguments:
+  if (argc < 2) {
+    std::cout << "\nUsage: " << argv[0] << " <option> [run config]"
+	      << std::endl; 
+    exit(0);
+  }
+  TString option = argv[1];
+  TString configFile = argc > 2 ? argv[2] : "";
+  
+  std::vector<RunConfig*> runs = RunConfig::getRuns(option, configFile);
+  for (int i_r = 0; i_r < (int)runs.size(); i_r++) {
+    analyzeRun(runs[i_r], option, !configFile.IsNull());
+    delete runs[i_r];
+  }
   return 0;
 }